@@ -26,6 +26,10 @@
 #include <utils/compiler.h>
 #include <utils/EntityManager.h>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 namespace filament {
 
 class Camera;
@@ -346,6 +350,28 @@ public:
 
     DebugRegistry& getDebugRegistry() noexcept;
 
+    /**
+     * Returns the JobSystem used by the engine, it can be used to run CPU work in parallel with
+     * the engine's own jobs, e.g. to decode textures while loading an asset.
+     *
+     * Jobs must be created and run from the thread that created the Engine.
+     */
+    utils::JobSystem& getJobSystem() noexcept;
+
+    /**
+     * Returns a report of the variants used by each material, which matc can use to leave the
+     * unused variants out of the material packages (see matc --variant-usage).
+     *
+     * The report is text, with one line per material name: the hexadecimal mask returned by
+     * Material::getUsedVariants() followed by the name. Materials that have been destroyed are
+     * included. Reports of several runs can simply be concatenated.
+     *
+     * @param report Buffer receiving the null-terminated report, can be nullptr.
+     * @param size Size of the buffer in bytes.
+     * @return The length of the report, which is written only if it is less than size.
+     */
+    size_t getVariantUsageReport(char* report, size_t size) const noexcept;
+
 protected:
     //! \privatesection
     Engine() noexcept = default;
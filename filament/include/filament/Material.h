@@ -78,6 +78,26 @@ public:
         Precision precision;
     };
 
+    /**
+     * Rendering features that need dedicated shader variants, used to select the variants to
+     * compile with compile().
+     */
+    enum VariantFeature : uint8_t {
+        DIRECTIONAL_LIGHTING = 0x01,    //!< The scene has a directional light
+        DYNAMIC_LIGHTING     = 0x02,    //!< The scene has point or spot lights
+        SHADOW_RECEIVER      = 0x04,    //!< Renderables using this material receive shadows
+        SKINNING             = 0x08,    //!< Renderables using this material are skinned
+        ALL_VARIANT_FEATURES = 0x0F     //!< All the variants
+    };
+
+    /**
+     * Callback invoked when the variants requested with compile() have been compiled.
+     *
+     * @param material The material that was compiled.
+     * @param user The user data passed to compile().
+     */
+    using CompilationCallback = void(*)(Material* material, void* user);
+
     class Builder : public BuilderBase<BuilderDetails> {
         friend struct BuilderDetails;
     public:
@@ -97,6 +117,23 @@ public:
          */
         Builder& package(const void* payload, size_t size);
 
+        /**
+         * Sets the value of one of the material's specialization constants. The shaders are
+         * specialized with this value when they are compiled, so the code that depends on a
+         * constant costs nothing at runtime, but the value can't change once the material is
+         * built. Constants that are not set keep the default value from the material definition.
+         *
+         * @param name Name of the constant as declared in the material definition.
+         * @param value Value of the constant, its type must match the declaration.
+         *
+         * @exception utils::PreConditionPanic if the material doesn't have this constant or if
+         *            its type is not the same, reported by build().
+         */
+        Builder& constant(const char* name, bool value);
+
+        //! \overload
+        Builder& constant(const char* name, int32_t value);
+
         /**
          * Creates the Material object and returns a pointer to it.
          *
@@ -186,6 +223,42 @@ public:
     //! Indicates whether a parameter of the given name exists on this material.
     bool hasParameter(const char* name) const noexcept;
 
+    /**
+     * Compiles ahead of time the shader variants of this material that rendering the given
+     * features requires. Without this, each variant is compiled the first time it is drawn,
+     * which can cause a hitch.
+     *
+     * The shaders are reconstructed on the Engine's worker threads. The resulting programs are
+     * sent to the backend, and the callback invoked, on the next Renderer::beginFrame() after
+     * that. Variants already compiled are skipped. The callback is not invoked if the material
+     * is destroyed first.
+     *
+     * @param variantFeatures A combination of VariantFeature. All the variants that use a subset
+     *                        of these features are compiled.
+     * @param callback Optional callback invoked once the programs have been created.
+     * @param user User data passed to the callback.
+     */
+    void compile(uint8_t variantFeatures = ALL_VARIANT_FEATURES,
+            CompilationCallback callback = nullptr, void* user = nullptr) noexcept;
+
+    /**
+     * Returns the number of shader programs this material had to compile while rendering,
+     * because their variant had not been compiled ahead of time with compile(). Each of these
+     * compilations can cause a hitch.
+     */
+    size_t getOnDemandCompilationCount() const noexcept;
+
+    /**
+     * Returns the variants of this material that have been used to render, as a bit mask of
+     * variant keys.
+     *
+     * A material package contains shaders for every variant, i.e. every combination of lighting,
+     * shadowing and skinning features, but an application typically uses a few of them only.
+     *
+     * @see Engine::getVariantUsageReport()
+     */
+    uint32_t getUsedVariants() const noexcept;
+
     /**
      * Sets the value of the given parameter on this material's default instance.
      *
@@ -131,6 +131,7 @@ public:
 
     void setAxisAlignedBoundingBox(Instance instance, const Box& aabb) noexcept;
     void setLayerMask(Instance instance, uint8_t select, uint8_t values) noexcept;
+    uint8_t getLayerMask(Instance instance) const noexcept;
     void setPriority(Instance instance, uint8_t priority) noexcept;
     void setCastShadows(Instance instance, bool enable) noexcept;
     void setReceiveShadows(Instance instance, bool enable) noexcept;
@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DRIVER_BLOBCACHE_H
+#define TNT_FILAMENT_DRIVER_BLOBCACHE_H
+
+#include <utils/compiler.h>
+
+#include <string>
+
+#include <stddef.h>
+
+namespace filament {
+namespace driver {
+
+/**
+ * Persistent storage for the compiled programs of a backend, e.g. the output of
+ * glGetProgramBinary() or the content of a VkPipelineCache.
+ *
+ * Keys and values are opaque blobs, whose content depends on the backend and the device. The
+ * backends validate what they read back, so a cache can always be emptied or shared with another
+ * device. A BlobCache is set on the Platform with Platform::setBlobCache(); its methods are
+ * called from the driver thread.
+ *
+ * This is modeled after EGL_ANDROID_blob_cache, so that an implementation can simply forward
+ * these calls to the callbacks provided by Android.
+ */
+class UTILS_PUBLIC BlobCache {
+public:
+    virtual ~BlobCache() noexcept;
+
+    // Stores value under key, replacing any previous entry.
+    virtual void insert(const void* key, size_t keySize,
+            const void* value, size_t valueSize) noexcept = 0;
+
+    // Returns the size of the value stored under key, or 0 if there is none. The value is copied
+    // into the given buffer only if it is large enough, so this can be called with a null buffer
+    // to query the size first.
+    virtual size_t retrieve(const void* key, size_t keySize,
+            void* value, size_t valueSize) noexcept = 0;
+};
+
+/**
+ * A BlobCache that stores each entry in its own file in the given directory, so that programs
+ * compiled by a run of the application can be reused by the next ones.
+ */
+class UTILS_PUBLIC FileBlobCache : public BlobCache {
+public:
+    // the directory is created if needed
+    explicit FileBlobCache(const char* directory) noexcept;
+    ~FileBlobCache() noexcept override;
+
+    void insert(const void* key, size_t keySize,
+            const void* value, size_t valueSize) noexcept override;
+
+    size_t retrieve(const void* key, size_t keySize,
+            void* value, size_t valueSize) noexcept override;
+
+private:
+    std::string getFileName(const void* key, size_t keySize) const noexcept;
+    std::string mDirectory;
+};
+
+} // namespace driver
+} // namespace filament
+
+#endif // TNT_FILAMENT_DRIVER_BLOBCACHE_H
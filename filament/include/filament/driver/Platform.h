@@ -30,6 +30,8 @@ class Driver;
 
 namespace driver {
 
+class BlobCache;
+
 class UTILS_PUBLIC Platform {
 public:
     struct SwapChain {};
@@ -43,6 +45,11 @@ public:
 
     virtual ~Platform() noexcept;
 
+    // Sets the cache used by the driver to store and reuse compiled programs across runs, it must
+    // be set before the Engine is created and outlive it. The Platform doesn't take ownership.
+    void setBlobCache(BlobCache* blobCache) noexcept { mBlobCache = blobCache; }
+    BlobCache* getBlobCache() const noexcept { return mBlobCache; }
+
 protected:
     // Creates and initializes the low-level API (e.g. an OpenGL context or Vulkan instance),
     // then creates the concrete Driver. Returns null on failure.
@@ -53,6 +60,8 @@ private:
     friend class details::FEngine;
     static Platform* create(driver::Backend* backendHint) noexcept;
     static void destroy(Platform** context) noexcept;
+
+    BlobCache* mBlobCache = nullptr;
 };
 
 class UTILS_PUBLIC OpenGLPlatform : public Platform {
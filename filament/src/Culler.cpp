@@ -88,6 +88,32 @@ void Culler::intersects(
     }
 }
 
+void Culler::intersectsConvexVolume(
+        result_type* UTILS_RESTRICT results,
+        filament::math::float4 const* UTILS_RESTRICT planes, size_t planeCount,
+        filament::math::float3 const* UTILS_RESTRICT center,
+        filament::math::float3 const* UTILS_RESTRICT extent,
+        size_t count, size_t bit) noexcept {
+
+    // the number of planes is not known at compile time, so we loop over them in the outer loop,
+    // which keeps the inner loop vectorizable.
+    count = round(count); // capacity guaranteed to be multiple of 8
+    for (size_t j = 0; j < planeCount; j++) {
+        const float4 plane = planes[j];
+        #pragma clang loop vectorize_width(8)
+        for (size_t i = 0; i < count; i++) {
+            const float dot =
+                    plane.x * center[i].x - std::abs(plane.x) * extent[i].x +
+                    plane.y * center[i].y - std::abs(plane.y) * extent[i].y +
+                    plane.z * center[i].z - std::abs(plane.z) * extent[i].z +
+                    plane.w;
+
+            // keep all bits but 'bit', which is kept only if we're inside the plane
+            results[i] &= result_type(~(1 << bit) | (fast::signbit(dot) << bit));
+        }
+    }
+}
+
 /*
  * returns whether a box intersects with the frustum
  */
@@ -135,5 +161,14 @@ void Culler::Test::intersects(
     Culler::intersects(results, frustum, b, count);
 }
 
+void Culler::Test::intersectsConvexVolume(
+        result_type* UTILS_RESTRICT results,
+        filament::math::float4 const* UTILS_RESTRICT planes, size_t planeCount,
+        filament::math::float3 const* UTILS_RESTRICT c,
+        filament::math::float3 const* UTILS_RESTRICT e,
+        size_t count) noexcept {
+    Culler::intersectsConvexVolume(results, planes, planeCount, c, e, count, 0);
+}
+
 } // namespace details
 } // namespace filament
@@ -0,0 +1,116 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "details/DynamicResolutionController.h"
+
+#include <utils/compiler.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace filament {
+namespace details {
+
+constexpr float DynamicResolutionController::GPU_BOUND_RATIO;
+constexpr size_t DynamicResolutionController::MAX_HISTORY;
+
+// this is to avoid a call to memmove
+template<class InputIterator, class OutputIterator>
+static inline
+void move_backward(InputIterator first, InputIterator last, OutputIterator result) {
+    while (first != last) {
+        *--result = *--last;
+    }
+}
+
+template<typename GETTER>
+static float median(std::array<DynamicResolutionController::FrameTimings,
+        DynamicResolutionController::MAX_HISTORY> const& history, size_t size, GETTER get) {
+    std::array<float, DynamicResolutionController::MAX_HISTORY> values; // NOLINT
+    for (size_t i = 0; i < size; i++) {
+        values[i] = get(history[i]);
+    }
+    std::nth_element(values.begin(), values.begin() + size / 2, values.begin() + size);
+    return values[size / 2];
+}
+
+void DynamicResolutionController::reset() noexcept {
+    mHistorySize = 0;
+    mState = {};
+}
+
+float DynamicResolutionController::update(View::DynamicResolutionOptions const& options,
+        FrameTimings const& timings, float currentScale) noexcept {
+
+    if (UTILS_UNLIKELY(timings.gpu <= std::numeric_limits<float>::epsilon())) {
+        // we don't have a valid measure yet
+        return 1.0f;
+    }
+
+    // keep an history of frame timings, this is like doing { pop_back(); push_front(); }
+    details::move_backward(mHistory.begin(), mHistory.end() - 1, mHistory.end());
+    mHistory.front() = timings;
+    mHistorySize = std::min(++mHistorySize, MAX_HISTORY);
+
+    if (UTILS_UNLIKELY(mHistorySize < 3)) {
+        // don't make any decision if we don't have enough data
+        return 1.0f;
+    }
+
+    // apply a median filter to get a good representation of the timings of the last N frames.
+    State& state = mState;
+    const size_t size = std::min(mHistorySize, size_t(options.history));
+    state.filtered.cpu    = median(mHistory, size, [](FrameTimings const& t) { return t.cpu; });
+    state.filtered.driver = median(mHistory, size, [](FrameTimings const& t) { return t.driver; });
+    state.filtered.gpu    = median(mHistory, size, [](FrameTimings const& t) { return t.gpu; });
+
+    const float targetWithHeadroom = options.targetFrameTimeMilli * (1 - options.headRoomRatio);
+    const float cpuTime = std::max(state.filtered.cpu, state.filtered.driver);
+    const float gpuTime = state.filtered.gpu;
+
+    if (gpuTime > cpuTime * GPU_BOUND_RATIO) {
+        state.bottleneck = Bottleneck::GPU;
+        state.gpuBudget = targetWithHeadroom;
+    } else {
+        state.bottleneck = state.filtered.cpu >= state.filtered.driver ?
+                Bottleneck::CPU : Bottleneck::DRIVER;
+        // the GPU can take as long as the cpu without slowing the frame down, we stay a bit
+        // below so we don't become GPU bound because of the higher resolution.
+        state.gpuBudget = std::max(targetWithHeadroom, cpuTime / GPU_BOUND_RATIO);
+    }
+
+    // how much we need to scale the current area so the GPU fits in its budget
+    state.targetScale = currentScale * state.gpuBudget / gpuTime;
+    if (state.bottleneck != Bottleneck::GPU) {
+        // lowering the resolution wouldn't make the frame any faster
+        state.targetScale = std::max(state.targetScale, state.scale);
+    }
+
+    // low-pass: y += b * (x - y)
+    const float oneOverTau = options.scaleRate;
+    state.scale += (1.0f - std::exp(-oneOverTau)) * (state.targetScale - state.scale);
+
+    // don't let the scale wander outside of the range we can actually use
+    const float minScale = options.minScale.x * options.minScale.y;
+    const float maxScale = options.maxScale.x * options.maxScale.y;
+    state.scale = std::min(std::max(state.scale, minScale), maxScale);
+
+    return state.scale;
+}
+
+} // namespace details
+} // namespace filament
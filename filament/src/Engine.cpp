@@ -53,6 +53,7 @@
 #include <functional>
 
 #include <stdio.h>
+#include <string.h>
 
 #include "generated/resources/materials.h"
 
@@ -325,12 +326,34 @@ void FEngine::prepare() {
         }
     }
 
-    // Commit default material instances.
+    // Commit default material instances and the programs compiled ahead of time.
     for (auto& material : mMaterials) {
         material->getDefaultInstance()->commit(*this);
+        material->commitCompilations();
     }
 }
 
+size_t FEngine::getVariantUsageReport(char* report, size_t size) const noexcept {
+    std::map<std::string, uint32_t> usage(mDestroyedMaterialsVariantUsage);
+    for (FMaterial const* material : mMaterials) {
+        if (material->getUsedVariants() && !material->getName().empty()) {
+            usage[material->getName().c_str()] |= material->getUsedVariants();
+        }
+    }
+
+    std::string text;
+    for (auto const& entry : usage) {
+        char mask[16];
+        snprintf(mask, sizeof(mask), "%08x ", entry.second);
+        text.append(mask).append(entry.first).append("\n");
+    }
+
+    if (report && text.size() < size) {
+        memcpy(report, text.c_str(), text.size() + 1);
+    }
+    return text.size();
+}
+
 void FEngine::gc() {
     JobSystem& js = mJobSystem;
     auto parent = js.createJob();
@@ -694,6 +717,9 @@ inline void FEngine::destroy(const FMaterial* ptr) {
                 return;
             }
         }
+        if (ptr->getUsedVariants() && !ptr->getName().empty()) {
+            mDestroyedMaterialsVariantUsage[ptr->getName().c_str()] |= ptr->getUsedVariants();
+        }
         terminateAndDestroy(ptr, mMaterials);
     }
 }
@@ -900,5 +926,13 @@ DebugRegistry& Engine::getDebugRegistry() noexcept {
     return upcast(this)->getDebugRegistry();
 }
 
+utils::JobSystem& Engine::getJobSystem() noexcept {
+    return upcast(this)->getJobSystem();
+}
+
+size_t Engine::getVariantUsageReport(char* report, size_t size) const noexcept {
+    return upcast(this)->getVariantUsageReport(report, size);
+}
+
 
 } // namespace filament
@@ -40,6 +40,12 @@ FrameInfoManager::FrameInfoManager(FEngine& engine)
 FrameInfoManager::~FrameInfoManager() noexcept = default;
 
 void FrameInfo::beginFrame(FrameInfoManager* mgr) {
+    cpuBegin = clock::now();
+    // this must be queued before the fence below, which guarantees that this FrameInfo is
+    // still alive when the driver thread executes it.
+    mgr->getEngine().getDriverApi().queueCommand([this]() {
+        driverBegin = clock::now();
+    });
     Fence* fence = mgr->getEngine().createFence(Fence::Type::HARD);
     mgr->push([this, fence]() {
         Fence::waitAndDestroy(fence, Fence::Mode::DONT_FLUSH);
@@ -56,6 +62,10 @@ void FrameInfo::lap(FrameInfoManager* mgr, lap_id id) {
 }
 
 void FrameInfo::endFrame(FrameInfoManager* mgr) {
+    cpuEnd = clock::now();
+    mgr->getEngine().getDriverApi().queueCommand([this]() {
+        driverEnd = clock::now();
+    });
     Fence* fence = mgr->getEngine().createFence(Fence::Type::HARD);
     mgr->push([this, mgr, fence]() {
         char buf[256];
@@ -68,6 +78,21 @@ void FrameInfo::endFrame(FrameInfoManager* mgr) {
     });
 }
 
+FrameInfo::Timings FrameInfo::getTimings() const noexcept {
+    auto elapsed = [](time_point begin, time_point end) -> duration {
+        // the frame might not have been (completely) recorded
+        if (begin == time_point::max() || end == time_point::max() || end < begin) {
+            return duration{};
+        }
+        return end - begin;
+    };
+    return {
+            elapsed(cpuBegin, cpuEnd),
+            elapsed(driverBegin, driverEnd),
+            elapsed(laps[START], laps[FINISH])
+    };
+}
+
 // ------------------------------------------------------------------------------------------------
 
 void FrameInfoManager::beginFrame(uint32_t frameId) {
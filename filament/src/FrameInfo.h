@@ -68,6 +68,20 @@ public:
 
     uint32_t frame = 0;
     time_point laps[MAX_LAPS_IDS] = { time_point::max() };
+
+    // when the main thread and the driver thread started and finished working on this frame
+    time_point cpuBegin = time_point::max();
+    time_point cpuEnd = time_point::max();
+    time_point driverBegin = time_point::max();
+    time_point driverEnd = time_point::max();
+
+    // time spent by the main thread, the driver thread and the GPU on this frame
+    struct Timings {
+        duration cpu{};
+        duration driver{};
+        duration gpu{};
+    };
+    Timings getTimings() const noexcept;
 };
 
 class FrameInfoManager {
@@ -86,7 +100,7 @@ public:
     explicit FrameInfoManager(FEngine& engine);
     ~FrameInfoManager() noexcept;
 
-    Engine& getEngine() { return mEngine; }
+    FEngine& getEngine() { return mEngine; }
 
     void run() {
         mSyncThread.run();
@@ -123,6 +137,13 @@ public:
         return info.laps[FrameInfo::FINISH] - info.laps[FrameInfo::START];
     }
 
+    // note: the GPU time is measured with fences, so it includes the time the GPU waited
+    // for the driver.
+    FrameInfo::Timings getLastFrameTimings() const noexcept {
+        std::unique_lock<std::mutex> lock(mLock);
+        return mFrameInfoHistory.back().getTimings();
+    }
+
     std::vector<FrameInfo> getHistory() const noexcept {
         std::unique_lock<std::mutex> lock(mLock);
         return mFrameInfoHistory;
@@ -33,8 +33,12 @@
 
 #include <MaterialParser.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
 #include <sstream>
 
 using namespace utils;
@@ -51,6 +55,8 @@ struct Material::BuilderDetails {
     size_t mSize = 0;
     MaterialParser* mMaterialParser = nullptr;
     bool mDefaultMaterial = false;
+    std::vector<Program::SpecializationConstant> mConstants;    // id is unused
+    std::vector<CString> mConstantNames;                         // same order as mConstants
 };
 
 FMaterial::DefaultMaterialBuilder::DefaultMaterialBuilder() : Material::Builder() {
@@ -71,6 +77,18 @@ Material::Builder& Material::Builder::package(const void* payload, size_t size)
     return *this;
 }
 
+Material::Builder& Material::Builder::constant(const char* name, bool value) {
+    mImpl->mConstantNames.emplace_back(name);
+    mImpl->mConstants.push_back({ 0, ConstantType::BOOL, value ? 1 : 0 });
+    return *this;
+}
+
+Material::Builder& Material::Builder::constant(const char* name, int32_t value) {
+    mImpl->mConstantNames.emplace_back(name);
+    mImpl->mConstants.push_back({ 0, ConstantType::INT, value });
+    return *this;
+}
+
 Material* Material::Builder::build(Engine& engine) {
     MaterialParser* materialParser = new MaterialParser(
             upcast(engine).getBackend(), mImpl->mPayload, mImpl->mSize);
@@ -107,11 +125,37 @@ Material* Material::Builder::build(Engine& engine) {
         return nullptr;
     }
 
+    // The constants must be declared by the material with the same type. This is checked here
+    // because the material is created in a noexcept context.
+    std::vector<MaterialConstant> constants;
+    materialParser->getConstants(&constants);
+    CString materialName;
+    materialParser->getName(&materialName);
+    for (size_t i = 0, n = mImpl->mConstants.size(); i < n; i++) {
+        CString const& name = mImpl->mConstantNames[i];
+        auto pos = std::find_if(constants.begin(), constants.end(),
+                [&name](MaterialConstant const& constant) { return constant.name == name; });
+        ASSERT_PRECONDITION(pos != constants.end(),
+                "The material '%s' has no constant named '%s'.",
+                materialName.c_str_safe(), name.c_str_safe());
+        ASSERT_PRECONDITION(pos->type == mImpl->mConstants[i].type,
+                "The constant '%s' of the material '%s' is declared as a %s.",
+                name.c_str_safe(), materialName.c_str_safe(),
+                pos->type == ConstantType::BOOL ? "bool" : "int");
+    }
+
     mImpl->mMaterialParser = materialParser;
 
     return upcast(engine).createMaterial(*this);
 }
 
+static_assert(Material::DIRECTIONAL_LIGHTING == Variant::DIRECTIONAL_LIGHTING &&
+              Material::DYNAMIC_LIGHTING == Variant::DYNAMIC_LIGHTING &&
+              Material::SHADOW_RECEIVER == Variant::SHADOW_RECEIVER &&
+              Material::SKINNING == Variant::SKINNING &&
+              Material::ALL_VARIANT_FEATURES == VARIANT_COUNT - 1,
+        "Material::VariantFeature must match Variant");
+
 namespace details {
 
 FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
@@ -130,6 +174,27 @@ FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
     UTILS_UNUSED_IN_RELEASE bool uibOK = parser->getUIB(&mUniformInterfaceBlock);
     assert(uibOK);
 
+    std::vector<MaterialConstant> constants;
+    UTILS_UNUSED_IN_RELEASE bool constantsOk = parser->getConstants(&constants);
+    assert(constantsOk);
+
+    // The programs are specialized with every constant, set or not, so that the shaders don't
+    // depend on how the driver handles the default values.
+    mSpecializationConstants.reserve(constants.size());
+    for (size_t i = 0, n = constants.size(); i < n; i++) {
+        mSpecializationConstants.push_back(
+                { uint32_t(i), constants[i].type, constants[i].defaultValue });
+    }
+    // the names and types of the constants have been checked by Material::Builder::build()
+    for (size_t i = 0, n = builder->mConstants.size(); i < n; i++) {
+        CString const& name = builder->mConstantNames[i];
+        auto pos = std::find_if(constants.begin(), constants.end(),
+                [&name](MaterialConstant const& constant) { return constant.name == name; });
+        assert(pos != constants.end());
+        mSpecializationConstants[size_t(pos - constants.begin())].value =
+                builder->mConstants[i].value;
+    }
+
     // Populate sampler bindings for the backend that will consume this Material.
     const uint8_t offset = getSamplerBindingsStart(engine.getBackend());
     mSamplerBindings.populate(offset, &mSamplerInterfaceBlock);
@@ -230,7 +295,7 @@ FMaterial::FMaterial(FEngine& engine, const Material::Builder& builder)
         auto& cachedPrograms = mCachedPrograms;
         for (uint8_t i = 0, n = cachedPrograms.size(); i < n; ++i) {
             if (Variant(i).isDepthPass()) {
-                cachedPrograms[i] = engine.getDefaultMaterial()->getProgram(i);
+                cachedPrograms[i] = engine.getDefaultMaterial()->prepareProgram(i);
             }
         }
     }
@@ -250,6 +315,9 @@ FMaterial::~FMaterial() noexcept {
 }
 
 void FMaterial::terminate(FEngine& engine) {
+    // the pending compilations use the parser
+    cancelCompilations();
+
     DriverApi& driverApi = engine.getDriverApi();
     auto& cachedPrograms = mCachedPrograms;
     for (size_t i = 0, n = cachedPrograms.size(); i < n; ++i) {
@@ -279,6 +347,19 @@ bool FMaterial::hasParameter(const char* name) const noexcept {
 }
 
 Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
+    mOnDemandCompilationCount++;
+    return createProgram(variantKey, getProgramBuilder(variantKey,
+            mEngine.getVertexShaderBuilder(), mEngine.getFragmentShaderBuilder()));
+}
+
+Handle<HwProgram> FMaterial::prepareProgram(uint8_t variantKey) const noexcept {
+    Handle<HwProgram> const entry = mCachedPrograms[variantKey];
+    return UTILS_LIKELY(entry) ? entry : createProgram(variantKey, getProgramBuilder(variantKey,
+            mEngine.getVertexShaderBuilder(), mEngine.getFragmentShaderBuilder()));
+}
+
+Program FMaterial::getProgramBuilder(uint8_t variantKey,
+        ShaderBuilder& vsBuilder, ShaderBuilder& fsBuilder) const noexcept {
     const ShaderModel sm = mEngine.getDriver().getShaderModel();
 
     assert(!Variant::isReserved(variantKey));
@@ -290,8 +371,6 @@ Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
      * Vertex shader
      */
 
-    filaflat::ShaderBuilder& vsBuilder = mEngine.getVertexShaderBuilder();
-
     UTILS_UNUSED_IN_RELEASE bool vsOK = mMaterialParser->getShader(sm,
             vertexVariantKey, ShaderType::VERTEX, vsBuilder);
 
@@ -304,8 +383,6 @@ Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
      * Fragment shader
      */
 
-    filaflat::ShaderBuilder& fsBuilder = mEngine.getFragmentShaderBuilder();
-
     UTILS_UNUSED_IN_RELEASE bool fsOK = mMaterialParser->getShader(sm,
             fragmentVariantKey, ShaderType::FRAGMENT, fsBuilder);
 
@@ -319,6 +396,7 @@ Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
             .withVertexShader(vsBuilder.getShader())
             .withFragmentShader(fsBuilder.getShader())
             .withSamplerBindings(&mSamplerBindings)
+            .specializationConstants(mSpecializationConstants)
             .addUniformBlock(BindingPoints::PER_VIEW, &UibGenerator::getPerViewUib())
             .addUniformBlock(BindingPoints::LIGHTS, &UibGenerator::getLightsUib())
             .addUniformBlock(BindingPoints::PER_RENDERABLE, &UibGenerator::getPerRenderableUib())
@@ -329,12 +407,134 @@ Handle<HwProgram> FMaterial::getProgramSlow(uint8_t variantKey) const noexcept {
     if (Variant(variantKey).hasSkinning()) {
         pb.addUniformBlock(BindingPoints::PER_RENDERABLE_BONES, &UibGenerator::getPerRenderableBonesUib());
     }
+    return pb;
+}
 
-    auto program = mEngine.getDriverApi().createProgram(std::move(pb));
-    assert(program);
+Handle<HwProgram> FMaterial::createProgram(uint8_t variantKey, Program&& program) const noexcept {
+    auto handle = mEngine.getDriverApi().createProgram(std::move(program));
+    assert(handle);
 
-    mCachedPrograms[variantKey] = program;
-    return program;
+    mCachedPrograms[variantKey] = handle;
+    return handle;
+}
+
+// A compile() request, the programs are built on the JobSystem and created on the main thread.
+struct FMaterial::Compilation {
+    CompilationCallback callback;
+    void* user;
+    std::vector<uint8_t> variants;
+    std::vector<Program> programs;          // same order as variants
+    std::atomic<uint32_t> remaining = { 0 };
+    JobSystem::Job* job = nullptr;
+};
+
+void FMaterial::compile(uint8_t variantFeatures,
+        CompilationCallback callback, void* user) noexcept {
+    std::unique_ptr<Compilation> compilation(new Compilation);
+    compilation->callback = callback;
+    compilation->user = user;
+
+    // select the variants that only use the requested features
+    bool selected[VARIANT_COUNT] = {};
+    auto select = [&](uint8_t variant) {
+        if (!mCachedPrograms[variant] && !selected[variant]) {
+            selected[variant] = true;
+            compilation->variants.push_back(variant);
+        }
+    };
+    for (uint8_t key = 0; key < VARIANT_COUNT; key++) {
+        if (!Variant::isReserved(key) && !(key & ~variantFeatures)) {
+            select(Variant::filterVariant(key, mIsVariantLit));
+        }
+    }
+    // the depth variants are used for shadow maps, they don't depend on SHADOW_RECEIVER
+    select(Variant::DEPTH_VARIANT);
+    if (variantFeatures & Variant::SKINNING) {
+        select(Variant::DEPTH_VARIANT | Variant::SKINNING);
+    }
+
+    if (!mMaterialParser->prepareShaders()) {
+        compilation->variants.clear();
+    }
+
+    // skip the variants that were left out of the package, e.g. by matc --variant-usage
+    const ShaderModel sm = mEngine.getDriver().getShaderModel();
+    MaterialParser const* const parser = mMaterialParser;
+    auto& variants = compilation->variants;
+    variants.erase(std::remove_if(variants.begin(), variants.end(), [sm, parser](uint8_t v) {
+        return !parser->hasShader(sm, Variant::filterVariantVertex(v), ShaderType::VERTEX) ||
+               !parser->hasShader(sm, Variant::filterVariantFragment(v), ShaderType::FRAGMENT);
+    }), variants.end());
+
+    const uint32_t count = uint32_t(compilation->variants.size());
+    if (count == 0) {
+        // nothing to compile, the callback is still invoked on the next frame
+        mCompilations.push_back(compilation.release());
+        return;
+    }
+
+    compilation->programs.resize(count);
+    compilation->remaining.store(count, std::memory_order_relaxed);
+
+    // The parser is now fully loaded, it can be used from the worker threads.
+    Compilation* const c = compilation.get();
+    FMaterial const* const material = this;
+    JobSystem& js = mEngine.getJobSystem();
+    auto job = jobs::parallel_for(js, nullptr, c->variants.data(), count,
+            [c, material](uint8_t* variants, uint32_t count) {
+                ShaderBuilder vsBuilder;
+                ShaderBuilder fsBuilder;
+                for (uint32_t i = 0; i < count; i++) {
+                    const size_t index = size_t(variants + i - c->variants.data());
+                    c->programs[index] = material->getProgramBuilder(variants[i],
+                            vsBuilder, fsBuilder);
+                }
+                c->remaining.fetch_sub(count, std::memory_order_release);
+            }, jobs::CountSplitter<1, 8>());
+    c->job = js.runAndRetain(job);
+
+    mCompilations.push_back(compilation.release());
+}
+
+void FMaterial::commitCompilations() noexcept {
+    if (UTILS_LIKELY(mCompilations.empty())) {
+        return;
+    }
+
+    JobSystem& js = mEngine.getJobSystem();
+    auto& compilations = mCompilations;
+    for (auto it = compilations.begin(); it != compilations.end();) {
+        Compilation* const c = *it;
+        if (c->remaining.load(std::memory_order_acquire)) {
+            ++it;
+            continue;
+        }
+        if (c->job) {
+            js.waitAndRelease(c->job);
+        }
+        for (size_t i = 0, n = c->variants.size(); i < n; i++) {
+            // the variant might have been needed while we were compiling it
+            if (!mCachedPrograms[c->variants[i]]) {
+                createProgram(c->variants[i], std::move(c->programs[i]));
+            }
+        }
+        if (c->callback) {
+            c->callback(this, c->user);
+        }
+        delete c;
+        it = compilations.erase(it);
+    }
+}
+
+void FMaterial::cancelCompilations() noexcept {
+    JobSystem& js = mEngine.getJobSystem();
+    for (Compilation* c : mCompilations) {
+        if (c->job) {
+            js.waitAndRelease(c->job);
+        }
+        delete c;
+    }
+    mCompilations.clear();
 }
 
 size_t FMaterial::getParameters(ParameterInfo* parameters, size_t count) const noexcept {
@@ -443,6 +643,19 @@ AttributeBitset Material::getRequiredAttributes() const noexcept {
     return upcast(this)->getRequiredAttributes();
 }
 
+void Material::compile(uint8_t variantFeatures,
+        CompilationCallback callback, void* user) noexcept {
+    upcast(this)->compile(variantFeatures, callback, user);
+}
+
+size_t Material::getOnDemandCompilationCount() const noexcept {
+    return upcast(this)->getOnDemandCompilationCount();
+}
+
+uint32_t Material::getUsedVariants() const noexcept {
+    return upcast(this)->getUsedVariants();
+}
+
 bool Material::hasParameter(const char* name) const noexcept {
     return upcast(this)->hasParameter(name);
 }
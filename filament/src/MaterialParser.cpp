@@ -32,6 +32,8 @@
 
 #include <utils/CString.h>
 
+#include <limits>
+
 #include <stdlib.h>
 
 using namespace utils;
@@ -71,6 +73,7 @@ struct MaterialParserDetails {
     // Keep MaterialChunk alive between calls to getShader to avoid reload the shader index.
     driver::Backend mBackend;
     MaterialChunk mMaterialChunk;
+    // References blobs directly inside mUnflattenable
     BlobDictionary mBlobDictionary;
 
     template<typename T>
@@ -84,6 +87,8 @@ struct MaterialParserDetails {
 
     bool getMtlShader(driver::ShaderModel shaderModel, uint8_t variant,
             driver::ShaderType shaderType, ShaderBuilder& shaderBuilder) noexcept;
+
+    bool prepareShaders() noexcept;
 };
 
 template<typename T>
@@ -182,6 +187,20 @@ bool MaterialParser::getSIB(SamplerInterfaceBlock* sib) const noexcept {
     return ChunkSamplerInterfaceBlock().unflatten(unflattener, sib);
 }
 
+bool MaterialParser::getConstants(std::vector<MaterialConstant>* constants) const noexcept {
+    auto type = MaterialConstants;
+    constants->clear();
+    if (!mImpl->mChunkContainer.hasChunk(type)) {
+        return true;
+    }
+
+    const uint8_t* start = mImpl->mChunkContainer.getChunkStart(type);
+    const uint8_t* end = mImpl->mChunkContainer.getChunkEnd(type);
+    Unflattener unflattener(start, end);
+
+    return ChunkMaterialConstants().unflatten(unflattener, constants);
+}
+
 bool MaterialParser::getShaderModels(uint32_t* value) const noexcept {
     return mImpl->getFromSimpleChunk(ChunkType::MaterialShaderModels, value);
 }
@@ -277,7 +296,9 @@ bool MaterialParser::getShader(
     if (mImpl->mBackend == driver::Backend::VULKAN) {
         return mImpl->getVkShader(shaderModel, variant, st, shader);
     }
-    if (mImpl->mBackend == driver::Backend::OPENGL) {
+    // the no-op backend ignores the shaders, it reads the GLSL ones so that materials can be
+    // created in tests
+    if (mImpl->mBackend == driver::Backend::OPENGL || mImpl->mBackend == driver::Backend::NOOP) {
         return mImpl->getGlShader(shaderModel, variant, st, shader);
     }
     if (mImpl->mBackend == driver::Backend::METAL) {
@@ -286,6 +307,55 @@ bool MaterialParser::getShader(
     return false;
 }
 
+bool MaterialParser::prepareShaders() noexcept {
+    return mImpl->prepareShaders();
+}
+
+bool MaterialParser::hasShader(driver::ShaderModel shaderModel, uint8_t variant,
+        driver::ShaderType st) const noexcept {
+    return mImpl->mMaterialChunk.hasShader(uint8_t(shaderModel), variant, uint8_t(st));
+}
+
+bool MaterialParserDetails::prepareShaders() noexcept {
+    ChunkType materialChunk;
+    ChunkType dictionaryChunk;
+    switch (mBackend) {
+        case driver::Backend::VULKAN:
+            materialChunk = ChunkType::MaterialSpirv;
+            dictionaryChunk = ChunkType::DictionarySpirv;
+            break;
+        case driver::Backend::OPENGL:
+        case driver::Backend::NOOP:
+            materialChunk = ChunkType::MaterialGlsl;
+            dictionaryChunk = ChunkType::DictionaryGlsl;
+            break;
+        case driver::Backend::METAL:
+            materialChunk = ChunkType::MaterialMetal;
+            dictionaryChunk = ChunkType::DictionaryMetal;
+            break;
+        default:
+            return false;
+    }
+
+    ChunkContainer const& container = mChunkContainer;
+    if (!container.hasChunk(materialChunk) || !container.hasChunk(dictionaryChunk)) {
+        return false;
+    }
+
+    if (mBlobDictionary.isEmpty()) {
+        bool ok = mBackend == driver::Backend::VULKAN ?
+                SpirvDictionaryReader::unflatten(container, mBlobDictionary, dictionaryChunk) :
+                TextDictionaryReader::unflatten(container, mBlobDictionary, dictionaryChunk);
+        if (!ok) {
+            return false;
+        }
+    }
+
+    Unflattener unflattener(container.getChunkStart(materialChunk),
+            container.getChunkEnd(materialChunk));
+    return mMaterialChunk.initialize(unflattener);
+}
+
 bool MaterialParserDetails::getVkShader(driver::ShaderModel shaderModel, uint8_t variant,
         driver::ShaderType st, ShaderBuilder& shader) noexcept {
 
@@ -457,4 +527,45 @@ bool ChunkSamplerInterfaceBlock::unflatten(Unflattener& unflattener,
     return true;
 }
 
+bool ChunkMaterialConstants::unflatten(Unflattener& unflattener,
+        std::vector<MaterialConstant>* constants) {
+
+    // Read number of constants.
+    uint64_t numConstants = 0;
+    if (!unflattener.read(&numConstants)) {
+        return false;
+    }
+
+    // Each constant needs at least a name terminator, a type and a value, reject counts that the
+    // chunk cannot hold rather than reserving memory for them.
+    constexpr size_t MIN_CONSTANT_SIZE = 1 + sizeof(uint8_t) + sizeof(uint32_t);
+    if (numConstants > std::numeric_limits<uint32_t>::max() ||
+            unflattener.willOverflow(size_t(numConstants) * MIN_CONSTANT_SIZE)) {
+        return false;
+    }
+
+    constants->reserve(numConstants);
+    for (uint64_t i = 0; i < numConstants; i++) {
+        CString name;
+        uint8_t type;
+        uint32_t defaultValue;
+
+        if (!unflattener.read(&name)) {
+            return false;
+        }
+
+        if (!unflattener.read(&type)) {
+            return false;
+        }
+
+        if (!unflattener.read(&defaultValue)) {
+            return false;
+        }
+
+        constants->push_back({ name, driver::ConstantType(type), int32_t(defaultValue) });
+    }
+
+    return true;
+}
+
 } // namespace filaflat
@@ -25,6 +25,8 @@
 #include <utils/compiler.h>
 #include <utils/CString.h>
 
+#include <vector>
+
 #include <inttypes.h>
 
 namespace filaflat {
@@ -39,6 +41,13 @@ class UniformInterfaceBlock;
 class SamplerInterfaceBlock;
 struct MaterialParserDetails;
 
+// A specialization constant declared by the material, its id is its index in the package.
+struct MaterialConstant {
+    utils::CString name;
+    driver::ConstantType type;
+    int32_t defaultValue;
+};
+
 class UTILS_PUBLIC MaterialParser {
 public:
     MaterialParser(driver::Backend backend, const void* data, size_t size);
@@ -58,6 +67,8 @@ public:
     bool getUIB(UniformInterfaceBlock* uib) const noexcept;
     bool getSIB(SamplerInterfaceBlock* sib) const noexcept;
     bool getShaderModels(uint32_t* value) const noexcept;
+    // the list is left empty for materials without specialization constants
+    bool getConstants(std::vector<MaterialConstant>* constants) const noexcept;
 
     bool getDepthWriteSet(bool* value) const noexcept;
     bool getDepthWrite(bool* value) const noexcept;
@@ -82,6 +93,14 @@ public:
             driver::ShaderType st,
             filaflat::ShaderBuilder& shader) noexcept;
 
+    // Loads the shader dictionary and index, getShader() does it as needed. Once they are loaded,
+    // getShader() can be called from several threads at once.
+    bool prepareShaders() noexcept;
+
+    // Returns whether the package has this shader, prepareShaders() must have succeeded.
+    bool hasShader(driver::ShaderModel shaderModel, uint8_t variant,
+            driver::ShaderType st) const noexcept;
+
 protected:
     filaflat::ChunkContainer& getChunkContainer() noexcept;
     filaflat::ChunkContainer const& getChunkContainer() const noexcept;
@@ -96,5 +115,9 @@ struct ChunkSamplerInterfaceBlock {
     bool unflatten(filaflat::Unflattener& unflattener, SamplerInterfaceBlock* sib);
 };
 
+struct ChunkMaterialConstants {
+    bool unflatten(filaflat::Unflattener& unflattener, std::vector<MaterialConstant>* constants);
+};
+
 } // namespace filamat
 #endif
@@ -31,6 +31,8 @@
 #include <utils/JobSystem.h>
 #include <utils/Systrace.h>
 
+#include <algorithm>
+
 using namespace utils;
 using namespace filament::math;
 
@@ -42,14 +44,21 @@ namespace details {
 
 RenderPass::~RenderPass() noexcept = default;
 
-UTILS_ALWAYS_INLINE // this allows the compiler to devirtualize some calls
-inline              // this removes the code from the compilation unit
-void RenderPass::render(
-        FEngine& engine, JobSystem& js,
-        FScene& scene, Range<uint32_t> vr,
+uint32_t RenderPass::getCommandCount(FScene::RenderableSoa const& soa,
+        Range<uint32_t> vr, uint32_t commandTypeFlags) noexcept {
+    uint32_t count = FScene::getPrimitiveCount(soa, vr.first, vr.last);
+    // double the color pass for transparent objects that need to render twice
+    const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
+    const bool depthPass  = bool(commandTypeFlags & (CommandTypeFlags::DEPTH | CommandTypeFlags::SHADOW));
+    count *= uint32_t(colorPass * 2 + depthPass);
+    // and the "eof" command
+    return count + 1;
+}
+
+void RenderPass::generateSortedCommands(JobSystem& js,
+        FScene const& scene, Range<uint32_t> vr,
         uint32_t commandTypeFlags, RenderFlags renderFlags,
-        const CameraInfo& camera, filament::Viewport const& viewport,
-        GrowingSlice<Command>& commands) noexcept {
+        const CameraInfo& camera, GrowingSlice<Command>& commands) noexcept {
 
     SYSTRACE_CONTEXT();
 
@@ -58,24 +67,18 @@ void RenderPass::render(
 
     FScene::RenderableSoa const& soa = scene.getRenderableData();
 
-    // up-to-date summed primitive counts needed for generateCommands()
-    updateSummedPrimitiveCounts(const_cast<FScene::RenderableSoa&>(soa), vr);
-
     // compute how much maximum storage we need for this pass
-    uint32_t growBy = FScene::getPrimitiveCount(soa, vr.last);
-    // double the color pass for transparent objects that need to render twice
-    const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
-    const bool depthPass  = bool(commandTypeFlags & (CommandTypeFlags::DEPTH | CommandTypeFlags::SHADOW));
-    growBy *= uint32_t(colorPass * 2 + depthPass);
+    const uint32_t growBy = getCommandCount(soa, vr, commandTypeFlags) - 1;
     Command* const curr = commands.grow(growBy);
 
     // we extract camera position/forward outside of the loop, because these are not cheap.
     const float3 cameraPosition(camera.getPosition());
     const float3 cameraForwardVector(camera.getForwardVector());
-    auto work = [commandTypeFlags, curr, &soa, renderFlags, cameraPosition, cameraForwardVector]
+    const uint32_t first = vr.first;
+    auto work = [commandTypeFlags, curr, &soa, first, renderFlags, cameraPosition, cameraForwardVector]
             (uint32_t startIndex, uint32_t indexCount) {
         RenderPass::generateCommands(commandTypeFlags, curr,
-                soa, { startIndex, startIndex + indexCount }, renderFlags,
+                soa, first, { startIndex, startIndex + indexCount }, renderFlags,
                 cameraPosition, cameraForwardVector);
     };
 
@@ -96,6 +99,13 @@ void RenderPass::render(
         SYSTRACE_NAME("sort commands");
         std::sort(commands.begin(), commands.end());
     }
+}
+
+UTILS_ALWAYS_INLINE // this allows the compiler to devirtualize some calls
+inline              // this removes the code from the compilation unit
+void RenderPass::execute(FEngine& engine, FScene& scene,
+        const CameraInfo& camera, filament::Viewport const& viewport,
+        Slice<Command> const& commands) noexcept {
 
     // Take care not to upload data within the render pass (synchronize can commit froxel data)
     driver::DriverApi& driver = engine.getDriverApi();
@@ -205,7 +215,8 @@ void RenderPass::setupColorCommand(Command& cmdDraw, bool hasDepthPass,
 /* static */
 UTILS_NOINLINE
 void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const commands,
-        FScene::RenderableSoa const& soa, utils::Range<uint32_t> range, RenderFlags renderFlags,
+        FScene::RenderableSoa const& soa, uint32_t first,
+        utils::Range<uint32_t> range, RenderFlags renderFlags,
         filament::math::float3 cameraPosition, filament::math::float3 cameraForward) noexcept {
 
     // generateCommands() writes both the draw and depth commands simultaneously such that
@@ -214,7 +225,8 @@ void RenderPass::generateCommands(uint32_t commandTypeFlags, Command* const comm
     // the list twice)
 
     // compute how much maximum storage we need
-    uint32_t offset = FScene::getPrimitiveCount(soa, range.first);
+    // (the summed primitive counts are shared by all passes, so they're relative to 'first')
+    uint32_t offset = FScene::getPrimitiveCount(soa, first, range.first);
     // double the color pass for transparents that need to render twice
     const bool colorPass  = bool(commandTypeFlags & CommandTypeFlags::COLOR);
     const bool depthPass  = bool(commandTypeFlags & (CommandTypeFlags::DEPTH | CommandTypeFlags::SHADOW));
@@ -484,6 +496,37 @@ void RenderPass::updateSummedPrimitiveCounts(
 // inlining and devirtualization.
 // ------------------------------------------------------------------------------------------------
 
+RenderPass::RenderFlags FRenderer::getRenderFlags(FView const& view) noexcept {
+    RenderPass::RenderFlags flags = 0;
+    if (view.hasShadowing())               flags |= RenderPass::HAS_SHADOWING;
+    if (view.hasDirectionalLight())        flags |= RenderPass::HAS_DIRECTIONAL_LIGHT;
+    if (view.hasDynamicLighting())         flags |= RenderPass::HAS_DYNAMIC_LIGHTING;
+    if (view.isFrontFaceWindingInverted()) flags |= RenderPass::HAS_INVERSE_FRONT_FACES;
+    return flags;
+}
+
+void FRenderer::updateRenderables(FEngine& engine, FView& view) noexcept {
+    // The shadow and color passes generate their commands concurrently, so the data they share
+    // is updated once for both, beforehand. The visible renderables and shadow casters are
+    // contiguous and overlapping ranges starting at the visible renderables.
+    auto& soa = view.getScene()->getRenderableData();
+    Range<uint32_t> vr = view.getVisibleRenderables();
+    if (view.hasShadowing()) {
+        Range<uint32_t> const& casters = view.getVisibleShadowCasters();
+        vr.first = std::min(vr.first, casters.first);
+        vr.last = std::max(vr.last, casters.last);
+    }
+
+    // populate the RenderPrimitive array with the proper LOD
+    // (the level of detail doesn't depend on the camera yet, so both passes share it)
+    view.updatePrimitivesLod(engine, view.getCameraInfo(), soa, vr);
+
+    // up-to-date summed primitive counts needed for generateCommands()
+    RenderPass::updateSummedPrimitiveCounts(soa, vr);
+}
+
+// ------------------------------------------------------------------------------------------------
+
 FRenderer::ColorPass::ColorPass(const char* name,
         JobSystem& js, JobSystem::Job* jobFroxelize, FView& view, Handle<HwRenderTarget> const rth)
         : RenderPass(name), js(js), jobFroxelize(jobFroxelize), view(view), rth(rth) {
@@ -545,50 +588,43 @@ void FRenderer::ColorPass::endRenderPass(DriverApi& driver, filament::Viewport c
     }
 }
 
-void FRenderer::ColorPass::renderColorPass(FEngine& engine,
-        JobSystem& js, JobSystem::Job* sync,
-        Handle<HwRenderTarget> const rth, FView& view, filament::Viewport const& scaledViewport,
-        GrowingSlice<Command>& commands) noexcept {
-
-    CameraInfo const& cameraInfo = view.getCameraInfo();
-    auto& soa = view.getScene()->getRenderableData();
-    auto vr = view.getVisibleRenderables();
-
-    // populate the RenderPrimitive array with the proper LOD
-    view.updatePrimitivesLod(engine, cameraInfo, soa, vr);
-
-    DriverApi& driver = engine.getDriverApi();
-    view.prepareCamera(cameraInfo, scaledViewport);
-    view.commitUniforms(driver);
-
-    RenderPass::RenderFlags flags = 0;
-    if (view.hasShadowing())               flags |= RenderPass::HAS_SHADOWING;
-    if (view.hasDirectionalLight())        flags |= RenderPass::HAS_DIRECTIONAL_LIGHT;
-    if (view.hasDynamicLighting())         flags |= RenderPass::HAS_DYNAMIC_LIGHTING;
-    if (view.isFrontFaceWindingInverted()) flags |= RenderPass::HAS_INVERSE_FRONT_FACES;
-
-    CommandTypeFlags commandType;
+RenderPass::CommandTypeFlags FRenderer::ColorPass::getCommandType(FView const& view) noexcept {
     switch (view.getDepthPrepass()) {
         case View::DepthPrepass::DEFAULT:
             // TODO: better default strategy (can even change on a per-frame basis)
 #if defined(ANDROID) || defined(__EMSCRIPTEN__)
-            commandType = COLOR;
+            return COLOR;
 #else
-            commandType = DEPTH_AND_COLOR;
+            return DEPTH_AND_COLOR;
 #endif
-            break;
         case View::DepthPrepass::DISABLED:
-            commandType = COLOR;
-            break;
+            return COLOR;
         case View::DepthPrepass::ENABLED:
-            commandType = DEPTH_AND_COLOR;
-            break;
+            return DEPTH_AND_COLOR;
     }
+    return COLOR;
+}
+
+void FRenderer::ColorPass::prepareColorPass(JobSystem& js, FView const& view,
+        GrowingSlice<Command>& commands) noexcept {
+    RenderPass::generateSortedCommands(js, *view.getScene(), view.getVisibleRenderables(),
+            getCommandType(view), getRenderFlags(view), view.getCameraInfo(), commands);
+}
+
+void FRenderer::ColorPass::renderColorPass(FEngine& engine,
+        JobSystem& js, JobSystem::Job* sync,
+        Handle<HwRenderTarget> const rth, FView& view, filament::Viewport const& scaledViewport,
+        Slice<Command> const& commands) noexcept {
+
+    CameraInfo const& cameraInfo = view.getCameraInfo();
+
+    DriverApi& driver = engine.getDriverApi();
+    view.prepareCamera(cameraInfo, scaledViewport);
+    view.commitUniforms(driver);
 
     ColorPass colorPass("ColorPass", js, sync, view, rth);
     driver.pushGroupMarker("Color Pass");
-    colorPass.render(engine, js, *view.getScene(), vr, commandType, flags,
-            cameraInfo, scaledViewport, commands);
+    colorPass.execute(engine, *view.getScene(), cameraInfo, scaledViewport, commands);
     driver.popGroupMarker();
 }
 
@@ -604,16 +640,9 @@ void FRenderer::ShadowPass::beginRenderPass(driver::DriverApi& driver,
     shadowMap.beginRenderPass(driver);
 }
 
-void FRenderer::ShadowPass::renderShadowMap(FEngine& engine, JobSystem& js,
-        FView& view, GrowingSlice<Command>& commands) noexcept {
-
-    auto& soa = view.getScene()->getRenderableData();
-    auto vr = view.getVisibleShadowCasters();
-    ShadowMap const& shadowMap = view.getShadowMap();
-    filament::Viewport const& viewport = shadowMap.getViewport();
+CameraInfo FRenderer::ShadowPass::getCameraInfo(ShadowMap const& shadowMap) noexcept {
     FCamera const& camera = shadowMap.getCamera();
-
-    CameraInfo cameraInfo = {
+    return {
             .projection         = mat4f{ camera.getProjectionMatrix() },
             .cullingProjection  = mat4f{ camera.getCullingProjectionMatrix() },
             .model              = camera.getModelMatrix(),
@@ -621,24 +650,29 @@ void FRenderer::ShadowPass::renderShadowMap(FEngine& engine, JobSystem& js,
             .zn                 = camera.getNear(),
             .zf                 = camera.getCullingFar(),
     };
+}
 
-    // populate the RenderPrimitive array with the proper LOD
-    view.updatePrimitivesLod(engine, cameraInfo, soa, vr);
+void FRenderer::ShadowPass::prepareShadowMap(JobSystem& js, FView const& view,
+        GrowingSlice<Command>& commands) noexcept {
+    RenderPass::generateSortedCommands(js, *view.getScene(), view.getVisibleShadowCasters(),
+            CommandTypeFlags::SHADOW, getRenderFlags(view),
+            getCameraInfo(view.getShadowMap()), commands);
+}
+
+void FRenderer::ShadowPass::renderShadowMap(FEngine& engine,
+        FView& view, Slice<Command> const& commands) noexcept {
+
+    ShadowMap const& shadowMap = view.getShadowMap();
+    filament::Viewport const& viewport = shadowMap.getViewport();
+    const CameraInfo cameraInfo = getCameraInfo(shadowMap);
 
     driver::DriverApi& driver = engine.getDriverApi();
     view.prepareCamera(cameraInfo, viewport);
     view.commitUniforms(driver);
 
-    RenderPass::RenderFlags flags = 0;
-    if (view.hasShadowing())               flags |= RenderPass::HAS_SHADOWING;
-    if (view.hasDirectionalLight())        flags |= RenderPass::HAS_DIRECTIONAL_LIGHT;
-    if (view.hasDynamicLighting())         flags |= RenderPass::HAS_DYNAMIC_LIGHTING;
-    if (view.isFrontFaceWindingInverted()) flags |= RenderPass::HAS_INVERSE_FRONT_FACES;
-
     ShadowPass shadowPass("ShadowPass", shadowMap);
     driver.pushGroupMarker("Shadow map Pass");
-    shadowPass.render(engine, js, *view.getScene(), vr,
-            CommandTypeFlags::SHADOW, flags, cameraInfo, viewport, commands);
+    shadowPass.execute(engine, *view.getScene(), cameraInfo, viewport, commands);
     driver.popGroupMarker();
 }
 
@@ -206,13 +206,24 @@ public:
 
     virtual ~RenderPass() noexcept;
 
-    // appends rendering commands for the given view
-    void render(
-            FEngine& engine, utils::JobSystem& js,
-            FScene& scene, utils::Range<uint32_t> visibleRenderables,
+    // Returns the maximum number of commands generateSortedCommands() appends for the given
+    // renderables, including the sentinel command. The summed primitive counts must be up-to-date.
+    static uint32_t getCommandCount(FScene::RenderableSoa const& soa,
+            utils::Range<uint32_t> visibleRenderables, uint32_t commandTypeFlags) noexcept;
+
+    // Appends the sorted rendering commands for the given renderables. This doesn't use the
+    // driver and only reads the scene, so it can run on any thread, concurrently with other
+    // passes. The primitives and summed primitive counts of the renderables must be up-to-date.
+    static void generateSortedCommands(utils::JobSystem& js,
+            FScene const& scene, utils::Range<uint32_t> visibleRenderables,
             uint32_t commandTypeFlags, RenderFlags renderFlags,
+            const CameraInfo& camera, utils::GrowingSlice<Command>& commands) noexcept;
+
+    // Records the driver commands for commands generated by generateSortedCommands().
+    // This must be called from the engine thread.
+    void execute(FEngine& engine, FScene& scene,
             const CameraInfo& camera, Viewport const& viewport,
-            utils::GrowingSlice<Command>& commands) noexcept;
+            utils::Slice<Command> const& commands) noexcept;
 
 private:
     // Called just before rendering, make sure all needed asynchronous tasks are finished.
@@ -238,7 +249,8 @@ private:
             "Size of Commands jobs must be multiple of a cache-line size");
 
     static inline void generateCommands(uint32_t commandTypeFlags, Command* commands,
-            FScene::RenderableSoa const& soa, utils::Range<uint32_t> range, RenderFlags renderFlags,
+            FScene::RenderableSoa const& soa, uint32_t first,
+            utils::Range<uint32_t> range, RenderFlags renderFlags,
             filament::math::float3 cameraPosition, filament::math::float3 cameraForward) noexcept;
 
     template<uint32_t commandTypeFlags>
@@ -52,6 +52,7 @@ FRenderer::FRenderer(FEngine& engine) :
         mEngine(engine),
         mFrameSkipper(engine, 2),
         mFrameInfoManager(engine),
+        mResourceAllocator(engine.getDriverApi()),
         mIsRGB16FSupported(false),
         mIsRGB8Supported(false),
         mPerRenderPassArena(engine.getPerRenderPassAllocator())
@@ -87,6 +88,7 @@ void FRenderer::terminate(FEngine& engine) {
     // shut down threads if we created any.
     DriverApi& driver = engine.getDriverApi();
     driver.destroyRenderTarget(mRenderTarget);
+    mResourceAllocator.terminate();
 
     // before we can destroy this Renderer's resources, we must make sure
     // that all pending commands have been executed (as they could reference data in this
@@ -163,7 +165,9 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
     filament::Viewport const& vp = view.getViewport();
     const bool hasPostProcess = view.hasPostProcessPass();
-    float2 scale = view.updateScale(mFrameInfoManager.getLastFrameTime());
+    const FrameInfo::Timings timings = mFrameInfoManager.getLastFrameTimings();
+    float2 scale = view.updateScale(
+            { timings.cpu.count(), timings.driver.count(), timings.gpu.count() });
     bool useFXAA = view.getAntiAliasing() == View::AntiAliasing::FXAA;
     if (!hasPostProcess) {
         // dynamic scaling and FXAA are part of the post-process phase and can't happen if
@@ -184,31 +188,33 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     JobSystem::Job* jobFroxelize = js.runAndRetain(js.createJob(nullptr,
             [&engine, &view](JobSystem&, JobSystem::Job*) { view.froxelize(engine); }));
 
+    // update the renderable data shared by the shadow and color passes
+    updateRenderables(engine, view);
+
     /*
-     * Allocate command buffer.
+     * Allocate command buffers.
+     * The shadow and color passes generate their commands concurrently, so they each get their
+     * own part of the buffer, sized for the maximum number of commands they can generate.
      */
 
     const size_t commandsSize = FEngine::CONFIG_PER_FRAME_COMMANDS_SIZE;
     const size_t commandsCount = commandsSize / sizeof(Command);
-    GrowingSlice<Command> commands(
-            arena.allocate<Command>(commandsCount, CACHELINE_SIZE), commandsCount);
-
-    /*
-     * Shadow pass
-     */
+    Command* const commandsBuffer = arena.allocate<Command>(commandsCount, CACHELINE_SIZE);
 
-    if (view.hasShadowing()) {
-        ShadowPass::renderShadowMap(engine, js, view, commands);
-        recordHighWatermark(commands); // for debugging
-        // reset the command buffer
-        commands.clear();
-    }
+    auto const& soa = view.getScene()->getRenderableData();
+    const size_t shadowCommandsCount = view.hasShadowing() ?
+            RenderPass::getCommandCount(soa, view.getVisibleShadowCasters(),
+                    RenderPass::CommandTypeFlags::SHADOW) : 0;
+    assert(shadowCommandsCount <= commandsCount);
+    GrowingSlice<Command> shadowCommands(commandsBuffer, shadowCommandsCount);
+    GrowingSlice<Command> colorCommands(commandsBuffer + shadowCommandsCount,
+            commandsCount - shadowCommandsCount);
 
     /*
      * Frame graph
      */
 
-    FrameGraph fg;
+    FrameGraph fg(mResourceAllocator);
 
     const TextureFormat hdrFormat = getHdrFormat(view);
     const uint8_t useMSAA = view.getSampleCount();
@@ -223,6 +229,29 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
     FrameGraphResource output = fg.importResource("viewRenderTarget",
             { .viewport = vp }, viewRenderTarget, vp.width, vp.height);
 
+    /*
+     * Shadow pass
+     */
+
+    if (view.hasShadowing()) {
+        struct ShadowPassData {
+        };
+
+        // the shadow map isn't managed by the FrameGraph, this pass is only kept by its
+        // side effect.
+        fg.addPass<ShadowPassData>("Shadow pass",
+                [&](FrameGraph::Builder& builder, ShadowPassData& data) {
+                    builder.sideEffect();
+                },
+                [&js, &view, &shadowCommands](ShadowPassData& data) {
+                    ShadowPass::prepareShadowMap(js, view, shadowCommands);
+                },
+                [&engine, &view, &shadowCommands](FrameGraphPassResources const& resources,
+                        ShadowPassData const& data, DriverApi& driver) {
+                    ShadowPass::renderShadowMap(engine, view, shadowCommands);
+                });
+    }
+
     /*
      * Depth + Color passes
      */
@@ -250,13 +279,16 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
                 };
                 data.color = builder.useRenderTarget("colorRenderTarget", desc).textures[0];
             },
-            [=, &engine, &js, &view, &commands]
+            [&js, &view, &colorCommands](ColorPassData& data) {
+                ColorPass::prepareColorPass(js, view, colorCommands);
+            },
+            [=, &engine, &js, &view, &colorCommands]
                     (FrameGraphPassResources const& resources,
                             ColorPassData const& data, DriverApi& driver) {
                 auto out = resources.getRenderTarget(data.color);
                 ColorPass::renderColorPass(engine, js, jobFroxelize, out.target, view,
                         static_cast<filament::Viewport const&>(out.params.viewport),
-                        commands);
+                        colorCommands);
             });
 
     FrameGraphResource input = colorPass.getData().color;
@@ -282,12 +314,12 @@ void FRenderer::renderJob(ArenaScope& arena, FView& view) {
 
     fg.moveResource(output, input);
 
-    fg.compile();
+    fg.compile(mCompiledGraph);
     //fg.export_graphviz(slog.d);
-    fg.execute(driver);
+    fg.execute(js, driver);
 
     // for debugging
-    recordHighWatermark(commands);
+    recordHighWatermark(shadowCommands.size() + colorCommands.size());
 }
 
 void FRenderer::mirrorFrame(FSwapChain* dstSwapChain, filament::Viewport const& dstViewport,
@@ -411,6 +443,9 @@ void FRenderer::endFrame() {
         mSwapChain = nullptr;
     }
 
+    // evict the FrameGraph resources we haven't used in a while
+    mResourceAllocator.gc();
+
     driver.endFrame(mFrameId);
 
     // Run the component managers' GC in parallel
@@ -26,6 +26,7 @@
 
 #include <filament/driver/DriverEnums.h>
 
+#include <algorithm>
 #include <limits>
 
 using namespace filament::math;
@@ -198,6 +199,8 @@ void ShadowMap::computeShadowCameraDirectional(
         filament::math::float3 const& dir, FScene const* scene, CameraInfo const& camera,
         uint8_t visibleLayers) noexcept {
 
+    mCasterCullingPlaneCount = 0;
+
     // scene bounds in world space
     Aabb wsShadowCastersVolume, wsShadowReceiversVolume;
     scene->computeBounds(wsShadowCastersVolume, wsShadowReceiversVolume, visibleLayers);
@@ -392,6 +395,12 @@ void ShadowMap::computeShadowCameraDirectional(
 
         // for the debug camera, we need to undo the world origin
         mDebugCamera->setCustomProjection(mat4(S * camera.worldOrigin), znear, zfar);
+
+        // Only the shadow casters inside the visible receivers volume extruded towards the light
+        // can cast a visible shadow. This volume is tighter than the light frustum, which is
+        // only its bounding box in light space.
+        mCasterCullingPlaneCount = computeCasterCullingPlanes(mCasterCullingPlanes.data(),
+                dir, mWsClippedShadowReceiverVolume.data(), vertexCount);
     }
 }
 
@@ -581,6 +590,70 @@ void ShadowMap::intersectWithShadowCasters(
     lightFrustum.max.xy = min(box.max.xy, lightFrustum.max.xy);
 }
 
+size_t ShadowMap::computeCasterCullingPlanes(
+        float4* UTILS_RESTRICT planes,
+        float3 const& dir,
+        float3 const* UTILS_RESTRICT wsReceiverVertices,
+        size_t vertexCount) noexcept {
+
+    // note: planes must have room for vertexCount + 1 entries
+    assert(vertexCount <= std::tuple_size<FrustumBoxIntersection>::value);
+    if (vertexCount == 0) {
+        return 0;
+    }
+
+    // light-space, the light looks down the -z axis
+    const mat4f M = mat4f::lookAt(float3{ 0, 0, 0 }, dir, float3{ 0, 1, 0 });
+    const mat4f Mv = FCamera::rigidTransformInverse(M);
+    const mat4f Mvt = transpose(Mv);
+
+    // project the receivers onto the light's plane and find the farthest one from the light
+    float2 lsVertices[std::tuple_size<FrustumBoxIntersection>::value];
+    float zfar = std::numeric_limits<float>::max();
+    #pragma clang loop vectorize(disable)
+    for (size_t i = 0; i < vertexCount; ++i) {
+        const float3 v = mat4f::project(Mv, wsReceiverVertices[i]);
+        lsVertices[i] = v.xy;
+        zfar = std::min(zfar, v.z);
+    }
+
+    size_t planeCount = 0;
+
+    // shadow casters farther than all receivers can't cast shadows on them
+    planes[planeCount++] = Mvt * float4{ 0, 0, -1, zfar };
+
+    // 2D convex-hull of the receivers in light space (Andrew's monotone chain), counter-clockwise
+    std::sort(lsVertices, lsVertices + vertexCount, [](float2 const& lhs, float2 const& rhs) {
+        return lhs.x < rhs.x || (lhs.x == rhs.x && lhs.y < rhs.y);
+    });
+    auto turn = [](float2 o, float2 a, float2 b) {
+        return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+    };
+    float2 hull[std::tuple_size<FrustumBoxIntersection>::value + 1];
+    size_t k = 0;
+    for (size_t i = 0; i < vertexCount; ++i) {
+        while (k >= 2 && turn(hull[k - 2], hull[k - 1], lsVertices[i]) <= 0) k--;
+        hull[k++] = lsVertices[i];
+    }
+    for (size_t i = vertexCount - 1, t = k + 1; i > 0; --i) {
+        while (k >= t && turn(hull[k - 2], hull[k - 1], lsVertices[i - 1]) <= 0) k--;
+        hull[k++] = lsVertices[i - 1];
+    }
+    // the last vertex of the hull is the same as its first one
+    const size_t hullVertexCount = k - 1;
+
+    if (hullVertexCount >= 3) {
+        // each edge of the hull, extruded along the light direction, is a culling plane
+        for (size_t i = 0; i < hullVertexCount; ++i) {
+            const float2 e = hull[i + 1] - hull[i];
+            const float2 n = normalize(float2{ e.y, -e.x }); // outwards b/c hull is CCW
+            planes[planeCount++] = Mvt * float4{ n, 0, -dot(n, hull[i]) };
+        }
+    }
+
+    return planeCount;
+}
+
 void ShadowMap::computeFrustumCorners(
         float3* UTILS_RESTRICT out,
         const mat4f& UTILS_RESTRICT projectionViewInverse) noexcept {
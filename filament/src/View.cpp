@@ -140,9 +140,8 @@ void FView::setDynamicResolutionOptions(DynamicResolutionOptions const& options)
         dynamicResolution.maxScale = min(dynamicResolution.maxScale, float2(2.0f));
 
         // reset the history, so we start from a known (and current) state
-        mFrameTimeHistorySize = 0;
+        mDynamicResolutionController.reset();
         mScale = 1.0f;
-        mDynamicWorkloadScale = 1.0f;
     }
 }
 
@@ -150,57 +149,13 @@ void FView::setDynamicLightingOptions(float zLightNear, float zLightFar) noexcep
     mFroxelizer.setOptions(zLightNear, zLightFar);
 }
 
-// this is to avoid a call to memmove
-template<class InputIterator, class OutputIterator>
-static inline
-void move_backward(InputIterator first, InputIterator last, OutputIterator result) {
-    while (first != last) {
-        *--result = *--last;
-    }
-}
-
-math::float2 FView::updateScale(duration frameTime) noexcept {
+math::float2 FView::updateScale(FrameTimings const& timings) noexcept {
     DynamicResolutionOptions const& options = mDynamicResolution;
     if (options.enabled) {
 
-        if (UTILS_UNLIKELY(frameTime.count() <= std::numeric_limits<float>::epsilon())) {
-            mScale = 1.0f;
-            return mScale;
-        }
-
-        // keep an history of frame times
-        auto& history = mFrameTimeHistory;
-
-        // this is like doing { pop_back(); push_front(); }
-        details::move_backward(history.begin(), history.end() - 1, history.end());
-        history.front() = frameTime;
-        mFrameTimeHistorySize = std::min(++mFrameTimeHistorySize, size_t(MAX_FRAMETIME_HISTORY));
-
-        if (UTILS_UNLIKELY(mFrameTimeHistorySize < 3)) {
-            // don't make any decision if we don't have enough data
-            mScale = 1.0f;
-            return mScale;
-        }
-
-        // apply a median filter to get a good representation of the frame time of the last
-        // N frames.
-        std::array<duration, MAX_FRAMETIME_HISTORY> median; // NOLINT -- it's initialized below
-        size_t size = std::min(mFrameTimeHistorySize, median.size());
-        std::uninitialized_copy_n(history.begin(), size, median.begin());
-        std::sort(median.begin(), median.begin() + size);
-        duration filteredFrameTime = median[size / 2];
-
-        // how much we need to scale the current workload to fit in our target, at this instant
-        const float targetWithHeadroom = options.targetFrameTimeMilli * (1 - options.headRoomRatio);
-        const float workloadScale = targetWithHeadroom / filteredFrameTime.count();
-
-        // low-pass: y += b * (x - y)
-        const float oneOverTau = options.scaleRate;
-        const float x = mScale.x * mScale.y * workloadScale;
-        mDynamicWorkloadScale += (1.0f - std::exp(-oneOverTau)) * (x - mDynamicWorkloadScale);
-
         // scaling factor we need to apply on the whole surface
-        const float scale = mDynamicWorkloadScale;
+        const float scale = mDynamicResolutionController.update(
+                options, timings, mScale.x * mScale.y);
 
         const float w = mViewport.width;
         const float h = mViewport.height;
@@ -240,10 +195,15 @@ math::float2 FView::updateScale(duration frameTime) noexcept {
         static int sLogCounter = 15;
         if (!--sLogCounter) {
             sLogCounter = 15;
-            slog.d << frameTime.count()
-                   << ", " << filteredFrameTime.count()
-                   << ", " << workloadScale
-                   << ", " << mDynamicWorkloadScale
+            DynamicResolutionController::State const& state =
+                    mDynamicResolutionController.getState();
+            slog.d << timings.cpu
+                   << ", " << timings.driver
+                   << ", " << timings.gpu
+                   << ", " << state.filtered.gpu
+                   << ", " << int(state.bottleneck)
+                   << ", " << state.targetScale
+                   << ", " << state.scale
                    << ", " << mScale.x
                    << ", " << mScale.y
                    << ", " << mScale.x * mScale.y
@@ -297,8 +257,7 @@ void FView::prepareShadowing(FEngine& engine, driver::DriverApi& driver,
         shadowMap.update(lightData, 0, scene, mViewingCameraInfo, mVisibleLayers);
         if (shadowMap.hasVisibleShadows()) {
             // Cull shadow casters
-            Frustum const& frustum = shadowMap.getCamera().getFrustum();
-            FView::prepareVisibleShadowCasters(engine.getJobSystem(), frustum, renderableData);
+            FView::prepareVisibleShadowCasters(engine.getJobSystem(), shadowMap, renderableData);
 
             // allocates shadowmap driver resources
             shadowMap.prepare(driver, getUs());
@@ -670,9 +629,32 @@ void FView::prepareVisibleRenderables(JobSystem& js,
 
 UTILS_NOINLINE
 void FView::prepareVisibleShadowCasters(JobSystem& js,
-        Frustum const& lightFrustum, FScene::RenderableSoa& renderableData) noexcept {
+        ShadowMap const& shadowMap, FScene::RenderableSoa& renderableData) noexcept {
     SYSTRACE_CALL();
+    Frustum const& lightFrustum = shadowMap.getCamera().getFrustum();
     FView::cullRenderables(js, renderableData, lightFrustum, VISIBLE_SHADOW_CASTER_BIT);
+
+    // further reject the casters that can't shadow any visible receiver
+    float4 const* planes = shadowMap.getCasterCullingPlanes();
+    size_t planeCount = shadowMap.getCasterCullingPlaneCount();
+    if (planeCount) {
+        float3 const* worldAABBCenter = renderableData.data<FScene::WORLD_AABB_CENTER>();
+        float3 const* worldAABBExtent = renderableData.data<FScene::WORLD_AABB_EXTENT>();
+        uint8_t     * visibleArray    = renderableData.data<FScene::VISIBLE_MASK>();
+
+        auto functor = [planes, planeCount, worldAABBCenter, worldAABBExtent, visibleArray]
+                (uint32_t index, uint32_t c) {
+            Culler::intersectsConvexVolume(
+                    visibleArray + index,
+                    planes, planeCount,
+                    worldAABBCenter + index,
+                    worldAABBExtent + index, c, VISIBLE_SHADOW_CASTER_BIT);
+        };
+
+        auto job = jobs::parallel_for(js, nullptr, 0, (uint32_t)renderableData.size(),
+                std::ref(functor), jobs::CountSplitter<Culler::MODULO * Culler::MIN_LOOP_COUNT_HINT, 8>());
+        js.runAndWait(job);
+    }
 }
 
 void FView::cullRenderables(JobSystem& js,
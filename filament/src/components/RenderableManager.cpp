@@ -548,6 +548,10 @@ void RenderableManager::setLayerMask(Instance instance, uint8_t select, uint8_t
     upcast(this)->setLayerMask(instance, select, values);
 }
 
+uint8_t RenderableManager::getLayerMask(Instance instance) const noexcept {
+    return upcast(this)->getLayerMask(instance);
+}
+
 void RenderableManager::setPriority(Instance instance, uint8_t priority) noexcept {
     upcast(this)->setPriority(instance, priority);
 }
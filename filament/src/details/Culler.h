@@ -57,6 +57,16 @@ public:
             filament::math::float3 const* extent,
             size_t count, size_t bit) noexcept;
 
+    /*
+     * clears 'bit' for each AABB in an array that is entirely outside of one of the planes,
+     * i.e. refines a previous result against an arbitrary convex volume
+     */
+    static void intersectsConvexVolume(result_type* results,
+            filament::math::float4 const* planes, size_t planeCount,
+            filament::math::float3 const* center,
+            filament::math::float3 const* extent,
+            size_t count, size_t bit) noexcept;
+
     /*
      * returns whether each sphere in an array intersects with the frustum
      */
@@ -92,6 +102,12 @@ public:
                 Frustum const& frustum,
                 filament::math::float4 const* b,
                 size_t count) noexcept;
+
+        static void intersectsConvexVolume(result_type* results,
+                filament::math::float4 const* planes, size_t planeCount,
+                filament::math::float3 const* c,
+                filament::math::float3 const* e,
+                size_t count) noexcept;
     };
 };
 
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_DETAILS_DYNAMICRESOLUTIONCONTROLLER_H
+#define TNT_FILAMENT_DETAILS_DYNAMICRESOLUTIONCONTROLLER_H
+
+#include <filament/View.h>
+
+#include <array>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace details {
+
+/*
+ * Decides how much the rendered area must be scaled to reach the target frame time.
+ *
+ * Scaling the resolution only changes the GPU time, so the resolution is lowered only when the
+ * GPU is the bottleneck. When the main thread or the driver thread is the bottleneck, the GPU
+ * can take as long as they do without slowing the frame down, so the resolution is allowed to
+ * go up, but never down.
+ *
+ * The GPU time is modeled as proportional to the rendered area, and the scale that would fit
+ * the GPU budget is low-pass filtered to avoid oscillations.
+ */
+class DynamicResolutionController {
+public:
+    // timings of a frame, in milliseconds
+    struct FrameTimings {
+        float cpu = 0;      // time the main thread spent building the frame
+        float driver = 0;   // time the driver thread spent executing the frame's commands
+        float gpu = 0;      // time the GPU spent rendering the frame
+    };
+
+    enum class Bottleneck : uint8_t {
+        UNKNOWN,
+        CPU,
+        DRIVER,
+        GPU
+    };
+
+    // last decision made by the controller, useful for tuning
+    struct State {
+        FrameTimings filtered;      // median of the recent frame timings
+        Bottleneck bottleneck = Bottleneck::UNKNOWN;
+        float gpuBudget = 0;        // time the GPU can take without slowing the frame down
+        float targetScale = 1;      // area scale that would fit the GPU budget, at this instant
+        float scale = 1;            // low-passed area scale
+    };
+
+    // the GPU must be that much slower than the cpu and driver to be considered the bottleneck
+    static constexpr float GPU_BOUND_RATIO = 1.1f;
+
+    static constexpr size_t MAX_HISTORY = 32;
+
+    // forgets the history, the scale goes back to 1
+    void reset() noexcept;
+
+    // Records the timings of the last frame, which was rendered with an area scale of
+    // currentScale, and returns the area scale to use for the next frame. options must have
+    // been sanitized.
+    float update(View::DynamicResolutionOptions const& options,
+            FrameTimings const& timings, float currentScale) noexcept;
+
+    State const& getState() const noexcept { return mState; }
+
+private:
+    std::array<FrameTimings, MAX_HISTORY> mHistory;
+    size_t mHistorySize = 0;
+    State mState;
+};
+
+} // namespace details
+} // namespace filament
+
+#endif // TNT_FILAMENT_DETAILS_DYNAMICRESOLUTIONCONTROLLER_H
@@ -55,7 +55,9 @@
 #include <math/quat.h>
 
 #include <chrono>
+#include <map>
 #include <memory>
+#include <string>
 #include <unordered_map>
 
 namespace filament {
@@ -263,6 +265,8 @@ public:
         return mDebugRegistry;
     }
 
+    size_t getVariantUsageReport(char* report, size_t size) const noexcept;
+
     bool execute();
 
 private:
@@ -317,6 +321,9 @@ private:
     // FMaterialInstance are handled directly by FMaterial
     std::unordered_map<const FMaterial*, ResourceList<FMaterialInstance>> mMaterialInstances;
 
+    // variants used by the materials that have been destroyed, by material name
+    std::map<std::string, uint32_t> mDestroyedMaterialsVariantUsage;
+
     std::unique_ptr<DFG> mDFG;
 
     // Per-view Uniform interface block
@@ -29,10 +29,14 @@
 
 #include <utils/compiler.h>
 
+#include <atomic>
+#include <vector>
+
 
 namespace filament {
 
 class MaterialParser;
+class Program;
 
 namespace details {
 
@@ -71,12 +75,19 @@ public:
 
     FEngine& getEngine() const noexcept  { return mEngine; }
 
+    // creates a program on demand while rendering, which is counted as a hitch
     Handle<HwProgram> getProgramSlow(uint8_t variantKey) const noexcept;
     Handle<HwProgram> getProgram(uint8_t variantKey) const noexcept {
 
         // filterVariant() has already been applied in generateCommands(), shouldn't be needed here
         assert( variantKey == Variant::filterVariant(variantKey, isVariantLit()) );
 
+        // getUsedVariants() can be called from another thread while commands are recorded, the
+        // bit is usually set already, which avoids a read-modify-write for each draw
+        const uint32_t bit = 1u << variantKey;
+        if (UTILS_UNLIKELY(!(mUsedVariants.load(std::memory_order_relaxed) & bit))) {
+            mUsedVariants.fetch_or(bit, std::memory_order_relaxed);
+        }
         Handle<HwProgram> const entry = mCachedPrograms[variantKey];
         return UTILS_LIKELY(entry) ? entry : getProgramSlow(variantKey);
     }
@@ -112,7 +123,31 @@ public:
 
     uint32_t generateMaterialInstanceId() const noexcept { return mMaterialInstanceId++; }
 
+    void compile(uint8_t variantFeatures, CompilationCallback callback, void* user) noexcept;
+
+    // Creates the programs of the compile() requests that have completed, and invokes their
+    // callbacks. Called once per frame by the engine.
+    void commitCompilations() noexcept;
+
+    size_t getOnDemandCompilationCount() const noexcept { return mOnDemandCompilationCount; }
+
+    uint32_t getUsedVariants() const noexcept {
+        return mUsedVariants.load(std::memory_order_relaxed);
+    }
+
 private:
+    struct Compilation;
+
+    // same as getProgram() but not counted as a hitch
+    Handle<HwProgram> prepareProgram(uint8_t variantKey) const noexcept;
+
+    Program getProgramBuilder(uint8_t variantKey,
+            filaflat::ShaderBuilder& vsBuilder, filaflat::ShaderBuilder& fsBuilder) const noexcept;
+
+    Handle<HwProgram> createProgram(uint8_t variantKey, Program&& program) const noexcept;
+
+    void cancelCompilations() noexcept;
+
     // try to order by frequency of use
     mutable std::array<Handle<HwProgram>, VARIANT_COUNT> mCachedPrograms;
 
@@ -137,12 +172,18 @@ private:
     SamplerInterfaceBlock mSamplerInterfaceBlock;
     UniformInterfaceBlock mUniformInterfaceBlock;
     SamplerBindingMap mSamplerBindings;
+    Program::SpecializationConstants mSpecializationConstants;
 
     utils::CString mName;
     FEngine& mEngine;
     const uint32_t mMaterialId;
     mutable uint32_t mMaterialInstanceId = 0;
     MaterialParser* mMaterialParser = nullptr;
+
+    std::vector<Compilation*> mCompilations;
+    mutable size_t mOnDemandCompilationCount = 0;
+    mutable std::atomic<uint32_t> mUsedVariants{ 0 };
+    static_assert(VARIANT_COUNT <= 32, "mUsedVariants must have one bit per variant");
 };
 
 
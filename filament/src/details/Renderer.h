@@ -29,6 +29,9 @@
 #include "driver/DriverApiForward.h"
 #include "driver/Handle.h"
 
+#include "fg/FrameGraph.h"
+#include "fg/ResourceAllocator.h"
+
 #include <filament/Renderer.h>
 #include <filament/driver/DriverEnums.h>
 
@@ -96,11 +99,15 @@ private:
     public:
         ColorPass(const char* name, utils::JobSystem& js, utils::JobSystem::Job* jobFroxelize,
                 FView& view, Handle<HwRenderTarget> rth);
+        static CommandTypeFlags getCommandType(FView const& view) noexcept;
+        // CPU-only, can be called from any thread
+        static void prepareColorPass(utils::JobSystem& js, FView const& view,
+                utils::GrowingSlice<Command>& commands) noexcept;
         static void renderColorPass(FEngine& engine,
                 utils::JobSystem& js, utils::JobSystem::Job* sync,
                 Handle<HwRenderTarget> rth,
                 FView& view, Viewport const& scaledViewport,
-                utils::GrowingSlice<Command>& commands) noexcept;
+                utils::Slice<Command> const& commands) noexcept;
     };
 
     // this class is defined in RenderPass.cpp
@@ -111,15 +118,25 @@ private:
         void endRenderPass(DriverApi& driver, Viewport const& viewport) noexcept override;
     public:
         ShadowPass(const char* name, ShadowMap const& shadowMap) noexcept;
-        static void renderShadowMap(FEngine& engine, utils::JobSystem& js,
-                FView& view, utils::GrowingSlice<Command>& commands) noexcept;
+        static CameraInfo getCameraInfo(ShadowMap const& shadowMap) noexcept;
+        // CPU-only, can be called from any thread
+        static void prepareShadowMap(utils::JobSystem& js, FView const& view,
+                utils::GrowingSlice<Command>& commands) noexcept;
+        static void renderShadowMap(FEngine& engine,
+                FView& view, utils::Slice<Command> const& commands) noexcept;
     };
 
+    static RenderPass::RenderFlags getRenderFlags(FView const& view) noexcept;
+
+    // Updates the renderable data shared by the shadow and color passes. This must be called
+    // before preparing them.
+    static void updateRenderables(FEngine& engine, FView& view) noexcept;
+
     Handle<HwRenderTarget> getRenderTarget() const noexcept { return mRenderTarget; }
 
-    void recordHighWatermark(utils::Slice<Command> const& commands) noexcept {
+    void recordHighWatermark(size_t commandCount) noexcept {
 #ifndef NDEBUG
-        mCommandsHighWatermark = std::max(mCommandsHighWatermark, size_t(commands.size()));
+        mCommandsHighWatermark = std::max(mCommandsHighWatermark, commandCount);
 #endif
     }
 
@@ -147,6 +164,8 @@ private:
     size_t mCommandsHighWatermark = 0;
     uint32_t mFrameId = 0;
     FrameInfoManager mFrameInfoManager;
+    fg::ResourceAllocator mResourceAllocator;  // FrameGraph resources, recycled across frames
+    fg::CompiledGraph mCompiledGraph;          // last compiled FrameGraph, reused if unchanged
     bool mIsRGB16FSupported : 1;
     bool mIsRGB8Supported : 1;
     Epoch mUserEpoch;
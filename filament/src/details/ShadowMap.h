@@ -68,6 +68,22 @@ public:
     // Returns the light's projection. Valid after calling update().
     FCamera const& getCamera() const noexcept { return *mCamera; }
 
+    // Returns the planes of the visible shadow receivers volume extruded towards the light.
+    // Shadow casters outside of this volume can't cast shadows onto any visible receiver.
+    // Valid after calling update().
+    filament::math::float4 const* getCasterCullingPlanes() const noexcept {
+        return mCasterCullingPlanes.data();
+    }
+    size_t getCasterCullingPlaneCount() const noexcept { return mCasterCullingPlaneCount; }
+
+    // Computes the planes (in world space, pointing outwards) of the volume formed by extruding
+    // the convex-hull of wsReceiverVertices towards the light. Returns the number of planes.
+    // (public for testing)
+    static size_t computeCasterCullingPlanes(filament::math::float4* UTILS_RESTRICT planes,
+            filament::math::float3 const& dir,
+            filament::math::float3 const* UTILS_RESTRICT wsReceiverVertices,
+            size_t vertexCount) noexcept;
+
     // Set-up the render target, call before rendering the shadow map.
     void beginRenderPass(driver::DriverApi& driverApi) const noexcept;
 
@@ -104,6 +120,9 @@ private:
     // 8 corners, 12 segments w/ 2 intersection max -- all of this twice (8 + 12 * 2) * 2 (768 bytes)
     using FrustumBoxIntersection = std::array<filament::math::float3, 64>;
 
+    // one plane per edge of the receivers' convex-hull in light space + the far plane
+    using CasterCullingPlanes = std::array<filament::math::float4, 64 + 1>;
+
     void computeShadowCameraDirectional(
             filament::math::float3 const& direction, FScene const* scene, CameraInfo const& camera,
             uint8_t visibleLayers) noexcept;
@@ -186,6 +205,10 @@ private:
     // initialization of the float3 each time
     FrustumBoxIntersection mWsClippedShadowReceiverVolume;
 
+    // set-up in update()
+    CasterCullingPlanes mCasterCullingPlanes;
+    size_t mCasterCullingPlaneCount = 0;
+
     FEngine& mEngine;
     const bool mClipSpaceFlipped;
 };
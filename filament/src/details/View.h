@@ -25,6 +25,7 @@
 
 #include "details/Allocators.h"
 #include "details/Camera.h"
+#include "details/DynamicResolutionController.h"
 #include "details/Froxelizer.h"
 #include "details/ShadowMap.h"
 #include "details/Scene.h"
@@ -168,7 +169,8 @@ public:
         return mHasPostProcessPass;
     }
 
-    filament::math::float2 updateScale(std::chrono::duration<float, std::milli> frameTime) noexcept;
+    using FrameTimings = DynamicResolutionController::FrameTimings;
+    filament::math::float2 updateScale(FrameTimings const& timings) noexcept;
 
     void setDynamicResolutionOptions(View::DynamicResolutionOptions const& options) noexcept;
 
@@ -176,6 +178,11 @@ public:
         return mDynamicResolution;
     }
 
+    // last decision of the dynamic resolution controller, useful for tuning
+    DynamicResolutionController::State const& getDynamicResolutionState() const noexcept {
+        return mDynamicResolutionController.getState();
+    }
+
     void setRenderQuality(RenderQuality const& renderQuality) noexcept {
         mRenderQuality = renderQuality;
     }
@@ -218,13 +225,13 @@ public:
     void setCameraUser(FCamera* camera) noexcept { setCullingCamera(camera); }
 
 private:
-    static constexpr size_t MAX_FRAMETIME_HISTORY = 32u;
+    static constexpr size_t MAX_FRAMETIME_HISTORY = DynamicResolutionController::MAX_HISTORY;
 
     void prepareVisibleRenderables(utils::JobSystem& js,
             Frustum const& frustum, FScene::RenderableSoa& renderableData) const noexcept;
 
     static void prepareVisibleShadowCasters(utils::JobSystem& js,
-            Frustum const& lightFrustum, FScene::RenderableSoa& renderableData) noexcept;
+            ShadowMap const& shadowMap, FScene::RenderableSoa& renderableData) noexcept;
 
     static void prepareVisibleLights(
             FLightManager const& lcm, utils::JobSystem& js, Frustum const& frustum,
@@ -283,13 +290,10 @@ private:
     bool mHasPostProcessPass = true;
     DepthPrepass mDepthPrepass = DepthPrepass::DEFAULT;
 
-    using duration = std::chrono::duration<float, std::milli>;
     DynamicResolutionOptions mDynamicResolution;
-    std::array<duration, MAX_FRAMETIME_HISTORY> mFrameTimeHistory;
-    size_t mFrameTimeHistorySize = 0;
+    DynamicResolutionController mDynamicResolutionController;
 
     filament::math::float2 mScale = 1.0f;
-    float mDynamicWorkloadScale = 1.0f;
     bool mIsDynamicResolutionSupported = false;
 
     RenderQuality mRenderQuality;
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <filament/driver/BlobCache.h>
+
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/Path.h>
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(WIN32)
+#   include <process.h>
+#   define getpid _getpid
+#else
+#   include <unistd.h>
+#endif
+
+using namespace utils;
+
+namespace filament {
+namespace driver {
+
+static constexpr char BLOB_MAGIC[4] = { 'F', 'B', 'L', 'B' };
+
+BlobCache::~BlobCache() noexcept = default;
+
+FileBlobCache::FileBlobCache(const char* directory) noexcept : mDirectory(directory) {
+    Path path(mDirectory);
+    if (!path.isDirectory() && !path.mkdirRecursive()) {
+        slog.w << "Could not create the blob cache directory " << directory << io::endl;
+    }
+}
+
+FileBlobCache::~FileBlobCache() noexcept = default;
+
+std::string FileBlobCache::getFileName(const void* key, size_t keySize) const noexcept {
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.blob",
+            (unsigned long long) hash::fnv1a64(key, keySize));
+    return Path(mDirectory).concat(name).getPath();
+}
+
+void FileBlobCache::insert(const void* key, size_t keySize,
+        const void* value, size_t valueSize) noexcept {
+    const std::string path = getFileName(key, keySize);
+
+    // Write to a temporary file first, so that a reader never sees a partially written entry.
+    // The name of the temporary file is unique to this process and thread.
+    const size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    const std::string temp = path + "." + std::to_string(getpid()) + "." +
+            std::to_string(thread) + ".tmp";
+
+    std::ofstream out(temp, std::ios::binary);
+    if (!out) {
+        return;
+    }
+
+    const uint64_t ks = keySize;
+    const uint64_t vs = valueSize;
+    out.write(BLOB_MAGIC, sizeof(BLOB_MAGIC));
+    out.write(reinterpret_cast<const char*>(&ks), sizeof(ks));
+    out.write(static_cast<const char*>(key), keySize);
+    out.write(reinterpret_cast<const char*>(&vs), sizeof(vs));
+    out.write(static_cast<const char*>(value), valueSize);
+    out.close();
+
+    if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+    }
+}
+
+size_t FileBlobCache::retrieve(const void* key, size_t keySize,
+        void* value, size_t valueSize) noexcept {
+    std::ifstream in(getFileName(key, keySize), std::ios::binary);
+    if (!in) {
+        return 0;
+    }
+
+    // The file name is only a hash, make sure the entry really is for this key.
+    char magic[sizeof(BLOB_MAGIC)];
+    uint64_t ks = 0;
+    if (!in.read(magic, sizeof(magic)) || memcmp(magic, BLOB_MAGIC, sizeof(magic)) != 0 ||
+        !in.read(reinterpret_cast<char*>(&ks), sizeof(ks)) || ks != keySize) {
+        return 0;
+    }
+    std::unique_ptr<char[]> storedKey(new char[keySize]);
+    if (!in.read(storedKey.get(), keySize) || memcmp(storedKey.get(), key, keySize) != 0) {
+        return 0;
+    }
+
+    uint64_t vs = 0;
+    if (!in.read(reinterpret_cast<char*>(&vs), sizeof(vs))) {
+        return 0;
+    }
+    if (value && valueSize >= vs) {
+        if (!in.read(static_cast<char*>(value), vs)) {
+            return 0;
+        }
+    }
+    return size_t(vs);
+}
+
+} // namespace driver
+} // namespace filament
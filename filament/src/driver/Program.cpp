@@ -16,6 +16,8 @@
 
 #include "driver/Program.h"
 
+#include <utils/Hash.h>
+
 using namespace utils;
 
 namespace filament {
@@ -70,6 +72,29 @@ Program& Program::addSamplerBlock(size_t index, const SamplerInterfaceBlock* sb)
     return *this;
 }
 
+Program& Program::specializationConstants(SpecializationConstants constants) noexcept {
+    mSpecializationConstants = std::move(constants);
+    return *this;
+}
+
+uint64_t Program::getContentHash() const noexcept {
+    // the lengths are hashed too, so that moving text from one shader to another changes the hash
+    uint64_t lengths[NUM_SHADER_TYPES];
+    for (size_t i = 0; i < NUM_SHADER_TYPES; i++) {
+        lengths[i] = mShadersSource[i].size();
+    }
+    uint64_t h = hash::fnv1a64(lengths, sizeof(lengths));
+    for (CString const& source : mShadersSource) {
+        h = hash::fnv1a64(source.c_str_safe(), source.size(), h);
+    }
+    // the same shaders specialized differently are different programs
+    for (SpecializationConstant const& constant : mSpecializationConstants) {
+        const int32_t key[3] = { int32_t(constant.id), int32_t(constant.type), constant.value };
+        h = hash::fnv1a64(key, sizeof(key), h);
+    }
+    return h;
+}
+
 #if !defined(NDEBUG)
 io::ostream& operator<<(io::ostream& out, const Program& builder) {
     // FIXME: maybe do better here!
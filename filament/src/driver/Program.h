@@ -23,11 +23,14 @@
 #include <private/filament/SamplerInterfaceBlock.h>
 #include <private/filament/UniformInterfaceBlock.h>
 
+#include <filament/driver/DriverEnums.h>
+
 #include <utils/compiler.h>
 #include <utils/CString.h>
 #include <utils/Log.h>
 
 #include <array>
+#include <vector>
 
 namespace filament {
 
@@ -43,6 +46,15 @@ public:
         FRAGMENT = 1
     };
 
+    // value of one of the material's specialization constants, the id is the constant's index
+    struct SpecializationConstant {
+        uint32_t id;
+        driver::ConstantType type;
+        int32_t value;          // 0 or 1 for booleans
+    };
+
+    using SpecializationConstants = std::vector<SpecializationConstant>;
+
     Program() noexcept;
     Program(const Program& rhs);
     Program(Program&& rhs) noexcept;
@@ -64,6 +76,10 @@ public:
     // sets a sampler interface block for this program
     Program& addSamplerBlock(size_t index, const SamplerInterfaceBlock* ib);
 
+    // sets the values of the specialization constants, the shaders use their default values for
+    // the constants that are not in this list
+    Program& specializationConstants(SpecializationConstants constants) noexcept;
+
     template <typename T>
     Program& withVertexShader(T&& source) {
         return shader(Shader::VERTEX, std::forward<T>(source));
@@ -95,6 +111,10 @@ public:
         return mSamplerBindings;
     }
 
+    SpecializationConstants const& getSpecializationConstants() const noexcept {
+        return mSpecializationConstants;
+    }
+
     const utils::CString& getName() const noexcept {
         return mName;
     }
@@ -107,6 +127,11 @@ public:
         return mSamplerCount > 0;
     }
 
+    // Hash of the shaders' source and specialization constants, it identifies the compiled
+    // program and is stable across runs and platforms, so it can be used as a key for persistent
+    // caches.
+    uint64_t getContentHash() const noexcept;
+
 private:
 #if !defined(NDEBUG)
     friend utils::io::ostream& operator<< (utils::io::ostream& out, const Program& builder);
@@ -116,6 +141,7 @@ private:
     std::array<SamplerInterfaceBlock const *, NUM_SAMPLER_BINDINGS> mSamplerInterfaceBlocks;
     const SamplerBindingMap* mSamplerBindings = nullptr;
     std::array<utils::CString, NUM_SHADER_TYPES> mShadersSource;
+    SpecializationConstants mSpecializationConstants;
     size_t mSamplerCount = 0;
     utils::CString mName;
     uint8_t mVariant;
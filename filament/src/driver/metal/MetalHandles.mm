@@ -197,6 +197,22 @@ MetalProgram::MetalProgram(id<MTLDevice> device, const Program& program) noexcep
     static_assert(Program::NUM_SHADER_TYPES == 2, "Only vertex and fragment shaders expected.");
     MetalFunctionPtr shaderFunctions[2] = { &vertexFunction, &fragmentFunction };
 
+    // The specialization constants are function constants, values for constants a function
+    // doesn't declare are ignored.
+    MTLFunctionConstantValues* constants = nil;
+    if (!program.getSpecializationConstants().empty()) {
+        constants = [[MTLFunctionConstantValues alloc] init];
+        for (const auto& constant : program.getSpecializationConstants()) {
+            if (constant.type == driver::ConstantType::BOOL) {
+                const bool value = constant.value != 0;
+                [constants setConstantValue:&value type:MTLDataTypeBool atIndex:constant.id];
+            } else {
+                const int32_t value = constant.value;
+                [constants setConstantValue:&value type:MTLDataTypeInt atIndex:constant.id];
+            }
+        }
+    }
+
     const auto& sources = program.getShadersSource();
     for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
         const auto& source = sources[i];
@@ -217,11 +233,21 @@ MetalProgram::MetalProgram(id<MTLDevice> device, const Program& program) noexcep
         }
         ASSERT_POSTCONDITION(library != nil, "Unable to compile Metal shading library.");
 
-        *shaderFunctions[i] = [library newFunctionWithName:@"main0"];
+        if (constants) {
+            *shaderFunctions[i] = [library newFunctionWithName:@"main0"
+                                                constantValues:constants
+                                                         error:&error];
+            ASSERT_POSTCONDITION(*shaderFunctions[i] != nil,
+                    "Unable to specialize Metal function.");
+        } else {
+            *shaderFunctions[i] = [library newFunctionWithName:@"main0"];
+        }
 
         [library release];
     }
 
+    [constants release];
+
     samplerBindings = *program.getSamplerBindings();
 }
 
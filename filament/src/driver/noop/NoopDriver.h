@@ -50,12 +50,15 @@ private:
 #define DECL_DRIVER_API_SYNCHRONOUS(RetType, methodName, paramsDecl, params) \
     RetType methodName(paramsDecl) override { return RetType(true); }
 
+    // Handles are all different so that clients can use them as keys.
 #define DECL_DRIVER_API_RETURN(RetType, methodName, paramsDecl, params) \
     RetType methodName##S() noexcept override { \
-        return RetType((RetType::HandleId)0xDEAD0000); } \
+        return RetType((RetType::HandleId)(0xDEAD0000 + mNextId++)); } \
     UTILS_ALWAYS_INLINE void methodName##R(RetType, paramsDecl) { }
 
 #include "driver/DriverAPI.inc"
+
+    HandleBase::HandleId mNextId = 0;
 };
 
 } // namespace filament
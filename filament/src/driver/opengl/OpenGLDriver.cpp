@@ -19,6 +19,7 @@
 #include <set>
 
 #include <utils/compiler.h>
+#include <utils/Hash.h>
 #include <utils/Log.h>
 #include <utils/Panic.h>
 #include <utils/Systrace.h>
@@ -189,6 +190,16 @@ OpenGLDriver::OpenGLDriver(OpenGLPlatform* platform) noexcept
     };
     mShaderModel = shaderModel;
 
+#if !defined(__EMSCRIPTEN__)
+    // WebGL doesn't have program binaries, elsewhere they could still be unsupported by the driver
+    GLint programBinaryFormats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &programBinaryFormats);
+    features.program_binary = programBinaryFormats > 0 && mPlatform.getBlobCache();
+#endif
+    for (char const* s : { vendor, renderer, version, shader }) {
+        mDriverHash = hash::fnv1a64(s, strlen(s), mDriverHash);
+    }
+
     /*
      * Set our default state
      */
@@ -524,6 +524,7 @@ private:
     // features supported by this version of GL or GLES
     struct {
         bool multisample_texture = false;
+        bool program_binary = false;    // supported by GL *and* a BlobCache is available
     } features;
 
     // supported extensions detected at runtime
@@ -569,6 +570,9 @@ private:
 
     driver::OpenGLPlatform& mPlatform;
 
+    // identifies the GL implementation, program binaries can't be reused across implementations
+    uint64_t mDriverHash = 0;
+
     OpenGLBlitter* mOpenGLBlitter = nullptr;
     void updateStream(GLTexture* t, driver::DriverApi* driver) noexcept;
     void updateBuffer(GLenum target, GLBuffer* buffer, BufferDescriptor const& p, uint32_t alignment = 16) noexcept;
@@ -18,6 +18,9 @@
 
 #include <cctype>
 #include <sstream>
+#include <string>
+
+#include <string.h>
 
 #include <utils/Log.h>
 #include <utils/compiler.h>
@@ -25,6 +28,10 @@
 
 #include "driver/opengl/OpenGLDriver.h"
 
+#include <filament/driver/BlobCache.h>
+
+#include <memory>
+
 namespace filament {
 
 using namespace filament::math;
@@ -41,68 +48,42 @@ static char* copy_n(char const* s, size_t n, char* d) noexcept {
     return d;
 }
 
-OpenGLProgram::OpenGLProgram(OpenGLDriver* gl, const Program& programBuilder) noexcept
-        :  HwProgram(programBuilder.getName()), mIsValid(false) {
-
-    using Shader = Program::Shader;
-
-    const auto& shadersSource = programBuilder.getShadersSource();
-
-    // build all shaders
-    #pragma nounroll
-    for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
-        GLenum glShaderType;
-        Shader type = (Shader)i;
-        switch (type) {
-            case Shader::VERTEX:
-                glShaderType = GL_VERTEX_SHADER;
-                break;
-            case Shader::FRAGMENT:
-                glShaderType = GL_FRAGMENT_SHADER;
-                break;
+// GLSL has no specialization constants, filamat emits them as macros that default to the constant's
+// value, so we just need to define these macros after the #version directive.
+static std::string getSpecializationDefines(
+        Program::SpecializationConstants const& constants) noexcept {
+    std::string defines;
+    for (Program::SpecializationConstant const& constant : constants) {
+        defines += "#define SPIRV_CROSS_CONSTANT_ID_" + std::to_string(constant.id) + " ";
+        if (constant.type == driver::ConstantType::BOOL) {
+            defines += constant.value ? "true\n" : "false\n";
+        } else {
+            defines += std::to_string(constant.value) + "\n";
         }
+    }
+    return defines;
+}
 
-        if (shadersSource[i].length()) {
-            GLint status;
-            char const* const source = shadersSource[i].c_str();
-
-            GLuint shaderId = glCreateShader(glShaderType);
-            glShaderSource(shaderId, 1, &source, nullptr);
-            glCompileShader(shaderId);
+OpenGLProgram::OpenGLProgram(OpenGLDriver* gl, const Program& programBuilder) noexcept
+        :  HwProgram(programBuilder.getName()), mIsValid(false) {
 
-            glGetShaderiv(shaderId, GL_COMPILE_STATUS, &status);
-            if (UTILS_UNLIKELY(status != GL_TRUE)) {
-                logCompilationError(slog.e, shaderId, source);
-                glDeleteShader(shaderId);
-                return;
-            }
-            this->gl.shaders[i] = shaderId;
-            mValidShaderSet |= 1U << i;
-        }
+    // reuse the binary of a previous run if we can, the key is only computed if needed
+    ProgramBinaryKey key{};
+    const bool useBinaryCache = gl->features.program_binary;
+    if (useBinaryCache) {
+        key.program = programBuilder.getContentHash();
+        key.driver = gl->mDriverHash;
     }
 
-    // we need at least a vertex and fragment program
-    const uint8_t validShaderSet = mValidShaderSet;
-    const uint8_t mask = VERTEX_SHADER_BIT | FRAGMENT_SHADER_BIT;
-    if (UTILS_LIKELY((mValidShaderSet & mask) == mask)) {
-        GLint status;
-        GLuint program = glCreateProgram();
-        for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
-            if (validShaderSet & (1U << i)) {
-                glAttachShader(program, this->gl.shaders[i]);
-            }
+    GLuint program = useBinaryCache ? loadProgramBinary(gl, key) : 0;
+    if (!program) {
+        program = compileProgram(programBuilder, useBinaryCache);
+        if (program && useBinaryCache) {
+            storeProgramBinary(gl, key, program);
         }
-        glLinkProgram(program);
-
-        glGetProgramiv(program, GL_LINK_STATUS, &status);
-        if (UTILS_UNLIKELY(status != GL_TRUE)) {
-            char error[512];
-            glGetProgramInfoLog(program, sizeof(error), nullptr, error);
+    }
 
-            slog.e << "LINKING: " << error << io::endl;
-            glDeleteProgram(program);
-            return;
-        }
+    if (UTILS_LIKELY(program)) {
         this->gl.program = program;
 
         // Associate each UniformBlock in the program to a known binding.
@@ -195,6 +176,142 @@ OpenGLProgram::OpenGLProgram(OpenGLDriver* gl, const Program& programBuilder) no
     }
 }
 
+GLuint OpenGLProgram::compileProgram(const Program& programBuilder, bool retrievable) noexcept {
+    using Shader = Program::Shader;
+
+    const auto& shadersSource = programBuilder.getShadersSource();
+    const std::string defines =
+            getSpecializationDefines(programBuilder.getSpecializationConstants());
+
+    // build all shaders
+    #pragma nounroll
+    for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
+        GLenum glShaderType;
+        Shader type = (Shader)i;
+        switch (type) {
+            case Shader::VERTEX:
+                glShaderType = GL_VERTEX_SHADER;
+                break;
+            case Shader::FRAGMENT:
+                glShaderType = GL_FRAGMENT_SHADER;
+                break;
+        }
+
+        if (shadersSource[i].length()) {
+            GLint status;
+            char const* const source = shadersSource[i].c_str();
+
+            // the defines are passed as a separate string, right after the #version line
+            const char* version = strstr(source, "#version");
+            const char* body = version ? strchr(version, '\n') : nullptr;
+            body = body ? body + 1 : source;
+            const char* const strings[3] = { source, defines.c_str(), body };
+            const GLint lengths[3] = { GLint(body - source), GLint(defines.size()), -1 };
+
+            GLuint shaderId = glCreateShader(glShaderType);
+            glShaderSource(shaderId, 3, strings, lengths);
+            glCompileShader(shaderId);
+
+            glGetShaderiv(shaderId, GL_COMPILE_STATUS, &status);
+            if (UTILS_UNLIKELY(status != GL_TRUE)) {
+                logCompilationError(slog.e, shaderId, source);
+                glDeleteShader(shaderId);
+                return 0;
+            }
+            this->gl.shaders[i] = shaderId;
+            mValidShaderSet |= 1U << i;
+        }
+    }
+
+    // we need at least a vertex and fragment program
+    const uint8_t validShaderSet = mValidShaderSet;
+    const uint8_t mask = VERTEX_SHADER_BIT | FRAGMENT_SHADER_BIT;
+    if (UTILS_UNLIKELY((validShaderSet & mask) != mask)) {
+        return 0;
+    }
+
+    GLint status;
+    GLuint program = glCreateProgram();
+    for (size_t i = 0; i < Program::NUM_SHADER_TYPES; i++) {
+        if (validShaderSet & (1U << i)) {
+            glAttachShader(program, this->gl.shaders[i]);
+        }
+    }
+#if !defined(__EMSCRIPTEN__)
+    if (retrievable) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+#endif
+    glLinkProgram(program);
+
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (UTILS_UNLIKELY(status != GL_TRUE)) {
+        char error[512];
+        glGetProgramInfoLog(program, sizeof(error), nullptr, error);
+
+        slog.e << "LINKING: " << error << io::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+GLuint OpenGLProgram::loadProgramBinary(OpenGLDriver* gl, ProgramBinaryKey const& key) noexcept {
+#if !defined(__EMSCRIPTEN__)
+    driver::BlobCache& cache = *gl->mPlatform.getBlobCache();
+    const size_t size = cache.retrieve(&key, sizeof(key), nullptr, 0);
+    if (size <= sizeof(GLenum)) {
+        return 0;
+    }
+
+    std::unique_ptr<uint8_t[]> blob(new uint8_t[size]);
+    if (cache.retrieve(&key, sizeof(key), blob.get(), size) != size) {
+        return 0;
+    }
+
+    // the blob is the binary format followed by the binary itself
+    GLenum format;
+    memcpy(&format, blob.get(), sizeof(format));
+    GLuint program = glCreateProgram();
+    glProgramBinary(program, format, blob.get() + sizeof(format), GLsizei(size - sizeof(format)));
+
+    // this fails if the driver was updated since the binary was stored
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE) {
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+#else
+    return 0;
+#endif
+}
+
+void OpenGLProgram::storeProgramBinary(OpenGLDriver* gl, ProgramBinaryKey const& key,
+        GLuint program) noexcept {
+#if !defined(__EMSCRIPTEN__)
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    const size_t size = sizeof(GLenum) + size_t(length);
+    std::unique_ptr<uint8_t[]> blob(new uint8_t[size]);
+    GLenum format = 0;
+    GLsizei written = 0;
+    // don't mistake an earlier error for a failure of glGetProgramBinary()
+    while (glGetError() != GL_NO_ERROR) { }
+    glGetProgramBinary(program, length, &written, &format, blob.get() + sizeof(format));
+    if (glGetError() != GL_NO_ERROR || written != length) {
+        return;
+    }
+    memcpy(blob.get(), &format, sizeof(format));
+    gl->mPlatform.getBlobCache()->insert(&key, sizeof(key), blob.get(), size);
+#endif
+}
+
 OpenGLProgram::~OpenGLProgram() noexcept {
     const size_t validShaderSet = mValidShaderSet;
     const bool isValid = mIsValid;
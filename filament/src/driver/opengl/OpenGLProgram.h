@@ -94,6 +94,18 @@ private:
     std::array<uint8_t, NUM_TEXTURE_UNITS> mIndicesRuns;    // 16 bytes
 
     void updateSamplers(OpenGLDriver* gl) noexcept;
+
+    // key of the program binaries in the platform's BlobCache
+    struct ProgramBinaryKey {
+        uint64_t program;   // Program::getContentHash()
+        uint64_t driver;    // identifies the GL implementation
+    };
+
+    // returns the linked program, or 0 on failure
+    GLuint compileProgram(const Program& programBuilder, bool retrievable) noexcept;
+    static GLuint loadProgramBinary(OpenGLDriver* gl, ProgramBinaryKey const& key) noexcept;
+    static void storeProgramBinary(OpenGLDriver* gl, ProgramBinaryKey const& key,
+            GLuint program) noexcept;
 };
 
 
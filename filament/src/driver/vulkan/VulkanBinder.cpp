@@ -206,6 +206,8 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
     // If we reach this point, we need to create and stash a brand new pipeline object.
     mShaderStages[0].module = mPipelineKey.shaders[0];
     mShaderStages[1].module = mPipelineKey.shaders[1];
+    mShaderStages[0].pSpecializationInfo = mSpecializationInfo;
+    mShaderStages[1].pSpecializationInfo = mSpecializationInfo;
 
     // We don't store array sizes to save space, but it's quick to count all non-zero
     // entries because these arrays have a small fixed-size capacity.
@@ -270,7 +272,7 @@ bool VulkanBinder::getOrCreatePipeline(VkPipeline* pipeline) noexcept {
             << mShaderStages[0].module << ", " << mShaderStages[1].module << ")" << utils::io::endl;
     #endif
 
-    VkResult err = vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo,
+    VkResult err = vkCreateGraphicsPipelines(mDevice, mPipelineCache, 1, &pipelineCreateInfo,
             VKALLOC, pipeline);
     if (err) {
         utils::slog.e << "vkCreateGraphicsPipelines error " << err << utils::io::endl;
@@ -294,6 +296,7 @@ void VulkanBinder::bindProgramBundle(const ProgramBundle& bundle) noexcept {
             mPipelineKey.shaders[ssi] = shaders[ssi];
         }
     }
+    mSpecializationInfo = bundle.specializationInfo;
 }
 
 void VulkanBinder::bindRasterState(const RasterState& rasterState) noexcept {
@@ -83,10 +83,13 @@ public:
         VkVertexInputBindingDescription buffers[MAX_VERTEX_ATTRIBUTES];
     };
 
-    // The ProgramBundle contains weak references to the compiled vertex and fragment shaders.
+    // The ProgramBundle contains weak references to the compiled vertex and fragment shaders,
+    // and to the values of their specialization constants (null if there are none). The shader
+    // modules belong to a single program, so they also identify the specialization.
     struct ProgramBundle {
         VkShaderModule vertex;
         VkShaderModule fragment;
+        const VkSpecializationInfo* specializationInfo;
     };
 
     // The RasterState POD contains standard graphics-related state like blending, culling, etc.
@@ -114,6 +117,9 @@ public:
     ~VulkanBinder();
     void setDevice(VkDevice device) { mDevice = device; }
 
+    // Optional cache used when creating pipelines, it's owned by the client.
+    void setPipelineCache(VkPipelineCache cache) { mPipelineCache = cache; }
+
     // Clients should initialize their copy of the raster state using this method. They can then
     // mutate their copy and pass it back through bindRasterState().
     const RasterState& getDefaultRasterState() const { return mDefaultRasterState; }
@@ -242,6 +248,7 @@ private:
     void evictDescriptors(std::function<bool(const DescriptorKey&)> filter) noexcept;
 
     VkDevice mDevice = nullptr;
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
     const RasterState mDefaultRasterState;
 
     // Info structs used only in a transient way but they are stored for convenience.
@@ -256,6 +263,7 @@ private:
     // uniform buffers).
     PipelineKey mPipelineKey;
     DescriptorKey mDescriptorKey;
+    const VkSpecializationInfo* mSpecializationInfo = nullptr;
 
     // Weak references to the currently bound pipeline and descriptor set.
     PipelineVal* mCurrentPipeline = nullptr;
@@ -21,12 +21,16 @@
 #include "VulkanBuffer.h"
 #include "VulkanHandles.h"
 
+#include <filament/driver/BlobCache.h>
+
 #include <utils/Panic.h>
 #include <utils/CString.h>
 #include <utils/trap.h>
 
 #include <set>
 
+#include <string.h>
+
 // Vulkan functions often immediately dereference pointers, so it's fine to pass in a pointer
 // to a stack-allocated variable.
 #pragma clang diagnostic push
@@ -157,6 +161,8 @@ VulkanDriver::VulkanDriver(VulkanPlatform* platform,
     createVirtualDevice(mContext);
     mBinder.setDevice(mContext.device);
 
+    createPipelineCache();
+
     // Choose a depth format that meets our requirements. Take care not to include stencil formats
     // just yet, since that would require a corollary change to the "aspect" flags for the VkImage.
     mContext.depthFormat = findSupportedFormat(mContext,
@@ -188,6 +194,7 @@ void VulkanDriver::terminate() {
     }
     waitForIdle(mContext);
     mBinder.destroyCache();
+    destroyPipelineCache();
     mStagePool.reset();
     mFramebufferCache.reset();
     mSamplerCache.reset();
@@ -202,6 +209,73 @@ void VulkanDriver::terminate() {
     mContext.instance = nullptr;
 }
 
+// Key of the pipeline cache in the BlobCache. The cache data has a header that is validated by the
+// driver, but we don't want devices sharing a BlobCache to overwrite each other's pipelines.
+struct PipelineCacheKey {
+    char tag[4];
+    uint32_t vendorID;
+    uint32_t deviceID;
+    uint32_t driverVersion;
+    uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+static PipelineCacheKey getPipelineCacheKey(VkPhysicalDeviceProperties const& props) noexcept {
+    PipelineCacheKey key = { { 'V', 'K', 'P', 'C' },
+            props.vendorID, props.deviceID, props.driverVersion, {} };
+    memcpy(key.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE);
+    return key;
+}
+
+void VulkanDriver::createPipelineCache() noexcept {
+    BlobCache* const cache = mContextManager.getBlobCache();
+    if (!cache) {
+        return;
+    }
+
+    const PipelineCacheKey key = getPipelineCacheKey(mContext.physicalDeviceProperties);
+    std::vector<uint8_t> data(cache->retrieve(&key, sizeof(key), nullptr, 0));
+    if (!data.empty() &&
+            cache->retrieve(&key, sizeof(key), data.data(), data.size()) != data.size()) {
+        data.clear();
+    }
+
+    VkPipelineCacheCreateInfo createInfo = {};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = data.size();
+    createInfo.pInitialData = data.data();
+    VkResult result = vkCreatePipelineCache(mContext.device, &createInfo, VKALLOC, &mPipelineCache);
+    if (result != VK_SUCCESS && !data.empty()) {
+        // the data is stale, start with an empty cache
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = nullptr;
+        result = vkCreatePipelineCache(mContext.device, &createInfo, VKALLOC, &mPipelineCache);
+    }
+    if (result != VK_SUCCESS) {
+        mPipelineCache = VK_NULL_HANDLE;
+    }
+    mBinder.setPipelineCache(mPipelineCache);
+}
+
+void VulkanDriver::destroyPipelineCache() noexcept {
+    if (!mPipelineCache) {
+        return;
+    }
+
+    // save the pipelines created during this run for the next one
+    size_t size = 0;
+    vkGetPipelineCacheData(mContext.device, mPipelineCache, &size, nullptr);
+    std::vector<uint8_t> data(size);
+    if (size && vkGetPipelineCacheData(mContext.device, mPipelineCache,
+            &size, data.data()) == VK_SUCCESS) {
+        const PipelineCacheKey key = getPipelineCacheKey(mContext.physicalDeviceProperties);
+        mContextManager.getBlobCache()->insert(&key, sizeof(key), data.data(), size);
+    }
+
+    mBinder.setPipelineCache(VK_NULL_HANDLE);
+    vkDestroyPipelineCache(mContext.device, mPipelineCache, VKALLOC);
+    mPipelineCache = VK_NULL_HANDLE;
+}
+
 void VulkanDriver::beginFrame(int64_t monotonic_clock_ns, uint32_t frameId) {
     // We allow multiple beginFrame / endFrame pairs before commit(), so gracefully return early
     // if the swap chain has already been acquired.
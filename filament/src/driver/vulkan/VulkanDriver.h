@@ -74,6 +74,10 @@ private:
     VulkanDriver(VulkanDriver const&) = delete;
     VulkanDriver& operator = (VulkanDriver const&) = delete;
 
+    // The pipeline cache is loaded from and saved to the platform's BlobCache, if any.
+    void createPipelineCache() noexcept;
+    void destroyPipelineCache() noexcept;
+
 private:
     driver::VulkanPlatform& mContextManager;
 
@@ -146,6 +150,7 @@ private:
     VulkanRenderTarget* mCurrentRenderTarget = nullptr;
     VulkanSamplerBuffer* mSamplerBindings[VulkanBinder::NUM_SAMPLER_BINDINGS] = {};
     VkDebugReportCallbackEXT mDebugCallback = VK_NULL_HANDLE;
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;
 };
 
 } // namespace driver
@@ -66,6 +66,24 @@ VulkanProgram::VulkanProgram(VulkanContext& context, const Program& builder) noe
         ASSERT_POSTCONDITION(result == VK_SUCCESS, "Unable to create shader module.");
     }
 
+    // The same values are used for both stages, a stage ignores the constants it doesn't declare.
+    // Booleans are 32-bits in SPIR-V, so all the values can be stored as int32_t.
+    auto const& constants = builder.getSpecializationConstants();
+    bundle.specializationInfo = nullptr;
+    if (!constants.empty()) {
+        for (Program::SpecializationConstant const& constant : constants) {
+            specializationEntries.push_back({ constant.id,
+                    uint32_t(specializationData.size() * sizeof(int32_t)), sizeof(int32_t) });
+            specializationData.push_back(constant.value);
+        }
+        specializationInfo = {};
+        specializationInfo.mapEntryCount = uint32_t(specializationEntries.size());
+        specializationInfo.pMapEntries = specializationEntries.data();
+        specializationInfo.dataSize = specializationData.size() * sizeof(int32_t);
+        specializationInfo.pData = specializationData.data();
+        bundle.specializationInfo = &specializationInfo;
+    }
+
     // Output a warning because it's okay to encounter empty blobs, but it's not okay to use
     // this program handle in a draw call.
     if (missing) {
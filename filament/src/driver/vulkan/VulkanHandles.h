@@ -24,6 +24,8 @@
 #include <private/filament/EngineEnums.h>
 #include <private/filament/SamplerBindingMap.h>
 
+#include <vector>
+
 namespace filament {
 namespace driver {
 
@@ -33,6 +35,9 @@ struct VulkanProgram : public HwProgram {
     VulkanContext& context;
     VulkanBinder::ProgramBundle bundle;
     SamplerBindingMap samplerBindings;
+    std::vector<VkSpecializationMapEntry> specializationEntries;
+    std::vector<int32_t> specializationData;
+    VkSpecializationInfo specializationInfo;
 };
 
 struct VulkanTexture;
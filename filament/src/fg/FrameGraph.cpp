@@ -17,6 +17,7 @@
 #include "FrameGraph.h"
 
 #include "FrameGraphPassResources.h"
+#include "ResourceAllocator.h"
 
 #include "driver/Driver.h"
 #include "driver/Handle.h"
@@ -25,9 +26,12 @@
 
 #include <filament/driver/DriverEnums.h>
 
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 #include <utils/Log.h>
 
+#include <atomic>
+
 using namespace utils;
 
 namespace filament {
@@ -163,17 +167,17 @@ struct RenderTargetResource final : public VirtualResource {  // 104
                 }
 
                 // create the concrete rendertarget
-                targetInfo.target = driver.createRenderTarget(attachments,
-                        width, height, desc.samples, format,
-                        { textures[0] }, { textures[1] }, {});
+                targetInfo.target = fg.getResourceAllocator().createRenderTarget(
+                        attachments, width, height, desc.samples, format,
+                        textures[0], textures[1]);
             }
         }
     }
 
-    void destroy(FrameGraph&, DriverApi& driver) noexcept override {
+    void destroy(FrameGraph& fg, DriverApi&) noexcept override {
         if (!imported) {
             if (targetInfo.target) {
-                driver.destroyRenderTarget(targetInfo.target);
+                fg.getResourceAllocator().destroyRenderTarget(targetInfo.target);
                 targetInfo.target.clear();
             }
         }
@@ -307,13 +311,15 @@ struct PassNode { // 200
     template <typename T>
     using Vector = FrameGraph::Vector<T>;
 
-    PassNode(FrameGraph& fg, const char* name, uint32_t id, FrameGraphPassExecutor* base) noexcept
-            : name(name), id(id), base(base, fg),
+    PassNode(FrameGraph& fg, const char* name, uint32_t id, FrameGraphPassExecutor* base,
+            bool hasPrepare) noexcept
+            : name(name), id(id), base(base, fg), hasPrepare(hasPrepare),
               reads(fg.getArena()),
               writes(fg.getArena()),
               renderTargets(fg.getArena()),
               devirtualize(fg.getArena()),
-              destroy(fg.getArena()) {
+              destroy(fg.getArena()),
+              dependents(fg.getArena()) {
     }
     PassNode(PassNode const&) = delete;
     PassNode(PassNode&& rhs) noexcept = default;
@@ -395,6 +401,7 @@ struct PassNode { // 200
     const char* const name;                             // our name
     const uint32_t id;                                  // a unique id (only for debugging)
     FrameGraph::UniquePtr<FrameGraphPassExecutor> base; // type eraser for calling execute()
+    const bool hasPrepare;                              // whether base has a prepare() step
 
     // set by the builder
     Vector<FrameGraphResource> reads;               // resources we're reading from
@@ -406,6 +413,11 @@ struct PassNode { // 200
     Vector<VirtualResource*> destroy;              // resources we need to destroy after executing
     uint32_t refCount = 0;                  // count resources that have a reference to us
 
+    // set during execute(), when using a JobSystem
+    Vector<PassNode*> dependents;           // passes consuming our outputs
+    std::atomic<uint32_t>* pendingDependencies = nullptr; // # of producers not prepared yet
+    JobSystem::Job* prepareJob = nullptr;   // our prepare job
+
     // set by the builder
     bool hasSideEffect = false;             // whether this pass has side effects
 };
@@ -425,23 +437,25 @@ Resource::~Resource() noexcept {
     }
 }
 
-void Resource::create(FrameGraph&, DriverApi& driver) noexcept {
+void Resource::create(FrameGraph& fg, DriverApi&) noexcept {
     // some sanity check
     if (!imported) {
         if (needsTexture) {
             assert(usage);
             // (it means it's only used as an attachment for a rendertarget)
-            texture = driver.createTexture(desc.type, desc.levels, desc.format, 1,
+            texture = fg.getResourceAllocator().createTexture(desc.type, desc.levels, desc.format, 1,
                     desc.width, desc.height, desc.depth, usage);
         }
     }
 }
 
-void Resource::destroy(FrameGraph&, DriverApi& driver) noexcept {
+void Resource::destroy(FrameGraph& fg, DriverApi&) noexcept {
     // we don't own the handles of imported resources
     if (!imported) {
         if (texture) {
-            driver.destroyTexture(texture);
+            // this returns the texture to the pool, where it can be reused by a resource
+            // created later in this frame (i.e. lifetimes don't overlap) or in later frames.
+            fg.getResourceAllocator().destroyTexture(texture);
             texture.clear(); // needed because of noop driver
         }
     }
@@ -629,8 +643,9 @@ FrameGraphResource::Descriptor const& FrameGraphPassResources::getDescriptor(
 
 // ------------------------------------------------------------------------------------------------
 
-FrameGraph::FrameGraph()
-        : mArena("FrameGraph Arena", 16384), // TODO: the Area will eventually come from outside
+FrameGraph::FrameGraph(fg::ResourceAllocator& resourceAllocator)
+        : mResourceAllocator(resourceAllocator),
+          mArena("FrameGraph Arena", 16384), // TODO: the Area will eventually come from outside
           mPassNodes(mArena),
           mResourceNodes(mArena),
           mRenderTargets(mArena),
@@ -681,10 +696,11 @@ void FrameGraph::present(FrameGraphResource input) {
             }, [](FrameGraphPassResources const& resources, auto const& data, DriverApi&) {});
 }
 
-PassNode& FrameGraph::createPass(const char* name, FrameGraphPassExecutor* base) noexcept {
+PassNode& FrameGraph::createPass(const char* name, FrameGraphPassExecutor* base,
+        bool hasPrepare) noexcept {
     auto& frameGraphPasses = mPassNodes;
     const uint32_t id = (uint32_t)frameGraphPasses.size();
-    frameGraphPasses.emplace_back(*this, name, id, base);
+    frameGraphPasses.emplace_back(*this, name, id, base, hasPrepare);
     return frameGraphPasses.back();
 }
 
@@ -840,14 +856,37 @@ uint8_t FrameGraph::computeDiscardFlags(DiscardPhase phase,
 }
 
 FrameGraph& FrameGraph::compile() noexcept {
+    remapAliases();
+    computeLifetimes();
+    buildResourceLists();
+    return *this;
+}
+
+FrameGraph& FrameGraph::compile(fg::CompiledGraph& compiledGraph) noexcept {
+    // this must be done before aliases are remapped, as it modifies the passes
+    std::vector<uint32_t>& key = compiledGraph.mScratch;
+    serializeDeclaration(key);
+
+    remapAliases();
+
+    if (key == compiledGraph.mKey) {
+        // same graph as last time, the result of the compilation is the same as well
+        restoreCompilation(compiledGraph);
+        compiledGraph.mStats.hits++;
+    } else {
+        computeLifetimes();
+        saveCompilation(compiledGraph);
+        std::swap(compiledGraph.mKey, key);
+        compiledGraph.mStats.misses++;
+    }
+
+    buildResourceLists();
+    return *this;
+}
+
+void FrameGraph::remapAliases() noexcept {
     Vector<fg::PassNode>& passNodes = mPassNodes;
     Vector<fg::ResourceNode>& resourceNodes = mResourceNodes;
-    Vector<UniquePtr<fg::Resource>>& resourceRegistry = mResourceRegistry;
-    Vector<UniquePtr<RenderTargetResource>>& renderTargetCache = mRenderTargetCache;
-
-    /*
-     * remap aliased resources
-     */
 
     if (!mAliases.empty()) {
         Vector<FrameGraphResource> sratch(mArena); // keep out of loops to avoid reallocations
@@ -887,6 +926,11 @@ FrameGraph& FrameGraph::compile() noexcept {
             pass.reads.erase(std::unique(pass.reads.begin(), pass.reads.end()), pass.reads.end());
         }
     }
+}
+
+void FrameGraph::computeLifetimes() noexcept {
+    Vector<fg::PassNode>& passNodes = mPassNodes;
+    Vector<fg::ResourceNode>& resourceNodes = mResourceNodes;
 
     /*
      * compute passes and resource reference counts
@@ -1003,6 +1047,11 @@ FrameGraph& FrameGraph::compile() noexcept {
             };
         }
     }
+}
+
+void FrameGraph::buildResourceLists() noexcept {
+    Vector<UniquePtr<fg::Resource>> const& resourceRegistry = mResourceRegistry;
+    Vector<UniquePtr<RenderTargetResource>> const& renderTargetCache = mRenderTargetCache;
 
     // add resource to de-virtualize or destroy to the corresponding list for each active pass
     for (UniquePtr<fg::Resource> const& resource : resourceRegistry) {
@@ -1023,15 +1072,273 @@ FrameGraph& FrameGraph::compile() noexcept {
             entry->last->destroy.push_back(entry.get());
         }
     }
+}
 
-    return *this;
+void FrameGraph::serializeDeclaration(std::vector<uint32_t>& key) const noexcept {
+    // Everything the builder, aliasing and importing can set, and that compile() depends on,
+    // must be captured here. Two graphs with the same serialization compile the same way.
+    key.clear();
+    key.push_back((uint32_t)mPassNodes.size());
+    key.push_back((uint32_t)mResourceNodes.size());
+    key.push_back((uint32_t)mResourceRegistry.size());
+    key.push_back((uint32_t)mRenderTargets.size());
+    key.push_back((uint32_t)mAliases.size());
+    key.push_back((uint32_t)mRenderTargetCache.size());
+
+    auto pushAttachments = [&key](FrameGraphRenderTarget::Descriptor const& desc) {
+        key.push_back(desc.attachments.textures[0].index |
+                      uint32_t(desc.attachments.textures[1].index) << 16u);
+    };
+
+    for (PassNode const& pass : mPassNodes) {
+        key.push_back((uint32_t)pass.hasSideEffect);
+        key.push_back((uint32_t)pass.reads.size());
+        for (FrameGraphResource resource : pass.reads) {
+            key.push_back(resource.index);
+        }
+        key.push_back((uint32_t)pass.writes.size());
+        for (FrameGraphResource resource : pass.writes) {
+            key.push_back(resource.index);
+        }
+        key.push_back((uint32_t)pass.renderTargets.size());
+        for (RenderTarget const* pRenderTarget : pass.renderTargets) {
+            key.push_back(pRenderTarget->index);
+        }
+    }
+
+    for (ResourceNode const& node : mResourceNodes) {
+        key.push_back(node.resource->id | uint32_t(node.version) << 16u);
+    }
+
+    for (UniquePtr<fg::Resource> const& resource : mResourceRegistry) {
+        FrameGraphResource::Descriptor const& desc = resource->desc;
+        key.push_back(desc.width);
+        key.push_back(desc.height);
+        key.push_back(desc.depth);
+        key.push_back(desc.levels | uint32_t(desc.type) << 8u | uint32_t(desc.format) << 16u);
+        key.push_back(uint32_t(desc.relaxed) | uint32_t(resource->imported) << 1u |
+                      uint32_t(resource->needsTexture) << 2u | uint32_t(resource->usage) << 8u);
+    }
+
+    for (RenderTarget const& renderTarget : mRenderTargets) {
+        FrameGraphRenderTarget::Descriptor const& desc = renderTarget.desc;
+        pushAttachments(desc);
+        key.push_back((uint32_t)desc.viewport.left);
+        key.push_back((uint32_t)desc.viewport.bottom);
+        key.push_back(desc.viewport.width);
+        key.push_back(desc.viewport.height);
+        key.push_back(desc.samples | uint32_t(renderTarget.imported) << 8u |
+                      uint32_t(renderTarget.userTargetFlags.clear) << 16u);
+        key.push_back(renderTarget.userTargetFlags.discardStart |
+                      uint32_t(renderTarget.userTargetFlags.discardEnd) << 8u);
+    }
+
+    for (fg::Alias const& alias : mAliases) {
+        key.push_back(alias.from.index | uint32_t(alias.to.index) << 16u);
+    }
+
+    // at this point, the cache only contains the imported render targets
+    for (UniquePtr<RenderTargetResource> const& entry : mRenderTargetCache) {
+        pushAttachments(entry->desc);
+        key.push_back(entry->desc.samples);
+        key.push_back(entry->width);
+        key.push_back(entry->height);
+    }
+}
+
+void FrameGraph::saveCompilation(fg::CompiledGraph& compiledGraph) const noexcept {
+    using State = fg::CompiledGraph;
+    PassNode const* const first = mPassNodes.data();
+    auto indexOf = [first](PassNode const* pass) -> uint16_t {
+        return pass ? uint16_t(pass - first) : State::NONE;
+    };
+    auto cacheIndexOf = [this](RenderTargetResource const* entry) -> uint16_t {
+        auto pos = std::find_if(mRenderTargetCache.begin(), mRenderTargetCache.end(),
+                [entry](auto const& cur) { return cur.get() == entry; });
+        return pos != mRenderTargetCache.end() ?
+               uint16_t(pos - mRenderTargetCache.begin()) : State::NONE;
+    };
+
+    compiledGraph.mPassRefCounts.clear();
+    for (PassNode const& pass : mPassNodes) {
+        compiledGraph.mPassRefCounts.push_back(pass.refCount);
+    }
+
+    compiledGraph.mResources.clear();
+    for (UniquePtr<fg::Resource> const& resource : mResourceRegistry) {
+        compiledGraph.mResources.push_back({ resource->refs,
+                resource->desc.width, resource->desc.height,
+                indexOf(resource->first), indexOf(resource->last) });
+    }
+
+    // go through the passes, they hold the render targets that compile() updated
+    compiledGraph.mRenderTargets.assign(mRenderTargets.size(), {});
+    for (PassNode const& pass : mPassNodes) {
+        for (RenderTarget const* pRenderTarget : pass.renderTargets) {
+            compiledGraph.mRenderTargets[pRenderTarget->index] = {
+                    pRenderTarget->targetFlags, cacheIndexOf(pRenderTarget->cache) };
+        }
+    }
+
+    // entries are created by resolve(), in pass order, by the first render target needing them
+    compiledGraph.mCacheEntries.clear();
+    for (UniquePtr<RenderTargetResource> const& entry : mRenderTargetCache) {
+        uint16_t creator = State::NONE;
+        if (!entry->imported) {
+            for (PassNode const& pass : mPassNodes) {
+                auto pos = std::find_if(pass.renderTargets.begin(), pass.renderTargets.end(),
+                        [&entry](RenderTarget const* rt) { return rt->cache == entry.get(); });
+                if (pos != pass.renderTargets.end()) {
+                    creator = (*pos)->index;
+                    break;
+                }
+            }
+        }
+        compiledGraph.mCacheEntries.push_back({ creator,
+                indexOf(entry->first), indexOf(entry->last),
+                entry->attachments, entry->format, entry->width, entry->height });
+    }
+}
+
+void FrameGraph::restoreCompilation(fg::CompiledGraph const& compiledGraph) noexcept {
+    using State = fg::CompiledGraph;
+    Vector<fg::PassNode>& passNodes = mPassNodes;
+    auto passAt = [&passNodes](uint16_t index) -> PassNode* {
+        return index != State::NONE ? &passNodes[index] : nullptr;
+    };
+
+    for (size_t i = 0, c = passNodes.size(); i < c; i++) {
+        passNodes[i].refCount = compiledGraph.mPassRefCounts[i];
+    }
+
+    for (size_t i = 0, c = mResourceRegistry.size(); i < c; i++) {
+        State::ResourceState const& state = compiledGraph.mResources[i];
+        fg::Resource* const pResource = mResourceRegistry[i].get();
+        pResource->refs = state.refs;
+        pResource->desc.width = state.width;
+        pResource->desc.height = state.height;
+        pResource->first = passAt(state.first);
+        pResource->last = passAt(state.last);
+    }
+
+    // imported entries already exist, the other ones are recreated as resolve() would
+    Vector<UniquePtr<RenderTargetResource>>& renderTargetCache = mRenderTargetCache;
+    for (size_t i = 0, c = compiledGraph.mCacheEntries.size(); i < c; i++) {
+        State::CacheEntryState const& state = compiledGraph.mCacheEntries[i];
+        if (i >= renderTargetCache.size()) {
+            RenderTarget const& creator = mRenderTargets[state.renderTarget];
+            RenderTargetResource* pRenderTargetResource = mArena.make<RenderTargetResource>(
+                    creator.desc, creator.imported,
+                    state.attachments, state.width, state.height, state.format);
+            renderTargetCache.emplace_back(pRenderTargetResource, *this);
+        }
+        renderTargetCache[i]->first = passAt(state.first);
+        renderTargetCache[i]->last = passAt(state.last);
+    }
+
+    for (PassNode& pass : passNodes) {
+        for (RenderTarget* pRenderTarget : pass.renderTargets) {
+            State::RenderTargetState const& state = compiledGraph.mRenderTargets[pRenderTarget->index];
+            pRenderTarget->targetFlags = state.targetFlags;
+            if (state.cache != State::NONE) {
+                RenderTargetResource* const pCache = renderTargetCache[state.cache].get();
+                pCache->targetInfo.params.flags.clear |= pRenderTarget->userTargetFlags.clear;
+                pRenderTarget->cache = pCache;
+            }
+        }
+    }
 }
 
 void FrameGraph::execute(DriverApi& driver) noexcept {
-    for (PassNode const& node : mPassNodes) {
+    executePasses(nullptr, driver);
+}
+
+void FrameGraph::execute(JobSystem& js, DriverApi& driver) noexcept {
+    startPrepareJobs(js);
+    executePasses(&js, driver);
+}
+
+void FrameGraph::startPrepareJobs(JobSystem& js) noexcept {
+    Vector<fg::PassNode>& passNodes = mPassNodes;
+
+    const bool hasPrepare = std::any_of(passNodes.begin(), passNodes.end(),
+            [](PassNode const& pass) { return pass.refCount && pass.hasPrepare; });
+    if (!hasPrepare) {
+        // nothing to run in parallel
+        return;
+    }
+
+    // find the pass writing to each resource node, that's what we depend on
+    Vector<PassNode*> writers(mResourceNodes.size(), nullptr, mArena);
+    for (PassNode& pass : passNodes) {
+        if (pass.refCount) {
+            for (FrameGraphResource resource : pass.writes) {
+                writers[resource.index] = &pass;
+            }
+        }
+    }
+
+    // Build the dependency graph. Passes without a Prepare lambda are part of it as well, so
+    // that dependencies carry through them.
+    for (PassNode& pass : passNodes) {
+        if (!pass.refCount) continue;
+        uint32_t count = 0;
+        for (FrameGraphResource resource : pass.reads) {
+            PassNode* const writer = writers[resource.index];
+            if (writer && writer != &pass) {
+                auto& dependents = writer->dependents;
+                if (std::find(dependents.begin(), dependents.end(), &pass) == dependents.end()) {
+                    dependents.push_back(&pass);
+                    count++;
+                }
+            }
+        }
+        pass.pendingDependencies = mArena.make<std::atomic<uint32_t>>(count);
+    }
+
+    // Create all the jobs before starting any of them. A job is started by the last of its
+    // dependencies to finish, so that jobs never have to wait on each other -- which could
+    // deadlock when the waiting job ends-up running the job it waits on.
+    Vector<JobSystem::Job*> ready(mArena);
+    for (PassNode& pass : passNodes) {
+        if (!pass.refCount) continue;
+        JobSystem::Job* job = js.createJob(nullptr,
+                [&pass](JobSystem& js, JobSystem::Job*) {
+                    if (pass.hasPrepare) {
+                        pass.base->prepare();
+                    }
+                    for (PassNode* dependent : pass.dependents) {
+                        auto& pending = *dependent->pendingDependencies;
+                        if (pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                            JobSystem::Job* next = dependent->prepareJob;
+                            js.run(next);
+                        }
+                    }
+                });
+        // this reference is released in executePasses(), after waiting on the job
+        pass.prepareJob = js.retain(job);
+        if (pass.pendingDependencies->load(std::memory_order_relaxed) == 0) {
+            ready.push_back(job);
+        }
+    }
+
+    for (JobSystem::Job* job : ready) {
+        js.run(job);
+    }
+}
+
+void FrameGraph::executePasses(JobSystem* js, DriverApi& driver) noexcept {
+    for (PassNode& node : mPassNodes) {
         if (!node.refCount) continue;
         assert(node.base);
 
+        // make sure our prepare step has run
+        if (node.prepareJob) {
+            js->waitAndRelease(node.prepareJob);
+        } else if (node.hasPrepare) {
+            node.base->prepare();
+        }
+
         // create concrete resources and rendertargets
         for (VirtualResource* resource : node.devirtualize) {
             resource->create(*this, driver);
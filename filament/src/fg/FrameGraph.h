@@ -30,9 +30,14 @@
 
 #include <utils/Log.h>
 
+#include <limits>
 #include <vector>
 #include <memory>
 
+namespace utils {
+class JobSystem;
+} // namespace utils
+
 /*
  * A somewhat generic frame graph API.
  *
@@ -44,12 +49,74 @@
 namespace filament {
 
 namespace fg {
+class ResourceAllocator;
 struct Resource;
 struct ResourceNode;
 struct RenderTarget;
 struct RenderTargetResource;
 struct PassNode;
 struct Alias;
+
+/*
+ * The result of FrameGraph::compile(), kept across frames.
+ *
+ * Most frames declare exactly the same graph as the previous one. When that's the case,
+ * FrameGraph::compile(CompiledGraph&) skips culling, reference counting, render target
+ * resolution and discard flags computation, and restores their result from here instead.
+ * Only the most recent graph is remembered.
+ */
+class CompiledGraph {
+public:
+    CompiledGraph() noexcept = default;
+    CompiledGraph(CompiledGraph const&) = delete;
+    CompiledGraph& operator=(CompiledGraph const&) = delete;
+
+    // forget the recorded graph, the next compile() will do all the work
+    void invalidate() noexcept { mKey.clear(); }
+
+    struct Stats {
+        uint32_t hits = 0;      // compilations restored from the recorded graph
+        uint32_t misses = 0;    // full compilations
+    };
+    Stats const& getStats() const noexcept { return mStats; }
+
+private:
+    friend class filament::FrameGraph;
+
+    static constexpr uint16_t NONE = std::numeric_limits<uint16_t>::max();
+
+    struct ResourceState {
+        uint32_t refs;
+        uint32_t width;                 // resolve() can adjust the dimensions
+        uint32_t height;
+        uint16_t first;                 // index of the first pass using the resource
+        uint16_t last;                  // index of the last pass using the resource
+    };
+
+    struct RenderTargetState {
+        driver::RenderPassFlags targetFlags{};
+        uint16_t cache = NONE;          // index of the render target cache entry
+    };
+
+    struct CacheEntryState {
+        uint16_t renderTarget;          // index of the render target that created the entry
+        uint16_t first;
+        uint16_t last;
+        driver::TargetBufferFlags attachments;
+        driver::TextureFormat format;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    std::vector<uint32_t> mKey;         // serialized declaration of the recorded graph
+    std::vector<uint32_t> mScratch;     // declaration of the graph being compiled
+    std::vector<uint32_t> mPassRefCounts;
+    std::vector<ResourceState> mResources;
+    std::vector<RenderTargetState> mRenderTargets;
+    std::vector<CacheEntryState> mCacheEntries;
+    Stats mStats;
+};
+
 } // namespace fg
 
 class FrameGraphPassResources;
@@ -113,7 +180,9 @@ public:
         fg::PassNode& mPass;
     };
 
-    FrameGraph();
+    // Concrete resources are allocated from (and returned to) resourceAllocator, which
+    // typically outlives the FrameGraph so resources can be recycled across frames.
+    explicit FrameGraph(fg::ResourceAllocator& resourceAllocator);
     FrameGraph(FrameGraph const&) = delete;
     FrameGraph& operator = (FrameGraph const&) = delete;
     ~FrameGraph();
@@ -143,6 +212,37 @@ public:
         return *pass;
     }
 
+    /*
+     * Same as above, with an additional Prepare lambda, which is where the CPU work of the pass
+     *   that doesn't need the driver (e.g. command generation) should be done.
+     * When the FrameGraph is executed with a JobSystem, Prepare lambdas are called from the
+     *   JobSystem's threads, concurrently with each other and with the Execute lambdas of earlier
+     *   passes. The Prepare lambda of a pass is called after the ones of the passes producing
+     *   the resources it reads, and before its own Execute lambda.
+     *   Prepare must not use the driver, and must only write to the pass' Data, or to state
+     *   owned by the pass alone (e.g. its command buffer).
+     */
+    template <typename Data, typename Setup, typename Prepare, typename Execute>
+    FrameGraphPass<Data, Execute, Prepare>& addPass(const char* name, Setup setup,
+            Prepare&& prepare, Execute&& execute) {
+        static_assert(sizeof(Execute) < 1024, "Execute() lambda is capturing too much data.");
+        static_assert(sizeof(Prepare) < 1024, "Prepare() lambda is capturing too much data.");
+
+        // create the FrameGraph pass
+        auto* const pass = mArena.make<FrameGraphPass<Data, Execute, Prepare>>(
+                std::forward<Prepare>(prepare), std::forward<Execute>(execute));
+
+        // record in our pass list
+        fg::PassNode& node = createPass(name, pass, true);
+
+        // call the setup code, which will declare used resources
+        Builder builder(*this, node);
+        setup(builder, pass->getData());
+
+        // return a reference to the pass to the user
+        return *pass;
+    }
+
     // Adds a reference to 'input', preventing it from being culled.
     void present(FrameGraphResource input);
 
@@ -178,14 +278,23 @@ public:
     // allocates concrete resources and culls unreferenced passes
     FrameGraph& compile() noexcept;
 
+    // same as compile(), but reuses the result recorded in compiledGraph if this graph is
+    // declared the same way as the one it was recorded from, and records it otherwise.
+    FrameGraph& compile(fg::CompiledGraph& compiledGraph) noexcept;
+
     // execute all referenced passes
     void execute(driver::DriverApi& driver) noexcept;
 
+    // Execute all referenced passes. Their Prepare lambdas run in parallel on the JobSystem,
+    // while the Execute lambdas are still called in order from the calling thread.
+    void execute(utils::JobSystem& js, driver::DriverApi& driver) noexcept;
+
     // for debugging
     void export_graphviz(utils::io::ostream& out);
 
 private:
     friend class FrameGraphPassResources;
+    friend struct fg::Resource;
     friend struct fg::PassNode;
     friend struct fg::RenderTarget;
     friend struct fg::RenderTargetResource;
@@ -203,7 +312,13 @@ private:
 
     auto& getArena() noexcept { return mArena; }
 
-    fg::PassNode& createPass(const char* name, FrameGraphPassExecutor* base) noexcept;
+    fg::ResourceAllocator& getResourceAllocator() noexcept { return mResourceAllocator; }
+
+    fg::PassNode& createPass(const char* name, FrameGraphPassExecutor* base,
+            bool hasPrepare = false) noexcept;
+
+    void startPrepareJobs(utils::JobSystem& js) noexcept;
+    void executePasses(utils::JobSystem* js, driver::DriverApi& driver) noexcept;
 
     fg::Resource* createResource(const char* name,
             FrameGraphResource::Descriptor const& desc, bool imported) noexcept;
@@ -220,9 +335,18 @@ private:
             fg::PassNode const* curr, fg::PassNode const* first,
             fg::RenderTarget const& renderTarget);
 
+    void remapAliases() noexcept;
+    void computeLifetimes() noexcept;
+    void buildResourceLists() noexcept;
+
+    void serializeDeclaration(std::vector<uint32_t>& key) const noexcept;
+    void saveCompilation(fg::CompiledGraph& compiledGraph) const noexcept;
+    void restoreCompilation(fg::CompiledGraph const& compiledGraph) noexcept;
+
     bool equals(FrameGraphRenderTarget::Descriptor const& lhs,
             FrameGraphRenderTarget::Descriptor const& rhs) const noexcept;
 
+    fg::ResourceAllocator& mResourceAllocator;
     details::LinearAllocatorArena mArena;
     Vector<fg::PassNode> mPassNodes;                    // list of frame graph passes
     Vector<fg::ResourceNode> mResourceNodes;            // list of resource nodes
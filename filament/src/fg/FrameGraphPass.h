@@ -32,6 +32,7 @@ class FrameGraphPassResources;
 
 class FrameGraphPassExecutor {
     friend class FrameGraph;
+    virtual void prepare() noexcept = 0;
     virtual void execute(FrameGraphPassResources const& resources, driver::DriverApi& driver) noexcept = 0;
 public:
     FrameGraphPassExecutor();
@@ -40,7 +41,13 @@ public:
     FrameGraphPassExecutor& operator = (FrameGraphPassExecutor const&) = delete;
 };
 
-template <typename Data, typename Execute>
+// used for passes that don't have a Prepare lambda
+struct FrameGraphNoPrepare {
+    template <typename Data>
+    void operator()(Data&) const noexcept { }
+};
+
+template <typename Data, typename Execute, typename Prepare = FrameGraphNoPrepare>
 class FrameGraphPass final : private FrameGraphPassExecutor {
     friend class FrameGraph;
 
@@ -51,9 +58,17 @@ class FrameGraphPass final : private FrameGraphPassExecutor {
     explicit FrameGraphPass(Execute&& execute) noexcept
             : FrameGraphPassExecutor(), mExecute(std::forward<Execute>(execute)) {
     }
+    FrameGraphPass(Prepare&& prepare, Execute&& execute) noexcept
+            : FrameGraphPassExecutor(),
+              mPrepare(std::forward<Prepare>(prepare)), mExecute(std::forward<Execute>(execute)) {
+    }
+    void prepare() noexcept final {
+        mPrepare(mData);
+    }
     void execute(FrameGraphPassResources const& resources, driver::DriverApi& driver) noexcept final {
         mExecute(resources, mData, driver);
     }
+    Prepare mPrepare;
     Execute mExecute;
     Data mData;
 
@@ -0,0 +1,173 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ResourceAllocator.h"
+
+#include "driver/CommandStream.h"
+
+#include <string.h>
+
+using namespace utils;
+
+namespace filament {
+
+using namespace driver;
+
+namespace fg {
+
+bool ResourceAllocator::TextureKeyEqualFn::operator()(
+        TextureKey const& lhs, TextureKey const& rhs) const noexcept {
+    return !memcmp(&lhs, &rhs, sizeof(TextureKey));
+}
+
+bool ResourceAllocator::RenderTargetKeyEqualFn::operator()(
+        RenderTargetKey const& lhs, RenderTargetKey const& rhs) const noexcept {
+    return !memcmp(&lhs, &rhs, sizeof(RenderTargetKey));
+}
+
+ResourceAllocator::ResourceAllocator(DriverApi& driverApi) noexcept
+        : mDriverApi(driverApi) {
+}
+
+ResourceAllocator::~ResourceAllocator() noexcept {
+    assert(mTextureCache.empty());
+    assert(mRenderTargetCache.empty());
+    assert(mInUseTextures.empty());
+    assert(mInUseRenderTargets.empty());
+}
+
+void ResourceAllocator::terminate() noexcept {
+    assert(mInUseTextures.empty());
+    assert(mInUseRenderTargets.empty());
+    DriverApi& driver = mDriverApi;
+    // render targets first, as they reference the textures
+    for (auto& entry : mRenderTargetCache) {
+        driver.destroyRenderTarget(entry.second.handle);
+    }
+    mRenderTargetCache.clear();
+    for (auto& entry : mTextureCache) {
+        driver.destroyTexture(entry.second.handle);
+    }
+    mTextureCache.clear();
+    mStats.textureCount = 0;
+}
+
+Handle<HwTexture> ResourceAllocator::createTexture(SamplerType target, uint8_t levels,
+        TextureFormat format, uint8_t samples, uint32_t width, uint32_t height, uint32_t depth,
+        TextureUsage usage) noexcept {
+    const TextureKey key{ width, height, depth, format, target, levels, samples, usage, 0 };
+
+    Handle<HwTexture> handle;
+    auto pos = mTextureCache.find(key);
+    if (pos != mTextureCache.end()) {
+        // we found a matching texture that nobody uses, recycle it
+        handle = pos->second.handle;
+        mTextureCache.erase(pos);
+        mStats.textureHits++;
+    } else {
+        handle = mDriverApi.createTexture(target, levels, format, samples,
+                width, height, depth, usage);
+        mStats.textureMisses++;
+        mStats.textureCount++;
+        mStats.peakTextureCount = std::max(mStats.peakTextureCount, mStats.textureCount);
+    }
+    mInUseTextures.emplace(handle.getId(), key);
+    return handle;
+}
+
+void ResourceAllocator::destroyTexture(Handle<HwTexture> h) noexcept {
+    auto pos = mInUseTextures.find(h.getId());
+    assert(pos != mInUseTextures.end());
+    if (pos != mInUseTextures.end()) {
+        mTextureCache.emplace(pos->second, CachedEntry<HwTexture>{ h, mCurrentTime });
+        mInUseTextures.erase(pos);
+    }
+}
+
+Handle<HwRenderTarget> ResourceAllocator::createRenderTarget(TargetBufferFlags targetBufferFlags,
+        uint32_t width, uint32_t height, uint8_t samples, TextureFormat format,
+        Handle<HwTexture> color, Handle<HwTexture> depth) noexcept {
+    const RenderTargetKey key{ width, height, color.getId(), depth.getId(),
+                               format, targetBufferFlags, samples };
+
+    Handle<HwRenderTarget> handle;
+    auto pos = mRenderTargetCache.find(key);
+    if (pos != mRenderTargetCache.end()) {
+        handle = pos->second.handle;
+        mRenderTargetCache.erase(pos);
+        mStats.renderTargetHits++;
+    } else {
+        handle = mDriverApi.createRenderTarget(targetBufferFlags,
+                width, height, samples, format, { color }, { depth }, {});
+        mStats.renderTargetMisses++;
+    }
+    mInUseRenderTargets.emplace(handle.getId(), key);
+    return handle;
+}
+
+void ResourceAllocator::destroyRenderTarget(Handle<HwRenderTarget> h) noexcept {
+    auto pos = mInUseRenderTargets.find(h.getId());
+    assert(pos != mInUseRenderTargets.end());
+    if (pos != mInUseRenderTargets.end()) {
+        mRenderTargetCache.emplace(pos->second, CachedEntry<HwRenderTarget>{ h, mCurrentTime });
+        mInUseRenderTargets.erase(pos);
+    }
+}
+
+void ResourceAllocator::evictRenderTargetsUsing(HandleBase::HandleId texture) noexcept {
+    // a render target can't outlive its attachments
+    for (auto it = mRenderTargetCache.begin(); it != mRenderTargetCache.end();) {
+        if (it->first.color == texture || it->first.depth == texture) {
+            mDriverApi.destroyRenderTarget(it->second.handle);
+            it = mRenderTargetCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void ResourceAllocator::gc() noexcept {
+    mCurrentTime++;
+    if (mCurrentTime < TIME_BEFORE_EVICTION) {
+        return;
+    }
+
+    DriverApi& driver = mDriverApi;
+    const uint32_t evictTime = mCurrentTime - TIME_BEFORE_EVICTION;
+
+    for (auto it = mRenderTargetCache.begin(); it != mRenderTargetCache.end();) {
+        if (it->second.timestamp < evictTime) {
+            driver.destroyRenderTarget(it->second.handle);
+            it = mRenderTargetCache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = mTextureCache.begin(); it != mTextureCache.end();) {
+        if (it->second.timestamp < evictTime) {
+            evictRenderTargetsUsing(it->second.handle.getId());
+            driver.destroyTexture(it->second.handle);
+            it = mTextureCache.erase(it);
+            mStats.textureCount--;
+        } else {
+            ++it;
+        }
+    }
+}
+
+} // namespace fg
+} // namespace filament
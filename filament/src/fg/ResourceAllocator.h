@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_FG_RESOURCEALLOCATOR_H
+#define TNT_FILAMENT_FG_RESOURCEALLOCATOR_H
+
+#include "driver/DriverApiForward.h"
+#include "driver/Handle.h"
+
+#include <filament/driver/DriverEnums.h>
+
+#include <utils/Hash.h>
+
+#include <tsl/robin_map.h>
+
+#include <unordered_map>
+
+#include <stdint.h>
+
+namespace filament {
+namespace fg {
+
+/*
+ * Pool of concrete textures and render targets used by the FrameGraph's transient resources.
+ *
+ * Resources given back to the allocator are not destroyed, instead they're kept around and
+ * handed out again to the next request with a matching description. This happens within a frame
+ * -- so that transient resources with non-overlapping lifetimes share the same memory -- as well
+ * as across frames, so that we don't pay for the driver's object creation every frame.
+ * Resources that haven't been used for a few frames are evicted by gc().
+ */
+class ResourceAllocator {
+public:
+    explicit ResourceAllocator(driver::DriverApi& driverApi) noexcept;
+    ResourceAllocator(ResourceAllocator const&) = delete;
+    ResourceAllocator& operator=(ResourceAllocator const&) = delete;
+    ~ResourceAllocator() noexcept;
+
+    // Destroys all the cached resources. Call this during shutdown.
+    void terminate() noexcept;
+
+    Handle<HwTexture> createTexture(driver::SamplerType target, uint8_t levels,
+            driver::TextureFormat format, uint8_t samples,
+            uint32_t width, uint32_t height, uint32_t depth,
+            driver::TextureUsage usage) noexcept;
+
+    // Returns the texture to the pool, it can be handed out again immediately.
+    void destroyTexture(Handle<HwTexture> h) noexcept;
+
+    Handle<HwRenderTarget> createRenderTarget(driver::TargetBufferFlags targetBufferFlags,
+            uint32_t width, uint32_t height, uint8_t samples, driver::TextureFormat format,
+            Handle<HwTexture> color, Handle<HwTexture> depth) noexcept;
+
+    // Returns the render target to the pool, it can be handed out again immediately.
+    void destroyRenderTarget(Handle<HwRenderTarget> h) noexcept;
+
+    // Evicts the resources that haven't been used for a while. Call this once per frame.
+    void gc() noexcept;
+
+    struct Stats {
+        uint32_t textureHits = 0;           // textures recycled from the pool
+        uint32_t textureMisses = 0;         // textures created by the driver
+        uint32_t renderTargetHits = 0;      // render targets recycled from the pool
+        uint32_t renderTargetMisses = 0;    // render targets created by the driver
+        uint32_t textureCount = 0;          // textures currently alive (in use or cached)
+        uint32_t peakTextureCount = 0;      // max number of textures alive at once
+    };
+
+    // Statistics since creation, useful for tuning.
+    Stats const& getStats() const noexcept { return mStats; }
+
+private:
+    struct TextureKey { // 20
+        uint32_t width;
+        uint32_t height;
+        uint32_t depth;
+        driver::TextureFormat format;
+        driver::SamplerType target;
+        uint8_t levels;
+        uint8_t samples;
+        driver::TextureUsage usage;
+        uint16_t padding;
+    };
+    static_assert(sizeof(TextureKey) == 20, "TextureKey has unexpected size.");
+    using TextureKeyHashFn = utils::hash::MurmurHashFn<TextureKey>;
+    struct TextureKeyEqualFn {
+        bool operator()(TextureKey const& lhs, TextureKey const& rhs) const noexcept;
+    };
+
+    struct RenderTargetKey { // 20
+        uint32_t width;
+        uint32_t height;
+        HandleBase::HandleId color;
+        HandleBase::HandleId depth;
+        driver::TextureFormat format;
+        driver::TargetBufferFlags targetBufferFlags;
+        uint8_t samples;
+    };
+    static_assert(sizeof(RenderTargetKey) == 20, "RenderTargetKey has unexpected size.");
+    using RenderTargetKeyHashFn = utils::hash::MurmurHashFn<RenderTargetKey>;
+    struct RenderTargetKeyEqualFn {
+        bool operator()(RenderTargetKey const& lhs, RenderTargetKey const& rhs) const noexcept;
+    };
+
+    template<typename T>
+    struct CachedEntry {
+        Handle<T> handle;
+        uint32_t timestamp;     // last time this entry was given back to the pool
+    };
+
+    void evictRenderTargetsUsing(HandleBase::HandleId texture) noexcept;
+
+    driver::DriverApi& mDriverApi;
+
+    // resources available for reuse
+    std::unordered_multimap<TextureKey, CachedEntry<HwTexture>,
+            TextureKeyHashFn, TextureKeyEqualFn> mTextureCache;
+    std::unordered_multimap<RenderTargetKey, CachedEntry<HwRenderTarget>,
+            RenderTargetKeyHashFn, RenderTargetKeyEqualFn> mRenderTargetCache;
+
+    // resources currently handed out
+    tsl::robin_map<HandleBase::HandleId, TextureKey> mInUseTextures;
+    tsl::robin_map<HandleBase::HandleId, RenderTargetKey> mInUseRenderTargets;
+
+    Stats mStats;
+    uint32_t mCurrentTime = 0;
+    static constexpr uint32_t TIME_BEFORE_EVICTION = 3;
+};
+
+} // namespace fg
+} // namespace filament
+
+#endif // TNT_FILAMENT_FG_RESOURCEALLOCATOR_H
@@ -18,19 +18,34 @@
 
 #include "fg/FrameGraph.h"
 #include "fg/FrameGraphPassResources.h"
+#include "fg/ResourceAllocator.h"
 
 #include "driver/CommandStream.h"
 #include "driver/noop/NoopDriver.h"
 
+#include <utils/JobSystem.h>
+
+#include <string>
+#include <vector>
+
 using namespace filament;
 using namespace driver;
 
 static CircularBuffer buffer(8192);
 static CommandStream driverApi(*NoopDriver::create(), buffer);
 
-TEST(FrameGraphTest, SimpleRenderPass) {
+class FrameGraphTest : public testing::Test {
+protected:
+    void TearDown() override {
+        resourceAllocator.terminate();
+    }
+
+    fg::ResourceAllocator resourceAllocator{ driverApi };
+};
 
-    FrameGraph fg;
+TEST_F(FrameGraphTest, SimpleRenderPass) {
+
+    FrameGraph fg(resourceAllocator);
 
     bool renderPassExecuted = false;
 
@@ -66,9 +81,9 @@ TEST(FrameGraphTest, SimpleRenderPass) {
     EXPECT_TRUE(renderPassExecuted);
 }
 
-TEST(FrameGraphTest, SimpleRenderPass2) {
+TEST_F(FrameGraphTest, SimpleRenderPass2) {
 
-    FrameGraph fg;
+    FrameGraph fg(resourceAllocator);
 
     bool renderPassExecuted = false;
 
@@ -114,9 +129,9 @@ TEST(FrameGraphTest, SimpleRenderPass2) {
     EXPECT_TRUE(renderPassExecuted);
 }
 
-TEST(FrameGraphTest, ScenarioDepthPrePass) {
+TEST_F(FrameGraphTest, ScenarioDepthPrePass) {
 
-    FrameGraph fg;
+    FrameGraph fg(resourceAllocator);
 
     bool depthPrepassExecuted = false;
     bool colorPassExecuted = false;
@@ -192,9 +207,9 @@ TEST(FrameGraphTest, ScenarioDepthPrePass) {
     EXPECT_TRUE(colorPassExecuted);
 }
 
-TEST(FrameGraphTest, SimplePassCulling) {
+TEST_F(FrameGraphTest, SimplePassCulling) {
 
-    FrameGraph fg;
+    FrameGraph fg(resourceAllocator);
 
     bool renderPassExecuted = false;
     bool postProcessPassExecuted = false;
@@ -279,9 +294,9 @@ TEST(FrameGraphTest, SimplePassCulling) {
     EXPECT_FALSE(culledPassExecuted);
 }
 
-TEST(FrameGraphTest, RenderTargetLifetime) {
+TEST_F(FrameGraphTest, RenderTargetLifetime) {
 
-    FrameGraph fg;
+    FrameGraph fg(resourceAllocator);
 
     bool renderPassExecuted1 = false;
     bool renderPassExecuted2 = false;
@@ -338,3 +353,332 @@ TEST(FrameGraphTest, RenderTargetLifetime) {
     EXPECT_TRUE(renderPassExecuted1);
     EXPECT_TRUE(renderPassExecuted2);
 }
+
+TEST_F(FrameGraphTest, TransientResourcePool) {
+
+    struct RenderPassData {
+        FrameGraphResource output;
+    };
+
+    struct PostProcessPassData {
+        FrameGraphResource input;
+        FrameGraphResource output;
+    };
+
+    auto renderFrame = [this]() {
+        FrameGraph fg(resourceAllocator);
+
+        auto& renderPass = fg.addPass<RenderPassData>("Render",
+                [&](FrameGraph::Builder& builder, RenderPassData& data) {
+                    data.output = builder.createTexture("color buffer",
+                            { .width = 512, .height = 512, .format = TextureFormat::RGBA16F });
+                    data.output = builder.useRenderTarget(data.output).textures[0];
+                },
+                [=](FrameGraphPassResources const& resources,
+                        RenderPassData const& data, DriverApi& driver) {});
+
+        auto& firstPass = fg.addPass<PostProcessPassData>("PostProcess1",
+                [&](FrameGraph::Builder& builder, PostProcessPassData& data) {
+                    data.input = builder.read(renderPass.getData().output);
+                    data.output = builder.createTexture("first buffer",
+                            { .width = 512, .height = 512, .format = TextureFormat::RGBA8 });
+                    data.output = builder.useRenderTarget(data.output).textures[0];
+                },
+                [=](FrameGraphPassResources const& resources,
+                        PostProcessPassData const& data, DriverApi& driver) {});
+
+        // same descriptor as "color buffer", whose lifetime has ended
+        auto& secondPass = fg.addPass<PostProcessPassData>("PostProcess2",
+                [&](FrameGraph::Builder& builder, PostProcessPassData& data) {
+                    data.input = builder.read(firstPass.getData().output);
+                    data.output = builder.createTexture("second buffer",
+                            { .width = 512, .height = 512, .format = TextureFormat::RGBA16F });
+                    data.output = builder.useRenderTarget(data.output).textures[0];
+                },
+                [=](FrameGraphPassResources const& resources,
+                        PostProcessPassData const& data, DriverApi& driver) {});
+
+        // this one doesn't need a texture, it's only used as a render target
+        auto& thirdPass = fg.addPass<PostProcessPassData>("PostProcess3",
+                [&](FrameGraph::Builder& builder, PostProcessPassData& data) {
+                    data.input = builder.read(secondPass.getData().output);
+                    data.output = builder.createTexture("third buffer",
+                            { .width = 512, .height = 512, .format = TextureFormat::RGBA8 });
+                    data.output = builder.useRenderTarget(data.output).textures[0];
+                },
+                [=](FrameGraphPassResources const& resources,
+                        PostProcessPassData const& data, DriverApi& driver) {});
+
+        fg.present(thirdPass.getData().output);
+        fg.compile();
+        fg.execute(driverApi);
+        resourceAllocator.gc();
+    };
+
+    // first frame: "second buffer" aliases "color buffer", and so do their render targets
+    renderFrame();
+    auto stats = resourceAllocator.getStats();
+    EXPECT_EQ(2, stats.textureMisses);
+    EXPECT_EQ(1, stats.textureHits);
+    EXPECT_EQ(2, stats.textureCount);
+    EXPECT_EQ(3, stats.renderTargetMisses);
+    EXPECT_EQ(1, stats.renderTargetHits);
+
+    // following frames: everything comes from the pool
+    renderFrame();
+    renderFrame();
+    stats = resourceAllocator.getStats();
+    EXPECT_EQ(2, stats.textureMisses);
+    EXPECT_EQ(7, stats.textureHits);
+    EXPECT_EQ(2, stats.textureCount);
+    EXPECT_EQ(2, stats.peakTextureCount);
+    EXPECT_EQ(3, stats.renderTargetMisses);
+    EXPECT_EQ(9, stats.renderTargetHits);
+
+    // resources not used for a while are evicted
+    for (size_t i = 0; i < 4; i++) {
+        resourceAllocator.gc();
+    }
+    EXPECT_EQ(0, resourceAllocator.getStats().textureCount);
+}
+
+TEST_F(FrameGraphTest, CompiledGraphReuse) {
+
+    struct PassResult {
+        bool executed = false;
+        RenderPassParams params{};
+    };
+
+    struct FrameResult {
+        PassResult color;
+        PassResult postProcess;
+        PassResult culled;
+    };
+
+    struct ColorPassData {
+        FrameGraphResource color;
+        FrameGraphResource depth;
+    };
+
+    struct PostProcessPassData {
+        FrameGraphResource input;
+        FrameGraphResource output;
+    };
+
+    Handle<HwRenderTarget> viewRenderTarget = driverApi.createDefaultRenderTarget();
+
+    // a graph similar to the one built by the Renderer
+    auto renderFrame = [&](uint32_t width, fg::CompiledGraph* compiledGraph) {
+        FrameResult result;
+        FrameGraph fg(resourceAllocator);
+
+        FrameGraphResource output = fg.importResource("viewRenderTarget",
+                { .viewport = { 0, 0, width, 256 } }, viewRenderTarget, width, 256);
+
+        auto& colorPass = fg.addPass<ColorPassData>("Color pass",
+                [&](FrameGraph::Builder& builder, ColorPassData& data) {
+                    data.color = builder.createTexture("color buffer",
+                            { .width = width, .height = 256, .format = TextureFormat::RGBA16F,
+                              .relaxed = true });
+                    data.depth = builder.createTexture("depth buffer",
+                            { .width = width, .height = 256, .format = TextureFormat::DEPTH24,
+                              .relaxed = true });
+                    FrameGraphRenderTarget::Descriptor desc{
+                            .attachments.color = data.color,
+                            .attachments.depth = data.depth
+                    };
+                    data.color = builder.useRenderTarget("colorRenderTarget", desc,
+                            TargetBufferFlags::COLOR_AND_DEPTH).textures[0];
+                },
+                [&result](FrameGraphPassResources const& resources,
+                        ColorPassData const& data, DriverApi& driver) {
+                    auto rt = resources.getRenderTarget(data.color);
+                    EXPECT_TRUE(rt.target);
+                    result.color = { true, rt.params };
+                });
+
+        auto& postProcessPass = fg.addPass<PostProcessPassData>("Post process",
+                [&](FrameGraph::Builder& builder, PostProcessPassData& data) {
+                    data.input = builder.read(colorPass.getData().color);
+                    data.output = builder.createTexture("tonemapped buffer",
+                            { .width = width, .height = 256 });
+                    data.output = builder.useRenderTarget(data.output).textures[0];
+                },
+                [&result](FrameGraphPassResources const& resources,
+                        PostProcessPassData const& data, DriverApi& driver) {
+                    auto rt = resources.getRenderTarget(data.output);
+                    EXPECT_TRUE(rt.target);
+                    result.postProcess = { true, rt.params };
+                });
+
+        fg.addPass<PostProcessPassData>("Culled",
+                [&](FrameGraph::Builder& builder, PostProcessPassData& data) {
+                    data.input = builder.read(colorPass.getData().color);
+                    data.output = builder.createTexture("unused buffer");
+                    data.output = builder.useRenderTarget(data.output).textures[0];
+                },
+                [&result](FrameGraphPassResources const& resources,
+                        PostProcessPassData const& data, DriverApi& driver) {
+                    result.culled.executed = true;
+                });
+
+        FrameGraphResource input = postProcessPass.getData().output;
+        fg.present(input);
+        fg.moveResource(output, input);
+
+        if (compiledGraph) {
+            fg.compile(*compiledGraph);
+        } else {
+            fg.compile();
+        }
+        fg.execute(driverApi);
+        resourceAllocator.gc();
+        return result;
+    };
+
+    auto expectSameResult = [](FrameResult const& lhs, FrameResult const& rhs) {
+        for (auto pass : { &FrameResult::color, &FrameResult::postProcess, &FrameResult::culled }) {
+            PassResult const& l = lhs.*pass;
+            PassResult const& r = rhs.*pass;
+            EXPECT_EQ(l.executed, r.executed);
+            EXPECT_EQ(l.params.flags.clear, r.params.flags.clear);
+            EXPECT_EQ(l.params.flags.discardStart, r.params.flags.discardStart);
+            EXPECT_EQ(l.params.flags.discardEnd, r.params.flags.discardEnd);
+            EXPECT_EQ(l.params.viewport.left, r.params.viewport.left);
+            EXPECT_EQ(l.params.viewport.bottom, r.params.viewport.bottom);
+            EXPECT_EQ(l.params.viewport.width, r.params.viewport.width);
+            EXPECT_EQ(l.params.viewport.height, r.params.viewport.height);
+        }
+    };
+
+    fg::CompiledGraph compiledGraph;
+
+    // first frame: nothing recorded yet
+    const FrameResult reference = renderFrame(500, nullptr);
+    EXPECT_TRUE(reference.color.executed);
+    EXPECT_TRUE(reference.postProcess.executed);
+    EXPECT_FALSE(reference.culled.executed);
+    EXPECT_EQ(512, reference.color.params.viewport.width); // relaxed attachments are rounded up
+
+    expectSameResult(reference, renderFrame(500, &compiledGraph));
+    EXPECT_EQ(0, compiledGraph.getStats().hits);
+    EXPECT_EQ(1, compiledGraph.getStats().misses);
+
+    // same graph: the compilation is reused, and must produce the same result
+    expectSameResult(reference, renderFrame(500, &compiledGraph));
+    expectSameResult(reference, renderFrame(500, &compiledGraph));
+    EXPECT_EQ(2, compiledGraph.getStats().hits);
+    EXPECT_EQ(1, compiledGraph.getStats().misses);
+
+    // a different descriptor invalidates the recorded graph
+    const FrameResult resized = renderFrame(300, nullptr);
+    EXPECT_EQ(320, resized.color.params.viewport.width);
+    expectSameResult(resized, renderFrame(300, &compiledGraph));
+    expectSameResult(resized, renderFrame(300, &compiledGraph));
+    EXPECT_EQ(3, compiledGraph.getStats().hits);
+    EXPECT_EQ(2, compiledGraph.getStats().misses);
+
+    driverApi.destroyRenderTarget(viewRenderTarget);
+}
+
+TEST_F(FrameGraphTest, ParallelPrepare) {
+
+    utils::JobSystem js;
+    js.adopt();
+
+    struct PassData {
+        FrameGraphResource input;
+        FrameGraphResource output;
+        uint32_t value = 0;
+    };
+
+    auto createOutput = [](FrameGraph::Builder& builder, PassData& data, const char* name) {
+        data.output = builder.createTexture(name);
+        data.output = builder.useRenderTarget(data.output).textures[0];
+    };
+
+    for (size_t frame = 0; frame < 16; frame++) {
+        FrameGraph fg(resourceAllocator);
+        std::vector<std::string> executed;
+        bool culledPrepared = false;
+
+        auto& shadowPass = fg.addPass<PassData>("Shadow",
+                [&](FrameGraph::Builder& builder, PassData& data) {
+                    createOutput(builder, data, "shadow buffer");
+                },
+                [](PassData& data) { data.value = 1; },
+                [&executed](FrameGraphPassResources const&, PassData const& data, DriverApi&) {
+                    EXPECT_EQ(1, data.value);
+                    executed.push_back("Shadow");
+                });
+
+        // independent of the other passes
+        auto& unrelatedPass = fg.addPass<PassData>("Unrelated",
+                [&](FrameGraph::Builder& builder, PassData& data) {
+                    createOutput(builder, data, "unrelated buffer");
+                },
+                [](PassData& data) { data.value = 10; },
+                [&executed](FrameGraphPassResources const&, PassData const& data, DriverApi&) {
+                    EXPECT_EQ(10, data.value);
+                    executed.push_back("Unrelated");
+                });
+
+        // its prepare step depends on the one of the shadow pass
+        auto& colorPass = fg.addPass<PassData>("Color",
+                [&](FrameGraph::Builder& builder, PassData& data) {
+                    data.input = builder.read(shadowPass.getData().output);
+                    createOutput(builder, data, "color buffer");
+                },
+                [&shadowPass](PassData& data) { data.value = shadowPass.getData().value + 1; },
+                [&executed](FrameGraphPassResources const&, PassData const& data, DriverApi&) {
+                    EXPECT_EQ(2, data.value);
+                    executed.push_back("Color");
+                });
+
+        // no prepare step
+        auto& postProcessPass = fg.addPass<PassData>("PostProcess",
+                [&](FrameGraph::Builder& builder, PassData& data) {
+                    data.input = builder.read(colorPass.getData().output);
+                    createOutput(builder, data, "post-process buffer");
+                },
+                [&executed](FrameGraphPassResources const&, PassData const& data, DriverApi&) {
+                    executed.push_back("PostProcess");
+                });
+
+        // dependencies carry through passes without a prepare step
+        auto& finalPass = fg.addPass<PassData>("Final",
+                [&](FrameGraph::Builder& builder, PassData& data) {
+                    data.input = builder.read(postProcessPass.getData().output);
+                    createOutput(builder, data, "final buffer");
+                },
+                [&colorPass](PassData& data) { data.value = colorPass.getData().value + 1; },
+                [&executed](FrameGraphPassResources const&, PassData const& data, DriverApi&) {
+                    EXPECT_EQ(3, data.value);
+                    executed.push_back("Final");
+                });
+
+        fg.addPass<PassData>("Culled",
+                [&](FrameGraph::Builder& builder, PassData& data) {
+                    data.input = builder.read(colorPass.getData().output);
+                    createOutput(builder, data, "unused buffer");
+                },
+                [&culledPrepared](PassData& data) { culledPrepared = true; },
+                [&executed](FrameGraphPassResources const&, PassData const& data, DriverApi&) {
+                    executed.push_back("Culled");
+                });
+
+        fg.present(finalPass.getData().output);
+        fg.present(unrelatedPass.getData().output);
+        fg.compile();
+        fg.execute(js, driverApi);
+
+        // driver work is still done in order, on this thread
+        const std::vector<std::string> expected = {
+                "Shadow", "Unrelated", "Color", "PostProcess", "Final" };
+        EXPECT_EQ(expected, executed);
+        EXPECT_FALSE(culledPrepared);
+        resourceAllocator.gc();
+    }
+
+    js.emancipate();
+}
@@ -14,8 +14,17 @@
  * limitations under the License.
  */
 
+#include <cstdio>
 #include <iostream>
 #include <random>
+#include <string>
+
+#if defined(WIN32)
+#   include <process.h>
+#   define getpid _getpid
+#else
+#   include <unistd.h>
+#endif
 
 #include <gtest/gtest.h>
 
@@ -26,20 +35,39 @@
 #include <filament/Camera.h>
 #include <filament/Color.h>
 #include <filament/Frustum.h>
+#include <filament/IndexBuffer.h>
 #include <filament/Material.h>
 #include <filament/Engine.h>
+#include <filament/RenderableManager.h>
+#include <filament/Renderer.h>
+#include <filament/Scene.h>
+#include <filament/VertexBuffer.h>
+#include <filament/View.h>
+#include <filament/driver/BlobCache.h>
 
 #include <private/filament/UniformInterfaceBlock.h>
 #include <private/filament/UibGenerator.h>
 
+#include <utils/EntityManager.h>
+#include <utils/Panic.h>
+#include <utils/Path.h>
+
+#if defined(FILAMENT_TEST_HAS_FILAMAT)
+#include <filamat/MaterialBuilder.h>
+#endif
+
 #include "details/Allocators.h"
 #include "details/Material.h"
 #include "details/Camera.h"
+#include "details/Culler.h"
+#include "details/DynamicResolutionController.h"
 #include "details/Froxelizer.h"
 #include "details/Engine.h"
+#include "details/ShadowMap.h"
 #include "components/RenderableManager.h"
 #include "components/TransformManager.h"
 #include "UniformBuffer.h"
+#include "driver/Program.h"
 
 using namespace filament;
 using namespace filament::math;
@@ -410,6 +438,74 @@ TEST(FilamentTest, SphereCulling) {
     EXPECT_TRUE(frustum.intersects({ 0, 200 }));
 }
 
+TEST(FilamentTest, ShadowCasterCulling) {
+    using filament::details::Culler;
+    using filament::details::ShadowMap;
+
+    // the sun, straight down
+    const float3 dir = { 0, -1, 0 };
+
+    // visible receivers: a thin diagonal strip on the ground
+    const float3 receivers[8] = {
+            { -50, 0, -49 }, { -49, 0, -50 }, { 50, 0, 49 }, { 49, 0, 50 },
+            { -50, 1, -49 }, { -49, 1, -50 }, { 50, 1, 49 }, { 49, 1, 50 },
+    };
+
+    // shadow casters: a grid of unit boxes above the ground, and the same below it
+    std::vector<float3> centers;
+    std::vector<float3> extents;
+    for (int y : { 5, -10 }) {
+        for (int z = -50; z <= 50; z += 2) {
+            for (int x = -50; x <= 50; x += 2) {
+                centers.push_back(float3(x, y, z));
+                extents.push_back(float3(0.5f));
+            }
+        }
+    }
+    const size_t count = centers.size();
+    centers.resize(Culler::round(count));
+    extents.resize(Culler::round(count));
+
+    // the light frustum: bounds of the receivers in light space, unbounded towards the light
+    const mat4f Mv = filament::details::FCamera::rigidTransformInverse(
+            mat4f::lookAt(float3{ 0, 0, 0 }, dir, float3{ 0, 1, 0 }));
+    Aabb lsBounds;
+    for (float3 v : receivers) {
+        v = mat4f::project(Mv, v);
+        lsBounds.min = min(lsBounds.min, v);
+        lsBounds.max = max(lsBounds.max, v);
+    }
+    const Frustum frustum(mat4f::ortho(lsBounds.min.x, lsBounds.max.x, lsBounds.min.y,
+            lsBounds.max.y, -1000, -lsBounds.min.z) * Mv);
+
+    std::vector<Culler::result_type> results(centers.size(), 0);
+    Culler::Test::intersects(results.data(), frustum, centers.data(), extents.data(), count);
+    const size_t frustumCasterCount = std::count(results.begin(), results.begin() + count, 1);
+
+    std::array<float4, 8 + 1> planes;
+    const size_t planeCount = ShadowMap::computeCasterCullingPlanes(
+            planes.data(), dir, receivers, 8);
+    EXPECT_EQ(5, planeCount); // four sides + far
+
+    Culler::Test::intersectsConvexVolume(results.data(), planes.data(), planeCount,
+            centers.data(), extents.data(), count);
+    const size_t volumeCasterCount = std::count(results.begin(), results.begin() + count, 1);
+
+    // casters above the strip must be kept, everything else must go
+    for (size_t i = 0; i < count; i++) {
+        if (centers[i].y > 0 && centers[i].x == centers[i].z && std::abs(centers[i].x) < 48) {
+            EXPECT_EQ(1, results[i]);
+        }
+        if (centers[i].y < 0 || std::abs(centers[i].x - centers[i].z) > 2) {
+            EXPECT_EQ(0, results[i]);
+        }
+    }
+
+    // the light frustum keeps all the casters above the ground
+    EXPECT_EQ(count / 2, frustumCasterCount);
+    EXPECT_LT(volumeCasterCount * 10, frustumCasterCount);
+}
+
 TEST(FilamentTest, ColorConversion) {
     // Linear to Gamma
     // 0.0 stays 0.0
@@ -694,6 +790,285 @@ TEST(FilamentTest, Bones) {
     }
 }
 
+TEST(FilamentTest, DynamicResolutionController) {
+    using namespace filament::details;
+    using Controller = DynamicResolutionController;
+    View::DynamicResolutionOptions options;
+    options.enabled = true;
+    options.targetFrameTimeMilli = 1000.0f / 60.0f;
+    options.headRoomRatio = 0.0f;
+    options.minScale = 0.25f;
+    options.maxScale = 1.0f;
+
+    // the GPU time is proportional to the rendered area
+    auto run = [&options](Controller& controller, size_t frames,
+            float cpu, float driver, float gpuAtFullScale) -> float {
+        float scale = 1.0f;
+        for (size_t i = 0; i < frames; i++) {
+            scale = controller.update(options, { cpu, driver, gpuAtFullScale * scale }, scale);
+        }
+        return scale;
+    };
+
+    // GPU bound: the area is reduced until the GPU fits in the target
+    Controller controller;
+    float scale = run(controller, 200, 5.0f, 4.0f, 30.0f);
+    EXPECT_EQ(Controller::Bottleneck::GPU, controller.getState().bottleneck);
+    EXPECT_NEAR(options.targetFrameTimeMilli / 30.0f, scale, 0.01f);
+
+    // the CPU becomes the bottleneck: the GPU can take as long as the CPU, so we scale back up
+    scale = run(controller, 200, 40.0f, 4.0f, 30.0f);
+    EXPECT_EQ(Controller::Bottleneck::CPU, controller.getState().bottleneck);
+    EXPECT_FLOAT_EQ(1.0f, scale);
+
+    // CPU bound from the start: lowering the resolution would be pointless
+    controller.reset();
+    for (size_t i = 0; i < 200; i++) {
+        scale = controller.update(options, { 30.0f, 10.0f, 20.0f }, 1.0f);
+        EXPECT_FLOAT_EQ(1.0f, scale);
+    }
+    EXPECT_EQ(Controller::Bottleneck::CPU, controller.getState().bottleneck);
+
+    // same thing when the driver thread is the bottleneck
+    controller.reset();
+    scale = run(controller, 200, 5.0f, 35.0f, 20.0f);
+    EXPECT_EQ(Controller::Bottleneck::DRIVER, controller.getState().bottleneck);
+    EXPECT_FLOAT_EQ(1.0f, scale);
+
+    // the scale never goes below the minimum
+    controller.reset();
+    scale = run(controller, 200, 5.0f, 4.0f, 300.0f);
+    EXPECT_FLOAT_EQ(options.minScale.x * options.minScale.y, scale);
+}
+
+// A fake backend, it "compiles" programs by concatenating their shaders and stores the result in
+// a BlobCache the same way the real backends store their program binaries.
+class FakeBackend {
+public:
+    FakeBackend(driver::BlobCache& cache, uint64_t driverHash) noexcept
+            : mCache(cache), mDriverHash(driverHash) {
+    }
+
+    std::string createProgram(Program const& program) {
+        const uint64_t key[2] = { program.getContentHash(), mDriverHash };
+        std::string binary(mCache.retrieve(key, sizeof(key), nullptr, 0), '\0');
+        if (!binary.empty() && mCache.retrieve(key, sizeof(key), &binary[0], binary.size())) {
+            return binary;
+        }
+        mCompilationCount++;
+        auto const& sources = program.getShadersSource();
+        binary = std::string(sources[0].c_str()) + "|" + sources[1].c_str();
+        mCache.insert(key, sizeof(key), binary.data(), binary.size());
+        return binary;
+    }
+
+    size_t getCompilationCount() const noexcept { return mCompilationCount; }
+
+private:
+    driver::BlobCache& mCache;
+    const uint64_t mDriverHash;
+    size_t mCompilationCount = 0;
+};
+
+TEST(FilamentTest, ProgramBinaryCache) {
+    Program lit;
+    lit.withVertexShader(CString("void main() { lit(); }"));
+    lit.withFragmentShader(CString("void main() { shade(); }"));
+
+    Program unlit;
+    unlit.withVertexShader(CString("void main() { unlit(); }"));
+    unlit.withFragmentShader(CString("void main() { shade(); }"));
+
+    // the hash only depends on the shaders
+    Program copy(lit);
+    copy.diagnostics(CString("copy"), 3);
+    EXPECT_EQ(lit.getContentHash(), copy.getContentHash());
+    EXPECT_NE(lit.getContentHash(), unlit.getContentHash());
+
+    // moving text from one shader to the other yields a different program
+    Program moved;
+    moved.withVertexShader(CString("void main() { lit(); }void main() {"));
+    moved.withFragmentShader(CString(" shade(); }"));
+    EXPECT_NE(lit.getContentHash(), moved.getContentHash());
+
+    // use a directory unique to this process, and start from an empty cache
+    Path directory = Path::getCurrentDirectory().concat(
+            "test_filament_blob_cache_" + std::to_string(getpid()));
+    auto removeDirectory = [&directory]() {
+        for (Path& file : directory.listContents()) {
+            file.unlinkFile();
+        }
+        std::remove(directory.c_str());
+    };
+    removeDirectory();
+
+    // first run, everything is compiled
+    std::string litBinary;
+    {
+        driver::FileBlobCache cache(directory.c_str());
+        FakeBackend backend(cache, 1);
+        litBinary = backend.createProgram(lit);
+        backend.createProgram(unlit);
+        backend.createProgram(lit);
+        EXPECT_EQ(2u, backend.getCompilationCount());
+    }
+
+    // second run, nothing is compiled
+    {
+        driver::FileBlobCache cache(directory.c_str());
+        FakeBackend backend(cache, 1);
+        EXPECT_EQ(litBinary, backend.createProgram(lit));
+        backend.createProgram(unlit);
+        EXPECT_EQ(0u, backend.getCompilationCount());
+
+        // a different driver can't use these binaries
+        FakeBackend otherBackend(cache, 2);
+        otherBackend.createProgram(lit);
+        EXPECT_EQ(1u, otherBackend.getCompilationCount());
+
+        // the value is only copied if it fits
+        const uint64_t key[2] = { lit.getContentHash(), 1 };
+        char small[4] = { 'x', 'x', 'x', 'x' };
+        EXPECT_EQ(litBinary.size(), cache.retrieve(key, sizeof(key), small, sizeof(small)));
+        EXPECT_EQ('x', small[0]);
+
+        const uint64_t unknown[2] = { moved.getContentHash(), 1 };
+        EXPECT_EQ(0u, cache.retrieve(unknown, sizeof(unknown), nullptr, 0));
+    }
+
+    removeDirectory();
+}
+
+// Renders a frame with a triangle that uses the default material.
+static void drawTriangle(Engine* engine) {
+    static const float3 positions[] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+    static const uint16_t indices[] = { 0, 1, 2 };
+    VertexBuffer* vb = VertexBuffer::Builder()
+            .vertexCount(3)
+            .bufferCount(1)
+            .attribute(VertexAttribute::POSITION, 0, VertexBuffer::AttributeType::FLOAT3)
+            .build(*engine);
+    vb->setBufferAt(*engine, 0,
+            VertexBuffer::BufferDescriptor(positions, sizeof(positions), nullptr));
+    IndexBuffer* ib = IndexBuffer::Builder()
+            .indexCount(3)
+            .bufferType(IndexBuffer::IndexType::USHORT)
+            .build(*engine);
+    ib->setBuffer(*engine, IndexBuffer::BufferDescriptor(indices, sizeof(indices), nullptr));
+
+    Entity triangle = EntityManager::get().create();
+    RenderableManager::Builder(1)
+            .boundingBox({{ 0.5f, 0.5f, 0 }, { 0.5f, 0.5f, 0.5f }})
+            .material(0, engine->getDefaultMaterial()->getDefaultInstance())
+            .geometry(0, RenderableManager::PrimitiveType::TRIANGLES, vb, ib)
+            .culling(false)
+            .build(*engine, triangle);
+
+    Scene* scene = engine->createScene();
+    scene->addEntity(triangle);
+    Camera* camera = engine->createCamera();
+    View* view = engine->createView();
+    view->setScene(scene);
+    view->setCamera(camera);
+    view->setViewport({ 0, 0, 64, 64 });
+    SwapChain* swapChain = engine->createSwapChain(nullptr);
+    Renderer* renderer = engine->createRenderer();
+    EXPECT_TRUE(renderer->beginFrame(swapChain));
+    renderer->render(view);
+    renderer->endFrame();
+
+    engine->destroy(renderer);
+    engine->destroy(swapChain);
+    engine->destroy(view);
+    engine->destroy(camera);
+    engine->destroy(scene);
+    engine->destroy(triangle);
+    engine->destroy(ib);
+    engine->destroy(vb);
+    EntityManager::get().destroy(triangle);
+}
+
+TEST(FilamentTest, UsedVariants) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    Material const* material = engine->getDefaultMaterial();
+    EXPECT_EQ(0u, material->getUsedVariants());
+
+    drawTriangle(engine);
+    const uint32_t usedVariants = material->getUsedVariants();
+    EXPECT_NE(0u, usedVariants);
+
+    // drawing again with the same variants doesn't change the mask
+    drawTriangle(engine);
+    EXPECT_EQ(usedVariants, material->getUsedVariants());
+
+    Engine::destroy(&engine);
+}
+
+TEST(FilamentTest, VariantUsageReport) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    EXPECT_EQ(0u, engine->getVariantUsageReport(nullptr, 0));
+
+    drawTriangle(engine);
+    char mask[16];
+    snprintf(mask, sizeof(mask), "%08x ", engine->getDefaultMaterial()->getUsedVariants());
+    const std::string expected = std::string(mask) + "Filament Default Material\n";
+
+    // the length is returned even without a buffer
+    EXPECT_EQ(expected.size(), engine->getVariantUsageReport(nullptr, 0));
+
+    std::string report(expected.size() + 1, 'x');
+    EXPECT_EQ(expected.size(), engine->getVariantUsageReport(&report[0], report.size()));
+    EXPECT_EQ(expected, report.c_str());
+
+    // nothing is written when the report and its terminator don't fit
+    std::string small(expected.size(), 'x');
+    EXPECT_EQ(expected.size(), engine->getVariantUsageReport(&small[0], small.size()));
+    EXPECT_EQ(std::string(expected.size(), 'x'), small);
+
+    Engine::destroy(&engine);
+}
+
+#if defined(FILAMENT_TEST_HAS_FILAMAT)
+TEST(FilamentTest, MaterialConstants) {
+    using namespace filamat;
+    MaterialBuilder::init();
+    MaterialBuilder builder;
+    builder.name("Constants")
+            .shading(MaterialBuilder::Shading::UNLIT)
+            .material(R"(
+                void material(inout MaterialInputs material) {
+                    prepareMaterial(material);
+                    material.baseColor = useTint ? vec4(0.8, 0.4, 0.4, 1.0) : vec4(0.8);
+                }
+            )")
+            .targetApi(MaterialBuilder::TargetApi::OPENGL)
+            .platform(MaterialBuilder::Platform::DESKTOP)
+            .constant(MaterialBuilder::ConstantType::BOOL, "useTint", false);
+    Package package = builder.build();
+    ASSERT_TRUE(package.isValid());
+
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    auto makeBuilder = [&package]() {
+        Material::Builder builder;
+        builder.package(package.getData(), package.getSize());
+        return builder;
+    };
+
+    Material* material = makeBuilder().constant("useTint", true).build(*engine);
+    EXPECT_NE(nullptr, material);
+    engine->destroy(material);
+
+    // the type and the name must match the declaration of the constant
+    EXPECT_THROW(makeBuilder().constant("useTint", int32_t(1)).build(*engine),
+            utils::PreconditionPanic);
+    EXPECT_THROW(makeBuilder().constant("mode", int32_t(1)).build(*engine),
+            utils::PreconditionPanic);
+
+    Engine::destroy(&engine);
+    MaterialBuilder::shutdown();
+}
+#endif
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
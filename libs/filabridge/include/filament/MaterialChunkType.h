@@ -53,6 +53,7 @@ enum UTILS_PUBLIC ChunkType : uint64_t {
     Unknown  = charTo64bitNum("UNKNOWN "),
     MaterialUib = charTo64bitNum("MAT_UIB "),
     MaterialSib = charTo64bitNum("MAT_SIB "),
+    MaterialConstants = charTo64bitNum("MAT_CONS"),
     MaterialGlsl = charTo64bitNum("MAT_GLSL"),
     MaterialSpirv = charTo64bitNum("MAT_SPIR"),
     MaterialMetal = charTo64bitNum("MAT_METL"),
@@ -89,7 +90,15 @@ enum UTILS_PUBLIC ChunkType : uint64_t {
 
     DictionaryGlsl = charTo64bitNum("DIC_GLSL"),
     DictionarySpirv = charTo64bitNum("DIC_SPIR"),
-    DictionaryMetal = charTo64bitNum("DIC_METL")
+    DictionaryMetal = charTo64bitNum("DIC_METL"),
+
+    // Wraps another chunk: its type (uint64), the codec (uint8, see ChunkCompression), its
+    // uncompressed size (uint32) and the compressed data.
+    Compressed = charTo64bitNum("CMP_CHNK")
+};
+
+enum class ChunkCompression : uint8_t {
+    LZ4 = 1     // LZ4 block format
 };
 
 } // namespace filamat
@@ -171,6 +171,12 @@ enum class Precision : uint8_t {
     DEFAULT
 };
 
+//! Type of a specialization constant, values are stored as int32_t, bools are 0 or 1
+enum class ConstantType : uint8_t {
+    INT,
+    BOOL
+};
+
 //! Texture sampler type
 enum class SamplerType : uint8_t {
     SAMPLER_2D,         //!< 2D or 2D array texture
@@ -22,7 +22,7 @@
 
 namespace filament {
 
-static constexpr size_t MATERIAL_VERSION = 2;
+static constexpr size_t MATERIAL_VERSION = 3;
 
 static constexpr size_t VERTEX_DOMAIN_COUNT = 4;
 
@@ -53,6 +53,7 @@ static_assert(BindingPoints::PER_MATERIAL_INSTANCE == BindingPoints::COUNT - 1,
 constexpr uint32_t ATTRIBUTE_INDEX_COUNT = 7;
 constexpr size_t MAX_ATTRIBUTE_BUFFERS_COUNT = 8; // FIXME: should match Driver::MAX_ATTRIBUTE_BUFFER_COUNT
 constexpr size_t MAX_SAMPLER_COUNT = 16; // Matches the Adreno Vulkan driver.
+constexpr size_t MAX_SPECIALIZATION_CONSTANTS = 16;  // per material
 
 // This value is limited by UBO size, ES3.0 only guarantees 16 KiB.
 // Values <= 256, use less CPU and GPU resources.
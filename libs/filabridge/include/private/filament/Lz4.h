@@ -0,0 +1,78 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMENT_LZ4_H
+#define TNT_FILAMENT_LZ4_H
+
+#include <memory>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace filament {
+namespace lz4 {
+
+// Codec for the LZ4 block format, used by the compressed chunks of material packages.
+// Decompression is a single pass over the data with no allocation, so it adds very little to the
+// time it takes to load a package.
+
+// Size of the largest possible output of compress() for the given input size.
+size_t compressBound(size_t size) noexcept;
+
+// Size of the largest possible output of decompress() for the given compressed size. A byte of
+// compressed data expands to at most 255 bytes, this is used to validate untrusted sizes.
+size_t decompressBound(size_t size) noexcept;
+
+// Compresses src into dst, returns the compressed size or 0 if it doesn't fit in dstCapacity.
+size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) noexcept;
+
+// Decompresses src into dst, dstSize must be the exact size of the decompressed data.
+// Returns false if the data is corrupted.
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) noexcept;
+
+// Same as above, but the data can reference a dictionary: typically a similar piece of data that
+// the decoder already has. The same dictionary must be used to compress and decompress.
+size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity,
+        const uint8_t* dict, size_t dictSize) noexcept;
+
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize,
+        const uint8_t* dict, size_t dictSize) noexcept;
+
+// The compress() functions above allocate and clear their state for each call. A Compressor
+// keeps it between calls instead, which is much faster when compressing many small blocks, e.g.
+// when trying several dictionaries for the same data. The dictionary isn't copied.
+class Compressor {
+public:
+    Compressor();
+    ~Compressor();
+
+    Compressor(Compressor const&) = delete;
+    Compressor& operator=(Compressor const&) = delete;
+
+    size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity,
+            const uint8_t* dict = nullptr, size_t dictSize = 0) noexcept;
+
+private:
+    // Position of the last occurrence of each hashed sequence. Positions only grow from one
+    // call to the next, so the entries older than mBase can be told apart without clearing.
+    std::unique_ptr<uint32_t[]> mTable;
+    uint32_t mBase = 1;
+};
+
+} // namespace lz4
+} // namespace filament
+
+#endif // TNT_FILAMENT_LZ4_H
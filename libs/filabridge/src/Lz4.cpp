@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "private/filament/Lz4.h"
+
+#include <algorithm>
+#include <memory>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace filament {
+namespace lz4 {
+
+// A block is a list of sequences, each made of a token, literals and a match:
+//  - the token's high nibble is the number of literals, the low nibble the match length - 4,
+//    15 means the length continues in the next bytes (each 255 adds up and continues),
+//  - the match is a 2-bytes little-endian offset back into the output, followed by the
+//    remaining match length bytes, if any.
+// The last sequence only has literals, the last 5 bytes are always literals and the last match
+// starts at least 12 bytes before the end of the block.
+
+static constexpr size_t MIN_MATCH = 4;
+static constexpr size_t LAST_LITERALS = 5;
+static constexpr size_t MF_LIMIT = 12;
+static constexpr size_t MAX_OFFSET = 65535;
+static constexpr size_t HASH_LOG = 16;
+
+static inline uint32_t read32(const uint8_t* p) noexcept {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline uint32_t hash(uint32_t sequence) noexcept {
+    return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+static inline uint8_t* writeLength(uint8_t* op, size_t length) noexcept {
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = uint8_t(length);
+    return op;
+}
+
+static inline bool readLength(const uint8_t*& ip, const uint8_t* iend, size_t& length) noexcept {
+    uint8_t b;
+    do {
+        if (ip >= iend) {
+            return false;
+        }
+        b = *ip++;
+        length += b;
+    } while (b == 255);
+    return true;
+}
+
+size_t compressBound(size_t size) noexcept {
+    return size + size / 255 + 16;
+}
+
+size_t decompressBound(size_t size) noexcept {
+    // the longest expansion is a match length byte, which adds 255 bytes to the output
+    return size > SIZE_MAX / 255 ? SIZE_MAX : size * 255;
+}
+
+// Compresses src, whose matches can also reference the dictionary, which logically precedes src.
+// The positions in the table start at base for the dictionary, which is followed by src. Entries
+// below base are left over from previous calls and are ignored.
+static size_t compressBlock(uint32_t* table, uint32_t base,
+        const uint8_t* dict, size_t dictSize, const uint8_t* src, size_t srcSize,
+        uint8_t* dst, size_t dstCapacity) noexcept {
+    const uint8_t* const end = src + srcSize;
+    const uint8_t* anchor = src;
+    uint8_t* op = dst;
+    uint8_t* const oend = dst + dstCapacity;
+
+    if (srcSize > MF_LIMIT) {
+        for (size_t i = 0; i + MIN_MATCH <= dictSize; i++) {
+            table[hash(read32(dict + i))] = base + uint32_t(i);
+        }
+        const uint32_t srcBase = base + uint32_t(dictSize);
+        const uint8_t* const matchLimit = end - LAST_LITERALS;
+        const uint8_t* const mfLimit = end - MF_LIMIT;
+        const uint8_t* ip = dictSize ? src : src + 1;
+        while (ip < mfLimit) {
+            const uint32_t sequence = read32(ip);
+            const uint32_t position = srcBase + uint32_t(ip - src);
+            uint32_t& entry = table[hash(sequence)];
+            const uint32_t refPosition = entry;
+            entry = position;
+            if (refPosition < base || position - refPosition > MAX_OFFSET) {
+                ip++;
+                continue;
+            }
+
+            // a match is either in the dictionary or in src, it doesn't span both
+            const bool inDict = refPosition < srcBase;
+            const uint8_t* const refStart = inDict ? dict : src;
+            const uint8_t* const refLimit = inDict ? dict + dictSize : end;
+            const uint8_t* ref = refStart + (refPosition - (inDict ? base : srcBase));
+            if (read32(ref) != sequence) {
+                ip++;
+                continue;
+            }
+
+            // extend the match forward and backward
+            const uint8_t* matchEnd = ip + MIN_MATCH;
+            const uint8_t* refEnd = ref + MIN_MATCH;
+            while (matchEnd < matchLimit && refEnd < refLimit && *matchEnd == *refEnd) {
+                matchEnd++;
+                refEnd++;
+            }
+            while (ip > anchor && ref > refStart && ip[-1] == ref[-1]) {
+                ip--;
+                ref--;
+            }
+
+            const size_t literals = size_t(ip - anchor);
+            const size_t matchLength = size_t(matchEnd - ip) - MIN_MATCH;
+            if (size_t(oend - op) < 1 + literals + literals / 255 + 1 + 2 + matchLength / 255 + 1) {
+                return 0;
+            }
+
+            uint8_t* const token = op++;
+            *token = uint8_t((literals < 15 ? literals : 15) << 4);
+            if (literals >= 15) {
+                op = writeLength(op, literals - 15);
+            }
+            memcpy(op, anchor, literals);
+            op += literals;
+
+            // extending the match backward didn't change its offset
+            const size_t offset = position - refPosition;
+            *op++ = uint8_t(offset);
+            *op++ = uint8_t(offset >> 8);
+
+            *token |= uint8_t(matchLength < 15 ? matchLength : 15);
+            if (matchLength >= 15) {
+                op = writeLength(op, matchLength - 15);
+            }
+
+            ip = matchEnd;
+            anchor = ip;
+        }
+    }
+
+    // the remaining bytes are stored as literals
+    const size_t literals = size_t(end - anchor);
+    if (size_t(oend - op) < 1 + literals + literals / 255 + 1) {
+        return 0;
+    }
+    *op++ = uint8_t((literals < 15 ? literals : 15) << 4);
+    if (literals >= 15) {
+        op = writeLength(op, literals - 15);
+    }
+    memcpy(op, anchor, literals);
+    op += literals;
+
+    return size_t(op - dst);
+}
+
+Compressor::Compressor() : mTable(new uint32_t[1u << HASH_LOG]()) {
+}
+
+Compressor::~Compressor() = default;
+
+size_t Compressor::compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity,
+        const uint8_t* dict, size_t dictSize) noexcept {
+    // matches can't reach further back than MAX_OFFSET, so only the end of the dictionary is used
+    if (dictSize > MAX_OFFSET) {
+        dict += dictSize - MAX_OFFSET;
+        dictSize = MAX_OFFSET;
+    }
+    if (uint64_t(mBase) + dictSize + srcSize >= UINT32_MAX) {
+        // the positions would wrap around, start over
+        std::fill_n(mTable.get(), 1u << HASH_LOG, 0u);
+        mBase = 1;
+    }
+    const size_t size = compressBlock(mTable.get(), mBase,
+            dict, dictSize, src, srcSize, dst, dstCapacity);
+    mBase += uint32_t(dictSize + srcSize);
+    return size;
+}
+
+size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity) noexcept {
+    return Compressor().compress(src, srcSize, dst, dstCapacity);
+}
+
+size_t compress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstCapacity,
+        const uint8_t* dict, size_t dictSize) noexcept {
+    return Compressor().compress(src, srcSize, dst, dstCapacity, dict, dictSize);
+}
+
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize) noexcept {
+    return decompress(src, srcSize, dst, dstSize, nullptr, 0);
+}
+
+bool decompress(const uint8_t* src, size_t srcSize, uint8_t* dst, size_t dstSize,
+        const uint8_t* dict, size_t dictSize) noexcept {
+    const uint8_t* ip = src;
+    const uint8_t* const iend = src + srcSize;
+    uint8_t* op = dst;
+    uint8_t* const oend = dst + dstSize;
+
+    while (ip < iend) {
+        const uint8_t token = *ip++;
+
+        size_t literals = token >> 4u;
+        if (literals == 15 && !readLength(ip, iend, literals)) {
+            return false;
+        }
+        if (literals > size_t(iend - ip) || literals > size_t(oend - op)) {
+            return false;
+        }
+        memcpy(op, ip, literals);
+        op += literals;
+        ip += literals;
+
+        if (ip == iend) {
+            // the last sequence doesn't have a match
+            break;
+        }
+
+        if (iend - ip < 2) {
+            return false;
+        }
+        const size_t offset = size_t(ip[0]) | (size_t(ip[1]) << 8u);
+        ip += 2;
+        if (offset == 0 || offset > size_t(op - dst) + dictSize) {
+            return false;
+        }
+
+        size_t length = token & 0xFu;
+        if (length == 15 && !readLength(ip, iend, length)) {
+            return false;
+        }
+        length += MIN_MATCH;
+        if (length > size_t(oend - op)) {
+            return false;
+        }
+
+        if (offset > size_t(op - dst)) {
+            // the match starts in the dictionary and may continue in the output
+            const size_t inDict = offset - size_t(op - dst);
+            const size_t count = inDict < length ? inDict : length;
+            memcpy(op, dict + dictSize - inDict, count);
+            op += count;
+            length -= count;
+            if (length == 0) {
+                continue;
+            }
+        }
+
+        const uint8_t* match = op - offset;
+        if (offset >= length) {
+            memcpy(op, match, length);
+            op += length;
+        } else {
+            // the match overlaps the output, this repeats the last offset bytes
+            uint8_t* const e = op + length;
+            while (op != e) {
+                *op++ = *match++;
+            }
+        }
+    }
+
+    return op == oend;
+}
+
+} // namespace lz4
+} // namespace filament
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <filaflat/BlobDictionary.h>
+#include <filaflat/MaterialChunk.h>
+#include <filaflat/ShaderBuilder.h>
+#include <filaflat/TextDictionaryReader.h>
+#include <filaflat/Unflattener.h>
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+using namespace filaflat;
+
+// Builds the text dictionary and material chunks of a large synthetic material package, laid out
+// the way filamat writes them.
+class LargePackage : public benchmark::Fixture {
+public:
+    static constexpr uint32_t LINE_COUNT = 8192;
+    static constexpr uint32_t SHADER_COUNT = 256;        // e.g. 2 shader models x 128 variants
+    static constexpr uint32_t LINES_PER_SHADER = 1024;
+
+    void SetUp(const benchmark::State&) override {
+        if (!dictionary.empty()) {
+            return;
+        }
+
+        std::vector<uint32_t> lineSizes(LINE_COUNT);
+        write32(dictionary, LINE_COUNT);
+        for (uint32_t i = 0; i < LINE_COUNT; i++) {
+            std::string line = "    highp vec4 variable" + std::to_string(i) +
+                    " = texture(materialParams_sampler, vertex_uv01.xy);";
+            dictionary.insert(dictionary.end(), line.begin(), line.end());
+            dictionary.push_back(0);
+            lineSizes[i] = uint32_t(line.size());
+        }
+
+        // index: count, then (shader model, variant, stage, offset) per shader
+        const uint32_t indexSize = 8 + SHADER_COUNT * 7;
+        write64(material, SHADER_COUNT);
+        std::vector<uint8_t> shaders;
+        for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+            material.push_back(uint8_t(1 + i / 128));
+            material.push_back(uint8_t((i / 2) % 64));
+            material.push_back(uint8_t(i % 2));
+            write32(material, indexSize + uint32_t(shaders.size()));
+
+            uint32_t size = 0;
+            std::vector<uint16_t> lines(LINES_PER_SHADER);
+            for (uint32_t j = 0; j < LINES_PER_SHADER; j++) {
+                lines[j] = uint16_t((i * 31 + j * 17) % LINE_COUNT);
+                size += lineSizes[lines[j]] + 1;     // each line is followed by a newline
+            }
+            write32(shaders, size + 1);
+            write32(shaders, LINES_PER_SHADER);
+            for (uint16_t line : lines) {
+                shaders.push_back(uint8_t(line));
+                shaders.push_back(uint8_t(line >> 8));
+            }
+        }
+        material.insert(material.end(), shaders.begin(), shaders.end());
+    }
+
+    std::vector<uint8_t> dictionary;
+    std::vector<uint8_t> material;
+
+private:
+    static void write32(std::vector<uint8_t>& out, uint32_t v) {
+        for (size_t i = 0; i < 4; i++) {
+            out.push_back(uint8_t(v >> (i * 8)));
+        }
+    }
+    static void write64(std::vector<uint8_t>& out, uint64_t v) {
+        for (size_t i = 0; i < 8; i++) {
+            out.push_back(uint8_t(v >> (i * 8)));
+        }
+    }
+};
+
+BENCHMARK_F(LargePackage, TextDictionaryReader)(benchmark::State& state) {
+    for (auto _ : state) {
+        BlobDictionary blobDictionary;
+        Unflattener unflattener(dictionary.data(), dictionary.data() + dictionary.size());
+        TextDictionaryReader reader;
+        bool ok = reader.unflatten(unflattener, blobDictionary);
+        benchmark::DoNotOptimize(ok);
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * LINE_COUNT);
+    state.SetBytesProcessed(int64_t(state.iterations()) * int64_t(dictionary.size()));
+}
+
+BENCHMARK_F(LargePackage, GetAllTextShaders)(benchmark::State& state) {
+    BlobDictionary blobDictionary;
+    Unflattener dictionaryUnflattener(dictionary.data(), dictionary.data() + dictionary.size());
+    TextDictionaryReader().unflatten(dictionaryUnflattener, blobDictionary);
+
+    ShaderBuilder builder;
+    for (auto _ : state) {
+        MaterialChunk chunk;
+        Unflattener unflattener(material.data(), material.data() + material.size());
+        for (uint32_t i = 0; i < SHADER_COUNT; i++) {
+            chunk.getTextShader(unflattener, blobDictionary, builder,
+                    uint8_t(1 + i / 128), uint8_t((i / 2) % 64), uint8_t(i % 2));
+            benchmark::DoNotOptimize(builder.c_str());
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * SHADER_COUNT);
+}
@@ -17,7 +17,6 @@
 #ifndef TNT_FILAFLAT_BLOBDICTIONARY_H
 #define TNT_FILAFLAT_BLOBDICTIONARY_H
 
-#include <cstdint>
 #include <vector>
 
 #include <stddef.h>
@@ -25,41 +24,45 @@
 namespace filaflat {
 
 // Flat list of blobs that can be referenced by index.
+//
+// Blobs are not copied, they point directly inside the material package, which must outlive the
+// dictionary.
 class BlobDictionary {
 public:
     BlobDictionary() = default;
     ~BlobDictionary() = default;
 
-    using Blob = std::vector<uint8_t>;
-
+    // References the blob, which must stay valid for the lifetime of the dictionary.
     inline void addBlob(const char* blob, size_t len) noexcept {
-        mBlobs.emplace_back(blob, blob + len);
-    }
-
-    inline void addBlob(Blob&& blob) noexcept {
-        mBlobs.emplace_back(std::move(blob));
+        mBlobs.push_back({ blob, len });
     }
 
     inline bool isEmpty() const noexcept {
         return mBlobs.empty();
     }
 
+    inline size_t getBlobCount() const noexcept {
+        return mBlobs.size();
+    }
+
     inline void reserve(size_t size) {
         mBlobs.reserve(size);
     }
 
     inline const char* getBlob(size_t index, size_t* size) const noexcept {
-        *size = mBlobs[index].size();
-        return (const char*) mBlobs[index].data();
+        *size = mBlobs[index].size;
+        return mBlobs[index].data;
     }
 
     inline const char* getString(size_t index) const noexcept {
-        size_t size;
-        return getBlob(index, &size);
+        return mBlobs[index].data;
     }
 
-
 private:
+    struct Blob {
+        const char* data;
+        size_t size;
+    };
     std::vector<Blob> mBlobs;
 };
 
@@ -22,11 +22,16 @@
 
 #include <tsl/robin_map.h>
 
+#include <memory>
+#include <vector>
+
 namespace filaflat {
 
 class Unflattener;
 
 // Allows to build a map of chunks in a Package and get direct individual access based on chunk ID.
+// Compressed chunks are decompressed by parse() and accessed like the others, the decompressed
+// data is owned by the container.
 class UTILS_PUBLIC ChunkContainer {
 public:
     using Type = uint64_t;      // this should come from some EIFF lib
@@ -35,6 +40,9 @@ public:
 
     ~ChunkContainer() = default;
 
+    ChunkContainer(ChunkContainer const&) = delete;
+    ChunkContainer& operator=(ChunkContainer const&) = delete;
+
     // Must be called before trying to access any of the chunk. Fails and return false ONLY if
     // an incomplete chunk is found or if a chunk with bogus size is found.
     bool parse() noexcept;
@@ -42,6 +50,7 @@ public:
     typedef struct {
         const uint8_t* start;
         size_t size;
+        size_t compressedSize;  // size in the package if the chunk is compressed, 0 otherwise
     } ChunkDesc;
 
     typedef struct {
@@ -77,10 +86,12 @@ public:
 
 private:
     bool parseChunk(Unflattener& unflattener);
+    bool decompressChunk(const uint8_t* start, size_t size);
 
     void const* mData;
     size_t mSize;
     tsl::robin_map<Type, ChunkContainer::ChunkDesc> mChunks;
+    std::vector<std::unique_ptr<uint8_t[]>> mDecompressedChunks;
 };
 
 } // namespace filaflat
@@ -29,13 +29,20 @@ namespace filaflat {
 class MaterialChunk {
 public:
 
+    // Reads the shader index if needed, the getters below do it automatically. Once the index
+    // is read, shaders can be retrieved from several threads at once.
+    bool initialize(Unflattener unflattener);
+
+    // Returns whether the package has this shader, the index must have been read.
+    bool hasShader(uint8_t shaderModel, uint8_t variant, uint8_t stage) const noexcept;
+
     bool getTextShader(
-            Unflattener unflattener, BlobDictionary& dictionary, ShaderBuilder& shaderBuilder,
-            uint8_t shaderModel, uint8_t variant, uint8_t stage);
+            Unflattener unflattener, BlobDictionary const& dictionary,
+            ShaderBuilder& shaderBuilder, uint8_t shaderModel, uint8_t variant, uint8_t stage);
 
     bool getSpirvShader(
-            Unflattener unflattener, BlobDictionary& dictionary, ShaderBuilder& shaderBuilder,
-            uint8_t shaderModel, uint8_t variant, uint8_t stage);
+            Unflattener unflattener, BlobDictionary const& dictionary,
+            ShaderBuilder& shaderBuilder, uint8_t shaderModel, uint8_t variant, uint8_t stage);
 
 private:
     bool readIndex(Unflattener& unflattener);
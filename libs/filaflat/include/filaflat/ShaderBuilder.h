@@ -38,6 +38,9 @@ public:
     // Append a data blob to the shader. Returns true if successful.
     void appendPart(const char* data, size_t size) noexcept;
 
+    // Appends size characters to the shader and returns them, so they can be written in place.
+    char* appendPart(size_t size) noexcept;
+
     // returns a copy of the shader string
     utils::CString getShader() const { return { mShader, mCursor }; }
 
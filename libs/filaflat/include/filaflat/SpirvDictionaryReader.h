@@ -23,6 +23,7 @@
 
 namespace filaflat {
 
+// Reads the index of a SPIR-V dictionary, the blobs stay compressed with smol-v and LZ4.
 struct SpirvDictionaryReader {
     bool unflatten(Unflattener& unflattener, BlobDictionary& dictionary);
 
@@ -18,6 +18,10 @@
 
 #include <filaflat/Unflattener.h>
 
+#include <filament/MaterialChunkType.h>
+
+#include <private/filament/Lz4.h>
+
 namespace filaflat {
 
 bool ChunkContainer::parseChunk(Unflattener& unflattener) {
@@ -39,11 +43,47 @@ bool ChunkContainer::parseChunk(Unflattener& unflattener) {
         return false;
     }
 
-    mChunks[Type(type)] = { cursor, size };
+    if (type == filamat::ChunkType::Compressed) {
+        if (!decompressChunk(cursor, size)) {
+            return false;
+        }
+    } else {
+        mChunks[Type(type)] = { cursor, size, 0 };
+    }
     unflattener.setCursor(cursor + size);
     return true;
 }
 
+bool ChunkContainer::decompressChunk(const uint8_t* start, size_t size) {
+    Unflattener unflattener(start, start + size);
+    uint64_t type;
+    uint8_t compression;
+    uint32_t uncompressedSize;
+    if (!unflattener.read(&type) || !unflattener.read(&compression) ||
+        !unflattener.read(&uncompressedSize)) {
+        return false;
+    }
+    if (compression != uint8_t(filamat::ChunkCompression::LZ4)) {
+        return false;
+    }
+
+    // The uncompressed size comes from the package, don't allocate more than the compressed
+    // data could possibly expand to.
+    const uint8_t* data = unflattener.getCursor();
+    const size_t compressedSize = size_t(start + size - data);
+    if (uncompressedSize > filament::lz4::decompressBound(compressedSize)) {
+        return false;
+    }
+    std::unique_ptr<uint8_t[]> chunk(new uint8_t[uncompressedSize]);
+    if (!filament::lz4::decompress(data, compressedSize, chunk.get(), uncompressedSize)) {
+        return false;
+    }
+
+    mChunks[Type(type)] = { chunk.get(), uncompressedSize, size };
+    mDecompressedChunks.push_back(std::move(chunk));
+    return true;
+}
+
 bool ChunkContainer::parse() noexcept {
     Unflattener unflattener((uint8_t *)mData, (uint8_t *)mData + mSize);
     do {
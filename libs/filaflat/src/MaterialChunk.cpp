@@ -18,8 +18,33 @@
 
 #include <utils/Log.h>
 
+#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
+#include <private/filament/Lz4.h>
+#include <smolv.h>
+#endif
+
+#include <memory>
+
 namespace filaflat {
 
+#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
+// see DictionarySpirvChunk in filamat
+static constexpr uint32_t NO_REFERENCE = 0xFFFFFFFF;
+
+// Reads a little-endian uint32 and advances past it.
+static inline bool readUint32(const char*& data, size_t& size, uint32_t* value) noexcept {
+    if (size < 4) {
+        return false;
+    }
+    const uint8_t* bytes = (const uint8_t*) data;
+    *value = uint32_t(bytes[0]) | (uint32_t(bytes[1]) << 8u) |
+            (uint32_t(bytes[2]) << 16u) | (uint32_t(bytes[3]) << 24u);
+    data += 4;
+    size -= 4;
+    return true;
+}
+#endif
+
 static inline uint32_t makeKey(uint8_t shaderModel, uint8_t variant, uint8_t type) noexcept {
     return (shaderModel << 16) | (type << 8) | variant;
 }
@@ -62,14 +87,23 @@ bool MaterialChunk::readIndex(Unflattener& unflattener) {
     return true;
 }
 
-bool MaterialChunk::getTextShader(Unflattener unflattener, BlobDictionary& dictionary,
+bool MaterialChunk::initialize(Unflattener unflattener) {
+    if (mBase == nullptr) {
+        return readIndex(unflattener);
+    }
+    return true;
+}
+
+bool MaterialChunk::hasShader(uint8_t shaderModel, uint8_t variant, uint8_t stage) const noexcept {
+    return mOffsets.find(makeKey(shaderModel, variant, stage)) != mOffsets.end();
+}
+
+bool MaterialChunk::getTextShader(Unflattener unflattener, BlobDictionary const& dictionary,
         ShaderBuilder& shader, uint8_t shaderModel, uint8_t variant, uint8_t ps) {
 
     shader.reset();
-    if (mBase == nullptr ) {
-        if (!readIndex(unflattener)) {
-            return false;
-        }
+    if (!initialize(unflattener)) {
+        return false;
     }
 
     // Jump and read
@@ -107,8 +141,10 @@ bool MaterialChunk::getTextShader(Unflattener unflattener, BlobDictionary& dicti
         if (!unflattener.read(&lineIndex)) {
             return false;
         }
-        const char* string = dictionary.getString(lineIndex);
-        shader.appendPart(string, strlen(string));
+        // lines are stored with their null terminator, which is replaced by a newline
+        size_t lineSize;
+        const char* string = dictionary.getBlob(lineIndex, &lineSize);
+        shader.appendPart(string, lineSize - 1);
         shader.appendPart("\n", 1);
     }
 
@@ -119,12 +155,10 @@ bool MaterialChunk::getTextShader(Unflattener unflattener, BlobDictionary& dicti
 }
 
 
-bool MaterialChunk::getSpirvShader(Unflattener unflattener, BlobDictionary& dictionary,
+bool MaterialChunk::getSpirvShader(Unflattener unflattener, BlobDictionary const& dictionary,
         ShaderBuilder& builder, uint8_t shaderModel, uint8_t variant, uint8_t stage) {
-    if (mBase == nullptr ) {
-        if (!readIndex(unflattener)) {
-            return false;
-        }
+    if (!initialize(unflattener)) {
+        return false;
     }
     uint32_t key = makeKey(shaderModel, variant, stage);
     auto pos = mOffsets.find(key);
@@ -132,13 +166,52 @@ bool MaterialChunk::getSpirvShader(Unflattener unflattener, BlobDictionary& dict
         return false;
     }
 
-    size_t index = pos->second;
-    size_t shaderSize;
-    const char* shaderContent = dictionary.getBlob(index, &shaderSize);
+    // SPIR-V blobs are stored compressed in the dictionary, only decompress this one.
     builder.reset();
+#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
+    size_t blobSize;
+    const char* blob = dictionary.getBlob(pos->second, &blobSize);
+    uint32_t reference;
+    if (!readUint32(blob, blobSize, &reference)) {
+        return false;
+    }
+
+    // The blob is either a smol-v stream or an LZ4 delta against another blob, which is a
+    // smol-v stream itself.
+    const char* compressed = blob;
+    size_t compressedSize = blobSize;
+    std::unique_ptr<char[]> expanded;
+    if (reference != NO_REFERENCE) {
+        if (reference >= dictionary.getBlobCount()) {
+            return false;
+        }
+        uint32_t smolvSize;
+        size_t dictSize;
+        const char* dict = dictionary.getBlob(reference, &dictSize);
+        uint32_t dictReference;
+        if (!readUint32(blob, blobSize, &smolvSize) ||
+            !readUint32(dict, dictSize, &dictReference) || dictReference != NO_REFERENCE ||
+            smolvSize > filament::lz4::decompressBound(blobSize)) {
+            return false;
+        }
+        expanded.reset(new char[smolvSize]);
+        if (!filament::lz4::decompress((const uint8_t*) blob, blobSize,
+                (uint8_t*) expanded.get(), smolvSize, (const uint8_t*) dict, dictSize)) {
+            return false;
+        }
+        compressed = expanded.get();
+        compressedSize = smolvSize;
+    }
+
+    size_t shaderSize = smolv::GetDecodedBufferSize(compressed, compressedSize);
+    if (shaderSize == 0) {
+        return false;
+    }
     builder.announce(shaderSize);
-    builder.appendPart(shaderContent, shaderSize);
-    return true;
+    return smolv::Decode(compressed, compressedSize, builder.appendPart(shaderSize), shaderSize);
+#else
+    return false;
+#endif
 }
 
 }
@@ -16,13 +16,6 @@
 
 #include <filaflat/SpirvDictionaryReader.h>
 
-#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
-#include <utils/Log.h>
-#include <smolv.h>
-#endif
-
-#include <assert.h>
-
 namespace filaflat {
 
 bool SpirvDictionaryReader::unflatten(Unflattener& f, BlobDictionary& dictionary) {
@@ -31,14 +24,17 @@ bool SpirvDictionaryReader::unflatten(Unflattener& f, BlobDictionary& dictionary
         return false;
     }
 
-    // For now, 1 is the only acceptable compression scheme.
-    assert(compressionScheme == 1);
+    // Scheme 2 is the only acceptable compression scheme, see MaterialChunk::getSpirvShader().
+    if (compressionScheme != 2) {
+        return false;
+    }
 
     uint32_t numBlobs;
     if (!f.read(&numBlobs)) {
         return false;
     }
 
+    // The blobs are only indexed here, MaterialChunk decompresses the few that are used.
     dictionary.reserve(numBlobs);
     for (uint32_t i = 0; i < numBlobs; i++) {
         const char* compressed;
@@ -46,21 +42,7 @@ bool SpirvDictionaryReader::unflatten(Unflattener& f, BlobDictionary& dictionary
         if (!f.read(&compressed, &compressedSize)) {
             return false;
         }
-
-#if defined (FILAMENT_DRIVER_SUPPORTS_VULKAN)
-        size_t spirvSize = smolv::GetDecodedBufferSize(compressed, compressedSize);
-        if (spirvSize == 0) {
-            return false;
-        }
-        BlobDictionary::Blob spirv(spirvSize);
-        if (!smolv::Decode(compressed, compressedSize, spirv.data(), spirvSize)) {
-            return false;
-        }
-        dictionary.addBlob(std::move(spirv));
-#else
-        return false;
-#endif
-
+        dictionary.addBlob(compressed, compressedSize);
     }
     return true;
 }
@@ -33,8 +33,9 @@ bool TextDictionaryReader::unflatten(Unflattener& f, BlobDictionary& dictionary)
             return false;
         }
         // BlobDictionary hold binary chunks and does not care if the data holds text, it is
-        // therefore crucial to include the trailing null.
-        dictionary.addBlob(str, strlen(str) + 1);
+        // therefore crucial to include the trailing null. The line is referenced in place, the
+        // cursor is right after its null terminator.
+        dictionary.addBlob(str, size_t((const char*)f.getCursor() - str));
     }
     return true;
 }
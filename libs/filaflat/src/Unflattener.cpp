@@ -16,13 +16,22 @@
 
 #include <filaflat/Unflattener.h>
 
+#include <string.h>
+
 namespace filaflat {
 
+// returns a pointer to the first null character at or after cursor, or end if there isn't any
+static inline const uint8_t* findNull(const uint8_t* cursor, const uint8_t* end) noexcept {
+    if (cursor >= end) {
+        return end;
+    }
+    const void* p = memchr(cursor, '\0', size_t(end - cursor));
+    return p ? static_cast<const uint8_t*>(p) : end;
+}
+
 bool Unflattener::read(utils::CString* s) noexcept {
     const uint8_t* start = mCursor;
-    while (mCursor < mEnd && *mCursor != '\0') {
-        mCursor++;
-    }
+    mCursor = findNull(mCursor, mEnd);
     bool overflowed = mCursor >= mEnd;
     if (!overflowed) {
         *s = utils::CString{ (const char*)start, (utils::CString::size_type)(mCursor - start) };
@@ -48,9 +57,7 @@ bool Unflattener::read(const char** blob, size_t* size) noexcept {
 
 bool Unflattener::read(const char** s) noexcept {
     const uint8_t* start = mCursor;
-    while (mCursor < mEnd && *mCursor != '\0') {
-        mCursor++;
-    }
+    mCursor = findNull(mCursor, mEnd);
     bool overflowed = mCursor >= mEnd;
     if (!overflowed) {
         mCursor++;
@@ -34,9 +34,14 @@
 #include <utils/compiler.h>
 #include <utils/CString.h>
 
+namespace utils {
+class JobSystem;
+}
+
 namespace filamat {
 
 struct MaterialInfo;
+class ShaderCache;
 
 class UTILS_PUBLIC MaterialBuilderBase {
 public:
@@ -139,6 +144,7 @@ public:
     using SamplerFormat = filament::driver::SamplerFormat;
     using SamplerPrecision = filament::driver::Precision;
     using CullingMode = filament::driver::CullingMode;
+    using ConstantType = filament::driver::ConstantType;
 
     // set name of this material
     MaterialBuilder& name(const char* name) noexcept;
@@ -165,6 +171,12 @@ public:
             const char* name) noexcept;
     MaterialBuilder& parameter(SamplerType samplerType, const char* name) noexcept;
 
+    // add a specialization constant to this material, the material code uses it like a const
+    // variable. Its value can be changed when the material is loaded (see
+    // Material::Builder::constant()) without generating new shaders: the driver specializes them
+    // when it compiles the program, so the branches that depend on it cost nothing at runtime.
+    MaterialBuilder& constant(ConstantType type, const char* name, int32_t defaultValue = 0) noexcept;
+
     // custom variables (all float4)
     MaterialBuilder& variable(Variable v, const char* name) noexcept;
 
@@ -248,9 +260,37 @@ public:
     // specifies a list of variants that should be filtered out during code generation.
     MaterialBuilder& variantFilter(uint8_t variantFilter) noexcept;
 
+    // specifies the variants the engine uses, as reported by Material::getUsedVariants(). Only
+    // the shaders these variants need are generated, the engine fails to render with the others.
+    MaterialBuilder& usedVariants(uint32_t usedVariants) noexcept;
+
+    // if set, shaders are generated and compiled in parallel using this JobSystem, the calling
+    // thread must be adopted by the JobSystem. This doesn't change the generated package.
+    MaterialBuilder& jobSystem(utils::JobSystem* jobSystem) noexcept;
+
+    // if set, compiled shaders are looked up in and added to this cache. The cache must outlive
+    // calls to build().
+    MaterialBuilder& shaderCache(ShaderCache* shaderCache) noexcept;
+
+    // if true, the shader dictionaries -- the bulk of a package -- are compressed, which makes
+    // the package about 2.6x smaller at the cost of decompressing them when the material is loaded.
+    MaterialBuilder& compression(bool compression) noexcept;
+
     // build the material
     Package build() noexcept;
 
+    struct BuildStats {
+        uint32_t shaderCount = 0;       // number of shaders generated
+        float compileTime = 0;          // time spent generating and compiling shaders, in ms
+        float shaderCompileTime = 0;    // sum of the time spent on each shader, in ms
+        float packageTime = 0;          // time spent building the package, in ms
+        uint32_t cacheHits = 0;         // shaders found in the shader cache
+        uint32_t cacheMisses = 0;       // shaders compiled and added to the shader cache
+    };
+
+    // statistics about the last call to build()
+    BuildStats const& getBuildStats() const noexcept { return mBuildStats; }
+
 public:
     // The methods and types below are for internal use
     struct Parameter {
@@ -273,8 +313,16 @@ public:
         bool isSampler;
     };
 
+    struct Constant {
+        utils::CString name;
+        ConstantType type;
+        int32_t defaultValue;   // 0 or 1 for booleans
+    };
+
     using PropertyList = bool[MATERIAL_PROPERTIES_COUNT];
     using VariableList = utils::CString[MATERIAL_VARIABLES_COUNT];
+    // a constant's id is its index in this list
+    using ConstantList = std::vector<Constant>;
 
     // Preview the first shader that would generated in the MaterialPackage.
     // This is used to run Static Code Analysis before generating a package.
@@ -294,8 +342,15 @@ public:
     // returns a list of at least getParameterCount() parameters
     const ParameterList& getParameters() const noexcept { return mParameters; }
 
+    // maximum number of specialization constants of a material
+    static constexpr size_t MAX_CONSTANTS_COUNT = filament::MAX_SPECIALIZATION_CONSTANTS;
+
+    const ConstantList& getConstants() const noexcept { return mConstants; }
+
     uint8_t getVariantFilter() const { return mVariantFilter; }
 
+    const utils::CString& getName() const noexcept { return mMaterialName; }
+
 private:
     void prepareToBuild(MaterialInfo& info) noexcept;
 
@@ -315,6 +370,7 @@ private:
     PropertyList mProperties;
     ParameterList mParameters;
     VariableList mVariables;
+    ConstantList mConstants;
 
     BlendingMode mBlendingMode = BlendingMode::OPAQUE;
     CullingMode mCullingMode = CullingMode::BACK;
@@ -342,6 +398,12 @@ private:
     bool mClearCoatIorChange = true;
 
     bool mFlipUV = true;
+
+    utils::JobSystem* mJobSystem = nullptr;
+    ShaderCache* mShaderCache = nullptr;
+    bool mCompression = false;
+    uint32_t mUsedVariants = 0xFFFFFFFF;
+    BuildStats mBuildStats;
 };
 
 } // namespace filamat
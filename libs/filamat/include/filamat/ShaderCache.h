@@ -0,0 +1,90 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMAT_SHADERCACHE_H
+#define TNT_FILAMAT_SHADERCACHE_H
+
+#include <filament/driver/DriverEnums.h>
+
+#include <filamat/MaterialBuilder.h>
+
+#include <utils/compiler.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace filamat {
+
+class GLSLPostProcessor;
+
+/*
+ * On-disk cache of compiled shaders.
+ *
+ * Compiling shaders (glslang, the SPIR-V optimizer and cross-compilation to MSL) is where most
+ * of the time goes when building a material. Each compiled shader is stored in its own file,
+ * named after a hash of the generated GLSL, stage, shader model, optimization level and
+ * requested outputs. A shader that was already compiled -- by a previous build of the same
+ * material, or by another material generating the same code -- is read back instead of being
+ * compiled again.
+ *
+ * Entries are written atomically, so the same directory can be used by several threads and
+ * processes at once. The directory should be cleared when the compiler itself changes.
+ */
+class UTILS_PUBLIC ShaderCache {
+public:
+    // the directory is created if needed
+    explicit ShaderCache(const char* directory) noexcept;
+
+    ShaderCache(ShaderCache const&) = delete;
+    ShaderCache& operator=(ShaderCache const&) = delete;
+
+    struct Stats {
+        uint32_t hits = 0;      // shaders read from the cache
+        uint32_t misses = 0;    // shaders that had to be compiled
+    };
+
+    Stats getStats() const noexcept;
+
+    const char* getDirectory() const noexcept { return mDirectory.c_str(); }
+
+private:
+    friend class GLSLPostProcessor;
+
+    using ShaderType = filament::driver::ShaderType;
+    using ShaderModel = filament::driver::ShaderModel;
+    using Optimization = MaterialBuilder::Optimization;
+
+    // Fetches the outputs of the compilation of source, only the non-null outputs are needed.
+    bool get(std::string const& source, ShaderType type, ShaderModel model,
+            Optimization optimization, std::string* outputGlsl,
+            std::vector<uint32_t>* outputSpirv, std::string* outputMsl) noexcept;
+
+    // Stores the outputs of the compilation of source.
+    void put(std::string const& source, ShaderType type, ShaderModel model,
+            Optimization optimization, std::string const* outputGlsl,
+            std::vector<uint32_t> const* outputSpirv, std::string const* outputMsl) noexcept;
+
+    std::string mDirectory;
+    std::atomic<uint32_t> mHits = { 0 };
+    std::atomic<uint32_t> mMisses = { 0 };
+};
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_SHADERCACHE_H
@@ -16,6 +16,8 @@
 
 #include "GLSLPostProcessor.h"
 
+#include "filamat/ShaderCache.h"
+
 #include <sstream>
 #include <vector>
 
@@ -28,6 +30,7 @@
 
 #include "sca/builtinResource.h"
 #include "sca/GLSLTools.h"
+#include "shaders/CodeGenerator.h"
 
 #include <utils/Log.h>
 
@@ -37,8 +40,9 @@ using namespace spvtools;
 
 namespace filamat {
 
-GLSLPostProcessor::GLSLPostProcessor(MaterialBuilder::Optimization optimization, bool printShaders)
-        : mOptimization(optimization), mPrintShaders(printShaders) {
+GLSLPostProcessor::GLSLPostProcessor(MaterialBuilder::Optimization optimization, bool printShaders,
+        ShaderCache* cache)
+        : mOptimization(optimization), mPrintShaders(printShaders), mCache(cache) {
 
 }
 
@@ -55,6 +59,56 @@ static uint32_t shaderVersionFromModel(filament::driver::ShaderModel model) {
     }
 }
 
+// When it doesn't target Vulkan, spirv-cross replaces specialization constants with their default
+// value. This refers to them with the macros that emulate them in OpenGL instead, so that they can
+// still be set when the program is compiled (see CodeGenerator::generateConstants()).
+class SpecializableCompilerGLSL : public CompilerGLSL {
+public:
+    explicit SpecializableCompilerGLSL(std::vector<uint32_t> spirv)
+            : CompilerGLSL(std::move(spirv)) {
+    }
+
+    std::string constant_expression(const SPIRConstant& c) override {
+        if (c.specialization && has_decoration(c.self, spv::DecorationSpecId)) {
+            return CodeGenerator::getConstantMacroName(
+                    get_decoration(c.self, spv::DecorationSpecId));
+        }
+        // vectors built from specialization constants, e.g. the splat of a bool used to select
+        // between two vectors, would otherwise get the default values of their components
+        if (c.subconstants.empty() && c.columns() == 1 && c.vector_size() > 1) {
+            for (uint32_t i = 0; i < c.vector_size(); i++) {
+                if (c.specialization_constant_id(0, i)) {
+                    return specializedVectorExpression(c);
+                }
+            }
+        }
+        return CompilerGLSL::constant_expression(c);
+    }
+
+private:
+    std::string specializedVectorExpression(const SPIRConstant& c) {
+        SPIRType const& type = get<SPIRType>(c.constant_type);
+        std::string res = type_to_glsl(type) + "(";
+        for (uint32_t i = 0; i < c.vector_size(); i++) {
+            if (uint32_t id = c.specialization_constant_id(0, i)) {
+                res += to_expression(id);
+            } else {
+                switch (type.basetype) {
+                    case SPIRType::Boolean: res += c.scalar(0, i) ? "true" : "false"; break;
+                    case SPIRType::Int:     res += convert_to_string(c.scalar_i32(0, i)); break;
+                    case SPIRType::UInt:    res += convert_to_string(c.scalar(0, i)) + "u"; break;
+                    case SPIRType::Float:   res += convert_float_to_string(c, 0, i); break;
+                    default:
+                        // the constants are ints or bools, other types are left to spirv-cross
+                        return CompilerGLSL::constant_expression(c);
+                }
+            }
+            res += i + 1 < c.vector_size() ? ", " : ")";
+        }
+        return res;
+    }
+};
+
 static void errorHandler(const std::string& str) {
     utils::slog.e << str << utils::io::endl;
 }
@@ -151,6 +205,19 @@ bool GLSLPostProcessor::process(const std::string& inputShader,
         return true;
     }
 
+    // inputShader may alias outputGlsl, keep a copy of the source around to key the cache
+    std::string source;
+    if (mCache) {
+        if (mCache->get(inputShader, shaderType, shaderModel, mOptimization,
+                outputGlsl, outputSpirv, outputMsl)) {
+            if (outputGlsl && mPrintShaders) {
+                utils::slog.i << *outputGlsl << utils::io::endl;
+            }
+            return true;
+        }
+        source = inputShader;
+    }
+
     mGlslOutput = outputGlsl;
     mSpirvOutput = outputSpirv;
     mMslOutput = outputMsl;
@@ -215,6 +282,11 @@ bool GLSLPostProcessor::process(const std::string& inputShader,
             utils::slog.i << *mGlslOutput << utils::io::endl;
         }
     }
+
+    if (mCache && (!mSpirvOutput || !mSpirvOutput->empty())) {
+        mCache->put(source, shaderType, shaderModel, mOptimization,
+                mGlslOutput, mSpirvOutput, mMslOutput);
+    }
     return true;
 }
 
@@ -312,7 +384,7 @@ void GLSLPostProcessor::fullOptimization(const TShader& tShader,
         glslOptions.fragment.default_int_precision = glslOptions.es ?
                 CompilerGLSL::Options::Precision::Mediump : CompilerGLSL::Options::Precision::Highp;
 
-        CompilerGLSL glslCompiler(move(spirv));
+        SpecializableCompilerGLSL glslCompiler(move(spirv));
         glslCompiler.set_common_options(glslOptions);
 
         *mGlslOutput = glslCompiler.compile();
@@ -30,11 +30,14 @@
 
 namespace filamat {
 
+class ShaderCache;
+
 using SpirvBlob = std::vector<uint32_t>;
 
 class GLSLPostProcessor {
 public:
-    GLSLPostProcessor(MaterialBuilder::Optimization optimization, bool printShaders);
+    GLSLPostProcessor(MaterialBuilder::Optimization optimization, bool printShaders,
+            ShaderCache* cache = nullptr);
 
     ~GLSLPostProcessor();
 
@@ -54,6 +57,7 @@ private:
 
     const filamat::MaterialBuilder::Optimization mOptimization;
     const bool mPrintShaders;
+    ShaderCache* const mCache;
     std::string* mGlslOutput = nullptr;
     SpirvBlob* mSpirvOutput = nullptr;
     std::string* mMslOutput = nullptr;
@@ -15,9 +15,13 @@
  */
 
 #include "filamat/MaterialBuilder.h"
+#include "filamat/ShaderCache.h"
 
+#include <chrono>
+#include <limits>
 #include <vector>
 
+#include <utils/JobSystem.h>
 #include <utils/Panic.h>
 #include <utils/Log.h>
 
@@ -37,6 +41,7 @@
 #include "eiff/MaterialTextChunk.h"
 #include "eiff/MaterialSpirvChunk.h"
 #include "eiff/ChunkContainer.h"
+#include "eiff/CompressedChunk.h"
 #include "eiff/SimpleFieldChunk.h"
 #include "eiff/DictionaryTextChunk.h"
 #include "eiff/DictionarySpirvChunk.h"
@@ -179,6 +184,16 @@ MaterialBuilder& MaterialBuilder::parameter(
     return parameter(samplerType, SamplerFormat::FLOAT, SamplerPrecision::DEFAULT, name);
 }
 
+MaterialBuilder& MaterialBuilder::constant(
+        ConstantType type, const char* name, int32_t defaultValue) noexcept {
+    ASSERT_POSTCONDITION(mConstants.size() < MAX_CONSTANTS_COUNT, "Too many constants");
+    if (type == ConstantType::BOOL) {
+        defaultValue = defaultValue ? 1 : 0;
+    }
+    mConstants.push_back({ CString(name), type, defaultValue });
+    return *this;
+}
+
 MaterialBuilder& MaterialBuilder::require(filament::VertexAttribute attribute) noexcept {
     mRequiredAttributes.set(attribute);
     return *this;
@@ -281,6 +296,26 @@ MaterialBuilder& MaterialBuilder::variantFilter(uint8_t variantFilter) noexcept
     return *this;
 }
 
+MaterialBuilder& MaterialBuilder::usedVariants(uint32_t usedVariants) noexcept {
+    mUsedVariants = usedVariants;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::jobSystem(utils::JobSystem* jobSystem) noexcept {
+    mJobSystem = jobSystem;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::shaderCache(ShaderCache* shaderCache) noexcept {
+    mShaderCache = shaderCache;
+    return *this;
+}
+
+MaterialBuilder& MaterialBuilder::compression(bool compression) noexcept {
+    mCompression = compression;
+    return *this;
+}
+
 bool MaterialBuilder::hasExternalSampler() const noexcept {
     for (size_t i = 0, c = mParameterCount; i < c; i++) {
         auto const& param = mParameters[i];
@@ -337,7 +372,7 @@ bool MaterialBuilder::runStaticCodeAnalysis() noexcept {
     GLSLTools glslTools;
 
     // Populate mProperties with the properties set in the shader.
-    if (!glslTools.findProperties(*this, mProperties, mTargetApi)) {
+    if (!glslTools.findProperties(*this, mProperties, mTargetApi, mOptimization)) {
         return false;
     }
 
@@ -345,14 +380,26 @@ bool MaterialBuilder::runStaticCodeAnalysis() noexcept {
     ShaderModel model;
 
     std::string shaderCode = peek(ShaderType::VERTEX, model, mProperties);
-    bool result = glslTools.analyzeVertexShader(shaderCode, model, mTargetApi);
+    bool result = glslTools.analyzeVertexShader(shaderCode, model, mTargetApi, mOptimization);
     if (!result) return false;
 
     shaderCode = peek(ShaderType::FRAGMENT, model, mProperties);
-    result = glslTools.analyzeFragmentShader(shaderCode, model, mTargetApi);
+    result = glslTools.analyzeFragmentShader(shaderCode, model, mTargetApi, mOptimization);
     return result;
 }
 
+// A shader generated by build(), before it's added to the package.
+struct CompiledShader {
+    size_t permutation;                     // index in mCodeGenPermutations
+    uint8_t variant;
+    filament::driver::ShaderType stage;
+    bool ok;
+    float time;                             // time spent generating and compiling, in ms
+    std::string glsl;                       // or the generated source, if compilation failed
+    std::vector<uint32_t> spirv;
+    std::string msl;
+};
+
 static void showErrorMessage(const char* materialName, uint8_t variant,
         MaterialBuilder::TargetApi targetApi, filament::driver::ShaderType shaderType,
         const std::string& shaderCode) {
@@ -391,9 +438,6 @@ Package MaterialBuilder::build() noexcept {
     MaterialInfo info;
     prepareToBuild(info);
 
-    // Create a postprocessor to optimize / compile to Spir-V if necessary.
-    GLSLPostProcessor postProcessor(mOptimization, mPrintShaders);
-
     // Create chunk tree.
     ChunkContainer container;
 
@@ -448,6 +492,12 @@ Package MaterialBuilder::build() noexcept {
     MaterialSamplerInterfaceBlockChunk matSib = MaterialSamplerInterfaceBlockChunk(info.sib);
     container.addChild(&matSib);
 
+    // Specialization constants
+    MaterialConstantsChunk matConstants(mConstants);
+    if (!mConstants.empty()) {
+        container.addChild(&matConstants);
+    }
+
     SimpleFieldChunk<bool> matDepthWriteSet(ChunkType::MaterialDepthWriteSet, mDepthWriteSet);
     container.addChild(&matDepthWriteSet);
 
@@ -489,10 +539,8 @@ Package MaterialBuilder::build() noexcept {
     LineDictionary glslDictionary;
     BlobDictionary spirvDictionary;
     LineDictionary metalDictionary;
-    std::vector<uint32_t> spirv;
-    std::string msl;
 
-    ShaderGenerator sg(mProperties, mVariables,
+    ShaderGenerator sg(mProperties, mVariables, mConstants,
             mMaterialCode, mMaterialLineOffset, mMaterialVertexCode, mMaterialVertexLineOffset);
 
     bool emptyVertexCode = mMaterialVertexCode.empty();
@@ -501,32 +549,30 @@ Package MaterialBuilder::build() noexcept {
     SimpleFieldChunk<bool> hasCustomDepth(ChunkType::MaterialHasCustomDepthShader, customDepth);
     container.addChild(&hasCustomDepth);
 
-    for (const auto& params : mCodeGenPermutations) {
-        const ShaderModel shaderModel = ShaderModel(params.shaderModel);
-        const TargetApi targetApi = params.targetApi;
-        const TargetApi codeGenTargetApi = params.codeGenTargetApi;
+    // Shaders are generated in two steps: first all shaders are generated and compiled, which
+    // can happen in parallel, then they're added to the dictionaries in a fixed order, so the
+    // package doesn't depend on how the work was scheduled.
+    std::vector<MaterialInfo> infos(mCodeGenPermutations.size(), info);
+    // The vertex and fragment shaders needed by the variants that are used.
+    uint32_t usedVertexVariants = 0;
+    uint32_t usedFragmentVariants = 0;
+    for (uint8_t k = 0; k < filament::VARIANT_COUNT; k++) {
+        if (mUsedVariants & (1u << k)) {
+            usedVertexVariants |= 1u << filament::Variant::filterVariantVertex(k);
+            usedFragmentVariants |= 1u << filament::Variant::filterVariantFragment(k);
+        }
+    }
+
+    std::vector<CompiledShader> shaders;
+    for (size_t i = 0, c = mCodeGenPermutations.size(); i < c; i++) {
+        const auto& params = mCodeGenPermutations[i];
 
         // Re-populate the set of sampler bindings for this API.
         filament::SamplerBindingMap map;
         auto backend = static_cast<filament::driver::Backend>(params.targetApi);
         uint8_t offset = filament::getSamplerBindingsStart(backend);
         map.populate(offset, &info.sib, mMaterialName.c_str());
-        info.samplerBindings = std::move(map);
-
-        // Metal Shading Language is cross-compiled from Vulkan.
-        const bool targetApiNeedsSpirv =
-                (targetApi == TargetApi::VULKAN || targetApi == TargetApi::METAL);
-        const bool targetApiNeedsMsl = targetApi == TargetApi::METAL;
-        std::vector<uint32_t>* pSpirv = targetApiNeedsSpirv ? &spirv : nullptr;
-        std::string* pMsl = targetApiNeedsMsl ? &msl : nullptr;
-
-        TextEntry glslEntry{0};
-        SpirvEntry spirvEntry{0};
-        TextEntry metalEntry{0};
-
-        glslEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
-        spirvEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
-        metalEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+        infos[i].samplerBindings = std::move(map);
 
         // apply custom variants filters
         uint8_t variantMask = ~mVariantFilter;
@@ -537,133 +583,176 @@ Package MaterialBuilder::build() noexcept {
                 continue;
             }
 
-            glslEntry.variant = k;
-            spirvEntry.variant = k;
-            metalEntry.variant = k;
-
             // Remove variants for unlit materials
             uint8_t v = filament::Variant::filterVariant(
                     k & variantMask, isLit() || mShadowMultiplier);
 
-            if (filament::Variant::filterVariantVertex(v) == k) {
-                // Vertex Shader
-                std::string vs = sg.createVertexProgram(
-                        shaderModel, targetApi, codeGenTargetApi, info, k,
-                        mInterpolation, mVertexDomain);
-                bool ok = postProcessor.process(vs, filament::driver::ShaderType::VERTEX,
-                        shaderModel, &vs, pSpirv, pMsl);
-                if (!ok) {
-                    showErrorMessage(mMaterialName.c_str_safe(), k, targetApi,
-                            filament::driver::ShaderType::VERTEX, vs);
-                    errorOccured = true;
-                    break;
-                }
-
-                if (targetApi == TargetApi::OPENGL) {
-                    if (codeGenTargetApi == TargetApi::VULKAN) {
-                        sg.fixupExternalSamplers(shaderModel, vs, info);
-                    }
-
-                    glslEntry.stage = filament::driver::ShaderType::VERTEX;
-                    glslEntry.shaderSize = vs.size();
-                    glslEntry.shader = (char*) malloc(glslEntry.shaderSize + 1);
-                    strcpy(glslEntry.shader, vs.c_str());
-                    glslDictionary.addText(glslEntry.shader);
-                    glslEntries.push_back(glslEntry);
-                }
-
-                if (targetApi == TargetApi::VULKAN) {
-                    assert(!spirv.empty());
-                    spirvEntry.stage = filament::driver::ShaderType::VERTEX;
-                    spirvEntry.dictionaryIndex = spirvDictionary.addBlob(spirv);
-                    spirv.clear();
-                    spirvEntries.push_back(spirvEntry);
-                }
-                if (targetApi == TargetApi::METAL) {
-                    assert(spirv.size() > 0);
-                    assert(msl.length() > 0);
-                    metalEntry.stage = filament::driver::ShaderType::VERTEX;
-                    metalEntry.shaderSize = msl.length();
-                    metalEntry.shader = (char*)malloc(metalEntry.shaderSize + 1);
-                    strcpy(metalEntry.shader, msl.c_str());
-                    spirv.clear();
-                    msl.clear();
-                    metalDictionary.addText(metalEntry.shader);
-                    metalEntries.push_back(metalEntry);
-                }
+            if (filament::Variant::filterVariantVertex(v) == k &&
+                    (usedVertexVariants & (1u << k))) {
+                shaders.push_back({ i, k, filament::driver::ShaderType::VERTEX });
             }
+            if (filament::Variant::filterVariantFragment(v) == k &&
+                    (usedFragmentVariants & (1u << k))) {
+                shaders.push_back({ i, k, filament::driver::ShaderType::FRAGMENT });
+            }
+        }
+    }
+
+    auto compile = [this, &sg, &infos](CompiledShader& shader) {
+        const auto start = std::chrono::steady_clock::now();
+
+        const auto& params = mCodeGenPermutations[shader.permutation];
+        const ShaderModel shaderModel = ShaderModel(params.shaderModel);
+        const TargetApi targetApi = params.targetApi;
+        const TargetApi codeGenTargetApi = params.codeGenTargetApi;
+        MaterialInfo const& info = infos[shader.permutation];
+
+        // Metal Shading Language is cross-compiled from Vulkan.
+        const bool targetApiNeedsSpirv =
+                (targetApi == TargetApi::VULKAN || targetApi == TargetApi::METAL);
+        const bool targetApiNeedsMsl = targetApi == TargetApi::METAL;
+        std::vector<uint32_t>* pSpirv = targetApiNeedsSpirv ? &shader.spirv : nullptr;
+        std::string* pMsl = targetApiNeedsMsl ? &shader.msl : nullptr;
 
-            if (filament::Variant::filterVariantFragment(v) == k) {
-                // Fragment Shader
-                std::string fs = sg.createFragmentProgram(
-                        shaderModel, targetApi, codeGenTargetApi, info, k, mInterpolation);
-
-                bool ok = postProcessor.process(fs, filament::driver::ShaderType::FRAGMENT,
-                        shaderModel, &fs, pSpirv, pMsl);
-                if (!ok) {
-                    showErrorMessage(mMaterialName.c_str_safe(), k, targetApi,
-                            filament::driver::ShaderType::FRAGMENT, fs);
-                    errorOccured = true;
-                    break;
-                }
-
-                if (targetApi == TargetApi::OPENGL) {
-                    if (codeGenTargetApi == TargetApi::VULKAN) {
-                        sg.fixupExternalSamplers(shaderModel, fs, info);
+        std::string& glsl = shader.glsl;
+        if (shader.stage == filament::driver::ShaderType::VERTEX) {
+            glsl = sg.createVertexProgram(shaderModel, targetApi, codeGenTargetApi, info,
+                    shader.variant, mInterpolation, mVertexDomain);
+        } else {
+            glsl = sg.createFragmentProgram(shaderModel, targetApi, codeGenTargetApi, info,
+                    shader.variant, mInterpolation);
+        }
+
+        // The post-processor keeps per-shader state, so each shader needs its own.
+        GLSLPostProcessor postProcessor(mOptimization, mPrintShaders, mShaderCache);
+        shader.ok = postProcessor.process(glsl, shader.stage, shaderModel, &glsl, pSpirv, pMsl);
+        if (shader.ok && targetApi == TargetApi::OPENGL &&
+                codeGenTargetApi == TargetApi::VULKAN) {
+            sg.fixupExternalSamplers(shaderModel, glsl, info);
+        }
+        if (shader.ok && targetApi == TargetApi::OPENGL) {
+            sg.fixupSpecializationConstants(glsl);
+        }
+
+        shader.time = std::chrono::duration<float, std::milli>(
+                std::chrono::steady_clock::now() - start).count();
+    };
+
+    const ShaderCache::Stats cacheStart =
+            mShaderCache ? mShaderCache->getStats() : ShaderCache::Stats{};
+    const auto compileStart = std::chrono::steady_clock::now();
+    // printed shaders would be interleaved if they were compiled in parallel
+    if (mJobSystem && !mPrintShaders) {
+        JobSystem& js = *mJobSystem;
+        auto job = jobs::parallel_for(js, nullptr, shaders.data(), uint32_t(shaders.size()),
+                [&compile](CompiledShader* shaders, uint32_t count) {
+                    for (uint32_t i = 0; i < count; i++) {
+                        compile(shaders[i]);
                     }
+                }, jobs::CountSplitter<1, 16>());
+        js.runAndWait(job);
+    } else {
+        for (CompiledShader& shader : shaders) {
+            compile(shader);
+        }
+    }
+    const auto compileEnd = std::chrono::steady_clock::now();
+
+    mBuildStats = {};
+    mBuildStats.shaderCount = uint32_t(shaders.size());
+    mBuildStats.compileTime =
+            std::chrono::duration<float, std::milli>(compileEnd - compileStart).count();
+    if (mShaderCache) {
+        const ShaderCache::Stats cacheEnd = mShaderCache->getStats();
+        mBuildStats.cacheHits = cacheEnd.hits - cacheStart.hits;
+        mBuildStats.cacheMisses = cacheEnd.misses - cacheStart.misses;
+    }
 
-                    glslEntry.stage = filament::driver::ShaderType::FRAGMENT;
-                    glslEntry.shaderSize = fs.size();
-                    glslEntry.shader = (char*) malloc(glslEntry.shaderSize + 1);
-                    strcpy(glslEntry.shader, fs.c_str());
-                    glslDictionary.addText(glslEntry.shader);
-                    glslEntries.push_back(glslEntry);
-                }
-
-                if (targetApi == TargetApi::VULKAN) {
-                    assert(!spirv.empty());
-                    spirvEntry.stage = filament::driver::ShaderType::FRAGMENT;
-                    spirvEntry.dictionaryIndex = spirvDictionary.addBlob(spirv);
-                    spirv.clear();
-                    spirvEntries.push_back(spirvEntry);
-                }
-                if (targetApi == TargetApi::METAL) {
-                    assert(spirv.size() > 0);
-                    assert(msl.length() > 0);
-                    metalEntry.stage = filament::driver::ShaderType::FRAGMENT;
-                    metalEntry.shaderSize = msl.length();
-                    metalEntry.shader = (char*)malloc(metalEntry.shaderSize + 1);
-                    strcpy(metalEntry.shader, msl.c_str());
-                    spirv.clear();
-                    msl.clear();
-                    metalDictionary.addText(metalEntry.shader);
-                    metalEntries.push_back(metalEntry);
-                }
-            }
+    size_t failedPermutation = std::numeric_limits<size_t>::max();
+    for (CompiledShader& shader : shaders) {
+        mBuildStats.shaderCompileTime += shader.time;
+
+        // once a shader fails, skip the remaining variants of that permutation
+        if (shader.permutation == failedPermutation) {
+            continue;
         }
+
+        const auto& params = mCodeGenPermutations[shader.permutation];
+        const TargetApi targetApi = params.targetApi;
+
+        if (!shader.ok) {
+            showErrorMessage(mMaterialName.c_str_safe(), shader.variant, targetApi,
+                    shader.stage, shader.glsl);
+            errorOccured = true;
+            failedPermutation = shader.permutation;
+            continue;
+        }
+
+        if (targetApi == TargetApi::OPENGL) {
+            TextEntry glslEntry{0};
+            glslEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+            glslEntry.variant = shader.variant;
+            glslEntry.stage = shader.stage;
+            glslEntry.shaderSize = shader.glsl.size();
+            glslEntry.shader = (char*) malloc(glslEntry.shaderSize + 1);
+            strcpy(glslEntry.shader, shader.glsl.c_str());
+            glslDictionary.addText(glslEntry.shader);
+            glslEntries.push_back(glslEntry);
+        }
+
+        if (targetApi == TargetApi::VULKAN) {
+            assert(!shader.spirv.empty());
+            SpirvEntry spirvEntry{0};
+            spirvEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+            spirvEntry.variant = shader.variant;
+            spirvEntry.stage = shader.stage;
+            spirvEntry.dictionaryIndex = spirvDictionary.addBlob(shader.spirv);
+            spirvEntries.push_back(spirvEntry);
+        }
+
+        if (targetApi == TargetApi::METAL) {
+            assert(shader.spirv.size() > 0);
+            assert(shader.msl.length() > 0);
+            TextEntry metalEntry{0};
+            metalEntry.shaderModel = static_cast<uint8_t>(params.shaderModel);
+            metalEntry.variant = shader.variant;
+            metalEntry.stage = shader.stage;
+            metalEntry.shaderSize = shader.msl.length();
+            metalEntry.shader = (char*)malloc(metalEntry.shaderSize + 1);
+            strcpy(metalEntry.shader, shader.msl.c_str());
+            metalDictionary.addText(metalEntry.shader);
+            metalEntries.push_back(metalEntry);
+        }
+
+        // release the memory early, all the shaders are alive at this point
+        shader = {};
     }
 
     // Emit GLSL chunks (TextDictionaryReader and MaterialTextChunk).
+    // The dictionaries are optionally compressed, the chunks indexing them are small.
     filamat::DictionaryTextChunk dicGlslChunk(glslDictionary, ChunkType::DictionaryGlsl);
+    CompressedChunk compressedDicGlslChunk(dicGlslChunk);
     MaterialTextChunk glslChunk(glslEntries, glslDictionary, ChunkType::MaterialGlsl);
     if (!glslEntries.empty()) {
-        container.addChild(&dicGlslChunk);
+        container.addChild(mCompression ? (Chunk*) &compressedDicGlslChunk : &dicGlslChunk);
         container.addChild(&glslChunk);
     }
 
     // Emit SPIRV chunks (SpirvDictionaryReader and MaterialSpirvChunk).
     filamat::DictionarySpirvChunk dicSpirvChunk(spirvDictionary);
+    CompressedChunk compressedDicSpirvChunk(dicSpirvChunk);
     MaterialSpirvChunk spirvChunk(spirvEntries);
     if (!spirvEntries.empty()) {
-        container.addChild(&dicSpirvChunk);
+        container.addChild(mCompression ? (Chunk*) &compressedDicSpirvChunk : &dicSpirvChunk);
         container.addChild(&spirvChunk);
     }
 
     // Emit Metal chunks (MetalDictionaryReader and MaterialMetalChunk).
     filamat::DictionaryTextChunk dicMetalChunk(metalDictionary, ChunkType::DictionaryMetal);
+    CompressedChunk compressedDicMetalChunk(dicMetalChunk);
     MaterialTextChunk metalChunk(metalEntries, metalDictionary, ChunkType::MaterialMetal);
     if (!metalEntries.empty()) {
-        container.addChild(&dicMetalChunk);
+        container.addChild(mCompression ? (Chunk*) &compressedDicMetalChunk : &dicMetalChunk);
         container.addChild(&metalChunk);
     }
 
@@ -674,6 +763,9 @@ Package MaterialBuilder::build() noexcept {
     container.flatten(f);
     package.setValid(!errorOccured);
 
+    mBuildStats.packageTime = std::chrono::duration<float, std::milli>(
+            std::chrono::steady_clock::now() - compileEnd).count();
+
     // Free all shaders that were created earlier.
     for (TextEntry entry : glslEntries) {
         free(entry.shader);
@@ -687,7 +779,7 @@ Package MaterialBuilder::build() noexcept {
 const std::string MaterialBuilder::peek(filament::driver::ShaderType type,
         filament::driver::ShaderModel& model, const PropertyList& properties) noexcept {
 
-    ShaderGenerator sg(properties, mVariables,
+    ShaderGenerator sg(properties, mVariables, mConstants,
             mMaterialCode, mMaterialLineOffset, mMaterialVertexCode, mMaterialVertexLineOffset);
 
     MaterialInfo info;
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "filamat/ShaderCache.h"
+
+#include <private/filament/EngineEnums.h>
+
+#include <utils/Hash.h>
+#include <utils/Log.h>
+#include <utils/Path.h>
+
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#include <string.h>
+
+#if defined(WIN32)
+#   include <process.h>
+#   define getpid _getpid
+#else
+#   include <unistd.h>
+#endif
+
+using namespace utils;
+
+namespace filamat {
+
+// bump this when the format of the cache files or the shader compilation changes
+static constexpr uint32_t CACHE_VERSION = 1;
+
+static constexpr char CACHE_MAGIC[4] = { 'F', 'S', 'C', 'H' };
+
+enum : uint8_t {
+    OUTPUT_GLSL  = 0x1,
+    OUTPUT_SPIRV = 0x2,
+    OUTPUT_MSL   = 0x4,
+};
+
+// Everything but the source that identifies a compiled shader, this is stored as-is in the
+// cache files.
+struct CacheHeader {
+    uint32_t cacheVersion;
+    uint32_t materialVersion;
+    uint8_t type;
+    uint8_t model;
+    uint8_t optimization;
+    uint8_t outputs;
+};
+static_assert(sizeof(CacheHeader) == 12, "CacheHeader must not have padding");
+
+static CacheHeader makeHeader(filament::driver::ShaderType type,
+        filament::driver::ShaderModel model, MaterialBuilder::Optimization optimization,
+        bool glsl, bool spirv, bool msl) noexcept {
+    CacheHeader header;
+    header.cacheVersion = CACHE_VERSION;
+    header.materialVersion = uint32_t(filament::MATERIAL_VERSION);
+    header.type = uint8_t(type);
+    header.model = uint8_t(model);
+    header.optimization = uint8_t(optimization);
+    header.outputs = uint8_t((glsl ? OUTPUT_GLSL : 0) |
+                             (spirv ? OUTPUT_SPIRV : 0) |
+                             (msl ? OUTPUT_MSL : 0));
+    return header;
+}
+
+static std::string getCacheFileName(std::string const& directory,
+        CacheHeader const& header, std::string const& source) noexcept {
+    uint64_t h = hash::fnv1a64(&header, sizeof(header));
+    h = hash::fnv1a64(source.data(), source.size(), h);
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.shader", (unsigned long long) h);
+    return Path(directory).concat(name).getPath();
+}
+
+// Returns whether count elements of type T are left in the stream. The counts come from the file,
+// a corrupted one must not make us allocate an arbitrary amount of memory.
+template<typename T>
+static bool isAvailable(std::ifstream& in, std::streamoff fileSize, uint64_t count) {
+    const std::streamoff position = in.tellg();
+    return position >= 0 && position <= fileSize &&
+            count <= uint64_t(fileSize - position) / sizeof(T);
+}
+
+template<typename T>
+static bool readArray(std::ifstream& in, std::streamoff fileSize, std::vector<T>& array) {
+    uint64_t count = 0;
+    if (!in.read(reinterpret_cast<char*>(&count), sizeof(count)) ||
+            !isAvailable<T>(in, fileSize, count)) {
+        return false;
+    }
+    array.resize(size_t(count));
+    return bool(in.read(reinterpret_cast<char*>(array.data()), count * sizeof(T)));
+}
+
+static bool readString(std::ifstream& in, std::streamoff fileSize, std::string& string) {
+    uint64_t size = 0;
+    if (!in.read(reinterpret_cast<char*>(&size), sizeof(size)) ||
+            !isAvailable<char>(in, fileSize, size)) {
+        return false;
+    }
+    string.resize(size_t(size));
+    return bool(in.read(&string[0], size));
+}
+
+template<typename T>
+static void writeArray(std::ofstream& out, const T* data, uint64_t count) {
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(data), count * sizeof(T));
+}
+
+ShaderCache::ShaderCache(const char* directory) noexcept : mDirectory(directory) {
+    Path path(mDirectory);
+    if (!path.isDirectory() && !path.mkdirRecursive()) {
+        slog.w << "Could not create the shader cache directory " << directory << io::endl;
+    }
+}
+
+ShaderCache::Stats ShaderCache::getStats() const noexcept {
+    Stats stats;
+    stats.hits = mHits.load(std::memory_order_relaxed);
+    stats.misses = mMisses.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool ShaderCache::get(std::string const& source, ShaderType type, ShaderModel model,
+        Optimization optimization, std::string* outputGlsl,
+        std::vector<uint32_t>* outputSpirv, std::string* outputMsl) noexcept {
+    const CacheHeader header = makeHeader(type, model, optimization,
+            outputGlsl != nullptr, outputSpirv != nullptr, outputMsl != nullptr);
+
+    std::ifstream in(getCacheFileName(mDirectory, header, source), std::ios::binary);
+    in.seekg(0, std::ios::end);
+    const std::streamoff fileSize = in.tellg();
+    in.seekg(0, std::ios::beg);
+
+    // The file name is only a hash, make sure the entry really is for this shader.
+    char magic[sizeof(CACHE_MAGIC)];
+    CacheHeader fileHeader;
+    std::string fileSource;
+    bool found = in &&
+            in.read(magic, sizeof(magic)) &&
+            !memcmp(magic, CACHE_MAGIC, sizeof(magic)) &&
+            in.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader)) &&
+            !memcmp(&fileHeader, &header, sizeof(header)) &&
+            readString(in, fileSize, fileSource) &&
+            fileSource == source;
+
+    std::string glsl;
+    std::vector<uint32_t> spirv;
+    std::string msl;
+    found = found && readString(in, fileSize, glsl) && readArray(in, fileSize, spirv) &&
+            readString(in, fileSize, msl);
+
+    if (!found) {
+        mMisses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    if (outputGlsl) {
+        *outputGlsl = std::move(glsl);
+    }
+    if (outputSpirv) {
+        *outputSpirv = std::move(spirv);
+    }
+    if (outputMsl) {
+        *outputMsl = std::move(msl);
+    }
+    mHits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void ShaderCache::put(std::string const& source, ShaderType type, ShaderModel model,
+        Optimization optimization, std::string const* outputGlsl,
+        std::vector<uint32_t> const* outputSpirv, std::string const* outputMsl) noexcept {
+    const CacheHeader header = makeHeader(type, model, optimization,
+            outputGlsl != nullptr, outputSpirv != nullptr, outputMsl != nullptr);
+
+    const std::string path = getCacheFileName(mDirectory, header, source);
+
+    // Write to a temporary file first, so that other threads or processes never see a partially
+    // written entry. The name of the temporary file is unique to this process and thread.
+    const size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id());
+    const std::string temp = path + "." + std::to_string(getpid()) + "." +
+            std::to_string(thread) + ".tmp";
+
+    std::ofstream out(temp, std::ios::binary);
+    if (!out) {
+        return;
+    }
+
+    const std::string empty;
+    const std::vector<uint32_t> none;
+    std::string const& glsl = outputGlsl ? *outputGlsl : empty;
+    std::vector<uint32_t> const& spirv = outputSpirv ? *outputSpirv : none;
+    std::string const& msl = outputMsl ? *outputMsl : empty;
+
+    out.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writeArray(out, source.data(), source.size());
+    writeArray(out, glsl.data(), glsl.size());
+    writeArray(out, spirv.data(), spirv.size());
+    writeArray(out, msl.data(), msl.size());
+    out.close();
+
+    if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+        // another process might have written the same entry in the meantime
+        std::remove(temp.c_str());
+    }
+}
+
+} // namespace filamat
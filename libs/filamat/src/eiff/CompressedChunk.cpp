@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "CompressedChunk.h"
+
+#include <private/filament/Lz4.h>
+
+namespace filamat {
+
+CompressedChunk::CompressedChunk(Chunk& chunk) :
+        Chunk(ChunkType::Compressed), mChunk(chunk) {
+}
+
+void CompressedChunk::compress() {
+    // the container flattens everything twice (dry run first), only compress once
+    Flattener dryRunner(nullptr);
+    mChunk.flatten(dryRunner);
+    std::vector<uint8_t> uncompressed(dryRunner.getBytesWritten());
+    Flattener flattener(uncompressed.data());
+    mChunk.flatten(flattener);
+
+    mCompressed.resize(filament::lz4::compressBound(uncompressed.size()));
+    mCompressed.resize(filament::lz4::compress(uncompressed.data(), uncompressed.size(),
+            mCompressed.data(), mCompressed.size()));
+    mUncompressedSize = uint32_t(uncompressed.size());
+    mIsCompressed = true;
+}
+
+void CompressedChunk::flatten(Flattener& f) {
+    if (!mIsCompressed) {
+        compress();
+    }
+    f.writeUint64(static_cast<uint64_t>(mChunk.getType()));
+    f.writeUint8(static_cast<uint8_t>(ChunkCompression::LZ4));
+    f.writeUint32(mUncompressedSize);
+    f.writeRaw(mCompressed.data(), mCompressed.size());
+}
+
+} // namespace filamat
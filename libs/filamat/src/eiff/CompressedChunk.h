@@ -0,0 +1,45 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef TNT_FILAMAT_COMPRESSED_CHUNK_H
+#define TNT_FILAMAT_COMPRESSED_CHUNK_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "Chunk.h"
+#include "Flattener.h"
+
+namespace filamat {
+
+// Stores another chunk compressed, it is expanded back when the package is parsed.
+// The wrapped chunk must be valid until this chunk is flattened.
+class CompressedChunk : public Chunk {
+public:
+    explicit CompressedChunk(Chunk& chunk);
+    ~CompressedChunk() = default;
+    virtual void flatten(Flattener& f);
+private:
+    void compress();
+    Chunk& mChunk;
+    std::vector<uint8_t> mCompressed;
+    uint32_t mUncompressedSize = 0;
+    bool mIsCompressed = false;
+};
+
+} // namespace filamat
+
+#endif // TNT_FILAMAT_COMPRESSED_CHUNK_H
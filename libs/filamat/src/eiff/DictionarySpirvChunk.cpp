@@ -16,30 +16,107 @@
 
 #include "DictionarySpirvChunk.h"
 
+#include <private/filament/Lz4.h>
+
 #include <smolv.h>
 
+#include <algorithm>
+
 namespace filamat {
 
+// A blob is stored as a delta only if it is that much smaller, in percent of its size.
+static constexpr size_t DELTA_THRESHOLD = 75;
+
+// Number of references tried for each blob. The streams closest in size to the blob are tried
+// first, variants of the same shader differ by a few instructions at most.
+static constexpr size_t MAX_REFERENCE_CANDIDATES = 8;
+
+static void appendUint32(std::string& s, uint32_t v) {
+    for (size_t i = 0; i < 4; i++) {
+        s.push_back(char((v >> (i * 8u)) & 0xFFu));
+    }
+}
+
 DictionarySpirvChunk::DictionarySpirvChunk(BlobDictionary& dictionary) :
         Chunk(ChunkType::DictionarySpirv), mDictionary(dictionary){
 }
 
-void DictionarySpirvChunk::flatten(Flattener& f) {
-
-    // For now, 1 is the only acceptable compression scheme.
-    f.writeUint32(1);
-
-    f.writeUint32(mDictionary.getBlobCount());
-    for (size_t i = 0 ; i < mDictionary.getBlobCount() ; i++) {
+void DictionarySpirvChunk::encode() {
+    const size_t count = mDictionary.getBlobCount();
+    std::vector<smolv::ByteArray> modules(count);
+    for (size_t i = 0 ; i < count; i++) {
         const std::string& spirv = mDictionary.getBlob(i);
-
-        smolv::ByteArray compressed;
         const uint32_t flags = smolv::kEncodeFlagStripDebugInfo;
-        if (!smolv::Encode(spirv.data(), spirv.size(), compressed, flags)) {
+        if (!smolv::Encode(spirv.data(), spirv.size(), modules[i], flags)) {
             utils::slog.e << "Error with SPIRV compression" << utils::io::endl;
         }
+    }
+
+    // Variants of a shader share long runs of instructions, but their ids drift apart so they
+    // rarely share whole instructions. Instead each smol-v stream is stored as an LZ4 delta
+    // against the most similar of the streams stored as-is, which can be decoded independently.
+    filament::lz4::Compressor compressor;
+    std::vector<uint32_t> references;
+    std::vector<uint32_t> candidates;
+    std::vector<uint8_t> delta;
+    std::vector<uint8_t> bestDelta;
+    mBlobs.resize(count);
+    for (size_t i = 0 ; i < count; i++) {
+        const smolv::ByteArray& module = modules[i];
+        delta.resize(filament::lz4::compressBound(module.size()));
+
+        auto sizeDifference = [&modules, &module](uint32_t reference) {
+            const size_t size = modules[reference].size();
+            return size > module.size() ? size - module.size() : module.size() - size;
+        };
+        candidates = references;
+        const size_t candidateCount = std::min(candidates.size(), MAX_REFERENCE_CANDIDATES);
+        std::partial_sort(candidates.begin(), candidates.begin() + candidateCount,
+                candidates.end(), [&sizeDifference](uint32_t lhs, uint32_t rhs) {
+                    // ties are broken by index so that the output doesn't depend on the sort
+                    const size_t l = sizeDifference(lhs);
+                    const size_t r = sizeDifference(rhs);
+                    return l < r || (l == r && lhs < rhs);
+                });
+
+        uint32_t bestReference = NO_REFERENCE;
+        size_t bestSize = module.size() * DELTA_THRESHOLD / 100;
+        for (size_t c = 0; c < candidateCount; c++) {
+            const uint32_t reference = candidates[c];
+            const smolv::ByteArray& dict = modules[reference];
+            size_t size = compressor.compress(module.data(), module.size(),
+                    delta.data(), delta.size(), dict.data(), dict.size());
+            if (size && size < bestSize) {
+                bestReference = reference;
+                bestSize = size;
+                bestDelta.assign(delta.begin(), delta.begin() + size);
+            }
+        }
+
+        std::string& blob = mBlobs[i];
+        appendUint32(blob, bestReference);
+        if (bestReference == NO_REFERENCE) {
+            references.push_back(uint32_t(i));
+            blob.append((const char*) module.data(), module.size());
+        } else {
+            appendUint32(blob, uint32_t(module.size()));
+            blob.append((const char*) bestDelta.data(), bestDelta.size());
+        }
+    }
+    mIsEncoded = true;
+}
+
+void DictionarySpirvChunk::flatten(Flattener& f) {
+    if (!mIsEncoded) {
+        encode();
+    }
+
+    // Compression scheme 2: smol-v streams, optionally delta-compressed against another one.
+    f.writeUint32(2);
 
-        f.writeBlob((const char*) compressed.data(), compressed.size());
+    f.writeUint32(uint32_t(mBlobs.size()));
+    for (const std::string& blob : mBlobs) {
+        f.writeBlob(blob.data(), blob.size());
     }
 }
 
@@ -18,6 +18,7 @@
 #define TNT_FILAMAT_DIC_SPIRV_CHUNK_H
 
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include "Chunk.h"
@@ -26,13 +27,21 @@
 
 namespace filamat {
 
+// Each blob starts with the index of the blob it is a delta of, or NO_REFERENCE if it is a plain
+// smol-v stream. A delta is followed by the size of the smol-v stream and the LZ4 data, which
+// uses the reference stream as its dictionary.
 class DictionarySpirvChunk : public Chunk {
 public:
+    static constexpr uint32_t NO_REFERENCE = 0xFFFFFFFF;
+
     DictionarySpirvChunk(BlobDictionary& dictionary);
     ~DictionarySpirvChunk() = default;
     virtual void flatten(Flattener& f);
 private:
+    void encode();
     BlobDictionary& mDictionary;
+    std::vector<std::string> mBlobs;
+    bool mIsEncoded = false;
 };
 
 } // namespace filamat
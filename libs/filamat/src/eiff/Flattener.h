@@ -114,6 +114,13 @@ public:
         mCursor += nbytes;
     }
 
+    void writeRaw(const uint8_t* data, size_t nbytes) {
+        if (mStart != nullptr) {
+            memcpy(mCursor, data, nbytes);
+        }
+        mCursor += nbytes;
+    }
+
     void writeSizePlaceholder() {
         mSizePlaceholders.push_back(mCursor);
         if (mStart != nullptr) {
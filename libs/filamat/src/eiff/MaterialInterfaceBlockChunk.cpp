@@ -56,4 +56,19 @@ void MaterialSamplerInterfaceBlockChunk::flatten(Flattener &f) {
     }
 }
 
+MaterialConstantsChunk::MaterialConstantsChunk(MaterialBuilder::ConstantList const& constants) :
+        Chunk(ChunkType::MaterialConstants),
+        mConstants(constants) {
+}
+
+void MaterialConstantsChunk::flatten(Flattener &f) {
+    // the id of each constant is its index
+    f.writeUint64(mConstants.size());
+    for (auto const& constant : mConstants) {
+        f.writeString(constant.name.c_str());
+        f.writeUint8(static_cast<uint8_t>(constant.type));
+        f.writeUint32(static_cast<uint32_t>(constant.defaultValue));
+    }
+}
+
 }
@@ -20,6 +20,8 @@
 #include "Chunk.h"
 #include "../shaders/MaterialInfo.h"
 
+#include <filamat/MaterialBuilder.h>
+
 #include <private/filament/SamplerInterfaceBlock.h>
 #include <private/filament/SamplerBindingMap.h>
 #include <private/filament/UniformInterfaceBlock.h>
@@ -46,5 +48,15 @@ private:
     filament::SamplerInterfaceBlock& mSib;
 };
 
+class MaterialConstantsChunk : public Chunk {
+public:
+    MaterialConstantsChunk(MaterialBuilder::ConstantList const& constants);
+    virtual ~MaterialConstantsChunk() = default;
+
+    virtual void flatten(Flattener &) override;
+private:
+    MaterialBuilder::ConstantList const& mConstants;
+};
+
 } // namespace filamat
 #endif // TNT_FILAMAT_MAT_INFO_CHUNK_H
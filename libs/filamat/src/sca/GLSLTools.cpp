@@ -33,6 +33,7 @@
 // GLSLANG headers
 #include <InfoSink.h>
 #include <localintermediate.h>
+#include <doc.h>
 
 #include "builtinResource.h"
 
@@ -53,7 +54,8 @@ GLSLangCleaner::~GLSLangCleaner() {
 }
 
 bool GLSLTools::analyzeFragmentShader(const std::string& shaderCode, ShaderModel model,
-        MaterialBuilder::TargetApi targetApi) const noexcept {
+        MaterialBuilder::TargetApi targetApi,
+        MaterialBuilder::Optimization optimization) const noexcept {
 
     // Parse to check syntax and semantic.
     const char* shaderCString = shaderCode.c_str();
@@ -63,6 +65,7 @@ bool GLSLTools::analyzeFragmentShader(const std::string& shaderCode, ShaderModel
 
     GLSLangCleaner cleaner;
     int version = glslangVersionFromShaderModel(model);
+    prepareShaderParser(tShader, EShLangFragment, version, optimization);
     EShMessages msg = glslangFlagsFromTargetApi(targetApi);
     bool ok = tShader.parse(&DefaultTBuiltInResource, version, false, msg);
     if (!ok) {
@@ -102,7 +105,8 @@ bool GLSLTools::analyzeFragmentShader(const std::string& shaderCode, ShaderModel
 }
 
 bool GLSLTools::analyzeVertexShader(const std::string& shaderCode, ShaderModel model,
-        MaterialBuilder::TargetApi targetApi) const noexcept {
+        MaterialBuilder::TargetApi targetApi,
+        MaterialBuilder::Optimization optimization) const noexcept {
 
     // Parse to check syntax and semantic.
     const char* shaderCString = shaderCode.c_str();
@@ -112,6 +116,7 @@ bool GLSLTools::analyzeVertexShader(const std::string& shaderCode, ShaderModel m
 
     GLSLangCleaner cleaner;
     int version = glslangVersionFromShaderModel(model);
+    prepareShaderParser(tShader, EShLangVertex, version, optimization);
     EShMessages msg = glslangFlagsFromTargetApi(targetApi);
     bool ok = tShader.parse(&DefaultTBuiltInResource, version, false, msg);
     if (!ok) {
@@ -135,6 +140,10 @@ bool GLSLTools::analyzeVertexShader(const std::string& shaderCode, ShaderModel m
 void GLSLTools::init() {
     // Each call to InitializeProcess must be matched with a call to FinalizeProcess.
     InitializeProcess();
+
+    // The SPIR-V remapper initializes its opcode tables lazily, which isn't thread-safe. Do it
+    // now, since shaders can be compiled from several threads.
+    spv::Parameterize();
 }
 
 void GLSLTools::shutdown() {
@@ -143,7 +152,8 @@ void GLSLTools::shutdown() {
 
 bool GLSLTools::findProperties(const filamat::MaterialBuilder& builderIn,
         MaterialBuilder::PropertyList& properties,
-        MaterialBuilder::TargetApi targetApi) const noexcept {
+        MaterialBuilder::TargetApi targetApi,
+        MaterialBuilder::Optimization optimization) const noexcept {
     filamat::MaterialBuilder builder(builderIn);
 
     // Some fields in MaterialInputs only exist if the property is set (e.g: normal, subsurface
@@ -161,6 +171,7 @@ bool GLSLTools::findProperties(const filamat::MaterialBuilder& builderIn,
 
     GLSLangCleaner cleaner;
     int version = glslangVersionFromShaderModel(model);
+    prepareShaderParser(tShader, EShLangFragment, version, optimization);
     EShMessages msg = glslangFlagsFromTargetApi(targetApi);
     const TBuiltInResource* builtins = &DefaultTBuiltInResource;
     bool ok = tShader.parse(builtins, version, false, msg);
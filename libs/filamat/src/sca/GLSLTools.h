@@ -120,13 +120,19 @@ public:
     // The shader features a material() function AND
     // The shader features a prepareMaterial() function AND
     // prepareMaterial() is called at some point in material() call chain.
+    // The optimization level must be the one the shader was generated for, it decides whether the
+    // shader is parsed for SPIR-V generation (e.g. it can declare specialization constants).
     bool analyzeFragmentShader(const std::string& shaderCode,
             filament::driver::ShaderModel model,
-            filamat::MaterialBuilder::TargetApi targetApi) const noexcept;
+            filamat::MaterialBuilder::TargetApi targetApi,
+            filamat::MaterialBuilder::Optimization optimization =
+                    MaterialBuilder::Optimization::NONE) const noexcept;
 
     bool analyzeVertexShader(const std::string& shaderCode,
             filament::driver::ShaderModel model,
-            filamat::MaterialBuilder::TargetApi targetApi) const noexcept;
+            filamat::MaterialBuilder::TargetApi targetApi,
+            filamat::MaterialBuilder::Optimization optimization =
+                    MaterialBuilder::Optimization::NONE) const noexcept;
 
     // Public for unit tests.
     using Property = filamat::MaterialBuilder::Property;
@@ -134,7 +140,9 @@ public:
     // glgl code. Populate properties accordingly.
     bool findProperties(const filamat::MaterialBuilder& builder,
             MaterialBuilder::PropertyList& properties,
-            MaterialBuilder::TargetApi targetApi = MaterialBuilder::TargetApi::OPENGL) const noexcept;
+            MaterialBuilder::TargetApi targetApi = MaterialBuilder::TargetApi::OPENGL,
+            MaterialBuilder::Optimization optimization =
+                    MaterialBuilder::Optimization::NONE) const noexcept;
 
     static int glslangVersionFromShaderModel(filament::driver::ShaderModel model);
 
@@ -20,6 +20,7 @@
 
 #include <cctype>
 #include <iomanip>
+#include <sstream>
 
 namespace filamat {
 
@@ -350,6 +351,100 @@ void CodeGenerator::fixupExternalSamplers(
     }
 }
 
+static const char* getConstantTypeName(ConstantType type) noexcept {
+    switch (type) {
+        case ConstantType::INT:  return "int";
+        case ConstantType::BOOL: return "bool";
+    }
+}
+
+static std::string getConstantValue(ConstantType type, int32_t value) noexcept {
+    if (type == ConstantType::BOOL) {
+        return value ? "true" : "false";
+    }
+    return std::to_string(value);
+}
+
+std::string CodeGenerator::getConstantMacroName(size_t id) noexcept {
+    // this is the name spirv-cross uses for the same purpose
+    return "SPIRV_CROSS_CONSTANT_ID_" + std::to_string(id);
+}
+
+static void generateConstantMacro(std::ostream& out, std::string const& macro,
+        std::string const& defaultValue) {
+    out << "#ifndef " << macro << "\n";
+    out << "#define " << macro << " " << defaultValue << "\n";
+    out << "#endif\n";
+}
+
+std::ostream& CodeGenerator::generateConstants(std::ostream& out,
+        MaterialBuilder::ConstantList const& constants) const {
+    if (constants.empty()) {
+        return out;
+    }
+    out << "\n";
+    for (size_t i = 0, c = constants.size(); i < c; i++) {
+        auto const& constant = constants[i];
+        const char* typeName = getConstantTypeName(constant.type);
+        std::string value = getConstantValue(constant.type, constant.defaultValue);
+        if (mCodeGenTargetApi == TargetApi::VULKAN) {
+            out << "layout (constant_id = " << i << ") const " << typeName << " "
+                    << constant.name.c_str() << " = " << value << ";\n";
+        } else {
+            // OpenGL doesn't have specialization constants, they're emulated with macros that
+            // the driver defines when it compiles the program.
+            std::string macro = getConstantMacroName(i);
+            generateConstantMacro(out, macro, value);
+            out << "const " << typeName << " " << constant.name.c_str() << " = " << macro << ";\n";
+        }
+    }
+    return out;
+}
+
+void CodeGenerator::fixupSpecializationConstants(
+        std::string& shader, MaterialBuilder::ConstantList const& constants) noexcept {
+    if (constants.empty()) {
+        return;
+    }
+
+    std::string defines;
+    for (size_t i = 0, c = constants.size(); i < c; i++) {
+        std::string macro = getConstantMacroName(i);
+        if (shader.find("#define " + macro) != std::string::npos) {
+            // the shader was not modified
+            continue;
+        }
+
+        // A preprocessed shader declares the constant with its default value, use the macro
+        // instead. An optimized shader already refers to the macro (see GLSLPostProcessor).
+        auto const& constant = constants[i];
+        std::string declaration = std::string("const ") +
+                getConstantTypeName(constant.type) + " " + constant.name.c_str() + " =";
+        size_t index = shader.find(declaration);
+        if (index != std::string::npos) {
+            index += declaration.size();
+            size_t end = shader.find(';', index);
+            if (end != std::string::npos) {
+                shader.replace(index, end - index, " " + macro);
+            }
+        }
+        if (shader.find(macro) == std::string::npos) {
+            // the constant isn't used by this shader
+            continue;
+        }
+
+        std::ostringstream out;
+        generateConstantMacro(out,
+                macro, getConstantValue(constant.type, constant.defaultValue));
+        defines += out.str();
+    }
+
+    if (!defines.empty()) {
+        // the macros must be defined before they're used, right after the #version line
+        size_t index = shader.find('\n', shader.find("#version"));
+        shader.insert(index == std::string::npos ? shader.size() : index + 1, defines);
+    }
+}
 
 std::ostream& CodeGenerator::generateDefine(std::ostream& out, const char* name, bool value) const {
     if (value) {
@@ -79,6 +79,10 @@ public:
     std::ostream& generateVariable(std::ostream& out, ShaderType type,
             const utils::CString& name, size_t index) const;
 
+    // generate declarations for specialization constants
+    std::ostream& generateConstants(std::ostream& out,
+            MaterialBuilder::ConstantList const& constants) const;
+
     // generate declarations for non-custom "in" variables
     std::ostream& generateShaderInputs(std::ostream& out, ShaderType type,
         const filament::AttributeBitset& attributes, filament::Interpolation interpolation) const;
@@ -112,6 +116,13 @@ public:
     static void fixupExternalSamplers(
             std::string& shader, filament::SamplerInterfaceBlock const& sib) noexcept;
 
+    // restores the macros emulating specialization constants in OpenGL shaders
+    static void fixupSpecializationConstants(
+            std::string& shader, MaterialBuilder::ConstantList const& constants) noexcept;
+
+    // name of the macro emulating the specialization constant of the given id in OpenGL
+    static std::string getConstantMacroName(size_t id) noexcept;
+
 private:
     filament::driver::Precision getDefaultPrecision(ShaderType type) const;
     filament::driver::Precision getDefaultUniformPrecision() const;
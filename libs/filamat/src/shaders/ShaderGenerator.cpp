@@ -120,8 +120,10 @@ static void appendShader(std::stringstream& ss,
 ShaderGenerator::ShaderGenerator(
         MaterialBuilder::PropertyList const& properties,
         MaterialBuilder::VariableList const& variables,
+        MaterialBuilder::ConstantList const& constants,
         utils::CString const& materialCode, size_t lineOffset,
-        utils::CString const& materialVertexCode, size_t vertexLineOffset) noexcept {
+        utils::CString const& materialVertexCode, size_t vertexLineOffset) noexcept
+        : mConstants(constants) {
 
     std::copy(std::begin(properties), std::end(properties), std::begin(mProperties));
     std::copy(std::begin(variables), std::end(variables), std::begin(mVariables));
@@ -177,6 +179,9 @@ const std::string ShaderGenerator::createVertexProgram(filament::driver::ShaderM
         cg.generateVariable(vs, ShaderType::VERTEX, variable, variableIndex++);
     }
 
+    // specialization constants
+    cg.generateConstants(vs, mConstants);
+
     // materials defines
     generateVertexDomain(cg, vs, vertexDomain);
 
@@ -291,6 +296,9 @@ const std::string ShaderGenerator::createFragmentProgram(filament::driver::Shade
         cg.generateVariable(fs, ShaderType::FRAGMENT, variable, variableIndex++);
     }
 
+    // specialization constants
+    cg.generateConstants(fs, mConstants);
+
     // uniforms and samplers
     cg.generateUniforms(fs, ShaderType::FRAGMENT,
             BindingPoints::PER_VIEW, UibGenerator::getPerViewUib());
@@ -350,6 +358,10 @@ void ShaderGenerator::fixupExternalSamplers(filament::driver::ShaderModel sm,
     }
 }
 
+void ShaderGenerator::fixupSpecializationConstants(std::string& shader) const noexcept {
+    CodeGenerator::fixupSpecializationConstants(shader, mConstants);
+}
+
 const std::string ShaderPostProcessGenerator::createPostProcessVertexProgram(
         filament::driver::ShaderModel sm, MaterialBuilder::TargetApi targetApi,
         MaterialBuilder::TargetApi codeGenTargetApi, filament::PostProcessStage variant,
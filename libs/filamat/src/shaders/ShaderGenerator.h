@@ -37,6 +37,7 @@ public:
     ShaderGenerator(
             MaterialBuilder::PropertyList const& properties,
             MaterialBuilder::VariableList const& variables,
+            MaterialBuilder::ConstantList const& constants,
             utils::CString const& materialCode,
             size_t lineOffset,
             utils::CString const& materialVertexCode,
@@ -64,9 +65,17 @@ public:
     void fixupExternalSamplers(filament::driver::ShaderModel sm, std::string& shader,
             MaterialInfo const& material) const noexcept;
 
+    /**
+     * Specialization constants are emulated with macros in OpenGL. When a shader is optimized,
+     * or preprocessed, the macros are replaced by the constants' default values. This fixup step
+     * restores the macros, so that the driver can still set the constants.
+     */
+    void fixupSpecializationConstants(std::string& shader) const noexcept;
+
 private:
     MaterialBuilder::PropertyList mProperties;
     MaterialBuilder::VariableList mVariables;
+    MaterialBuilder::ConstantList mConstants;
     utils::CString mMaterialCode;
     utils::CString mMaterialVertexCode;
     size_t mMaterialLineOffset;
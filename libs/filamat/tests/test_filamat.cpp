@@ -16,9 +16,48 @@
 
 #include <gtest/gtest.h>
 
+#include "eiff/BlobDictionary.h"
+#include "eiff/ChunkContainer.h"
+#include "eiff/DictionarySpirvChunk.h"
+#include "eiff/Flattener.h"
+#include "eiff/MaterialSpirvChunk.h"
 #include "sca/ASTHelpers.h"
+#include "shaders/CodeGenerator.h"
 
 #include <filamat/Enums.h>
+#include <filamat/ShaderCache.h>
+
+#include <filaflat/BlobDictionary.h>
+#include <filaflat/ChunkContainer.h>
+#include <filaflat/MaterialChunk.h>
+#include <filaflat/ShaderBuilder.h>
+#include <filaflat/SpirvDictionaryReader.h>
+#include <filaflat/TextDictionaryReader.h>
+#include <filaflat/Unflattener.h>
+
+#include <filament/MaterialChunkType.h>
+
+#include <private/filament/Lz4.h>
+#include <private/filament/Variant.h>
+
+#include <utils/JobSystem.h>
+#include <utils/Path.h>
+
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <string.h>
+
+#if defined(WIN32)
+#   include <process.h>
+#   define getpid _getpid
+#else
+#   include <unistd.h>
+#endif
 
 using namespace ASTUtils;
 
@@ -35,6 +74,22 @@ static ::testing::AssertionResult PropertyListsMatch(const MaterialBuilder::Prop
     return ::testing::AssertionSuccess();
 }
 
+static void removeTestDirectory(utils::Path const& directory) {
+    for (utils::Path& file : directory.listContents()) {
+        file.unlinkFile();
+    }
+    std::remove(directory.c_str());
+}
+
+// Returns a directory in the current directory that's unique to this process, after deleting
+// anything a previous run left in it.
+static utils::Path makeTestDirectory(const char* name) {
+    utils::Path directory = utils::Path::getCurrentDirectory().concat(
+            std::string(name) + "_" + std::to_string(getpid()));
+    removeTestDirectory(directory);
+    return directory;
+}
+
 filamat::MaterialBuilder makeBuilder(const std::string shaderCode) {
     filamat::MaterialBuilder builder;
     builder.material(shaderCode.c_str());
@@ -518,6 +573,603 @@ TEST_F(MaterialCompiler, Uv0AndUv1) {
     EXPECT_TRUE(result.isValid());
 }
 
+TEST_F(MaterialCompiler, ParallelBuildIsDeterministic) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = vec4(0.8);
+        }
+    )");
+
+    auto build = [&shaderCode](utils::JobSystem* js) {
+        filamat::MaterialBuilder builder = makeBuilder(shaderCode);
+        builder.targetApi(filamat::MaterialBuilder::TargetApi::ALL);
+        builder.jobSystem(js);
+        filamat::Package package = builder.build();
+        EXPECT_GT(builder.getBuildStats().shaderCount, 0u);
+        return package;
+    };
+
+    filamat::Package serial = build(nullptr);
+
+    utils::JobSystem js(4);
+    js.adopt();
+    filamat::Package parallel = build(&js);
+    js.emancipate();
+
+    EXPECT_TRUE(serial.isValid());
+    EXPECT_TRUE(parallel.isValid());
+    ASSERT_EQ(serial.getSize(), parallel.getSize());
+    EXPECT_EQ(0, memcmp(serial.getData(), parallel.getData(), serial.getSize()));
+}
+
+TEST_F(MaterialCompiler, ShaderCacheReusesShaders) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = vec4(0.8);
+        }
+    )");
+
+    utils::Path directory = makeTestDirectory("test_filamat_cache");
+    filamat::ShaderCache cache(directory.c_str());
+
+    auto build = [&shaderCode, &cache]() {
+        filamat::MaterialBuilder builder = makeBuilder(shaderCode);
+        builder.targetApi(filamat::MaterialBuilder::TargetApi::ALL);
+        builder.shaderCache(&cache);
+        filamat::Package package = builder.build();
+        return std::make_pair(std::move(package), builder.getBuildStats());
+    };
+
+    auto cold = build();
+    auto warm = build();
+
+    EXPECT_GT(cold.second.cacheMisses, 0u);
+    EXPECT_EQ(warm.second.cacheMisses, 0u);
+    EXPECT_EQ(warm.second.cacheHits, cold.second.cacheHits + cold.second.cacheMisses);
+
+    EXPECT_TRUE(cold.first.isValid());
+    EXPECT_TRUE(warm.first.isValid());
+    ASSERT_EQ(cold.first.getSize(), warm.first.getSize());
+    EXPECT_EQ(0, memcmp(cold.first.getData(), warm.first.getData(), cold.first.getSize()));
+
+    removeTestDirectory(directory);
+}
+
+// Overwrites the size of the GLSL output in a shader cache file.
+static void corruptShaderCacheFile(utils::Path const& path, bool huge) {
+    std::fstream file(path.getPath(), std::ios::binary | std::ios::in | std::ios::out);
+    file.seekg(0, std::ios::end);
+    const uint64_t fileSize = uint64_t(file.tellg());
+
+    // the size of the GLSL output follows the magic, the header and the source
+    uint64_t sourceSize = 0;
+    file.seekg(4 + 12);
+    file.read(reinterpret_cast<char*>(&sourceSize), sizeof(sourceSize));
+    const uint64_t offset = 4 + 12 + sizeof(sourceSize) + sourceSize;
+
+    // either absurdly large, or one byte more than what's left in the file
+    const uint64_t size = huge ? ~0ull : fileSize - offset - sizeof(uint64_t) + 1;
+    file.seekp(offset);
+    file.write(reinterpret_cast<const char*>(&size), sizeof(size));
+}
+
+TEST_F(MaterialCompiler, ShaderCacheIgnoresCorruptedFiles) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = vec4(0.8);
+        }
+    )");
+
+    utils::Path directory = makeTestDirectory("test_filamat_corrupted_cache");
+    filamat::ShaderCache cache(directory.c_str());
+
+    auto build = [&shaderCode, &cache]() {
+        filamat::MaterialBuilder builder = makeBuilder(shaderCode);
+        builder.targetApi(filamat::MaterialBuilder::TargetApi::OPENGL);
+        builder.shaderCache(&cache);
+        filamat::Package package = builder.build();
+        return std::make_pair(std::move(package), builder.getBuildStats());
+    };
+
+    auto cold = build();
+    EXPECT_GT(cold.second.cacheMisses, 0u);
+
+    // the corrupted entries are compiled again, which rewrites them
+    for (bool huge : { true, false }) {
+        for (utils::Path const& file : directory.listContents()) {
+            corruptShaderCacheFile(file, huge);
+        }
+        auto corrupted = build();
+        EXPECT_EQ(0u, corrupted.second.cacheHits);
+        EXPECT_EQ(cold.second.cacheHits + cold.second.cacheMisses, corrupted.second.cacheMisses);
+        ASSERT_EQ(cold.first.getSize(), corrupted.first.getSize());
+        EXPECT_EQ(0, memcmp(cold.first.getData(), corrupted.first.getData(),
+                cold.first.getSize()));
+    }
+
+    removeTestDirectory(directory);
+}
+
+TEST_F(MaterialCompiler, CompressionShrinksPackage) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = vec4(0.8);
+        }
+    )");
+
+    auto build = [&shaderCode](bool compression) {
+        filamat::MaterialBuilder builder = makeBuilder(shaderCode);
+        builder.targetApi(filamat::MaterialBuilder::TargetApi::ALL);
+        builder.compression(compression);
+        return builder.build();
+    };
+
+    filamat::Package raw = build(false);
+    filamat::Package compressed = build(true);
+
+    EXPECT_TRUE(raw.isValid());
+    EXPECT_TRUE(compressed.isValid());
+    EXPECT_LT(compressed.getSize(), raw.getSize());
+
+    // compression is deterministic
+    filamat::Package again = build(true);
+    ASSERT_EQ(compressed.getSize(), again.getSize());
+    EXPECT_EQ(0, memcmp(compressed.getData(), again.getData(), compressed.getSize()));
+}
+
+// Decodes all the GLSL shaders of a package, in a fixed order.
+static std::vector<std::string> decodeGlslShaders(filaflat::ChunkContainer const& container) {
+    using namespace filamat;
+    std::vector<std::string> shaders;
+    filaflat::BlobDictionary dictionary;
+    if (!filaflat::TextDictionaryReader::unflatten(container, dictionary,
+            ChunkType::DictionaryGlsl)) {
+        return shaders;
+    }
+    filaflat::Unflattener unflattener(container.getChunkStart(ChunkType::MaterialGlsl),
+            container.getChunkEnd(ChunkType::MaterialGlsl));
+    filaflat::MaterialChunk chunk;
+    if (!chunk.initialize(unflattener)) {
+        return shaders;
+    }
+    filaflat::ShaderBuilder builder;
+    for (uint8_t model = 1; model <= 2; model++) {
+        for (uint8_t variant = 0; variant < filament::VARIANT_COUNT; variant++) {
+            for (uint8_t stage = 0; stage <= 1; stage++) {
+                if (chunk.hasShader(model, variant, stage)) {
+                    builder.reset();
+                    EXPECT_TRUE(chunk.getTextShader(unflattener, dictionary, builder,
+                            model, variant, stage));
+                    shaders.emplace_back(builder.c_str(), builder.size());
+                }
+            }
+        }
+    }
+    return shaders;
+}
+
+TEST_F(MaterialCompiler, CompressedPackageParsesBack) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = vec4(0.8);
+        }
+    )");
+
+    auto build = [&shaderCode](bool compression) {
+        filamat::MaterialBuilder builder = makeBuilder(shaderCode);
+        builder.targetApi(filamat::MaterialBuilder::TargetApi::ALL);
+        builder.compression(compression);
+        return builder.build();
+    };
+
+    filamat::Package raw = build(false);
+    filamat::Package compressed = build(true);
+
+    filaflat::ChunkContainer rawContainer(raw.getData(), raw.getSize());
+    filaflat::ChunkContainer compressedContainer(compressed.getData(), compressed.getSize());
+    ASSERT_TRUE(rawContainer.parse());
+    ASSERT_TRUE(compressedContainer.parse());
+
+    // once expanded, the compressed package has the same chunks as the raw one
+    ASSERT_EQ(rawContainer.getChunkCount(), compressedContainer.getChunkCount());
+    size_t compressedChunks = 0;
+    for (size_t i = 0; i < rawContainer.getChunkCount(); i++) {
+        const filaflat::ChunkContainer::Chunk chunk = rawContainer.getChunk(i);
+        ASSERT_TRUE(compressedContainer.hasChunk(chunk.type));
+        ASSERT_EQ(chunk.desc.size, compressedContainer.getChunkSize(chunk.type));
+        EXPECT_EQ(0, memcmp(chunk.desc.start, compressedContainer.getChunkStart(chunk.type),
+                chunk.desc.size));
+        EXPECT_EQ(0u, chunk.desc.compressedSize);
+    }
+    for (size_t i = 0; i < compressedContainer.getChunkCount(); i++) {
+        compressedChunks += compressedContainer.getChunk(i).desc.compressedSize ? 1 : 0;
+    }
+    EXPECT_GT(compressedChunks, 0u);
+
+    // and its shaders can be read
+    std::vector<std::string> rawShaders = decodeGlslShaders(rawContainer);
+    std::vector<std::string> compressedShaders = decodeGlslShaders(compressedContainer);
+    EXPECT_FALSE(rawShaders.empty());
+    EXPECT_EQ(rawShaders, compressedShaders);
+
+    // a chunk that claims to expand more than LZ4 can is rejected before anything is allocated
+    std::vector<uint8_t> bogus(compressed.getData(), compressed.getData() + compressed.getSize());
+    bool patched = false;
+    for (size_t i = 0; i + 12 <= bogus.size() && !patched;) {
+        uint64_t type;
+        uint32_t size;
+        memcpy(&type, bogus.data() + i, sizeof(type));
+        memcpy(&size, bogus.data() + i + 8, sizeof(size));
+        if (type == filamat::ChunkType::Compressed) {
+            // the uncompressed size follows the wrapped chunk's type and codec
+            const uint32_t huge = 0xFFFFFFFFu;
+            memcpy(bogus.data() + i + 12 + 9, &huge, sizeof(huge));
+            patched = true;
+        }
+        i += 12 + size;
+    }
+    ASSERT_TRUE(patched);
+    filaflat::ChunkContainer bogusContainer(bogus.data(), bogus.size());
+    EXPECT_FALSE(bogusContainer.parse());
+}
+
+// Decodes all the SPIR-V shaders of a package, and returns where each one belongs.
+static std::vector<std::string> decodeSpirvShaders(filaflat::ChunkContainer const& container,
+        std::vector<filamat::SpirvEntry>& entries) {
+    using namespace filamat;
+    std::vector<std::string> shaders;
+    filaflat::BlobDictionary dictionary;
+    if (!filaflat::SpirvDictionaryReader::unflatten(container, dictionary,
+            ChunkType::DictionarySpirv)) {
+        return shaders;
+    }
+    filaflat::Unflattener unflattener(container.getChunkStart(ChunkType::MaterialSpirv),
+            container.getChunkEnd(ChunkType::MaterialSpirv));
+    filaflat::MaterialChunk chunk;
+    if (!chunk.initialize(unflattener)) {
+        return shaders;
+    }
+    filaflat::ShaderBuilder builder;
+    for (uint8_t model = 1; model <= 2; model++) {
+        for (uint8_t variant = 0; variant < filament::VARIANT_COUNT; variant++) {
+            for (uint8_t stage = 0; stage <= 1; stage++) {
+                if (chunk.hasShader(model, variant, stage)) {
+                    EXPECT_TRUE(chunk.getSpirvShader(unflattener, dictionary, builder,
+                            model, variant, stage));
+                    shaders.emplace_back(builder.c_str(), builder.size());
+                    entries.push_back({ model, variant, stage, 0 });
+                }
+            }
+        }
+    }
+    return shaders;
+}
+
+// Returns how many blobs of a SPIR-V dictionary are stored as a delta of another blob.
+static size_t countSpirvDeltas(filaflat::ChunkContainer const& container) {
+    filaflat::BlobDictionary dictionary;
+    if (!filaflat::SpirvDictionaryReader::unflatten(container, dictionary,
+            filamat::ChunkType::DictionarySpirv)) {
+        return 0;
+    }
+    size_t count = 0;
+    for (size_t i = 0; i < dictionary.getBlobCount(); i++) {
+        size_t size;
+        const char* blob = dictionary.getBlob(i, &size);
+        uint32_t reference = filamat::DictionarySpirvChunk::NO_REFERENCE;
+        if (size >= sizeof(reference)) {
+            memcpy(&reference, blob, sizeof(reference));
+        }
+        count += reference != filamat::DictionarySpirvChunk::NO_REFERENCE ? 1 : 0;
+    }
+    return count;
+}
+
+TEST_F(MaterialCompiler, SpirvVariantsDecodeIdentically) {
+    // a lit material has many variants, most of them are stored as deltas of others
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = vec4(0.8);
+        }
+    )");
+    filamat::MaterialBuilder builder = makeBuilder(shaderCode);
+    builder.targetApi(filamat::MaterialBuilder::TargetApi::VULKAN);
+    filamat::Package package = builder.build();
+    ASSERT_TRUE(package.isValid());
+
+    filaflat::ChunkContainer container(package.getData(), package.getSize());
+    ASSERT_TRUE(container.parse());
+    EXPECT_GT(countSpirvDeltas(container), 0u);
+
+    std::vector<filamat::SpirvEntry> entries;
+    std::vector<std::string> shaders = decodeSpirvShaders(container, entries);
+    ASSERT_GT(shaders.size(), 2u);
+    for (std::string const& shader : shaders) {
+        uint32_t magic = 0;
+        ASSERT_GE(shader.size(), sizeof(magic));
+        memcpy(&magic, shader.data(), sizeof(magic));
+        EXPECT_EQ(0x07230203u, magic);
+    }
+
+    // Store the decoded shaders again, debug info is already stripped so they must decode to
+    // exactly the same SPIR-V, whether or not they're stored as a delta.
+    filamat::BlobDictionary dictionary;
+    for (size_t i = 0; i < shaders.size(); i++) {
+        std::vector<uint32_t> words(shaders[i].size() / sizeof(uint32_t));
+        memcpy(words.data(), shaders[i].data(), words.size() * sizeof(uint32_t));
+        entries[i].dictionaryIndex = dictionary.addBlob(words);
+    }
+    filamat::DictionarySpirvChunk dictionaryChunk(dictionary);
+    filamat::MaterialSpirvChunk materialChunk(entries);
+    filamat::ChunkContainer chunks;
+    chunks.addChild(&dictionaryChunk);
+    chunks.addChild(&materialChunk);
+    filamat::Package repacked(chunks.getSize());
+    filamat::Flattener flattener(repacked);
+    chunks.flatten(flattener);
+
+    filaflat::ChunkContainer reparsed(repacked.getData(), repacked.getSize());
+    ASSERT_TRUE(reparsed.parse());
+    EXPECT_GT(countSpirvDeltas(reparsed), 0u);
+
+    std::vector<filamat::SpirvEntry> reparsedEntries;
+    std::vector<std::string> reparsedShaders = decodeSpirvShaders(reparsed, reparsedEntries);
+    ASSERT_EQ(shaders.size(), reparsedShaders.size());
+    for (size_t i = 0; i < shaders.size(); i++) {
+        EXPECT_EQ(shaders[i], reparsedShaders[i]) << "variant " << int(entries[i].variant)
+                << ", stage " << int(entries[i].stage);
+    }
+}
+
+static ::testing::AssertionResult Lz4RoundTrips(std::vector<uint8_t> const& data) {
+    std::vector<uint8_t> compressed(filament::lz4::compressBound(data.size()));
+    const size_t size = filament::lz4::compress(data.data(), data.size(),
+            compressed.data(), compressed.size());
+    if (size == 0) {
+        return ::testing::AssertionFailure() << data.size() << " bytes didn't compress";
+    }
+    if (data.size() > filament::lz4::decompressBound(size)) {
+        return ::testing::AssertionFailure() << data.size() << " bytes exceed decompressBound()";
+    }
+    std::vector<uint8_t> decompressed(data.size());
+    if (!filament::lz4::decompress(compressed.data(), size,
+            decompressed.data(), decompressed.size())) {
+        return ::testing::AssertionFailure() << data.size() << " bytes didn't decompress";
+    }
+    if (decompressed != data) {
+        return ::testing::AssertionFailure() << data.size() << " bytes didn't round-trip";
+    }
+    return ::testing::AssertionSuccess();
+}
+
+static std::vector<uint8_t> makeText(size_t size) {
+    const char text[] = "void main() { gl_Position = getPosition(); } ";
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < size; i++) {
+        data[i] = uint8_t(text[i % (sizeof(text) - 1)]);
+    }
+    return data;
+}
+
+TEST(Lz4, RoundTripsSmallBlocks) {
+    // blocks under 12 bytes are stored as literals only
+    for (size_t size : { 0, 1, 2, 4, 5, 11, 12, 13, 16 }) {
+        EXPECT_TRUE(Lz4RoundTrips(makeText(size)));
+        EXPECT_TRUE(Lz4RoundTrips(std::vector<uint8_t>(size, 'a')));
+    }
+}
+
+TEST(Lz4, RoundTrips64KiB) {
+    // exactly the largest match offset
+    std::vector<uint8_t> data = makeText(65536);
+    EXPECT_TRUE(Lz4RoundTrips(data));
+    std::vector<uint8_t> compressed(filament::lz4::compressBound(data.size()));
+    EXPECT_LT(filament::lz4::compress(data.data(), data.size(),
+            compressed.data(), compressed.size()), data.size() / 10);
+
+    EXPECT_TRUE(Lz4RoundTrips(std::vector<uint8_t>(65536, 0)));
+    EXPECT_TRUE(Lz4RoundTrips(makeText(65537)));
+}
+
+TEST(Lz4, RoundTripsIncompressibleData) {
+    std::mt19937 generator(1234);
+    std::vector<uint8_t> data(100000);
+    for (uint8_t& byte : data) {
+        byte = uint8_t(generator());
+    }
+    EXPECT_TRUE(Lz4RoundTrips(data));
+
+    // the output is larger than the input, but within compressBound()
+    std::vector<uint8_t> compressed(filament::lz4::compressBound(data.size()));
+    const size_t size = filament::lz4::compress(data.data(), data.size(),
+            compressed.data(), compressed.size());
+    EXPECT_GE(size, data.size());
+    EXPECT_LE(size, filament::lz4::compressBound(data.size()));
+
+    // it doesn't fit in a buffer the size of the input
+    EXPECT_EQ(0u, filament::lz4::compress(data.data(), data.size(),
+            compressed.data(), data.size()));
+}
+
+TEST(Lz4, RejectsWrongSizes) {
+    std::vector<uint8_t> data = makeText(1000);
+    std::vector<uint8_t> compressed(filament::lz4::compressBound(data.size()));
+    const size_t size = filament::lz4::compress(data.data(), data.size(),
+            compressed.data(), compressed.size());
+    std::vector<uint8_t> decompressed(data.size() + 1);
+    EXPECT_FALSE(filament::lz4::decompress(compressed.data(), size,
+            decompressed.data(), data.size() - 1));
+    EXPECT_FALSE(filament::lz4::decompress(compressed.data(), size,
+            decompressed.data(), data.size() + 1));
+    EXPECT_FALSE(filament::lz4::decompress(compressed.data(), size - 1,
+            decompressed.data(), data.size()));
+}
+
+TEST(Lz4, CompressorReusesItsState) {
+    // blocks compressed one after the other against different dictionaries, the matches found
+    // in previous calls must never be used
+    std::mt19937 generator(5678);
+    std::vector<uint8_t> noise(4000);
+    for (uint8_t& byte : noise) {
+        byte = uint8_t(generator());
+    }
+    std::vector<uint8_t> data = makeText(3000);
+    std::vector<uint8_t> dictionaries[] = { makeText(2000), noise, {}, makeText(100000), noise };
+
+    filament::lz4::Compressor compressor;
+    for (int pass = 0; pass < 2; pass++) {
+        for (std::vector<uint8_t> const& dict : dictionaries) {
+            std::vector<uint8_t> compressed(filament::lz4::compressBound(data.size()));
+            const size_t size = compressor.compress(data.data(), data.size(),
+                    compressed.data(), compressed.size(), dict.data(), dict.size());
+            ASSERT_GT(size, 0u);
+
+            // same output as a fresh compressor
+            std::vector<uint8_t> expected(compressed.size());
+            EXPECT_EQ(size, filament::lz4::compress(data.data(), data.size(),
+                    expected.data(), expected.size(), dict.data(), dict.size()));
+            EXPECT_EQ(0, memcmp(compressed.data(), expected.data(), size));
+
+            std::vector<uint8_t> decompressed(data.size());
+            EXPECT_TRUE(filament::lz4::decompress(compressed.data(), size,
+                    decompressed.data(), decompressed.size(), dict.data(), dict.size()));
+            EXPECT_EQ(data, decompressed);
+        }
+    }
+}
+
+TEST_F(MaterialCompiler, UsedVariantsStripsShaders) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = vec4(0.8);
+        }
+    )");
+
+    auto build = [&shaderCode](uint32_t usedVariants) {
+        filamat::MaterialBuilder builder = makeBuilder(shaderCode);
+        builder.usedVariants(usedVariants);
+        filamat::Package package = builder.build();
+        EXPECT_TRUE(package.isValid());
+        return builder.getBuildStats().shaderCount;
+    };
+
+    // by default all the variants are kept
+    const uint32_t all = build(0xFFFFFFFF);
+
+    // variant 0 needs one vertex and one fragment shader per shader model
+    const uint32_t base = build(1u << 0u);
+    EXPECT_LT(base, all);
+    EXPECT_GT(base, 0u);
+
+    // directional lighting changes both shaders
+    const uint32_t lit = build((1u << 0u) | (1u << filament::Variant::DIRECTIONAL_LIGHTING));
+    EXPECT_EQ(lit, base * 2);
+}
+
+TEST_F(MaterialCompiler, SpecializationConstants) {
+    std::string shaderCode(R"(
+        void material(inout MaterialInputs material) {
+            prepareMaterial(material);
+            material.baseColor = useTint ? vec4(0.8, 0.4, 0.4, 1.0) : vec4(0.8);
+            if (mode == 2) {
+                material.roughness = 0.2;
+            }
+        }
+    )");
+
+    using TargetApi = filamat::MaterialBuilder::TargetApi;
+    using Optimization = filamat::MaterialBuilder::Optimization;
+    using ConstantType = filamat::MaterialBuilder::ConstantType;
+    for (auto optimization : { Optimization::NONE, Optimization::PERFORMANCE }) {
+        filamat::MaterialBuilder builder = makeBuilder(shaderCode);
+        builder.targetApi(TargetApi::ALL)
+                .optimization(optimization)
+                .constant(ConstantType::BOOL, "useTint", true)
+                .constant(ConstantType::INT, "mode", 2);
+        filamat::Package package = builder.build();
+        ASSERT_TRUE(package.isValid());
+
+        filaflat::ChunkContainer container(package.getData(), package.getSize());
+        ASSERT_TRUE(container.parse());
+
+        // the constants are declared in the order they were added, with their default values
+        ASSERT_TRUE(container.hasChunk(filamat::ChunkType::MaterialConstants));
+        filaflat::Unflattener unflattener(
+                container.getChunkStart(filamat::ChunkType::MaterialConstants),
+                container.getChunkEnd(filamat::ChunkType::MaterialConstants));
+        uint64_t numConstants = 0;
+        ASSERT_TRUE(unflattener.read(&numConstants));
+        ASSERT_EQ(2u, numConstants);
+        struct { const char* name; ConstantType type; uint32_t value; } expected[] = {
+                { "useTint", ConstantType::BOOL, 1 },
+                { "mode",    ConstantType::INT,  2 },
+        };
+        for (auto const& constant : expected) {
+            utils::CString name;
+            uint8_t type = 0;
+            uint32_t value = 0;
+            ASSERT_TRUE(unflattener.read(&name));
+            ASSERT_TRUE(unflattener.read(&type));
+            ASSERT_TRUE(unflattener.read(&value));
+            EXPECT_STREQ(constant.name, name.c_str());
+            EXPECT_EQ(uint8_t(constant.type), type);
+            EXPECT_EQ(constant.value, value);
+        }
+
+        // the GLSL shaders refer to the specialization macros instead of the default values
+        std::vector<std::string> shaders = decodeGlslShaders(container);
+        ASSERT_FALSE(shaders.empty());
+        bool usesUseTint = false;
+        bool usesMode = false;
+        for (auto const& shader : shaders) {
+            EXPECT_EQ(std::string::npos, shader.find("const bool useTint = true;"));
+            EXPECT_EQ(std::string::npos, shader.find("const int mode = 2;"));
+            usesUseTint |= shader.find("SPIRV_CROSS_CONSTANT_ID_0") != std::string::npos;
+            usesMode |= shader.find("SPIRV_CROSS_CONSTANT_ID_1") != std::string::npos;
+        }
+        EXPECT_TRUE(usesUseTint);
+        EXPECT_TRUE(usesMode);
+    }
+}
+
+TEST(CodeGenerator, FixupSpecializationConstants) {
+    using ConstantType = filamat::MaterialBuilder::ConstantType;
+    filamat::MaterialBuilder::ConstantList constants;
+    constants.push_back({ utils::CString("useTint"), ConstantType::BOOL, 1 });
+    constants.push_back({ utils::CString("mode"), ConstantType::INT, 2 });
+    constants.push_back({ utils::CString("unused"), ConstantType::INT, 0 });
+
+    // preprocessed shader, the declarations have the default values
+    std::string preprocessed("#version 300 es\nconst bool useTint = true;\nconst int mode = 2;\n");
+    CodeGenerator::fixupSpecializationConstants(preprocessed, constants);
+    EXPECT_EQ(preprocessed,
+            "#version 300 es\n"
+            "#ifndef SPIRV_CROSS_CONSTANT_ID_0\n#define SPIRV_CROSS_CONSTANT_ID_0 true\n#endif\n"
+            "#ifndef SPIRV_CROSS_CONSTANT_ID_1\n#define SPIRV_CROSS_CONSTANT_ID_1 2\n#endif\n"
+            "const bool useTint = SPIRV_CROSS_CONSTANT_ID_0;\n"
+            "const int mode = SPIRV_CROSS_CONSTANT_ID_1;\n");
+
+    // optimized shader, the macros are used directly
+    std::string optimized("#version 300 es\nvoid main() { if (SPIRV_CROSS_CONSTANT_ID_1 == 1) {} }\n");
+    CodeGenerator::fixupSpecializationConstants(optimized, constants);
+    EXPECT_EQ(optimized,
+            "#version 300 es\n"
+            "#ifndef SPIRV_CROSS_CONSTANT_ID_1\n#define SPIRV_CROSS_CONSTANT_ID_1 2\n#endif\n"
+            "void main() { if (SPIRV_CROSS_CONSTANT_ID_1 == 1) {} }\n");
+
+    // the macros are already defined
+    std::string source(preprocessed);
+    CodeGenerator::fixupSpecializationConstants(source, constants);
+    EXPECT_EQ(source, preprocessed);
+}
+
 int main(int argc, char** argv) {
     ::testing::InitGoogleTest(&argc, argv);
     return RUN_ALL_TESTS();
@@ -0,0 +1,390 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include "../src/AnimationSampler.h"
+#include "../src/SkinCache.h"
+#include "../src/TangentsJob.h"
+
+#include <filament/Engine.h>
+#include <filament/RenderableManager.h>
+#include <filament/TransformManager.h>
+
+#include <geometry/SurfaceOrientation.h>
+
+#include <math/mat4.h>
+#include <math/quat.h>
+#include <math/vec2.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <utils/EntityManager.h>
+#include <utils/JobSystem.h>
+
+#include <cgltf.h>
+
+#include <map>
+#include <vector>
+
+#include <math.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+using namespace filament;
+using namespace filament::math;
+using namespace gltfio;
+using namespace gltfio::details;
+using namespace utils;
+
+// A large synthetic mesh: a set of primitives that are all the same grid, with positions, normals
+// and texture coordinates interleaved in a single buffer and 32-bit indices in another one.
+class LargeMesh : public benchmark::Fixture {
+public:
+    static constexpr uint32_t PRIMITIVE_COUNT = 16;
+    static constexpr uint32_t GRID_SIZE = 256;          // 16 x 64K vertices
+    static constexpr uint32_t VERTEX_COUNT = GRID_SIZE * GRID_SIZE;
+
+    struct Vertex {
+        float3 position;
+        float3 normal;
+        float2 uv;
+    };
+
+    void SetUp(const benchmark::State&) override {
+        if (!vertices.empty()) {
+            return;
+        }
+
+        vertices.resize(VERTEX_COUNT);
+        for (uint32_t y = 0; y < GRID_SIZE; y++) {
+            for (uint32_t x = 0; x < GRID_SIZE; x++) {
+                const float2 uv = float2(x, y) / float(GRID_SIZE - 1);
+                vertices[y * GRID_SIZE + x] = {
+                    float3(uv, 0.1f * sin(uv.x * 10.0f)),
+                    normalize(float3(-cos(uv.x * 10.0f), 0.0f, 1.0f)),
+                    uv };
+            }
+        }
+        for (uint32_t y = 0; y < GRID_SIZE - 1; y++) {
+            for (uint32_t x = 0; x < GRID_SIZE - 1; x++) {
+                const uint32_t i = y * GRID_SIZE + x;
+                indices.insert(indices.end(), { i, i + 1, i + GRID_SIZE });
+                indices.insert(indices.end(), { i + 1, i + GRID_SIZE + 1, i + GRID_SIZE });
+            }
+        }
+
+        buffers[0].size = vertices.size() * sizeof(Vertex);
+        buffers[0].data = vertices.data();
+        buffers[1].size = indices.size() * sizeof(uint32_t);
+        buffers[1].data = indices.data();
+
+        views[0].buffer = &buffers[0];
+        views[0].size = buffers[0].size;
+        views[0].stride = sizeof(Vertex);
+        views[1].buffer = &buffers[1];
+        views[1].size = buffers[1].size;
+
+        initAccessor(accessors[0], views[0], cgltf_type_vec3, offsetof(Vertex, position));
+        initAccessor(accessors[1], views[0], cgltf_type_vec3, offsetof(Vertex, normal));
+        initAccessor(accessors[2], views[0], cgltf_type_vec2, offsetof(Vertex, uv));
+        accessors[3].component_type = cgltf_component_type_r_32u;
+        accessors[3].type = cgltf_type_scalar;
+        accessors[3].count = indices.size();
+        accessors[3].stride = sizeof(uint32_t);
+        accessors[3].buffer_view = &views[1];
+
+        attributes[0] = { nullptr, cgltf_attribute_type_position, 0, &accessors[0] };
+        attributes[1] = { nullptr, cgltf_attribute_type_normal, 0, &accessors[1] };
+        attributes[2] = { nullptr, cgltf_attribute_type_texcoord, 0, &accessors[2] };
+
+        primitives.resize(PRIMITIVE_COUNT);
+        for (cgltf_primitive& prim : primitives) {
+            prim.type = cgltf_primitive_type_triangles;
+            prim.indices = &accessors[3];
+            prim.attributes = attributes;
+            prim.attributes_count = 3;
+        }
+    }
+
+    std::vector<Vertex> vertices;
+    std::vector<uint32_t> indices;
+    std::vector<cgltf_primitive> primitives;
+
+private:
+    static void initAccessor(cgltf_accessor& accessor, cgltf_buffer_view& view,
+            cgltf_type type, size_t offset) {
+        accessor.component_type = cgltf_component_type_r_32f;
+        accessor.type = type;
+        accessor.offset = offset;
+        accessor.count = VERTEX_COUNT;
+        accessor.stride = view.stride;
+        accessor.buffer_view = &view;
+    }
+
+    cgltf_buffer buffers[2] = {};
+    cgltf_buffer_view views[2] = {};
+    cgltf_accessor accessors[4] = {};
+    cgltf_attribute attributes[3] = {};
+};
+
+// The primitives one after the other, reading the accessors one element at a time.
+BENCHMARK_DEFINE_F(LargeMesh, SerialPerElementReads)(benchmark::State& state) {
+    std::vector<float3> normals(VERTEX_COUNT);
+    std::vector<float3> positions(VERTEX_COUNT);
+    std::vector<float2> uvs(VERTEX_COUNT);
+    std::vector<uint3> triangles(indices.size() / 3);
+    for (auto _ : state) {
+        for (cgltf_primitive const& prim : primitives) {
+            for (cgltf_size i = 0; i < VERTEX_COUNT; ++i) {
+                cgltf_accessor_read_float(prim.attributes[0].data, i, &positions[i].x, 3);
+                cgltf_accessor_read_float(prim.attributes[1].data, i, &normals[i].x, 3);
+                cgltf_accessor_read_float(prim.attributes[2].data, i, &uvs[i].x, 2);
+            }
+            cgltf_size j = 0;
+            for (auto& triangle : triangles) {
+                triangle.x = cgltf_accessor_read_index(prim.indices, j++);
+                triangle.y = cgltf_accessor_read_index(prim.indices, j++);
+                triangle.z = cgltf_accessor_read_index(prim.indices, j++);
+            }
+            auto helper = filament::geometry::SurfaceOrientation::Builder()
+                    .vertexCount(VERTEX_COUNT)
+                    .normals(normals.data())
+                    .positions(positions.data())
+                    .uvs(uvs.data())
+                    .triangleCount(triangles.size())
+                    .triangles(triangles.data())
+                    .build();
+            short4* quats = (short4*) malloc(sizeof(short4) * VERTEX_COUNT);
+            helper.getQuats(quats, VERTEX_COUNT);
+            benchmark::DoNotOptimize(quats);
+            free(quats);
+        }
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * PRIMITIVE_COUNT * VERTEX_COUNT);
+}
+BENCHMARK_REGISTER_F(LargeMesh, SerialPerElementReads)->UseRealTime();
+
+// One job per primitive, as done by the ResourceLoader.
+BENCHMARK_DEFINE_F(LargeMesh, TangentsJobs)(benchmark::State& state) {
+    JobSystem js;
+    js.adopt();
+    std::vector<TangentsJob> tasks(PRIMITIVE_COUNT);
+    for (auto _ : state) {
+        JobSystem::Job* parent = js.createJob();
+        for (size_t i = 0; i < PRIMITIVE_COUNT; i++) {
+            TangentsJob* task = &tasks[i];
+            *task = TangentsJob();
+            task->primitive = &primitives[i];
+            js.run(jobs::createJob(js, parent, [task, &js]() { task->run(js); }));
+        }
+        js.runAndWait(parent);
+        for (TangentsJob& task : tasks) {
+            benchmark::DoNotOptimize(task.quats);
+            free(task.quats);
+        }
+    }
+    js.emancipate();
+    state.SetItemsProcessed(int64_t(state.iterations()) * PRIMITIVE_COUNT * VERTEX_COUNT);
+}
+// the work happens on the JobSystem threads, so only the real time is meaningful
+BENCHMARK_REGISTER_F(LargeMesh, TangentsJobs)->UseRealTime();
+
+// Many characters whose bones all have a translation, rotation and scale channel, sampled at 60
+// frames per second.
+class ManyAnimatedNodes : public benchmark::Fixture {
+public:
+    static constexpr uint32_t NODE_COUNT = 100 * 64;    // 100 characters with 64 bones
+    static constexpr uint32_t KEYFRAME_COUNT = 120;
+    static constexpr float DURATION = 4.0f;
+    static constexpr float FRAME_TIME = 1.0f / 60.0f;
+
+    void SetUp(const benchmark::State&) override {
+        if (!samplers.empty()) {
+            return;
+        }
+        samplers.resize(NODE_COUNT * 3);
+        for (uint32_t i = 0; i < NODE_COUNT * 3; i++) {
+            Sampler& sampler = samplers[i];
+            const uint32_t size = i % 3 == 1 ? 4 : 3;
+            sampler.interpolation = Sampler::LINEAR;
+            for (uint32_t k = 0; k < KEYFRAME_COUNT; k++) {
+                sampler.times.push_back(DURATION * k / (KEYFRAME_COUNT - 1));
+                if (size == 4) {
+                    quatf q = quatf::fromAxisAngle(float3(0, 1, 0), 0.01f * (i + k));
+                    sampler.values.insert(sampler.values.end(), { q.x, q.y, q.z, q.w });
+                } else {
+                    sampler.values.insert(sampler.values.end(), { 1.0f, 0.01f * k, 0.0f });
+                }
+            }
+        }
+        transforms.resize(NODE_COUNT);
+    }
+
+    std::vector<Sampler> samplers;      // translation, rotation and scale of each node
+    std::vector<mat4f> transforms;
+};
+
+// The previous implementation: keyframe times in a std::map searched every frame, and the transform
+// of the node decomposed and recomposed for each channel.
+BENCHMARK_F(ManyAnimatedNodes, MapAndDecompose)(benchmark::State& state) {
+    std::vector<std::map<float, size_t>> times(samplers.size());
+    for (size_t i = 0; i < samplers.size(); i++) {
+        for (size_t k = 0; k < samplers[i].times.size(); k++) {
+            times[i][samplers[i].times[k]] = k;
+        }
+    }
+    float time = 0;
+    for (auto _ : state) {
+        time = fmod(time + FRAME_TIME, DURATION);
+        for (uint32_t i = 0; i < NODE_COUNT * 3; i++) {
+            auto iter = times[i].lower_bound(time);
+            auto prevIter = iter, nextIter = iter;
+            if (iter == times[i].end()) {
+                prevIter = --times[i].end();
+                nextIter = times[i].begin();
+            } else if (iter != times[i].begin()) {
+                prevIter = --iter;
+            }
+            float interval = nextIter->first - prevIter->first;
+            Keyframes k = { prevIter->second, nextIter->second,
+                    interval == 0 ? 0.0f : (time - prevIter->first) / interval };
+
+            mat4f& xform = transforms[i / 3];
+            float3 translation, scale;
+            quatf rotation;
+            decomposeMatrix(xform, &translation, &rotation, &scale);
+            switch (i % 3) {
+                case 0: translation = sampleVec3(samplers[i], k); break;
+                case 1: rotation = sampleQuat(samplers[i], k); break;
+                case 2: scale = sampleVec3(samplers[i], k); break;
+            }
+            xform = composeMatrix(translation, rotation, scale);
+        }
+        benchmark::DoNotOptimize(transforms.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * NODE_COUNT * 3);
+}
+
+// The current implementation: flat keyframe arrays searched from a cursor, and the TRS of the nodes
+// kept in separate arrays and composed once per node.
+BENCHMARK_F(ManyAnimatedNodes, FlatArraysAndTRS)(benchmark::State& state) {
+    std::vector<size_t> cursors(samplers.size());
+    std::vector<float3> translations(NODE_COUNT);
+    std::vector<quatf> rotations(NODE_COUNT);
+    std::vector<float3> scales(NODE_COUNT);
+    float time = 0;
+    for (auto _ : state) {
+        time = fmod(time + FRAME_TIME, DURATION);
+        for (uint32_t i = 0; i < NODE_COUNT * 3; i++) {
+            Keyframes k = findKeyframes(samplers[i], time, DURATION, &cursors[i]);
+            switch (i % 3) {
+                case 0: translations[i / 3] = sampleVec3(samplers[i], k); break;
+                case 1: rotations[i / 3] = sampleQuat(samplers[i], k); break;
+                case 2: scales[i / 3] = sampleVec3(samplers[i], k); break;
+            }
+        }
+        for (uint32_t node = 0; node < NODE_COUNT; node++) {
+            transforms[node] = composeMatrix(translations[node], rotations[node], scales[node]);
+        }
+        benchmark::DoNotOptimize(transforms.data());
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * NODE_COUNT * 3);
+}
+
+// Many skinned characters, each with a root joint that has the rest of the skeleton as children and
+// a single target.
+class ManySkins : public benchmark::Fixture {
+public:
+    static constexpr uint32_t CHARACTER_COUNT = 200;
+    static constexpr uint32_t JOINT_COUNT = 64;
+
+    void SetUp(const benchmark::State&) override {
+        engine = Engine::create(Engine::Backend::NOOP);
+        TransformManager& tm = engine->getTransformManager();
+        EntityManager& em = EntityManager::get();
+        skins.resize(CHARACTER_COUNT);
+        for (uint32_t c = 0; c < CHARACTER_COUNT; c++) {
+            Skin& skin = skins[c];
+            for (uint32_t j = 0; j < JOINT_COUNT; j++) {
+                Entity joint = em.create();
+                const float3 position(j == 0 ? float(c) : 0.0f, j == 0 ? 0.0f : 0.1f * j, 0.0f);
+                tm.create(joint, j == 0 ? TransformManager::Instance() :
+                        tm.getInstance(skin.joints[0]), mat4f::translate(position));
+                skin.joints.push_back(joint);
+                skin.inverseBindMatrices.push_back(mat4f::translate(-position));
+            }
+            Entity target = em.create();
+            RenderableManager::Builder(1)
+                    .boundingBox({{ -1, -1, -1 }, { 1, 1, 1 }})
+                    .skinning(JOINT_COUNT)
+                    .build(*engine, target);
+            skin.targets.push_back(target);
+        }
+        caches.resize(CHARACTER_COUNT);
+    }
+
+    void TearDown(const benchmark::State&) override {
+        TransformManager& tm = engine->getTransformManager();
+        EntityManager& em = EntityManager::get();
+        for (Skin& skin : skins) {
+            engine->getRenderableManager().destroy(skin.targets[0]);
+            em.destroy(skin.targets[0]);
+            for (Entity joint : skin.joints) {
+                tm.destroy(joint);
+                em.destroy(joint);
+            }
+        }
+        skins.clear();
+        caches.clear();
+        Engine::destroy(&engine);
+    }
+
+    void update() {
+        updateSkins(skins.data(), caches.data(), skins.size(), engine->getRenderableManager(),
+                engine->getTransformManager(), engine->getJobSystem());
+    }
+
+    Engine* engine = nullptr;
+    std::vector<Skin> skins;
+    std::vector<SkinCache> caches;
+};
+
+// Every character walks, so all of the bone matrices are computed and uploaded.
+BENCHMARK_DEFINE_F(ManySkins, MovingSkeletons)(benchmark::State& state) {
+    TransformManager& tm = engine->getTransformManager();
+    float time = 0;
+    for (auto _ : state) {
+        time += 1.0f / 60.0f;
+        for (uint32_t c = 0; c < CHARACTER_COUNT; c++) {
+            tm.setTransform(tm.getInstance(skins[c].joints[0]),
+                    mat4f::translate(float3(c, 0, time)));
+        }
+        update();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * CHARACTER_COUNT);
+}
+BENCHMARK_REGISTER_F(ManySkins, MovingSkeletons)->UseRealTime();
+
+// No character moves, so only the joint transforms are compared and nothing is uploaded.
+BENCHMARK_DEFINE_F(ManySkins, UnchangedSkeletons)(benchmark::State& state) {
+    update();
+    for (auto _ : state) {
+        update();
+    }
+    state.SetItemsProcessed(int64_t(state.iterations()) * CHARACTER_COUNT);
+}
+BENCHMARK_REGISTER_F(ManySkins, UnchangedSkeletons)->UseRealTime();
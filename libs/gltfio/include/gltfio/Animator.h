@@ -25,6 +25,16 @@ namespace details { class FFilamentAsset; }
 
 struct AnimatorImpl;
 
+/**
+ * One of the animations mixed by Animator::applyAnimations().
+ */
+struct AnimationClip {
+    size_t animationIndex;
+    float time;                 //!< in seconds, wraps around the duration of the animation
+    float weight = 1.0f;
+    bool additive = false;      //!< adds the motion relative to the first keyframe of each channel
+};
+
 /**
  * Animator can be used for two things: (1) updating matrices in Transform components
  * according to glTF animation definitions and (2) updating bone matrices in Renderable components
@@ -42,10 +52,27 @@ public:
      */
     void applyAnimation(size_t animationIndex, float time) const;
 
+    /**
+     * Mixes several animations and applies the result, e.g. to crossfade between two animations
+     * or to add a layer of motion on top of them. The transform of each targeted entity is set
+     * only once, within a local transform transaction of the TransformManager.
+     *
+     * The clips that are not additive are blended by weight. Where the sum of their weights is
+     * less than 1, the remainder comes from the transform the entity had when the Animator was
+     * created. The additive clips are then applied on top of the result, scaled by their weight.
+     *
+     * Nothing is applied if one of the clips refers to an animation that doesn't exist.
+     */
+    void applyAnimations(const AnimationClip* clips, size_t count) const;
+
     /**
      * Uses TransformManager to compute root-to-node transforms for all bone nodes, then passes
      * the results into RenderableManager::setBones.
      *
+     * The skins are processed in parallel on the Engine's JobSystem, so this must be called from
+     * the thread that created the Engine. Only the renderables whose skeleton or transform has
+     * moved since the previous call are updated.
+     *
      * Note that this operation is actually independent of animation, but the Animator seems
      * like a reasonable place for a utility like this.
      */
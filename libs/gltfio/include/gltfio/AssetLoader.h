@@ -26,6 +26,30 @@
 
 namespace gltfio {
 
+struct AssetConfiguration {
+    filament::Engine* engine;
+    utils::NameComponentManager* names = nullptr;
+
+    // Stores float positions as half floats, and float texture coordinates as normalized shorts
+    // when they are within [-1, 1] or as half floats otherwise. This halves the size of these
+    // vertex attributes on the GPU. Positions are left as floats when the mesh is too far from its
+    // origin to keep the precision of half floats, e.g. a small part of a large scene.
+    bool quantizeVertices = false;
+
+    // Draws the nodes that share a mesh with a single renderable per batch of up to 255 nodes,
+    // rather than one renderable per node, which reduces the draw calls of assets that repeat the
+    // same mesh many times. The renderables are skinned, with one bone per node, and hold a copy of
+    // the vertices per node. Only the nodes that are not skinned, not animated and that do not
+    // have animated ancestors are batched. Their transforms are captured at load time and they do
+    // not have renderable components, the batches are extra entities under the root.
+    //
+    // This trades memory for draw calls: a mesh of V vertices drawn N times uses N * V copies of
+    // its vertices, each with 12 more bytes for its bone, and 32-bit indices, instead of a single
+    // copy. A batch holds at most 65536 vertices, so smaller meshes make larger batches, and the
+    // meshes of more than 32768 vertices are not batched.
+    bool instanceMeshes = false;
+};
+
 /**
  * AssetLoader consumes a blob of glTF 2.0 content (either JSON or GLB) and produces an "asset",
  * which is a bundle of Filament entities, material instances, textures, vertex buffers, and index
@@ -91,6 +115,9 @@ public:
      */
     static AssetLoader* create(filament::Engine* engine, utils::NameComponentManager* = nullptr);
 
+    /** Creates an asset loader with the given configuration. */
+    static AssetLoader* create(const AssetConfiguration& config);
+
     /**
      * Frees the loader.
      *
@@ -89,7 +89,8 @@ public:
     /**
      * Reclaims CPU-side memory for URI strings, binding lists, and raw animation data.
      *
-     * This should only be called after ResourceLoader::loadResources().
+     * This should only be called after ResourceLoader::loadResources(), or once a progressive
+     * load started with ResourceLoader::asyncBeginLoad() is complete.
      * If using Animator, this should be called after getAnimator().
      */
     void releaseSourceData() noexcept;
@@ -105,6 +106,13 @@ public:
     FilamentAsset& operator=(FilamentAsset&&) = delete;
 };
 
+/** How the resource loader converts a float vertex attribute. */
+enum class VertexQuantization : uint8_t {
+    NONE,
+    HALF,       // half floats
+    SNORM16,    // normalized shorts, the values must be within [-1, 1]
+};
+
 /**
  * BufferBinding is a read-only structure that tells clients how to load a source blob into a
  * VertexBuffer slot or IndexBuffer.
@@ -129,6 +137,19 @@ struct BufferBinding {
 
     bool convertBytesToShorts;   // the resource loader must convert the buffer from u8 to u16
     bool generateTrivialIndices; // the resource loader must generate indices like: 0, 1, 2, ...
+
+    // When not NONE, the resource loader must convert the vertex attribute from floats, see
+    // AssetConfiguration::quantizeVertices. The source has vertexCount elements of componentCount
+    // floats, sourceStride bytes apart. Elements of 3 components get a 4th one set to 1.
+    VertexQuantization quantization;
+    uint8_t componentCount;
+    uint32_t sourceStride;
+    uint32_t vertexCount;
+
+    // When greater than 1, the resource loader must repeat the data of the primitive once per
+    // instance, see AssetConfiguration::instanceMeshes. Index buffers are converted to u32, with
+    // sourceStride bytes per source index and the indices of each copy offset by vertexCount.
+    uint32_t instanceCount;
 };
 
 /** Describes a binding from a Texture to a MaterialInstance. */
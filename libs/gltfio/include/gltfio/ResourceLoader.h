@@ -28,12 +28,30 @@ namespace gltfio {
 namespace details {
     class FFilamentAsset;
     class AssetPool;
+    class TextureCache;
+    class ResourceCache;
+    class WorkerPool;
+    struct BufferStream;
 }
 
 struct ResourceConfiguration {
     class filament::Engine* engine;
     utils::Path basePath;
     bool normalizeSkinningWeights;
+
+    // Maximum size in bytes of the decoded images in flight, i.e. decoded but not uploaded yet.
+    // Images are decoded a few at a time to stay within this budget, 0 means no limit.
+    size_t decodedTextureBudget = 0;
+
+    // Keeps the buffers and textures of the loaded assets, so that the next assets loaded by the
+    // same ResourceLoader reuse them rather than reading and decoding them again. Resources are
+    // identified by their path, or by a hash of their contents when they are embedded. Assets
+    // hold references to the resources they use, which are destroyed with the last reference.
+    bool shareResources = false;
+
+    // Maximum size in bytes of the shared resources. Beyond it, the least recently used resources
+    // that are no longer used by any asset are evicted, 0 means no limit.
+    size_t sharedResourceBudget = 0;
 };
 
 /**
@@ -42,26 +60,84 @@ struct ResourceConfiguration {
  *
  * For a usage example, see the comment block for AssetLoader.
  *
- * In theory, this class could cache a map of URL's to data blobs and could therefore be useful
- * across multiple assets. However, clients should feel free to immediately destroy this after
- * calling loadResources. There is no need to wait for resources to finish uploading because this is
- * done in the the background.
+ * Images in KTX containers (image/ktx, or a .ktx URI) are not decoded: their mip levels are
+ * uploaded as-is, in their own format, which can be compressed (ETC2, ASTC, S3TC). The format must
+ * be supported by the backend. Other images are decoded to RGBA8 and get generated mipmaps.
+ *
+ * Textures are decoded and surface orientations are computed in parallel by a few threads owned
+ * by the loader, apart from the Engine's JobSystem. loadResources() returns once everything is
+ * loaded, while asyncBeginLoad() starts a progressive load that returns right away.
+ * With a progressive load:
+ *
+ *  - The buffers are read one at a time by asyncUpdateLoad(), which is called once per frame.
+ *  - Renderables are hidden until the data of all their primitives has been uploaded, including
+ *    their surface orientations, so they appear soon after their own buffers have been read.
+ *  - Placeholder textures are bound to the material instances until the images are decoded.
+ *
+ * With ResourceConfiguration::shareResources, the loader caches the buffers and textures of the
+ * assets it loads, and should be kept alive to share them with the next assets, e.g. variants of a
+ * model that reference the same texture atlas. Otherwise clients should feel free to immediately
+ * destroy this after calling loadResources. There is no need to wait for resources to finish
+ * uploading because this is done in the the background. With a progressive load, the loader must
+ * be kept alive until asyncGetLoadProgress() returns 1, destroying it earlier cancels the load.
  *
  * The resource loader must be destroyed on the same thread that calls Renderer::render because it
  * listens to BufferDescriptor callbacks in order to determine when to free CPU-side data blobs.
- *
- * TODO: the GPU upload is asynchronous but the load-from-disk and image decode is not.
  */
 class ResourceLoader {
 public:
     ResourceLoader(const ResourceConfiguration& config);
     ~ResourceLoader();
+
+    /**
+     * Loads the buffers and textures of the asset and uploads them to the GPU, textures are
+     * decoded in parallel but this returns only once they are all decoded.
+     */
     bool loadResources(FilamentAsset* asset);
+
+    /**
+     * Starts a progressive load of the asset's resources and returns immediately, only the data
+     * that is already in memory (e.g. the binary chunk of a GLB file) is uploaded by this call.
+     *
+     * Only one load can be in progress at a time, and the asset must not be destroyed before the
+     * load completes or is cancelled. The asset's Animator should not be created before the load
+     * completes, because it reads the animation data from the buffers.
+     */
+    bool asyncBeginLoad(FilamentAsset* asset);
+
+    /**
+     * Reads the next buffer and uploads the data and the textures that are ready. This should be
+     * called once per frame, from the thread that created the Engine, until the load is complete.
+     */
+    void asyncUpdateLoad();
+
+    /**
+     * Returns the fraction of the buffers, surface orientations and textures of the current load
+     * that have been uploaded, between 0 and 1. This returns 1 when there is no load in progress.
+     */
+    float asyncGetLoadProgress() const;
+
+    /**
+     * Stops the current load after waiting for the images and the surface orientations being
+     * processed. The renderables whose data has not been uploaded stay hidden and the textures
+     * that have not been uploaded keep their placeholders.
+     */
+    void asyncCancelLoad();
+
 private:
-    bool createTextures(details::FFilamentAsset* asset) const;
-    void computeTangents(details::FFilamentAsset* asset) const;
-    void normalizeWeights(details::FFilamentAsset* asset) const;
+    bool beginLoad(details::FFilamentAsset* asset, bool async);
+    void endLoad();
+    bool readNextBuffer();
+    void processBuffers();
+    void createTextures(details::FFilamentAsset* asset, bool usePlaceholders);
+    void computeTangents(details::FFilamentAsset* asset);
+    void uploadTangents(details::FFilamentAsset* asset);
+    void normalizeWeights(details::FFilamentAsset* asset);
     details::AssetPool* mPool;
+    details::BufferStream* mBufferStream;
+    details::WorkerPool* mWorkers;
+    details::TextureCache* mTextureCache;
+    details::ResourceCache* mResourceCache;
     const ResourceConfiguration mConfig;
 };
 
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLTFIO_ANIMATIONSAMPLER_H
+#define GLTFIO_ANIMATIONSAMPLER_H
+
+#include "math.h"
+
+#include <math/quat.h>
+#include <math/vec3.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace gltfio {
+namespace details {
+
+// The keyframes of an animation sampler, stored as flat arrays.
+struct Sampler {
+    std::vector<float> times;   // sorted
+    std::vector<float> values;  // 3 or 4 floats per keyframe, 3 values per keyframe for CUBIC
+    enum { LINEAR, STEP, CUBIC } interpolation;
+};
+
+// The two keyframes to interpolate between, and the interpolant.
+struct Keyframes {
+    size_t prev;
+    size_t next;
+    float t;
+};
+
+// Finds the keyframes around the given time, which must be within the duration of the animation.
+// Playback is usually monotonic, so the search starts from the result of the previous call, whose
+// index is kept in the given cursor. The sampler must have at least 2 keyframes.
+inline Keyframes findKeyframes(const Sampler& sampler, float time, float duration,
+        size_t* cursor) {
+    const float* times = sampler.times.data();
+    const size_t count = sampler.times.size();
+
+    // The first keyframe after the given time, or the keyframe that matches it exactly.
+    auto isNext = [times, count, time](size_t next) {
+        return (next == 0 || times[next - 1] < time) && (next == count || times[next] >= time);
+    };
+    size_t next = *cursor;
+    if (next > count || !isNext(next)) {
+        if (next < count && isNext(next + 1)) {
+            next++;
+        } else {
+            next = size_t(std::lower_bound(times, times + count, time) - times);
+        }
+    }
+    *cursor = next;
+
+    // Find the two values that we will interpolate between.
+    size_t prev;
+    if (next == count) {
+        prev = count - 1;
+        next = 0;
+    } else if (next == 0) {
+        prev = 0;
+    } else {
+        prev = next - 1;
+    }
+
+    // Compute the interpolant between 0 and 1.
+    float interval = times[next] - times[prev];
+    if (interval < 0) {
+        interval += duration;
+    }
+    float t = interval == 0 ? 0.0f : ((time - times[prev]) / interval);
+    if (sampler.interpolation == Sampler::STEP) {
+        t = 0.0f;
+    }
+    return { prev, next, t };
+}
+
+inline filament::math::float3 sampleVec3(const Sampler& sampler, Keyframes const& k) {
+    using filament::math::float3;
+    const float3* srcVec3 = (const float3*) sampler.values.data();
+    if (sampler.interpolation == Sampler::CUBIC) {
+        float3 vert0 = srcVec3[k.prev * 3 + 1];
+        float3 tang0 = srcVec3[k.prev * 3 + 2];
+        float3 tang1 = srcVec3[k.next * 3];
+        float3 vert1 = srcVec3[k.next * 3 + 1];
+        return cubicSpline(vert0, tang0, vert1, tang1, k.t);
+    }
+    return ((1 - k.t) * srcVec3[k.prev]) + (k.t * srcVec3[k.next]);
+}
+
+inline filament::math::quatf sampleQuat(const Sampler& sampler, Keyframes const& k) {
+    using filament::math::quatf;
+    const quatf* srcQuat = (const quatf*) sampler.values.data();
+    if (sampler.interpolation == Sampler::CUBIC) {
+        quatf vert0 = srcQuat[k.prev * 3 + 1];
+        quatf tang0 = srcQuat[k.prev * 3 + 2];
+        quatf tang1 = srcQuat[k.next * 3];
+        quatf vert1 = srcQuat[k.next * 3 + 1];
+        return normalize(cubicSpline(vert0, tang0, vert1, tang1, k.t));
+    }
+    return slerp(srcQuat[k.prev], srcQuat[k.next], k.t);
+}
+
+} // namespace details
+} // namespace gltfio
+
+#endif // GLTFIO_ANIMATIONSAMPLER_H
@@ -16,7 +16,9 @@
 
 #include <gltfio/Animator.h>
 
+#include "AnimationSampler.h"
 #include "FFilamentAsset.h"
+#include "SkinCache.h"
 #include "math.h"
 #include "upcast.h"
 
@@ -31,8 +33,9 @@
 #include <math/vec3.h>
 #include <math/vec4.h>
 
-#include <map>
+#include <algorithm>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 using namespace filament;
@@ -44,18 +47,10 @@ namespace gltfio {
 
 using namespace details;
 
-using TimeValues = std::map<float, size_t>;
-using SourceValues = std::vector<float>;
-
-struct Sampler {
-    TimeValues times;
-    SourceValues values;
-    enum { LINEAR, STEP, CUBIC } interpolation;
-};
-
 struct Channel {
     const Sampler* sourceData;
-    utils::Entity targetEntity;
+    size_t targetNode;          // index of the animated node
+    size_t cursor;              // keyframe found by the last update
     enum { TRANSLATION, ROTATION, SCALE } transformType;
 };
 
@@ -64,24 +59,51 @@ struct Animation {
     std::string name;
     vector<Sampler> samplers;
     vector<Channel> channels;
+    vector<size_t> nodes;       // the animated nodes targeted by the channels
+};
+
+// The animated nodes keep their translation, rotation and scale, so that their transform doesn't
+// need to be decomposed to update only one of them.
+struct AnimatedNodes {
+    vector<Entity> entities;
+    vector<float3> translations;
+    vector<quatf> rotations;
+    vector<float3> scales;
+    vector<float3> restTranslations;    // the transforms before any animation was applied
+    vector<quatf> restRotations;
+    vector<float3> restScales;
+};
+
+// The TRS accumulated by applyAnimations() for the nodes it touches, indexed like AnimatedNodes.
+struct Mixer {
+    vector<float3> translations;
+    vector<quatf> rotations;
+    vector<float3> scales;
+    vector<float3> weights;             // sums of the translation, rotation and scale weights
+    vector<bool> touched;
+    vector<size_t> nodes;               // the touched nodes
 };
 
 struct AnimatorImpl {
     vector<Animation> animations;
-    vector<mat4f> boneMatrices;
+    AnimatedNodes nodes;
+    Mixer mixer;
+    vector<SkinCache> skins;
     FFilamentAsset* asset;
     RenderableManager* renderableManager;
     TransformManager* transformManager;
 };
 
 static void createSampler(const cgltf_animation_sampler& src, Sampler& dst) {
-    // Copy the time values into a red-black tree.
+    // Copy the time values, which glTF requires to be increasing.
     const cgltf_accessor* timelineAccessor = src.input;
     const uint8_t* timelineBlob = (const uint8_t*) timelineAccessor->buffer_view->buffer->data;
     const float* timelineFloats = (const float*) (timelineBlob + timelineAccessor->offset +
             timelineAccessor->buffer_view->offset);
-    for (size_t i = 0, len = timelineAccessor->count; i < len; ++i) {
-        dst.times[timelineFloats[i]] = i;
+    dst.times.assign(timelineFloats, timelineFloats + timelineAccessor->count);
+    if (!std::is_sorted(dst.times.begin(), dst.times.end())) {
+        slog.e << "Animation keyframes are not sorted." << io::endl;
+        dst.times.clear();
     }
 
     // Convert source data to float.
@@ -140,6 +162,30 @@ Animator::Animator(FilamentAsset* publicAsset) {
     FFilamentAsset* asset = mImpl->asset = upcast(publicAsset);
     mImpl->renderableManager = &asset->mEngine->getRenderableManager();
     mImpl->transformManager = &asset->mEngine->getTransformManager();
+    mImpl->skins.resize(asset->mSkins.size());
+
+    // The animated nodes start from their current transform, it is decomposed only once.
+    AnimatedNodes& nodes = mImpl->nodes;
+    std::unordered_map<Entity, size_t> nodeIndices;
+    auto getNodeIndex = [&](Entity entity) {
+        auto iter = nodeIndices.find(entity);
+        if (iter != nodeIndices.end()) {
+            return iter->second;
+        }
+        auto& transformManager = *mImpl->transformManager;
+        mat4f xform = transformManager.getTransform(transformManager.getInstance(entity));
+        float3 translation, scale;
+        quatf rotation;
+        decomposeMatrix(xform, &translation, &rotation, &scale);
+        nodes.entities.push_back(entity);
+        nodes.translations.push_back(translation);
+        nodes.rotations.push_back(rotation);
+        nodes.scales.push_back(scale);
+        nodes.restTranslations.push_back(translation);
+        nodes.restRotations.push_back(rotation);
+        nodes.restScales.push_back(scale);
+        return nodeIndices[entity] = nodes.entities.size() - 1;
+    };
 
     // Loop over the glTF animation definitions.
     const cgltf_data* srcAsset = asset->mSourceAsset;
@@ -161,7 +207,7 @@ Animator::Animator(FilamentAsset* publicAsset) {
             Sampler& dstSampler = dstAnim.samplers[j];
             createSampler(srcSampler, dstSampler);
             if (dstSampler.times.size() > 1) {
-                float maxtime = (--dstSampler.times.end())->first;
+                float maxtime = dstSampler.times.back();
                 dstAnim.duration = std::max(dstAnim.duration, maxtime);
             }
         }
@@ -169,15 +215,19 @@ Animator::Animator(FilamentAsset* publicAsset) {
         // Import each glTF channel into a custom data structure.
         cgltf_animation_channel* srcChannels = srcAnim.channels;
         dstAnim.channels.resize(srcAnim.channels_count);
-        auto& transformManager = *mImpl->transformManager;
         for (cgltf_size j = 0, nchans = srcAnim.channels_count; j < nchans; ++j) {
             const cgltf_animation_channel& srcChannel = srcChannels[j];
             utils::Entity targetEntity = asset->mNodeMap[srcChannel.target_node];
             Channel& dstChannel = dstAnim.channels[j];
             dstChannel.sourceData = &dstAnim.samplers[srcChannel.sampler - srcSamplers];
-            dstChannel.targetEntity = targetEntity;
+            dstChannel.targetNode = getNodeIndex(targetEntity);
+            dstChannel.cursor = 0;
             setTransformType(srcChannel, dstChannel);
+            dstAnim.nodes.push_back(dstChannel.targetNode);
         }
+        std::sort(dstAnim.nodes.begin(), dstAnim.nodes.end());
+        dstAnim.nodes.erase(std::unique(dstAnim.nodes.begin(), dstAnim.nodes.end()),
+                dstAnim.nodes.end());
     }
 }
 
@@ -190,136 +240,198 @@ size_t Animator::getAnimationCount() const {
 }
 
 void Animator::applyAnimation(size_t animationIndex, float time) const {
-    const Animation& anim = mImpl->animations[animationIndex];
+    Animation& anim = mImpl->animations[animationIndex];
+    AnimatedNodes& nodes = mImpl->nodes;
     TransformManager* transformManager = mImpl->transformManager;
     time = fmod(time, anim.duration);
-    for (const auto& channel : anim.channels) {
+
+    // Update the translation, rotation or scale of the nodes targeted by the channels...
+    for (auto& channel : anim.channels) {
         const Sampler* sampler = channel.sourceData;
         if (sampler->times.size() < 2) {
             continue;
         }
-
-        TransformManager::Instance node = transformManager->getInstance(channel.targetEntity);
-        const TimeValues& times = sampler->times;
-
-        // Find the first keyframe after the given time, or the keyframe that matches it exactly.
-        TimeValues::const_iterator iter = times.lower_bound(time);
-
-        // Find the two values that we will interpolate between.
-        TimeValues::const_iterator prevIter;
-        TimeValues::const_iterator nextIter;
-        if (iter == times.end()) {
-            prevIter = --times.end();
-            nextIter = times.begin();
-        } else if (iter == times.begin()) {
-            prevIter = nextIter = iter;
-        } else {
-            nextIter = iter;
-            prevIter = --iter;
+        Keyframes keyframes = findKeyframes(*sampler, time, anim.duration, &channel.cursor);
+        const size_t node = channel.targetNode;
+        switch (channel.transformType) {
+            case Channel::SCALE:
+                nodes.scales[node] = sampleVec3(*sampler, keyframes);
+                break;
+            case Channel::TRANSLATION:
+                nodes.translations[node] = sampleVec3(*sampler, keyframes);
+                break;
+            case Channel::ROTATION:
+                nodes.rotations[node] = sampleQuat(*sampler, keyframes);
+                break;
         }
+    }
 
-        // Compute the interpolant between 0 and 1.
-        float prevTime = prevIter->first;
-        float nextTime = nextIter->first;
-        float interval = nextTime - prevTime;
-        if (interval < 0) {
-            interval += anim.duration;
-        }
-        float t = interval == 0 ? 0.0f : ((time - prevTime) / interval);
+    // ...then recompose their transform, once per node.
+    for (size_t node : anim.nodes) {
+        TransformManager::Instance instance = transformManager->getInstance(nodes.entities[node]);
+        transformManager->setTransform(instance, composeMatrix(nodes.translations[node],
+                nodes.rotations[node], nodes.scales[node]));
+    }
+}
 
-        // Perform the interpolation. This is a simple but inefficient implementation; Filament
-        // stores transforms as mat4's but glTF animation is based on TRS (translation rotation
-        // scale).
-        size_t prevIndex = prevIter->second;
-        size_t nextIndex = nextIter->second;
+// Completes a weighted sum with the rest value, or normalizes it if the weights add up to 1 or
+// more.
+static float3 blendRest(float3 sum, float weight, float3 rest) {
+    return weight >= 1.0f ? sum / weight : sum + (1.0f - weight) * rest;
+}
 
-        mat4f xform = transformManager->getTransform(node);
-        float3 scale;
-        quatf rotation;
-        float3 translation;
-        decomposeMatrix(xform, &translation, &rotation, &scale);
+static quatf blendRest(quatf sum, float weight, quatf rest) {
+    if (weight < 1.0f) {
+        sum += (dot(sum, rest) < 0 ? weight - 1.0f : 1.0f - weight) * rest;
+    }
+    return dot(sum, sum) > 0 ? normalize(sum) : rest;
+}
 
-        if (sampler->interpolation == Sampler::STEP) {
-            t = 0.0f;
+static float3 scaleRatio(float3 scale, float3 reference) {
+    return float3(
+            reference.x != 0 ? scale.x / reference.x : 1.0f,
+            reference.y != 0 ? scale.y / reference.y : 1.0f,
+            reference.z != 0 ? scale.z / reference.z : 1.0f);
+}
+
+void Animator::applyAnimations(const AnimationClip* clips, size_t count) const {
+    for (size_t i = 0; i < count; ++i) {
+        if (clips[i].animationIndex >= mImpl->animations.size()) {
+            slog.e << "Animation index out of range: " << clips[i].animationIndex << io::endl;
+            return;
         }
+    }
 
-        switch (channel.transformType) {
-            case Channel::SCALE: {
-                const float3* srcVec3 = (const float3*) sampler->values.data();
-                if (sampler->interpolation == Sampler::CUBIC) {
-                    float3 vert0 = srcVec3[prevIndex * 3 + 1];
-                    float3 tang0 = srcVec3[prevIndex * 3 + 2];
-                    float3 tang1 = srcVec3[nextIndex * 3];
-                    float3 vert1 = srcVec3[nextIndex * 3 + 1];
-                    scale = cubicSpline(vert0, tang0, vert1, tang1, t);
-                } else {
-                    scale = ((1 - t) * srcVec3[prevIndex]) + (t * srcVec3[nextIndex]);
-                }
-                break;
+    AnimatedNodes& nodes = mImpl->nodes;
+    Mixer& mixer = mImpl->mixer;
+    const size_t nodeCount = nodes.entities.size();
+    mixer.translations.resize(nodeCount);
+    mixer.rotations.resize(nodeCount);
+    mixer.scales.resize(nodeCount);
+    mixer.weights.resize(nodeCount);
+    mixer.touched.resize(nodeCount, false);
+    mixer.nodes.clear();
+
+    // The blended clips accumulate weighted sums, starting from 0...
+    for (size_t i = 0; i < count; ++i) {
+        const AnimationClip& clip = clips[i];
+        if (clip.additive || clip.weight <= 0) {
+            continue;
+        }
+        Animation& anim = mImpl->animations[clip.animationIndex];
+        const float time = fmod(clip.time, anim.duration);
+        const float w = clip.weight;
+        for (auto& channel : anim.channels) {
+            const Sampler* sampler = channel.sourceData;
+            if (sampler->times.size() < 2) {
+                continue;
             }
-            case Channel::TRANSLATION: {
-                const float3* srcVec3 = (const float3*) sampler->values.data();
-                if (sampler->interpolation == Sampler::CUBIC) {
-                    float3 vert0 = srcVec3[prevIndex * 3 + 1];
-                    float3 tang0 = srcVec3[prevIndex * 3 + 2];
-                    float3 tang1 = srcVec3[nextIndex * 3];
-                    float3 vert1 = srcVec3[nextIndex * 3 + 1];
-                    translation = cubicSpline(vert0, tang0, vert1, tang1, t);
-                } else {
-                    translation = ((1 - t) * srcVec3[prevIndex]) + (t * srcVec3[nextIndex]);
-                }
-                break;
+            Keyframes keyframes = findKeyframes(*sampler, time, anim.duration, &channel.cursor);
+            const size_t node = channel.targetNode;
+            if (!mixer.touched[node]) {
+                mixer.touched[node] = true;
+                mixer.nodes.push_back(node);
+                mixer.translations[node] = float3(0);
+                mixer.rotations[node] = quatf();
+                mixer.scales[node] = float3(0);
+                mixer.weights[node] = float3(0);
             }
-            case Channel::ROTATION: {
-                const quatf* srcQuat = (const quatf*) sampler->values.data();
-                if (sampler->interpolation == Sampler::CUBIC) {
-                    quatf vert0 = srcQuat[prevIndex * 3 + 1];
-                    quatf tang0 = srcQuat[prevIndex * 3 + 2];
-                    quatf tang1 = srcQuat[nextIndex * 3];
-                    quatf vert1 = srcQuat[nextIndex * 3 + 1];
-                    rotation = normalize(cubicSpline(vert0, tang0, vert1, tang1, t));
-                } else {
-                    rotation = slerp(srcQuat[prevIndex], srcQuat[nextIndex], t);
+            switch (channel.transformType) {
+                case Channel::SCALE:
+                    mixer.scales[node] += w * sampleVec3(*sampler, keyframes);
+                    mixer.weights[node].z += w;
+                    break;
+                case Channel::TRANSLATION:
+                    mixer.translations[node] += w * sampleVec3(*sampler, keyframes);
+                    mixer.weights[node].x += w;
+                    break;
+                case Channel::ROTATION: {
+                    // q and -q are the same rotation, keep the sum in the same hemisphere
+                    quatf rotation = sampleQuat(*sampler, keyframes);
+                    mixer.rotations[node] +=
+                            (dot(mixer.rotations[node], rotation) < 0 ? -w : w) * rotation;
+                    mixer.weights[node].y += w;
+                    break;
                 }
-                break;
             }
         }
+    }
 
-        xform = composeMatrix(translation, rotation, scale);
-        transformManager->setTransform(node, xform);
+    // ...which are completed with the rest pose.
+    for (size_t node : mixer.nodes) {
+        const float3 weights = mixer.weights[node];
+        mixer.translations[node] = blendRest(mixer.translations[node], weights.x,
+                nodes.restTranslations[node]);
+        mixer.rotations[node] = blendRest(mixer.rotations[node], weights.y,
+                nodes.restRotations[node]);
+        mixer.scales[node] = blendRest(mixer.scales[node], weights.z, nodes.restScales[node]);
     }
-}
 
-void Animator::updateBoneMatrices() {
-    vector<mat4f>& boneMatrices = mImpl->boneMatrices;
-    FFilamentAsset* asset = mImpl->asset;
-    auto renderableManager = mImpl->renderableManager;
-    auto transformManager = mImpl->transformManager;
-    for (const auto& skin : asset->mSkins) {
-        size_t njoints = skin.joints.size();
-        boneMatrices.resize(njoints);
-        for (const auto& entity : skin.targets) {
-            auto renderable = renderableManager->getInstance(entity);
-            if (!renderable) {
+    // The additive clips apply their offset from their first keyframe on top of that.
+    const Keyframes first = { 0, 0, 0.0f };
+    for (size_t i = 0; i < count; ++i) {
+        const AnimationClip& clip = clips[i];
+        if (!clip.additive || clip.weight == 0) {
+            continue;
+        }
+        Animation& anim = mImpl->animations[clip.animationIndex];
+        const float time = fmod(clip.time, anim.duration);
+        const float w = clip.weight;
+        for (auto& channel : anim.channels) {
+            const Sampler* sampler = channel.sourceData;
+            if (sampler->times.size() < 2) {
                 continue;
             }
-            mat4f inverseGlobalTransform;
-            auto xformable = transformManager->getInstance(entity);
-            if (xformable) {
-                inverseGlobalTransform = inverse(transformManager->getWorldTransform(xformable));
+            Keyframes keyframes = findKeyframes(*sampler, time, anim.duration, &channel.cursor);
+            const size_t node = channel.targetNode;
+            if (!mixer.touched[node]) {
+                mixer.touched[node] = true;
+                mixer.nodes.push_back(node);
+                mixer.translations[node] = nodes.restTranslations[node];
+                mixer.rotations[node] = nodes.restRotations[node];
+                mixer.scales[node] = nodes.restScales[node];
             }
-            for (size_t boneIndex = 0; boneIndex < njoints; ++boneIndex) {
-                const auto& joint = skin.joints[boneIndex];
-                TransformManager::Instance jointInstance = transformManager->getInstance(joint);
-                mat4f globalJointTransform = transformManager->getWorldTransform(jointInstance);
-                boneMatrices[boneIndex] =
-                        inverseGlobalTransform *
-                        globalJointTransform *
-                        skin.inverseBindMatrices[boneIndex];
+            switch (channel.transformType) {
+                case Channel::SCALE: {
+                    float3 ratio = scaleRatio(sampleVec3(*sampler, keyframes),
+                            sampleVec3(*sampler, first));
+                    mixer.scales[node] *= 1.0f + w * (ratio - 1.0f);
+                    break;
+                }
+                case Channel::TRANSLATION:
+                    mixer.translations[node] += w * (sampleVec3(*sampler, keyframes) -
+                            sampleVec3(*sampler, first));
+                    break;
+                case Channel::ROTATION: {
+                    quatf delta = sampleQuat(*sampler, keyframes) *
+                            inverse(sampleQuat(*sampler, first));
+                    mixer.rotations[node] = normalize(slerp(quatf(1), delta, w) *
+                            mixer.rotations[node]);
+                    break;
+                }
             }
-            renderableManager->setBones(renderable, boneMatrices.data(), boneMatrices.size());
         }
     }
+
+    // Set each transform once, the world transforms are updated when the transaction is committed.
+    TransformManager* transformManager = mImpl->transformManager;
+    transformManager->openLocalTransformTransaction();
+    for (size_t node : mixer.nodes) {
+        nodes.translations[node] = mixer.translations[node];
+        nodes.rotations[node] = mixer.rotations[node];
+        nodes.scales[node] = mixer.scales[node];
+        TransformManager::Instance instance = transformManager->getInstance(nodes.entities[node]);
+        transformManager->setTransform(instance, composeMatrix(nodes.translations[node],
+                nodes.rotations[node], nodes.scales[node]));
+        mixer.touched[node] = false;
+    }
+    transformManager->commitLocalTransformTransaction();
+}
+
+void Animator::updateBoneMatrices() {
+    FFilamentAsset* asset = mImpl->asset;
+    updateSkins(asset->mSkins.data(), mImpl->skins.data(), asset->mSkins.size(),
+            *mImpl->renderableManager, *mImpl->transformManager, asset->mEngine->getJobSystem());
 }
 
 float Animator::getAnimationDuration(size_t animationIndex) const {
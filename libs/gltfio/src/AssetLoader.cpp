@@ -19,6 +19,7 @@
 #include "FFilamentAsset.h"
 #include "GltfEnums.h"
 #include "MaterialGenerator.h"
+#include "Quantization.h"
 
 #include <filament/Box.h>
 #include <filament/Engine.h>
@@ -40,9 +41,14 @@
 #include <utils/NameComponentManager.h>
 
 #include <tsl/robin_map.h>
+#include <tsl/robin_set.h>
 
+#include <algorithm>
 #include <vector>
 
+#include <stddef.h>
+#include <stdlib.h>
+
 #define CGLTF_IMPLEMENTATION
 #include <cgltf.h>
 
@@ -73,6 +79,28 @@ using MeshCache = tsl::robin_map<const cgltf_mesh*, std::vector<Primitive>>;
 // Filament materials are cached by the MaterialGenerator, but material instances are cached here.
 using MatInstanceCache = tsl::robin_map<intptr_t, MaterialInstance*>;
 
+// Instancing
+// ----------
+// With AssetConfiguration::instanceMeshes, the static nodes that share a mesh are drawn by skinned
+// renderables, each vertex of the copy of the mesh for a node being bound to the bone of the node.
+// The nodes still get entities with transform components, but the loader gathers them here instead
+// of creating their renderables.
+using InstanceMap = tsl::robin_map<const cgltf_mesh*, std::vector<Entity>>;
+using NodeSet = tsl::robin_set<const cgltf_node*>;
+
+// The bone indices and weights of instanced vertices, interleaved in a single vertex buffer slot.
+struct InstanceBone {
+    ushort4 indices;
+    ubyte4 weights;
+};
+
+// A batch is limited by the number of bones of a renderable, and by the number of vertices of its
+// copies of the mesh. It needs a vertex buffer slot for the bones in addition to the slots of the
+// mesh.
+static constexpr size_t MAX_INSTANCES = 255;
+static constexpr size_t MAX_INSTANCED_VERTICES = 65536;
+static constexpr cgltf_size MAX_VERTEX_BUFFERS = 8;
+
 // Filament automatically infers the size of driver-level vertex buffers from the attribute data
 // (stride, count, offset) and clients are expected to avoid uploading data blobs that exceed this
 // size. Since this information doesn't exist in the glTF we need to compute it manually. This is a
@@ -87,14 +115,72 @@ static uint32_t computeBindingOffset(const cgltf_accessor* accessor) {
     return uint32_t(accessor->offset + accessor->buffer_view->offset);
 };
 
+// Returns how a vertex attribute is converted when quantization is enabled. Only float positions
+// and texture coordinates are quantized, the other attributes are uploaded in their source format.
+static VertexQuantization getQuantization(const cgltf_attribute& attribute) {
+    const cgltf_accessor* accessor = attribute.data;
+    if (accessor->component_type != cgltf_component_type_r_32f || accessor->normalized) {
+        return VertexQuantization::NONE;
+    }
+    if (attribute.type == cgltf_attribute_type_position && accessor->type == cgltf_type_vec3 &&
+            accessor->has_min && accessor->has_max) {
+        const float* minp = &accessor->min[0];
+        const float* maxp = &accessor->max[0];
+        return getPositionQuantization(float3(minp[0], minp[1], minp[2]),
+                float3(maxp[0], maxp[1], maxp[2]));
+    }
+    if (attribute.type == cgltf_attribute_type_texcoord && accessor->type == cgltf_type_vec2) {
+        return getTexCoordQuantization(accessor->has_min ? &accessor->min[0] : nullptr,
+                accessor->has_max ? &accessor->max[0] : nullptr);
+    }
+    return VertexQuantization::NONE;
+}
+
+// Returns the number of instances of the given mesh that fit in a batch.
+static size_t getMaxInstances(const cgltf_mesh* mesh) {
+    size_t vertexCount = 1;
+    for (cgltf_size i = 0; i < mesh->primitives_count; ++i) {
+        const cgltf_primitive& prim = mesh->primitives[i];
+        if (prim.attributes_count) {
+            vertexCount = std::max(vertexCount, size_t(prim.attributes[0].data->count));
+        }
+    }
+    return std::min(MAX_INSTANCES, MAX_INSTANCED_VERTICES / vertexCount);
+}
+
+// Returns true if the given node can be drawn as an instance of its mesh, i.e. if it does not move
+// relative to the root of the asset, if its primitives have room for the bones and if the mesh is
+// small enough to be repeated in a batch.
+static bool isInstanceable(const cgltf_node* node) {
+    const cgltf_mesh* mesh = node->mesh;
+    if (!mesh || node->skin) {
+        return false;
+    }
+    for (cgltf_size i = 0; i < mesh->primitives_count; ++i) {
+        const cgltf_primitive& prim = mesh->primitives[i];
+        if (prim.targets_count || prim.attributes_count >= MAX_VERTEX_BUFFERS) {
+            return false;
+        }
+        for (cgltf_size slot = 0; slot < prim.attributes_count; ++slot) {
+            const cgltf_attribute_type type = prim.attributes[slot].type;
+            if (type == cgltf_attribute_type_joints || type == cgltf_attribute_type_weights) {
+                return false;
+            }
+        }
+    }
+    return getMaxInstances(mesh) > 1;
+}
+
 struct FAssetLoader : public AssetLoader {
-    FAssetLoader(Engine* engine, NameComponentManager* names) :
+    FAssetLoader(const AssetConfiguration& config) :
             mEntityManager(EntityManager::get()),
-            mRenderableManager(engine->getRenderableManager()),
-            mNameManager(names),
-            mTransformManager(engine->getTransformManager()),
-            mMaterials(engine),
-            mEngine(engine) {}
+            mRenderableManager(config.engine->getRenderableManager()),
+            mNameManager(config.names),
+            mTransformManager(config.engine->getTransformManager()),
+            mMaterials(config.engine),
+            mEngine(config.engine),
+            mQuantizeVertices(config.quantizeVertices),
+            mInstanceMeshes(config.instanceMeshes) {}
 
     FFilamentAsset* createAssetFromJson(const uint8_t* bytes, uint32_t nbytes);
     FilamentAsset* createAssetFromBinary(const uint8_t* bytes, uint32_t nbytes);
@@ -118,7 +204,11 @@ struct FAssetLoader : public AssetLoader {
     void createAsset(const cgltf_data* srcAsset);
     void createEntity(const cgltf_node* node, Entity parent);
     void createRenderable(const cgltf_node* node, Entity entity);
-    bool createPrimitive(const cgltf_primitive* inPrim, Primitive* outPrim, const UvMap& uvmap);
+    bool createPrimitive(const cgltf_primitive* inPrim, Primitive* outPrim, const UvMap& uvmap,
+            uint32_t instanceCount = 1);
+    void findInstances(const cgltf_node* node, const NodeSet& animatedNodes,
+            tsl::robin_map<const cgltf_mesh*, std::vector<const cgltf_node*>>* candidates);
+    void createInstancedRenderable(const cgltf_mesh* mesh, const Entity* nodes, size_t count);
     MaterialInstance* createMaterialInstance(const cgltf_material* inputMat, UvMap* uvmap,
             bool vertexColor);
     void addTextureBinding(MaterialInstance* materialInstance, const char* parameterName,
@@ -132,11 +222,15 @@ struct FAssetLoader : public AssetLoader {
     TransformManager& mTransformManager;
     MaterialGenerator mMaterials;
     Engine* mEngine;
+    const bool mQuantizeVertices;
+    const bool mInstanceMeshes;
 
     // The loader owns a few transient mappings used only for the current asset being loaded.
     FFilamentAsset* mResult;
     MatInstanceCache mMatInstanceCache;
     MeshCache mMeshCache;
+    NodeSet mInstancedNodes;
+    InstanceMap mInstances;
     bool mError = false;
 };
 
@@ -197,13 +291,44 @@ void FAssetLoader::createAsset(const cgltf_data* srcAsset) {
     mResult->mRoot = mEntityManager.create();
     mTransformManager.create(mResult->mRoot);
 
-    // One scene may have multiple root nodes. Recurse down and create an entity for each node.
+    // Find the nodes that can be drawn as instances of a mesh that is shared with other nodes. The
+    // animated nodes move relative to the root, and so do their descendants.
     cgltf_node** nodes = scene->nodes;
+    if (mInstanceMeshes) {
+        NodeSet animatedNodes;
+        for (cgltf_size i = 0; i < srcAsset->animations_count; ++i) {
+            const cgltf_animation& anim = srcAsset->animations[i];
+            for (cgltf_size j = 0; j < anim.channels_count; ++j) {
+                animatedNodes.insert(anim.channels[j].target_node);
+            }
+        }
+        tsl::robin_map<const cgltf_mesh*, std::vector<const cgltf_node*>> candidates;
+        for (cgltf_size i = 0, len = scene->nodes_count; i < len; ++i) {
+            findInstances(nodes[i], animatedNodes, &candidates);
+        }
+        for (const auto& iter : candidates) {
+            if (iter.second.size() > 1) {
+                mInstancedNodes.insert(iter.second.begin(), iter.second.end());
+            }
+        }
+    }
+
+    // One scene may have multiple root nodes. Recurse down and create an entity for each node.
     for (cgltf_size i = 0, len = scene->nodes_count; i < len; ++i) {
         const cgltf_node* root = nodes[i];
         createEntity(root, mResult->mRoot);
     }
 
+    // Now that the transforms of all the nodes are known, create the renderables of the instances.
+    for (const auto& iter : mInstances) {
+        const std::vector<Entity>& instances = iter.second;
+        const size_t batchSize = getMaxInstances(iter.first);
+        for (size_t i = 0; i < instances.size(); i += batchSize) {
+            size_t count = std::min(batchSize, instances.size() - i);
+            createInstancedRenderable(iter.first, instances.data() + i, count);
+        }
+    }
+
     if (mError) {
         delete mResult;
         mResult = nullptr;
@@ -229,9 +354,24 @@ void FAssetLoader::createAsset(const cgltf_data* srcAsset) {
     // We're done with the import, so free up transient bookkeeping resources.
     mMatInstanceCache.clear();
     mMeshCache.clear();
+    mInstancedNodes.clear();
+    mInstances.clear();
     mError = false;
 }
 
+void FAssetLoader::findInstances(const cgltf_node* node, const NodeSet& animatedNodes,
+        tsl::robin_map<const cgltf_mesh*, std::vector<const cgltf_node*>>* candidates) {
+    if (animatedNodes.count(node)) {
+        return;
+    }
+    if (isInstanceable(node)) {
+        (*candidates)[node->mesh].push_back(node);
+    }
+    for (cgltf_size i = 0, len = node->children_count; i < len; ++i) {
+        findInstances(node->children[i], animatedNodes, candidates);
+    }
+}
+
 void FAssetLoader::createEntity(const cgltf_node* node, Entity parent) {
     Entity entity = mEntityManager.create();
 
@@ -253,10 +393,13 @@ void FAssetLoader::createEntity(const cgltf_node* node, Entity parent) {
     mResult->mEntities.push_back(entity);
     mResult->mNodeMap[node] = entity;
 
-    // If the node has a mesh, then create a renderable component.
-    if (node->mesh) {
+    // If the node has a mesh, then create a renderable component, unless the node is drawn by the
+    // renderable of a batch of instances.
+    if (mInstancedNodes.count(node)) {
+        mInstances[node->mesh].push_back(entity);
+    } else if (node->mesh) {
         createRenderable(node, entity);
-     }
+    }
 
     for (cgltf_size i = 0, len = node->children_count; i < len; ++i) {
         createEntity(node->children[i], entity);
@@ -340,8 +483,72 @@ void FAssetLoader::createRenderable(const cgltf_node* node, Entity entity) {
     // TODO: support vertex morphing by honoring mesh->weights and mesh->weight_count.
 }
 
+void FAssetLoader::createInstancedRenderable(const cgltf_mesh* mesh, const Entity* nodes,
+        size_t count) {
+    Entity entity = mEntityManager.create();
+    mTransformManager.create(entity, mTransformManager.getInstance(mResult->mRoot));
+    mResult->mEntities.push_back(entity);
+    mResult->mInstancedRenderables.push_back({ mesh, entity, { nodes, nodes + count } });
+
+    if (mNameManager && mesh->name) {
+        mNameManager->addComponent(entity);
+        mNameManager->setName(mNameManager->getInstance(entity), mesh->name);
+    }
+
+    cgltf_size nprims = mesh->primitives_count;
+    RenderableManager::Builder builder(nprims);
+
+    // Each batch has its own vertex and index buffers, with a copy of the primitives per node.
+    Aabb aabb;
+    const cgltf_primitive* inputPrim = &mesh->primitives[0];
+    for (cgltf_size index = 0; index < nprims; ++index, ++inputPrim) {
+        RenderableManager::PrimitiveType primType;
+        if (!getPrimitiveType(inputPrim->type, &primType)) {
+            slog.e << "Unsupported primitive type." << io::endl;
+        }
+
+        UvMap uvmap;
+        bool hasVertexColor = primitiveHasVertexColor(inputPrim);
+        MaterialInstance* mi = createMaterialInstance(inputPrim->material, &uvmap, hasVertexColor);
+        builder.material(index, mi);
+
+        Primitive outputPrim;
+        if (!createPrimitive(inputPrim, &outputPrim, uvmap, uint32_t(count))) {
+            mError = true;
+            continue;
+        }
+        aabb.min = min(outputPrim.aabb.min, aabb.min);
+        aabb.max = max(outputPrim.aabb.max, aabb.max);
+        builder.geometry(index, primType, outputPrim.vertices, outputPrim.indices);
+    }
+
+    // The bones are the transforms of the nodes relative to the root, which is also the parent of
+    // the renderable. The bounding box of the renderable encloses all the instances.
+    const Box meshBounds = Box().set(aabb.min, aabb.max);
+    std::vector<mat4f> bones(count);
+    Aabb bounds;
+    for (size_t i = 0; i < count; ++i) {
+        bones[i] = mTransformManager.getWorldTransform(mTransformManager.getInstance(nodes[i]));
+        const Box instanceBounds = rigidTransform(meshBounds, bones[i]);
+        bounds.min = min(bounds.min, instanceBounds.getMin());
+        bounds.max = max(bounds.max, instanceBounds.getMax());
+    }
+
+    mResult->mBoundingBox.min = min(mResult->mBoundingBox.min, bounds.min);
+    mResult->mBoundingBox.max = max(mResult->mBoundingBox.max, bounds.max);
+
+    builder
+        .skinning(count, bones.data())
+        .boundingBox(Box().set(bounds.min, bounds.max))
+        .culling(true)
+        .castShadows(true)
+        .receiveShadows(true)
+        .build(*mEngine, entity);
+}
+
 bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* outPrim,
-        const UvMap& uvmap) {
+        const UvMap& uvmap, uint32_t instanceCount) {
+    const cgltf_size vertexCount = inPrim->attributes[0].data->count;
 
     // In glTF, each primitive may or may not have an index buffer. If a primitive does not have an
     // index buffer, we ask the ResourceLoader to generate a trivial index buffer.
@@ -349,13 +556,15 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
     const cgltf_accessor* indicesAccessor = inPrim->indices;
     if (indicesAccessor) {
         IndexBuffer::Builder ibb;
-        ibb.indexCount(indicesAccessor->count);
+        ibb.indexCount(indicesAccessor->count * instanceCount);
         IndexBuffer::IndexType indexType;
         if (!getIndexType(indicesAccessor->component_type, &indexType)) {
             utils::slog.e << "Unrecognized index type." << utils::io::endl;
             return false;
         }
-        ibb.bufferType(indexType);
+
+        // The indices of each instance are offset by the vertex count, which can overflow shorts.
+        ibb.bufferType(instanceCount > 1 ? IndexBuffer::IndexType::UINT : indexType);
         indices = ibb.build(*mEngine);
         const cgltf_buffer_view* bv = indicesAccessor->buffer_view;
         mResult->mBufferBindings.emplace_back(BufferBinding {
@@ -365,18 +574,21 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
             .size = computeBindingSize(indicesAccessor),
             .data = &bv->buffer->data,
             .indexBuffer = indices,
-            .convertBytesToShorts = indicesAccessor->component_type == cgltf_component_type_r_8u,
-            .generateTrivialIndices = false
+            .convertBytesToShorts = instanceCount == 1 &&
+                    indicesAccessor->component_type == cgltf_component_type_r_8u,
+            .generateTrivialIndices = false,
+            .sourceStride = uint32_t(indicesAccessor->stride),
+            .vertexCount = uint32_t(vertexCount),
+            .instanceCount = instanceCount
         });
     } else {
-        const cgltf_size vertexCount = inPrim->attributes[0].data->count;
         indices = IndexBuffer::Builder()
-            .indexCount(vertexCount)
+            .indexCount(vertexCount * instanceCount)
             .bufferType(IndexBuffer::IndexType::UINT)
             .build(*mEngine);
         mResult->mBufferBindings.emplace_back(BufferBinding {
             .indexBuffer = indices,
-            .size = uint32_t(vertexCount * sizeof(uint32_t)),
+            .size = uint32_t(vertexCount * instanceCount * sizeof(uint32_t)),
             .generateTrivialIndices = true
         });
     }
@@ -388,6 +600,7 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
     // do not remap the slots.
     VertexBuffer::Builder vbb;
     vbb.bufferCount(inPrim->attributes_count);
+    vbb.vertexCount(vertexCount * instanceCount);
 
     for (int slot = 0; slot < inPrim->attributes_count; slot++) {
         const cgltf_attribute& inputAttribute = inPrim->attributes[slot];
@@ -429,9 +642,6 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
             }
         }
 
-        // This will needlessly set the same vertex count multiple times, which should be fine.
-        vbb.vertexCount(inputAccessor->count);
-
         // The positions accessor is required to have min/max properties, use them to expand
         // the bounding box for this primitive.
         if (inputAttribute.type == cgltf_attribute_type_position) {
@@ -452,6 +662,21 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
             return false;
         }
 
+        // Quantized attributes are converted by the ResourceLoader into tightly packed buffers.
+        const VertexQuantization quantization = mQuantizeVertices ?
+                getQuantization(inputAttribute) : VertexQuantization::NONE;
+        if (quantization != VertexQuantization::NONE) {
+            const bool isPosition = inputAttribute.type == cgltf_attribute_type_position;
+            if (quantization == VertexQuantization::SNORM16) {
+                vbb.attribute(semantic, slot, VertexBuffer::AttributeType::SHORT2);
+                vbb.normalized(semantic);
+            } else {
+                vbb.attribute(semantic, slot, isPosition ? VertexBuffer::AttributeType::HALF4 :
+                        VertexBuffer::AttributeType::HALF2);
+            }
+            continue;
+        }
+
         // The cgltf library provides a stride value for all accessors, even though they do not
         // exist in the glTF file. It is computed from the type and the stride of the buffer view.
         // As a convenience, cgltf also replaces zero (default) stride with the actual stride.
@@ -462,8 +687,39 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
         }
     }
 
-    VertexBuffer* vertices = mResult->mPrimMap[inPrim] = vbb.build(*mEngine);
+    // Instances are skinned vertices, bound to the bone of their node with a weight of 1. The bone
+    // indices and weights are interleaved in an extra slot.
+    const uint8_t bonesSlot = uint8_t(inPrim->attributes_count);
+    if (instanceCount > 1) {
+        vbb.bufferCount(bonesSlot + 1);
+        vbb.attribute(VertexAttribute::BONE_INDICES, bonesSlot,
+                VertexBuffer::AttributeType::USHORT4, 0, sizeof(InstanceBone));
+        vbb.attribute(VertexAttribute::BONE_WEIGHTS, bonesSlot,
+                VertexBuffer::AttributeType::UBYTE4, offsetof(InstanceBone, weights),
+                sizeof(InstanceBone));
+        vbb.normalized(VertexAttribute::BONE_WEIGHTS);
+    }
+
+    VertexBuffer* vertices = vbb.build(*mEngine);
     mResult->mVertexBuffers.push_back(vertices);
+    if (instanceCount > 1) {
+        mResult->mInstancedPrimMap[inPrim].push_back({ vertices, instanceCount });
+    } else {
+        mResult->mPrimMap[inPrim] = vertices;
+    }
+
+    // The bones do not depend on the source data, so they can be uploaded right away.
+    if (instanceCount > 1) {
+        const size_t size = vertexCount * instanceCount * sizeof(InstanceBone);
+        InstanceBone* bones = (InstanceBone*) malloc(size);
+        for (uint32_t instance = 0; instance < instanceCount; ++instance) {
+            const InstanceBone bone = { ushort4(instance, 0, 0, 0), ubyte4(255, 0, 0, 0) };
+            std::fill_n(bones + instance * vertexCount, vertexCount, bone);
+        }
+        auto callback = (VertexBuffer::BufferDescriptor::Callback) free;
+        VertexBuffer::BufferDescriptor bd(bones, size, callback);
+        vertices->setBufferAt(*mEngine, bonesSlot, std::move(bd));
+    }
 
     for (cgltf_size slot = 0; slot < inPrim->attributes_count; slot++) {
         const cgltf_attribute& inputAttribute = inPrim->attributes[slot];
@@ -487,7 +743,13 @@ bool FAssetLoader::createPrimitive(const cgltf_primitive* inPrim, Primitive* out
             .vertexBuffer = vertices,
             .indexBuffer = nullptr,
             .convertBytesToShorts = false,
-            .generateTrivialIndices = false
+            .generateTrivialIndices = false,
+            .quantization = mQuantizeVertices ?
+                    getQuantization(inputAttribute) : VertexQuantization::NONE,
+            .componentCount = uint8_t(inputAccessor->type == cgltf_type_vec3 ? 3 : 2),
+            .sourceStride = uint32_t(inputAccessor->stride),
+            .vertexCount = uint32_t(inputAccessor->count),
+            .instanceCount = instanceCount
         });
     }
 
@@ -685,7 +947,11 @@ bool FAssetLoader::primitiveHasVertexColor(const cgltf_primitive* inPrim) const
 }
 
 AssetLoader* AssetLoader::create(Engine* engine, NameComponentManager* names) {
-    return new FAssetLoader(engine, names);
+    return new FAssetLoader({ .engine = engine, .names = names });
+}
+
+AssetLoader* AssetLoader::create(const AssetConfiguration& config) {
+    return new FAssetLoader(config);
 }
 
 void AssetLoader::destroy(AssetLoader** loader) {
@@ -37,6 +37,8 @@
 
 #include "upcast.h"
 
+#include "ResourceCache.h"
+
 #include <tsl/robin_map.h>
 
 #include <set>
@@ -53,6 +55,19 @@ struct Skin {
     std::vector<utils::Entity> targets;
 };
 
+// A vertex buffer that holds one copy of a primitive per instance of its mesh.
+struct InstancedBuffer {
+    filament::VertexBuffer* vertices;
+    uint32_t instanceCount;
+};
+
+// A renderable that draws a batch of instances of a mesh, one per skinning bone.
+struct InstancedRenderable {
+    const cgltf_mesh* mesh;
+    utils::Entity entity;
+    std::vector<utils::Entity> nodes;   // the node drawn by each bone
+};
+
 struct FFilamentAsset : public FilamentAsset {
     FFilamentAsset(filament::Engine* engine) : mEngine(engine) {}
 
@@ -131,6 +146,9 @@ struct FFilamentAsset : public FilamentAsset {
         mTextureBindings.shrink_to_fit();
         mNodeMap.clear();
         mPrimMap.clear();
+        mInstancedPrimMap.clear();
+        mInstancedRenderables.clear();
+        mInstancedRenderables.shrink_to_fit();
         releaseSourceAsset();
     }
 
@@ -142,7 +160,18 @@ struct FFilamentAsset : public FilamentAsset {
         if (--mSourceAssetRefCount == 0) {
             mGlbData.clear();
             mGlbData.shrink_to_fit();
-            cgltf_free((cgltf_data*) mSourceAsset);
+
+            // The shared buffers are freed with their last reference rather than by cgltf.
+            auto gltf = (cgltf_data*) mSourceAsset;
+            for (cgltf_size i = 0, n = gltf ? gltf->buffers_count : 0; i < n; ++i) {
+                for (const auto& buffer : mSharedBuffers) {
+                    if (gltf->buffers[i].data == buffer->data) {
+                        gltf->buffers[i].data = nullptr;
+                    }
+                }
+            }
+            mSharedBuffers.clear();
+            cgltf_free(gltf);
             mSourceAsset = nullptr;
         }
     }
@@ -154,6 +183,8 @@ struct FFilamentAsset : public FilamentAsset {
     std::vector<filament::VertexBuffer*> mVertexBuffers;
     std::vector<filament::IndexBuffer*> mIndexBuffers;
     std::vector<filament::Texture*> mTextures;
+    std::vector<std::shared_ptr<SharedTexture>> mSharedTextures;
+    std::vector<std::shared_ptr<SharedBuffer>> mSharedBuffers;
     filament::Aabb mBoundingBox;
     utils::Entity mRoot;
     std::vector<Skin> mSkins;
@@ -167,6 +198,8 @@ struct FFilamentAsset : public FilamentAsset {
     const cgltf_data* mSourceAsset = nullptr;
     tsl::robin_map<const cgltf_node*, utils::Entity> mNodeMap;
     tsl::robin_map<const cgltf_primitive*, filament::VertexBuffer*> mPrimMap;
+    tsl::robin_map<const cgltf_primitive*, std::vector<InstancedBuffer>> mInstancedPrimMap;
+    std::vector<InstancedRenderable> mInstancedRenderables;
     /** @} */
 };
 
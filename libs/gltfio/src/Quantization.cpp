@@ -0,0 +1,99 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Quantization.h"
+
+#include <math/half.h>
+#include <math/norm.h>
+
+#include <algorithm>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace filament::math;
+
+namespace gltfio {
+namespace details {
+
+// Half floats have 11 significant bits, so their error is at most 2^-11 of the largest coordinate.
+// Allowing coordinates up to 4 times the size of the mesh keeps the error under 0.2% of it.
+static constexpr float MAX_POSITION_TO_EXTENT = 4.0f;
+static constexpr float MAX_HALF = 65504.0f;
+
+VertexQuantization getPositionQuantization(float3 min, float3 max) {
+    const float3 extents = max - min;
+    const float extent = std::max(extents.x, std::max(extents.y, extents.z));
+    const float3 largest = std::max(abs(min), abs(max));
+    const float coordinate = std::max(largest.x, std::max(largest.y, largest.z));
+    if (!(extent > 0) || coordinate > MAX_HALF || coordinate > extent * MAX_POSITION_TO_EXTENT) {
+        return VertexQuantization::NONE;
+    }
+    return VertexQuantization::HALF;
+}
+
+VertexQuantization getTexCoordQuantization(const float* min, const float* max) {
+    if (min && max && min[0] >= -1.0f && min[1] >= -1.0f && max[0] <= 1.0f && max[1] <= 1.0f) {
+        return VertexQuantization::SNORM16;
+    }
+    return VertexQuantization::HALF;
+}
+
+size_t getQuantizedSize(VertexQuantization quantization, uint8_t componentCount,
+        size_t vertexCount) {
+    const size_t components = componentCount == 3 ? 4 : componentCount;
+    const size_t componentSize = quantization == VertexQuantization::NONE ? sizeof(float) : 2;
+    return vertexCount * components * componentSize;
+}
+
+template<typename T>
+static void convert(const uint8_t* source, uint32_t sourceStride, uint32_t vertexCount,
+        uint8_t componentCount, T* out, T one, T (*pack)(float)) {
+    const uint8_t outCount = componentCount == 3 ? uint8_t(4) : componentCount;
+    float element[4];
+    for (uint32_t i = 0; i < vertexCount; ++i, source += sourceStride, out += outCount) {
+        memcpy(element, source, componentCount * sizeof(float));
+        for (uint8_t c = 0; c < componentCount; ++c) {
+            out[c] = pack(element[c]);
+        }
+        if (componentCount == 3) {
+            out[3] = one;
+        }
+    }
+}
+
+void* quantizeVertices(const uint8_t* source, uint32_t sourceStride, uint32_t vertexCount,
+        uint8_t componentCount, VertexQuantization quantization) {
+    void* out = malloc(getQuantizedSize(quantization, componentCount, vertexCount));
+    switch (quantization) {
+        case VertexQuantization::NONE:
+            convert<float>(source, sourceStride, vertexCount, componentCount, (float*) out,
+                    1.0f, [](float v) { return v; });
+            break;
+        case VertexQuantization::HALF:
+            convert<half>(source, sourceStride, vertexCount, componentCount, (half*) out,
+                    half(1.0f), [](float v) { return half(v); });
+            break;
+        case VertexQuantization::SNORM16:
+            convert<int16_t>(source, sourceStride, vertexCount, componentCount, (int16_t*) out,
+                    int16_t(32767), [](float v) { return packSnorm16(v); });
+            break;
+    }
+    return out;
+}
+
+} // namespace details
+} // namespace gltfio
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLTFIO_QUANTIZATION_H
+#define GLTFIO_QUANTIZATION_H
+
+#include <gltfio/FilamentAsset.h>
+
+#include <math/vec3.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace gltfio {
+namespace details {
+
+// Positions are stored as half floats when the mesh is close enough to its origin that the error
+// stays below a small fraction of the size of the mesh, otherwise they are left as floats.
+VertexQuantization getPositionQuantization(filament::math::float3 min,
+        filament::math::float3 max);
+
+// Texture coordinates within [-1, 1] are stored as normalized shorts, other ones as half floats.
+// The bounds are optional in glTF, without them the coordinates are assumed to be out of range.
+VertexQuantization getTexCoordQuantization(const float* min, const float* max);
+
+// Size in bytes of an attribute converted with the given quantization.
+size_t getQuantizedSize(VertexQuantization quantization, uint8_t componentCount,
+        size_t vertexCount);
+
+// Converts vertexCount elements of componentCount floats, sourceStride bytes apart, to the given
+// quantization. Elements of 3 components get a 4th one set to 1. The returned buffer is allocated
+// with malloc().
+void* quantizeVertices(const uint8_t* source, uint32_t sourceStride, uint32_t vertexCount,
+        uint8_t componentCount, VertexQuantization quantization);
+
+} // namespace details
+} // namespace gltfio
+
+#endif // GLTFIO_QUANTIZATION_H
@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "ResourceCache.h"
+
+#include <utils/Hash.h>
+
+#include <stdio.h>
+
+namespace gltfio {
+namespace details {
+
+std::shared_ptr<SharedResource> ResourceCache::get(std::string const& key) {
+    auto iter = mMap.find(key);
+    if (iter == mMap.end()) {
+        return nullptr;
+    }
+    mEntries.splice(mEntries.begin(), mEntries, iter->second);
+    return iter->second->resource;
+}
+
+std::shared_ptr<SharedBuffer> ResourceCache::getBuffer(std::string const& key) {
+    return std::static_pointer_cast<SharedBuffer>(get("buffer:" + key));
+}
+
+std::shared_ptr<SharedTexture> ResourceCache::getTexture(std::string const& key) {
+    return std::static_pointer_cast<SharedTexture>(get("texture:" + key));
+}
+
+void ResourceCache::addBuffer(std::string const& key, std::shared_ptr<SharedBuffer> buffer) {
+    add("buffer:" + key, std::move(buffer));
+}
+
+void ResourceCache::addTexture(std::string const& key, std::shared_ptr<SharedTexture> texture) {
+    add("texture:" + key, std::move(texture));
+}
+
+void ResourceCache::add(std::string const& key, std::shared_ptr<SharedResource> resource) {
+    if (mMap.find(key) != mMap.end()) {
+        return;
+    }
+    mSize += resource->size;
+    mEntries.push_front({ key, std::move(resource) });
+    mMap[key] = mEntries.begin();
+    trim();
+}
+
+void ResourceCache::trim() {
+    if (!mBudget) {
+        return;
+    }
+    for (auto iter = mEntries.end(); iter != mEntries.begin() && mSize > mBudget;) {
+        --iter;
+        if (iter->resource.use_count() > 1) {
+            continue;
+        }
+        mSize -= iter->resource->size;
+        mMap.erase(iter->key);
+        iter = mEntries.erase(iter);
+    }
+}
+
+std::string ResourceCache::getContentKey(const void* data, size_t size) {
+    char key[40];
+    snprintf(key, sizeof(key), "%016llx-%zu",
+            (unsigned long long) utils::hash::fnv1a64(data, size), size);
+    return key;
+}
+
+} // namespace details
+} // namespace gltfio
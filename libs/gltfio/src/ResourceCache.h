@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLTFIO_RESOURCECACHE_H
+#define GLTFIO_RESOURCECACHE_H
+
+#include <filament/Engine.h>
+#include <filament/Texture.h>
+
+#include <tsl/robin_map.h>
+
+#include <list>
+#include <memory>
+#include <string>
+
+#include <stddef.h>
+#include <stdlib.h>
+
+namespace gltfio {
+namespace details {
+
+// A resource that can be shared by several assets. Each asset holds a reference to the resources
+// it uses, which are destroyed with the last reference.
+struct SharedResource {
+    explicit SharedResource(size_t size) : size(size) {}
+    virtual ~SharedResource() = default;
+    const size_t size;  // in bytes, counted against the budget of the cache
+};
+
+// The contents of a glTF buffer, allocated with malloc().
+struct SharedBuffer : public SharedResource {
+    SharedBuffer(void* data, size_t size) : SharedResource(size), data(data) {}
+    ~SharedBuffer() override { free(data); }
+    void* const data;
+};
+
+// A texture uploaded to the GPU, destroyed on the thread of the engine.
+struct SharedTexture : public SharedResource {
+    SharedTexture(filament::Engine& engine, filament::Texture* texture, size_t size)
+            : SharedResource(size), engine(engine), texture(texture) {}
+    ~SharedTexture() override { engine.destroy(texture); }
+    filament::Engine& engine;
+    filament::Texture* const texture;
+};
+
+// The ResourceCache keeps the buffers and textures of the assets loaded by a ResourceLoader, so
+// that other assets can reuse them instead of reading and decoding them again. Resources are keyed
+// by their path, or by a hash of their contents when they are embedded.
+//
+// The cache keeps the resources that are no longer used by any asset until the total size of the
+// cached resources exceeds the budget, at which point the least recently used ones are evicted. The
+// resources used by assets cannot be evicted, but they count against the budget.
+class ResourceCache {
+public:
+    explicit ResourceCache(size_t budget) : mBudget(budget) {}
+
+    std::shared_ptr<SharedBuffer> getBuffer(std::string const& key);
+    std::shared_ptr<SharedTexture> getTexture(std::string const& key);
+
+    void addBuffer(std::string const& key, std::shared_ptr<SharedBuffer> buffer);
+    void addTexture(std::string const& key, std::shared_ptr<SharedTexture> texture);
+
+    // Evicts the least recently used resources until the cache is within its budget, or until all
+    // of the remaining resources are in use. This should be called once assets have been destroyed.
+    void trim();
+
+    size_t getSize() const { return mSize; }
+
+    // The key of an embedded resource, e.g. a data URI or an image in a buffer view.
+    static std::string getContentKey(const void* data, size_t size);
+
+private:
+    struct Entry {
+        std::string key;
+        std::shared_ptr<SharedResource> resource;
+    };
+    using EntryList = std::list<Entry>;
+
+    std::shared_ptr<SharedResource> get(std::string const& key);
+    void add(std::string const& key, std::shared_ptr<SharedResource> resource);
+
+    const size_t mBudget;
+    size_t mSize = 0;
+    EntryList mEntries;  // from the most recently used to the least recently used
+    tsl::robin_map<std::string, EntryList::iterator> mMap;
+};
+
+} // namespace details
+} // namespace gltfio
+
+#endif // GLTFIO_RESOURCECACHE_H
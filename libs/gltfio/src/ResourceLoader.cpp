@@ -17,29 +17,51 @@
 #include <gltfio/ResourceLoader.h>
 
 #include "FFilamentAsset.h"
+#include "Quantization.h"
+#include "ResourceCache.h"
+#include "TangentsJob.h"
 #include "upcast.h"
 
 #include <filament/Engine.h>
 #include <filament/IndexBuffer.h>
 #include <filament/MaterialInstance.h>
+#include <filament/RenderableManager.h>
 #include <filament/Texture.h>
 #include <filament/VertexBuffer.h>
 
-#include <geometry/SurfaceOrientation.h>
+#include <image/KtxBundle.h>
+#include <image/KtxUtility.h>
 
 #include <math/quat.h>
 #include <math/vec3.h>
 #include <math/vec4.h>
 
+#include <utils/Condition.h>
+#include <utils/JobSystem.h>
 #include <utils/Log.h>
+#include <utils/Mutex.h>
 
 #include <cgltf.h>
 
 #include <stb_image.h>
 
 #include <tsl/robin_map.h>
+#include <tsl/robin_set.h>
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
 #include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include <ctype.h>
+#include <string.h>
 
 using namespace filament;
 using namespace filament::math;
@@ -86,14 +108,536 @@ private:
     int mPendingUploads = 0;
 };
 
+static constexpr uint8_t KTX_MAGIC[] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x31, 0x31, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+// The header of a KTX file is 64 bytes, starting with its identifier.
+static bool isKtx(const uint8_t* data, size_t size) {
+    return size >= 64 && !memcmp(data, KTX_MAGIC, sizeof(KTX_MAGIC));
+}
+
+static bool hasKtxExtension(const char* uri) {
+    const size_t len = uri ? strlen(uri) : 0;
+    return len >= 4 && uri[len - 4] == '.' && tolower(uri[len - 3]) == 'k' &&
+            tolower(uri[len - 2]) == 't' && tolower(uri[len - 1]) == 'x';
+}
+
+static bool isAccessorLoaded(const cgltf_accessor* accessor) {
+    return !accessor || !accessor->buffer_view || accessor->buffer_view->buffer->data;
+}
+
+static bool isPrimitiveLoaded(const cgltf_primitive& prim) {
+    if (!isAccessorLoaded(prim.indices)) {
+        return false;
+    }
+    for (cgltf_size i = 0; i < prim.attributes_count; ++i) {
+        if (!isAccessorLoaded(prim.attributes[i].data)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A renderable hidden until its primitives are uploaded, with the layer mask to restore.
+struct HiddenRenderable {
+    const cgltf_mesh* mesh;
+    Entity entity;
+    uint8_t layerMask;
+};
+
+// The surface orientations of a primitive, computed by a worker and uploaded from the main thread
+// once completed. The quaternions are freed if they are never uploaded.
+struct PendingTangents {
+    ~PendingTangents() {
+        free(job.quats);
+    }
+    TangentsJob job;
+    std::atomic<bool> completed = { false };
+};
+
+// The state of the buffers of the current load. With asyncBeginLoad() the buffers are read one at
+// a time, and everything that depends on a buffer is processed as soon as it is read. The
+// renderables stay hidden until the data of all their primitives, including their surface
+// orientations, has been uploaded.
+struct BufferStream {
+    FFilamentAsset* asset = nullptr;
+    std::vector<cgltf_buffer*> pendingBuffers;  // in reverse order, the next one is at the back
+    size_t bufferCount = 0;
+    std::vector<bool> uploadedBindings;
+    tsl::robin_set<const cgltf_accessor*> normalizedWeights;
+    tsl::robin_set<const cgltf_primitive*> orientedPrimitives;
+    tsl::robin_map<const cgltf_primitive*, std::unique_ptr<PendingTangents>> pendingTangents;
+    std::vector<HiddenRenderable> hiddenRenderables;
+
+    bool isLoading() const {
+        return asset != nullptr;
+    }
+};
+
+// A unique image of the asset, decoded by a worker. The Texture is created once the image is
+// decoded, the worker only writes the texels and then sets the completed flag. KTX images are not
+// decoded, the worker only parses the container, and their (possibly compressed) mip levels are
+// uploaded as-is. With a budget, the decoded size is first read from the header by a worker too.
+struct TextureCacheEntry {
+    std::vector<TextureBinding> bindings;   // where the texture is used
+    bool srgb = false;
+    void** data = nullptr;                  // the image is either a blob in a buffer...
+    size_t offset = 0;
+    size_t size = 0;
+    utils::Path path;                       // ...or a file
+    bool ktx = false;                       // the file is a KTX container
+    size_t bytes = 0;                       // size of the decoded image, if needed
+    std::atomic<bool> measured = { false }; // bytes has been set
+    bool measuring = false;
+    stbi_uc* texels = nullptr;
+    image::KtxBundle* ktxBundle = nullptr;
+    std::string cacheKey;                   // the key in the ResourceCache, if any
+    std::atomic<bool> keyed = { false };    // cacheKey has been set
+    bool keying = false;
+    Texture* sharedTexture = nullptr;       // the texture found in the ResourceCache
+    int width = 0;
+    int height = 0;
+    std::atomic<bool> completed = { false };
+    bool started = false;
+    bool uploaded = false;
+
+    bool isSourceLoaded() const {
+        return !data || *data;
+    }
+};
+
+// The threads that decode the images and compute the surface orientations, owned by the
+// ResourceLoader. They form a JobSystem separate from the Engine's, so that the load never delays
+// the jobs of the frames that are rendered meanwhile. The tasks are queued from the main thread,
+// which belongs to the Engine's JobSystem, and handed over to the workers by a thread adopted by
+// the loader's JobSystem, no more than one per worker at a time so that they start in order. The
+// threads are started with the first task.
+class WorkerPool {
+public:
+    WorkerPool() = default;
+    WorkerPool(WorkerPool const&) = delete;
+    WorkerPool& operator=(WorkerPool const&) = delete;
+
+    ~WorkerPool() {
+        cancel();
+        if (mDispatcher.joinable()) {
+            {
+                std::lock_guard<Mutex> lock(mLock);
+                mExitRequested = true;
+            }
+            mCondition.notify_all();
+            mDispatcher.join();
+        }
+    }
+
+    void run(std::function<void()> task) {
+        if (!mJobSystem) {
+            // one worker per core but one, which is left to the Engine, and no more than 4
+            const unsigned cores = std::thread::hardware_concurrency();
+            mWorkerCount = std::min(4u, cores > 1 ? cores - 1 : 1u);
+            mJobSystem.reset(new JobSystem(mWorkerCount));
+            mDispatcher = std::thread(&WorkerPool::dispatch, this);
+        }
+        {
+            std::lock_guard<Mutex> lock(mLock);
+            mTasks.push_back(std::move(task));
+            mPendingCount++;
+        }
+        mCondition.notify_all();
+    }
+
+    // Waits for all the tasks that have been run.
+    void wait() {
+        std::unique_lock<Mutex> lock(mLock);
+        mIdleCondition.wait(lock, [this]() { return mPendingCount == 0; });
+    }
+
+    // Drops the tasks that have not started yet and waits for the other ones.
+    void cancel() {
+        std::unique_lock<Mutex> lock(mLock);
+        mPendingCount -= mTasks.size();
+        mTasks.clear();
+        mIdleCondition.wait(lock, [this]() { return mPendingCount == 0; });
+    }
+
+private:
+    void dispatch() {
+        JobSystem& js = *mJobSystem;
+        js.adopt();
+        std::unique_lock<Mutex> lock(mLock);
+        while (true) {
+            mCondition.wait(lock, [this]() {
+                return mExitRequested || (!mTasks.empty() && mRunningCount < mWorkerCount);
+            });
+            if (mExitRequested) {
+                break;
+            }
+            std::function<void()> task = std::move(mTasks.front());
+            mTasks.pop_front();
+            mRunningCount++;
+            lock.unlock();
+            js.run(jobs::createJob(js, nullptr, [this, task]() {
+                task();
+                std::lock_guard<Mutex> lock(mLock);
+                mRunningCount--;
+                if (--mPendingCount == 0) {
+                    mIdleCondition.notify_all();
+                }
+                mCondition.notify_all();
+            }));
+            lock.lock();
+        }
+        lock.unlock();
+        js.emancipate();
+    }
+
+    std::unique_ptr<JobSystem> mJobSystem;
+    std::thread mDispatcher;
+    unsigned mWorkerCount = 0;
+    std::deque<std::function<void()>> mTasks;
+    size_t mPendingCount = 0;   // tasks queued or running
+    size_t mRunningCount = 0;
+    bool mExitRequested = false;
+    Mutex mLock;
+    Condition mCondition;
+    Condition mIdleCondition;
+};
+
+// The TextureCache holds the images of the current load. They are decoded in parallel by the
+// workers of the loader and uploaded from the main thread as they complete. With a budget, the
+// images are decoded only while the decoded size of the images in flight stays within the budget
+// (their size is read from their header), otherwise they are all decoded at once. The workers
+// must be idle when the cache is cancelled or destroyed.
+class TextureCache {
+public:
+    TextureCache(Engine& engine, WorkerPool& workers, size_t budget, ResourceCache* resourceCache)
+            : mEngine(engine), mWorkers(workers), mBudget(budget), mResourceCache(resourceCache) {}
+    ~TextureCache() {
+        cancel();
+    }
+
+    void begin(FFilamentAsset* asset, bool usePlaceholders) {
+        mAsset = asset;
+        mUsePlaceholders = usePlaceholders;
+    }
+
+    // The same image can be used both as a color and as data, which need different textures.
+    TextureCacheEntry* getOrAdd(const void* key, size_t offset, bool srgb) {
+        TextureCacheEntry*& entry = mMap[std::make_tuple(key, offset, srgb)];
+        if (!entry) {
+            mEntries.emplace_back(new TextureCacheEntry);
+            entry = mEntries.back().get();
+        }
+        return entry;
+    }
+
+    // Binds a placeholder until the image is uploaded.
+    void bindPlaceholder(TextureBinding const& tb) {
+        if (mUsePlaceholders) {
+            tb.materialInstance->setParameter(tb.materialParameter,
+                    getPlaceholder(tb.materialParameter), tb.sampler);
+        }
+    }
+
+    // Starts decoding the images whose data is loaded, as long as the budget allows it.
+    void decode() {
+        for (auto& e : mEntries) {
+            TextureCacheEntry* entry = e.get();
+            if (entry->started || !entry->isSourceLoaded()) {
+                continue;
+            }
+            if (mResourceCache) {
+                // hashing an embedded image reads all of it, which is left to the workers
+                if (!entry->keying) {
+                    entry->keying = true;
+                    if (entry->data) {
+                        mWorkers.run([entry]() {
+                            entry->cacheKey = getCacheKey(entry);
+                            entry->keyed.store(true, std::memory_order_release);
+                        });
+                    } else {
+                        entry->cacheKey = getCacheKey(entry);
+                        entry->keyed.store(true, std::memory_order_relaxed);
+                    }
+                }
+                if (!entry->keyed.load(std::memory_order_acquire)) {
+                    continue;
+                }
+                auto shared = mResourceCache->getTexture(entry->cacheKey);
+                if (shared) {
+                    mAsset->mSharedTextures.push_back(shared);
+                    entry->sharedTexture = shared->texture;
+                    entry->started = true;
+                    entry->completed.store(true, std::memory_order_release);
+                    continue;
+                }
+            }
+            if (mBudget) {
+                // reading the header can mean opening a file, which is left to the workers
+                if (!entry->measuring) {
+                    entry->measuring = true;
+                    mWorkers.run([entry]() {
+                        entry->bytes = getDecodedSize(entry);
+                        entry->measured.store(true, std::memory_order_release);
+                    });
+                }
+                if (!entry->measured.load(std::memory_order_acquire)) {
+                    continue;
+                }
+                if (mInFlightBytes && mInFlightBytes + entry->bytes > mBudget) {
+                    break;
+                }
+                mInFlightBytes += entry->bytes;
+            }
+            entry->started = true;
+            mWorkers.run([entry]() {
+                int comp;
+                if (entry->data) {
+                    const uint8_t* data8 = entry->offset + (const uint8_t*) *entry->data;
+                    if (isKtx(data8, entry->size)) {
+                        entry->ktxBundle = new image::KtxBundle(data8, uint32_t(entry->size));
+                    } else {
+                        entry->texels = stbi_load_from_memory(data8, int(entry->size),
+                                &entry->width, &entry->height, &comp, 4);
+                    }
+                } else if (entry->ktx) {
+                    std::vector<uint8_t> contents = readFile(entry->path);
+                    if (isKtx(contents.data(), contents.size())) {
+                        entry->ktxBundle = new image::KtxBundle(contents.data(),
+                                uint32_t(contents.size()));
+                    }
+                } else {
+                    entry->texels = stbi_load(entry->path.c_str(),
+                            &entry->width, &entry->height, &comp, 4);
+                }
+                entry->completed.store(true, std::memory_order_release);
+            });
+        }
+    }
+
+    // Uploads the images that have been decoded since the last call and starts decoding the next
+    // ones.
+    void update() {
+        for (auto& e : mEntries) {
+            TextureCacheEntry* entry = e.get();
+            if (entry->uploaded || !entry->started ||
+                    !entry->completed.load(std::memory_order_acquire)) {
+                continue;
+            }
+            entry->uploaded = true;
+            mInFlightBytes -= entry->bytes;
+            mUploadedCount++;
+            Texture* tex = entry->sharedTexture;
+            if (!tex) {
+                if (!entry->texels && !entry->ktxBundle) {
+                    slog.e << "Unable to decode texture: "
+                            << (entry->data ? "<buffer view>" : entry->path.c_str()) << io::endl;
+                    continue;
+                }
+                tex = entry->ktxBundle ? createKtxTexture(entry) : createTexture(entry);
+                if (!tex) {
+                    continue;
+                }
+            }
+            for (TextureBinding const& tb : entry->bindings) {
+                tb.materialInstance->setParameter(tb.materialParameter, tex, tb.sampler);
+            }
+        }
+        decode();
+    }
+
+    // Drops what has been decoded but not uploaded.
+    void cancel() {
+        for (auto& entry : mEntries) {
+            free(entry->texels);
+            delete entry->ktxBundle;
+        }
+        clear();
+    }
+
+    void clear() {
+        mEntries.clear();
+        mMap.clear();
+        mPlaceholders.clear();
+        mUploadedCount = 0;
+        mInFlightBytes = 0;
+        mAsset = nullptr;
+    }
+
+    bool isLoading() const {
+        return mUploadedCount < mEntries.size();
+    }
+
+    size_t getCount() const {
+        return mEntries.size();
+    }
+
+    size_t getUploadedCount() const {
+        return mUploadedCount;
+    }
+
+private:
+    static std::vector<uint8_t> readFile(utils::Path const& path) {
+        std::ifstream in(path.getPath(), std::ios::binary | std::ios::ate);
+        std::vector<uint8_t> contents;
+        if (in) {
+            contents.resize(size_t(in.tellg()));
+            in.seekg(0);
+            if (!in.read((char*) contents.data(), contents.size())) {
+                contents.clear();
+            }
+        }
+        return contents;
+    }
+
+    static size_t getDecodedSize(TextureCacheEntry const* entry) {
+        int width = 0, height = 0, comp;
+        if (entry->data) {
+            const uint8_t* data8 = entry->offset + (const uint8_t*) *entry->data;
+            if (isKtx(data8, entry->size)) {
+                return entry->size;
+            }
+            stbi_info_from_memory(data8, int(entry->size), &width, &height, &comp);
+        } else if (entry->ktx) {
+            std::ifstream in(entry->path.getPath(), std::ios::binary | std::ios::ate);
+            return in ? size_t(in.tellg()) : 0;
+        } else {
+            stbi_info(entry->path.c_str(), &width, &height, &comp);
+        }
+        return size_t(width) * size_t(height) * 4;
+    }
+
+    Texture* createTexture(TextureCacheEntry* entry) {
+        // TODO: this could be optimized, e.g. do not generate mips if never mipmap-sampled, and use
+        // a more compact format when possible.
+        Engine& engine = mEngine;
+        const uint32_t w = uint32_t(entry->width);
+        const uint32_t h = uint32_t(entry->height);
+        const bool srgb = entry->srgb;
+        Texture *tex = Texture::Builder()
+                .width(w)
+                .height(h)
+                .levels(0xff)
+                .format(srgb ? driver::TextureFormat::SRGB8_A8 : driver::TextureFormat::RGBA8)
+                .build(engine);
+
+        Texture::PixelBufferDescriptor pbd(entry->texels,
+                size_t(w * h * 4),
+                Texture::Format::RGBA,
+                Texture::Type::UBYTE,
+                (driver::BufferDescriptor::Callback) &free);
+        entry->texels = nullptr;
+
+        tex->setImage(engine, 0, std::move(pbd));
+        tex->generateMipmaps(engine);
+        addTexture(entry, tex, size_t(w * h * 4) * 4 / 3);
+        return tex;
+    }
+
+    // Uploads all the mip levels of a KTX image in its own format, compressed or not, the bundle is
+    // destroyed once they have been consumed.
+    Texture* createKtxTexture(TextureCacheEntry* entry) {
+        image::KtxBundle* ktx = entry->ktxBundle;
+        entry->ktxBundle = nullptr;
+        const auto format = image::KtxUtility::toTextureFormat(ktx->getInfo());
+        if (ktx->isCubemap() || !Texture::isTextureFormatSupported(mEngine, format)) {
+            slog.e << "Unsupported KTX texture: "
+                    << (entry->data ? "<buffer view>" : entry->path.c_str()) << io::endl;
+            delete ktx;
+            return nullptr;
+        }
+        const size_t size = ktx->getSerializedLength();
+        Texture* tex = image::KtxUtility::createTexture(&mEngine, ktx, entry->srgb, false);
+        addTexture(entry, tex, size);
+        return tex;
+    }
+
+    // The textures are owned by the asset, or shared with other assets through the ResourceCache.
+    void addTexture(TextureCacheEntry const* entry, Texture* tex, size_t size) {
+        if (!mResourceCache) {
+            mAsset->mTextures.push_back(tex);
+            return;
+        }
+        auto shared = std::make_shared<SharedTexture>(mEngine, tex, size);
+        mAsset->mSharedTextures.push_back(shared);
+        mResourceCache->addTexture(entry->cacheKey, std::move(shared));
+    }
+
+    // Images are identified by their path, or by their contents when they live in a buffer. The
+    // same image can be used both as a color and as data, which need different textures. Hashing
+    // the contents can take a while for large images, it is done by the workers.
+    static std::string getCacheKey(TextureCacheEntry const* entry) {
+        std::string key;
+        if (entry->data) {
+            const uint8_t* data8 = entry->offset + (const uint8_t*) *entry->data;
+            key = ResourceCache::getContentKey(data8, entry->size);
+        } else {
+            key = entry->path.getPath();
+        }
+        return key + (entry->srgb ? ":srgb" : ":linear");
+    }
+
+    // A 1x1 texture that doesn't change the look of the material too much, normal maps get a flat
+    // normal and emissive maps get black.
+    Texture* getPlaceholder(const char* parameter) {
+        uint32_t texel = 0xffffffff;
+        if (!strcmp(parameter, "normalMap")) {
+            texel = 0xffff8080;
+        } else if (!strcmp(parameter, "emissiveMap")) {
+            texel = 0xff000000;
+        }
+        Texture*& tex = mPlaceholders[texel];
+        if (!tex) {
+            Engine& engine = mEngine;
+            tex = Texture::Builder()
+                    .width(1)
+                    .height(1)
+                    .format(driver::TextureFormat::RGBA8)
+                    .build(engine);
+            uint32_t* data = (uint32_t*) malloc(sizeof(uint32_t));
+            *data = texel;
+            Texture::PixelBufferDescriptor pbd(data, sizeof(uint32_t),
+                    Texture::Format::RGBA, Texture::Type::UBYTE,
+                    (driver::BufferDescriptor::Callback) &free);
+            tex->setImage(engine, 0, std::move(pbd));
+            mAsset->mTextures.push_back(tex);
+        }
+        return tex;
+    }
+
+    Engine& mEngine;
+    WorkerPool& mWorkers;
+    const size_t mBudget;
+    ResourceCache* const mResourceCache;
+    FFilamentAsset* mAsset = nullptr;
+    bool mUsePlaceholders = false;
+    std::vector<std::unique_ptr<TextureCacheEntry>> mEntries;
+    std::map<std::tuple<const void*, size_t, bool>, TextureCacheEntry*> mMap;
+    tsl::robin_map<uint32_t, Texture*> mPlaceholders;
+    size_t mUploadedCount = 0;
+    size_t mInFlightBytes = 0;
+};
+
 } // namespace details
 
 using namespace details;
 
 ResourceLoader::ResourceLoader(const ResourceConfiguration& config) : mConfig(config),
-        mPool(new AssetPool) {}
+        mPool(new AssetPool), mBufferStream(new BufferStream),
+        mResourceCache(config.shareResources ?
+                new ResourceCache(config.sharedResourceBudget) : nullptr) {
+    mWorkers = new WorkerPool;
+    mTextureCache = new TextureCache(*config.engine, *mWorkers, config.decodedTextureBudget,
+            mResourceCache);
+}
 
 ResourceLoader::~ResourceLoader() {
+    // the workers reference the source assets, which the pool might release
+    delete mWorkers;
+    delete mTextureCache;
+    delete mBufferStream;
+    delete mResourceCache;
     mPool->onLoaderDestroyed();
 }
 
@@ -119,34 +663,274 @@ static void generateTrivialIndices(uint32_t* dst, size_t numVertices) {
     }
 }
 
+// Repeats the data of a single instance, of size bytes every instanceSize bytes. The data can be
+// smaller than instanceSize when the last element is followed by other attributes in the source.
+static void* repeatInstances(const void* src, size_t size, size_t instanceSize,
+        uint32_t instanceCount) {
+    uint8_t* dst = (uint8_t*) calloc(instanceCount, instanceSize);
+    for (uint32_t i = 0; i < instanceCount; ++i) {
+        memcpy(dst + i * instanceSize, src, size);
+    }
+    return dst;
+}
+
+// Converts indices of 1, 2 or 4 bytes to u32, once per instance with an offset of vertexCount.
+static void repeatIndices(uint32_t* dst, const uint8_t* src, size_t indexCount, uint32_t stride,
+        uint32_t vertexCount, uint32_t instanceCount) {
+    for (size_t i = 0; i < indexCount; ++i, src += stride) {
+        uint32_t index;
+        if (stride == sizeof(uint8_t)) {
+            index = *src;
+        } else if (stride == sizeof(uint16_t)) {
+            uint16_t index16;
+            memcpy(&index16, src, sizeof(index16));
+            index = index16;
+        } else {
+            memcpy(&index, src, sizeof(index));
+        }
+        for (uint32_t instance = 0; instance < instanceCount; ++instance) {
+            dst[instance * indexCount + i] = index + instance * vertexCount;
+        }
+    }
+}
+
+// Shows the renderables whose primitives are all uploaded.
+static void showUploadedRenderables(BufferStream& stream, RenderableManager& rm) {
+    auto& hidden = stream.hiddenRenderables;
+    for (auto it = hidden.begin(); it != hidden.end();) {
+        const cgltf_mesh* mesh = it->mesh;
+        bool uploaded = true;
+        for (cgltf_size i = 0; i < mesh->primitives_count && uploaded; ++i) {
+            const cgltf_primitive& prim = mesh->primitives[i];
+            uploaded = isPrimitiveLoaded(prim) && !stream.pendingTangents.count(&prim);
+        }
+        if (!uploaded) {
+            ++it;
+            continue;
+        }
+        rm.setLayerMask(rm.getInstance(it->entity), 0xff, it->layerMask);
+        it = hidden.erase(it);
+    }
+}
+
 bool ResourceLoader::loadResources(FilamentAsset* asset) {
-    FFilamentAsset* fasset = upcast(asset);
-    mPool->addAsset(fasset);
-    auto gltf = (cgltf_data*) fasset->mSourceAsset;
+    if (!beginLoad(upcast(asset), false)) {
+        return false;
+    }
+    // all the buffers have been read, only the surface orientations and the textures remain
+    BufferStream const& stream = *mBufferStream;
+    while (!stream.pendingTangents.empty() || mTextureCache->isLoading()) {
+        mWorkers->wait();
+        uploadTangents(upcast(asset));
+        mTextureCache->update();
+    }
+    endLoad();
+    return true;
+}
+
+bool ResourceLoader::asyncBeginLoad(FilamentAsset* asset) {
+    return beginLoad(upcast(asset), true);
+}
+
+void ResourceLoader::asyncUpdateLoad() {
+    BufferStream& stream = *mBufferStream;
+    if (!stream.isLoading()) {
+        return;
+    }
+    // read one buffer per update, so that a frame never waits for more than one file
+    if (!stream.pendingBuffers.empty()) {
+        if (!readNextBuffer()) {
+            slog.e << "Unable to load resources." << io::endl;
+            asyncCancelLoad();
+            return;
+        }
+        processBuffers();
+    }
+    uploadTangents(stream.asset);
+    mTextureCache->update();
+    if (stream.pendingBuffers.empty() && stream.pendingTangents.empty() &&
+            !mTextureCache->isLoading()) {
+        endLoad();
+    }
+}
+
+float ResourceLoader::asyncGetLoadProgress() const {
+    BufferStream const& stream = *mBufferStream;
+    if (!stream.isLoading()) {
+        return 1.0f;
+    }
+    // the surface orientations are only counted once their data has been read
+    const size_t total = stream.bufferCount + stream.orientedPrimitives.size() +
+            mTextureCache->getCount();
+    const size_t done = stream.bufferCount - stream.pendingBuffers.size() +
+            stream.orientedPrimitives.size() - stream.pendingTangents.size() +
+            mTextureCache->getUploadedCount();
+    return total ? float(done) / float(total) : 1.0f;
+}
+
+void ResourceLoader::asyncCancelLoad() {
+    mWorkers->cancel();
+    mTextureCache->cancel();
+    endLoad();
+}
+
+bool ResourceLoader::beginLoad(FFilamentAsset* asset, bool async) {
+    BufferStream& stream = *mBufferStream;
+    if (stream.isLoading()) {
+        slog.e << "A load is already in progress." << io::endl;
+        return false;
+    }
+    mPool->addAsset(asset);
+    auto gltf = (cgltf_data*) asset->mSourceAsset;
 
-    // Read data from the file system and base64 URLs.
+    // Assets destroyed since the last load might have left unused resources in the cache.
+    if (mResourceCache) {
+        mResourceCache->trim();
+    }
+
+    stream.asset = asset;
+    stream.uploadedBindings.assign(asset->getBufferBindingCount(), false);
+
+    // The binary chunk of a GLB file is already in memory, other buffers are read from the file
+    // system or decoded from base64 URLs.
+    if (gltf->buffers_count && !gltf->buffers[0].data && !gltf->buffers[0].uri && gltf->bin) {
+        if (gltf->bin_size < gltf->buffers[0].size) {
+            slog.e << "Unable to load resources." << io::endl;
+            endLoad();
+            return false;
+        }
+        gltf->buffers[0].data = (void*) gltf->bin;
+    }
+    for (cgltf_size i = gltf->buffers_count; i > 0; --i) {
+        if (!gltf->buffers[i - 1].data) {
+            stream.pendingBuffers.push_back(&gltf->buffers[i - 1]);
+        }
+    }
+    stream.bufferCount = stream.pendingBuffers.size();
+
+    // Hide the renderables until their data is uploaded.
+    if (async) {
+        RenderableManager& rm = mConfig.engine->getRenderableManager();
+        auto hide = [&rm, &stream](const cgltf_mesh* mesh, Entity entity) {
+            auto instance = rm.getInstance(entity);
+            if (mesh && instance) {
+                stream.hiddenRenderables.push_back({ mesh, entity, rm.getLayerMask(instance) });
+                rm.setLayerMask(instance, 0xff, 0);
+            }
+        };
+        for (auto iter : asset->mNodeMap) {
+            hide(iter.first->mesh, iter.second);
+        }
+        for (const InstancedRenderable& renderable : asset->mInstancedRenderables) {
+            hide(renderable.mesh, renderable.entity);
+        }
+    }
+
+    createTextures(asset, async);
+
+    if (!async) {
+        while (!stream.pendingBuffers.empty()) {
+            if (!readNextBuffer()) {
+                slog.e << "Unable to load resources." << io::endl;
+                asyncCancelLoad();
+                return false;
+            }
+        }
+    }
+    processBuffers();
+    return true;
+}
+
+void ResourceLoader::endLoad() {
+    BufferStream& stream = *mBufferStream;
+    mTextureCache->clear();
+    stream = BufferStream();
+}
+
+bool ResourceLoader::readNextBuffer() {
+    BufferStream& stream = *mBufferStream;
+    cgltf_buffer* buffer = stream.pendingBuffers.back();
+    stream.pendingBuffers.pop_back();
+
+    // cgltf_load_buffers() reads all the buffers of the asset, so we give it a shallow copy that
+    // only has this one.
+    std::string key;
+    if (mResourceCache && buffer->uri) {
+        key = strncmp(buffer->uri, "data:", 5) ?
+                (mConfig.basePath + buffer->uri).getPath() :
+                ResourceCache::getContentKey(buffer->uri, strlen(buffer->uri));
+        auto shared = mResourceCache->getBuffer(key);
+        if (shared && shared->size >= buffer->size) {
+            buffer->data = shared->data;
+            stream.asset->mSharedBuffers.push_back(shared);
+            return true;
+        }
+    }
+
+    cgltf_data single = *stream.asset->mSourceAsset;
+    single.buffers = buffer;
+    single.buffers_count = 1;
+    single.bin = nullptr;
     cgltf_options options {};
-    cgltf_result result = cgltf_load_buffers(&options, gltf, mConfig.basePath.c_str());
-    if (result != cgltf_result_success) {
-        slog.e << "Unable to load resources." << io::endl;
+    if (cgltf_load_buffers(&options, &single, mConfig.basePath.c_str()) != cgltf_result_success) {
         return false;
     }
 
+    // The buffer is now owned by the assets that use it, see FFilamentAsset::releaseSourceAsset.
+    if (!key.empty()) {
+        auto shared = std::make_shared<SharedBuffer>(buffer->data, buffer->size);
+        stream.asset->mSharedBuffers.push_back(shared);
+        mResourceCache->addBuffer(key, std::move(shared));
+    }
+    return true;
+}
+
+void ResourceLoader::processBuffers() {
+    BufferStream& stream = *mBufferStream;
+    FFilamentAsset* asset = stream.asset;
+    auto gltf = (cgltf_data*) asset->mSourceAsset;
+
     // To be robust against the glTF conformance suite, we optionally ensure that skinning weights
     // sum to 1.0 at every vertex. Note that if the same weights buffer is shared in multiple
     // places, this will needlessly repeat the work. In the future we would like to remove this
     // feature, and instead simply require correct models. See also:
     // https://github.com/KhronosGroup/glTF-Sample-Models/issues/215
     if (mConfig.normalizeSkinningWeights) {
-        normalizeWeights(fasset);
+        normalizeWeights(asset);
     }
 
-    // Upload data to the GPU.
+    // Upload the data that has been read to the GPU.
     const BufferBinding* bindings = asset->getBufferBindings();
     for (size_t i = 0, n = asset->getBufferBindingCount(); i < n; ++i) {
         auto bb = bindings[i];
-        const uint8_t* data8 = bb.offset + (const uint8_t*) *bb.data;
-        if (bb.vertexBuffer) {
+        if (stream.uploadedBindings[i] || !(bb.generateTrivialIndices || *bb.data)) {
+            continue;
+        }
+        stream.uploadedBindings[i] = true;
+        const uint8_t* data8 = bb.data ? bb.offset + (const uint8_t*) *bb.data : nullptr;
+        if (bb.vertexBuffer && (bb.quantization != VertexQuantization::NONE ||
+                bb.instanceCount > 1)) {
+            // Quantized attributes are tightly packed, other ones keep their source stride.
+            void* converted = nullptr;
+            const void* source = data8;
+            size_t size = bb.size;
+            size_t instanceSize = size_t(bb.sourceStride) * bb.vertexCount;
+            if (bb.quantization != VertexQuantization::NONE) {
+                source = converted = quantizeVertices(data8, bb.sourceStride, bb.vertexCount,
+                        bb.componentCount, bb.quantization);
+                size = instanceSize = getQuantizedSize(bb.quantization, bb.componentCount,
+                        bb.vertexCount);
+            }
+            if (bb.instanceCount > 1) {
+                void* instances = repeatInstances(source, size, instanceSize, bb.instanceCount);
+                free(converted);
+                converted = instances;
+                size = instanceSize * bb.instanceCount;
+            }
+            auto callback = (VertexBuffer::BufferDescriptor::Callback) free;
+            VertexBuffer::BufferDescriptor bd(converted, size, callback);
+            bb.vertexBuffer->setBufferAt(*mConfig.engine, bb.bufferIndex, std::move(bd));
+        } else if (bb.vertexBuffer) {
             mPool->addPendingUpload();
             VertexBuffer::BufferDescriptor bd(data8, bb.size, AssetPool::onLoadedResource, mPool);
             bb.vertexBuffer->setBufferAt(*mConfig.engine, bb.bufferIndex, std::move(bd));
@@ -156,6 +940,15 @@ bool ResourceLoader::loadResources(FilamentAsset* asset) {
             auto callback = (IndexBuffer::BufferDescriptor::Callback) free;
             IndexBuffer::BufferDescriptor bd(data32, bb.size, callback);
             bb.indexBuffer->setBuffer(*mConfig.engine, std::move(bd));
+        } else if (bb.indexBuffer && bb.instanceCount > 1) {
+            const size_t indexCount = bb.size / bb.sourceStride;
+            const size_t size32 = indexCount * bb.instanceCount * sizeof(uint32_t);
+            uint32_t* data32 = (uint32_t*) malloc(size32);
+            repeatIndices(data32, data8, indexCount, bb.sourceStride, bb.vertexCount,
+                    bb.instanceCount);
+            auto callback = (IndexBuffer::BufferDescriptor::Callback) free;
+            IndexBuffer::BufferDescriptor bd(data32, size32, callback);
+            bb.indexBuffer->setBuffer(*mConfig.engine, std::move(bd));
         } else if (bb.convertBytesToShorts) {
             size_t size16 = bb.size * 2;
             uint16_t* data16 = (uint16_t*) malloc(size16);
@@ -170,214 +963,114 @@ bool ResourceLoader::loadResources(FilamentAsset* asset) {
         }
     }
 
-    // Copy over the inverse bind matrices to allow users to destroy the source asset.
-    for (cgltf_size i = 0, len = gltf->skins_count; i < len; ++i) {
-        importSkinningData(fasset->mSkins[i], gltf->skins[i]);
-    }
-
     // Compute surface orientation quaternions if necessary.
-    computeTangents(fasset);
+    computeTangents(asset);
 
-    // Finally, load image files and create Filament Textures.
-    return createTextures(fasset);
-}
-
-bool ResourceLoader::createTextures(details::FFilamentAsset* asset) const {
-    // Define a simple functor that creates a Filament Texture from a blob of texels.
-    // TODO: this could be optimized, e.g. do not generate mips if never mipmap-sampled, and use a
-    // more compact format when possible.
-    auto createTexture = [this, asset](stbi_uc* texels, uint32_t w, uint32_t h, bool srgb) {
-        Texture *tex = Texture::Builder()
-                .width(w)
-                .height(h)
-                .levels(0xff)
-                .format(srgb ? driver::TextureFormat::SRGB8_A8 : driver::TextureFormat::RGBA8)
-                .build(*mConfig.engine);
+    showUploadedRenderables(stream, mConfig.engine->getRenderableManager());
 
-        Texture::PixelBufferDescriptor pbd(texels,
-                size_t(w * h * 4),
-                Texture::Format::RGBA,
-                Texture::Type::UBYTE,
-                (driver::BufferDescriptor::Callback) &free);
+    // Copy over the inverse bind matrices to allow users to destroy the source asset.
+    if (stream.pendingBuffers.empty()) {
+        for (cgltf_size i = 0, len = gltf->skins_count; i < len; ++i) {
+            importSkinningData(asset->mSkins[i], gltf->skins[i]);
+        }
+    }
 
-        tex->setImage(*mConfig.engine, 0, std::move(pbd));
-        tex->generateMipmaps(*mConfig.engine);
-        asset->mTextures.push_back(tex);
-        return tex;
-    };
+    // Start decoding the images that live in the buffers that have been read.
+    mTextureCache->decode();
+}
 
-    // Decode textures and associate them with material instance parameters.
-    // To prevent needless re-decoding, we create a small map of Filament Texture objects where the
-    // map key is (usually) a pointer to a URI string. In the case of buffer view textures, the
-    // cache key is a data pointer.
-    stbi_uc* texels;
-    int width, height, comp;
-    Texture* tex;
-    tsl::robin_map<const void*, Texture*> textures;
+void ResourceLoader::createTextures(details::FFilamentAsset* asset, bool usePlaceholders) {
+    // Associate the images with material instance parameters, the textures are created and bound
+    // once the images are decoded. Until then, placeholders are bound if needed.
+    // To prevent needless re-decoding, we create a small map of images where the map key is
+    // (usually) a pointer to a URI string. In the case of buffer view textures, the cache key is
+    // the location of the data in the source asset.
+    mTextureCache->begin(asset, usePlaceholders);
     const TextureBinding* texbindings = asset->getTextureBindings();
     for (size_t i = 0, n = asset->getTextureBindingCount(); i < n; ++i) {
         auto tb = texbindings[i];
+        TextureCacheEntry* entry;
         if (tb.data) {
-            const uint8_t* data8 = tb.offset + (const uint8_t*) *tb.data;
-            tex = textures[data8];
-            if (!tex) {
-                texels = stbi_load_from_memory(data8, tb.totalSize, &width, &height, &comp, 4);
-                if (texels == nullptr) {
-                    slog.e << "Unable to decode texture. " << io::endl;
-                    return false;
-                }
-                textures[data8] = tex = createTexture(texels, width, height, tb.srgb);
-            }
+            entry = mTextureCache->getOrAdd(tb.data, tb.offset, tb.srgb);
+            entry->data = tb.data;
+            entry->offset = tb.offset;
+            entry->size = tb.totalSize;
         } else {
-            tex = textures[tb.uri];
-            if (!tex) {
-                utils::Path fullpath = this->mConfig.basePath + tb.uri;
-                texels = stbi_load(fullpath.c_str(), &width, &height, &comp, 4);
-                if (texels == nullptr) {
-                    slog.e << "Unable to decode texture: " << tb.uri << io::endl;
-                    return false;
-                }
-                textures[tb.uri] = tex = createTexture(texels, width, height, tb.srgb);
-            }
+            entry = mTextureCache->getOrAdd(tb.uri, 0, tb.srgb);
+            entry->path = mConfig.basePath + tb.uri;
+            entry->ktx = (tb.mimeType && !strcmp(tb.mimeType, "image/ktx")) ||
+                    hasKtxExtension(tb.uri);
         }
-        tb.materialInstance->setParameter(tb.materialParameter, tex, tb.sampler);
+        entry->srgb = tb.srgb;
+        entry->bindings.push_back(tb);
+        mTextureCache->bindPlaceholder(tb);
     }
-    return true;
 }
 
-void ResourceLoader::computeTangents(FFilamentAsset* asset) const {
-    // Declare vectors of normals and tangents, which we'll extract & convert from the source.
-    std::vector<float3> fp32Normals;
-    std::vector<float4> fp32Tangents;
-    std::vector<float3> fp32Positions;
-    std::vector<float2> fp32TexCoords;
-    std::vector<uint3> ui32Triangles;
-
-    auto computeQuats = [&](const cgltf_primitive& prim) {
-
-        cgltf_size vertexCount = 0;
-
-        // Collect accessors for normals, tangents, etc.
-        const int NUM_ATTRIBUTES = 8;
-        int slots[NUM_ATTRIBUTES] = {};
-        const cgltf_accessor* accessors[NUM_ATTRIBUTES] = {};
-        for (cgltf_size slot = 0; slot < prim.attributes_count; slot++) {
-            const cgltf_attribute& attr = prim.attributes[slot];
-            // Ignore the second set of UV's.
-            if (attr.index != 0) {
-                continue;
-            }
-            vertexCount = attr.data->count;
-            slots[attr.type] = slot;
-            accessors[attr.type] = attr.data;
-        }
-
-        // At a minimum we need normals to generate tangents.
-        auto normalsInfo = accessors[cgltf_attribute_type_normal];
-        if (normalsInfo == nullptr || vertexCount == 0) {
-            return;
-        }
-
-        short4* quats = (short4*) malloc(sizeof(short4) * vertexCount);
-
-        geometry::SurfaceOrientation::Builder sob;
-        sob.vertexCount(vertexCount);
-
-        // Convert normals into packed floats.
-        assert(normalsInfo->count == vertexCount);
-        assert(normalsInfo->type == cgltf_type_vec3);
-        fp32Normals.resize(vertexCount);
-        for (cgltf_size i = 0; i < vertexCount; ++i) {
-            cgltf_accessor_read_float(normalsInfo, i, &fp32Normals[i].x, 3);
-        }
-        sob.normals(fp32Normals.data());
-
-        // Convert tangents into packed floats.
-        auto tangentsInfo = accessors[cgltf_attribute_type_tangent];
-        if (tangentsInfo) {
-            if (tangentsInfo->count != vertexCount || tangentsInfo->type != cgltf_type_vec4) {
-                slog.e << "Bad tangent count or type." << io::endl;
-                return;
-            }
-            fp32Tangents.resize(vertexCount);
-            for (cgltf_size i = 0; i < vertexCount; ++i) {
-                cgltf_accessor_read_float(tangentsInfo, i, &fp32Tangents[i].x, 4);
+void ResourceLoader::computeTangents(FFilamentAsset* asset) {
+    // Each primitive is processed once, as soon as its data has been read, by a worker of the
+    // loader. Its data is read in parallel by the other workers.
+    BufferStream& stream = *mBufferStream;
+    for (auto iter : asset->mNodeMap) {
+        const cgltf_mesh* mesh = iter.first->mesh;
+        if (mesh) {
+            cgltf_size nprims = mesh->primitives_count;
+            for (cgltf_size index = 0; index < nprims; ++index) {
+                const cgltf_primitive& prim = mesh->primitives[index];
+                if (isPrimitiveLoaded(prim) && TangentsJob::needsQuats(prim) &&
+                        stream.orientedPrimitives.insert(&prim).second) {
+                    PendingTangents* pending = new PendingTangents;
+                    pending->job.primitive = &prim;
+                    stream.pendingTangents[&prim].reset(pending);
+                    mWorkers->run([pending]() {
+                        pending->job.run(*JobSystem::getJobSystem());
+                        pending->completed.store(true, std::memory_order_release);
+                    });
+                }
             }
-            sob.tangents(fp32Tangents.data());
         }
+    }
+}
 
-        auto positionsInfo = accessors[cgltf_attribute_type_position];
-        if (positionsInfo) {
-            if (positionsInfo->count != vertexCount || positionsInfo->type != cgltf_type_vec3) {
-                slog.e << "Bad position count or type." << io::endl;
-                return;
-            }
-            fp32Positions.resize(vertexCount);
-            for (cgltf_size i = 0; i < vertexCount; ++i) {
-                cgltf_accessor_read_float(positionsInfo, i, &fp32Positions[i].x, 3);
-            }
-            sob.positions(fp32Positions.data());
+void ResourceLoader::uploadTangents(FFilamentAsset* asset) {
+    // Upload the quaternions that have been computed since the last call to the GPU.
+    BufferStream& stream = *mBufferStream;
+    auto& pendingTangents = stream.pendingTangents;
+    for (auto it = pendingTangents.begin(); it != pendingTangents.end();) {
+        TangentsJob& task = it->second->job;
+        if (!it->second->completed.load(std::memory_order_acquire)) {
+            ++it;
+            continue;
         }
-
-        if (prim.indices) {
-            size_t triangleCount = prim.indices->count / 3;
-            ui32Triangles.resize(triangleCount);
-            cgltf_size j = 0;
-            for (auto& triangle : ui32Triangles) {
-                triangle.x = cgltf_accessor_read_index(prim.indices, j++);
-                triangle.y = cgltf_accessor_read_index(prim.indices, j++);
-                triangle.z = cgltf_accessor_read_index(prim.indices, j++);
-            }
-        } else {
-            size_t triangleCount = vertexCount / 3;
-            ui32Triangles.resize(triangleCount);
-            cgltf_size j = 0;
-            for (auto& triangle : ui32Triangles) {
-                triangle.x = j++;
-                triangle.y = j++;
-                triangle.z = j++;
-            }
+        if (!task.quats && task.error) {
+            slog.e << task.error << io::endl;
         }
-
-        sob.triangleCount(ui32Triangles.size());
-        sob.triangles(ui32Triangles.data());
-
-        auto texcoordsInfo = accessors[cgltf_attribute_type_texcoord];
-        if (texcoordsInfo) {
-            if (texcoordsInfo->count != vertexCount || texcoordsInfo->type != cgltf_type_vec2) {
-                slog.e << "Bad texcoord count or type." << io::endl;
-                return;
+        if (task.quats) {
+            const size_t size = task.vertexCount * sizeof(short4);
+            auto callback = (VertexBuffer::BufferDescriptor::Callback) free;
+            auto instanced = asset->mInstancedPrimMap.find(task.primitive);
+            if (instanced != asset->mInstancedPrimMap.end()) {
+                for (const InstancedBuffer& buffer : instanced->second) {
+                    void* quats = repeatInstances(task.quats, size, size, buffer.instanceCount);
+                    VertexBuffer::BufferDescriptor bd(quats, size * buffer.instanceCount,
+                            callback);
+                    buffer.vertices->setBufferAt(*mConfig.engine, task.normalSlot, std::move(bd));
+                }
             }
-            fp32TexCoords.resize(vertexCount);
-            for (cgltf_size i = 0; i < vertexCount; ++i) {
-                cgltf_accessor_read_float(texcoordsInfo, i, &fp32TexCoords[i].x, 2);
-            }
-            sob.uvs(fp32TexCoords.data());
-        }
-
-        // Compute surface orientation quaternions.
-        auto helper = sob.build();
-        helper.getQuats(quats, vertexCount);
-
-        // Upload quaternions to the GPU.
-        auto callback = (VertexBuffer::BufferDescriptor::Callback) free;
-        VertexBuffer::BufferDescriptor bd(quats, vertexCount * sizeof(short4), callback);
-        VertexBuffer* vb = asset->mPrimMap.at(&prim);
-        vb->setBufferAt(*mConfig.engine, slots[cgltf_attribute_type_normal], std::move(bd));
-    };
-
-    for (auto iter : asset->mNodeMap) {
-        const cgltf_mesh* mesh = iter.first->mesh;
-        if (mesh) {
-            cgltf_size nprims = mesh->primitives_count;
-            for (cgltf_size index = 0; index < nprims; ++index) {
-                computeQuats(mesh->primitives[index]);
+            auto iter = asset->mPrimMap.find(task.primitive);
+            if (iter != asset->mPrimMap.end()) {
+                VertexBuffer::BufferDescriptor bd(task.quats, size, callback);
+                iter->second->setBufferAt(*mConfig.engine, task.normalSlot, std::move(bd));
+                task.quats = nullptr;
             }
         }
+        it = pendingTangents.erase(it);
     }
+
+    showUploadedRenderables(stream, mConfig.engine->getRenderableManager());
 }
 
-void ResourceLoader::normalizeWeights(details::FFilamentAsset* asset) const {
+void ResourceLoader::normalizeWeights(details::FFilamentAsset* asset) {
     auto normalize = [](cgltf_accessor* data) {
         if (data->type != cgltf_type_vec4 || data->component_type != cgltf_component_type_r_32f) {
             slog.w << "Cannot normalize weights, unsupported attribute type." << io::endl;
@@ -391,6 +1084,7 @@ void ResourceLoader::normalizeWeights(details::FFilamentAsset* asset) const {
             floats[i] = weights / sum;
         }
     };
+    BufferStream& stream = *mBufferStream;
     const cgltf_data* gltf = asset->mSourceAsset;
     cgltf_size mcount = gltf->meshes_count;
     for (cgltf_size mindex = 0; mindex < mcount; ++mindex) {
@@ -401,7 +1095,8 @@ void ResourceLoader::normalizeWeights(details::FFilamentAsset* asset) const {
             cgltf_size acount = prim.attributes_count;
             for (cgltf_size aindex = 0; aindex < acount; ++aindex) {
                 const auto& attr = prim.attributes[aindex];
-                if (attr.type == cgltf_attribute_type_weights) {
+                if (attr.type == cgltf_attribute_type_weights && isAccessorLoaded(attr.data) &&
+                        stream.normalizedWeights.insert(attr.data).second) {
                     normalize(attr.data);
                 }
             }
@@ -0,0 +1,136 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "SkinCache.h"
+
+#include <string.h>
+
+using namespace filament;
+using namespace filament::math;
+using namespace utils;
+
+namespace gltfio {
+namespace details {
+
+static bool isEqual(mat4f const& a, mat4f const& b) {
+    return !memcmp(&a, &b, sizeof(mat4f));
+}
+
+void SkinCache::update(const Skin& skin, RenderableManager& renderableManager,
+        TransformManager& transformManager) {
+    const size_t njoints = skin.joints.size();
+    const size_t ntargets = skin.targets.size();
+    if (!valid) {
+        jointTransforms.resize(njoints);
+        skinMatrices.resize(njoints);
+        targetTransforms.resize(ntargets);
+        boneMatrices.resize(ntargets);
+        targetMatrices.resize(ntargets);
+        renderables.resize(ntargets);
+        changed.resize(ntargets);
+    }
+
+    bool jointsChanged = !valid;
+    for (size_t boneIndex = 0; boneIndex < njoints; ++boneIndex) {
+        TransformManager::Instance jointInstance =
+                transformManager.getInstance(skin.joints[boneIndex]);
+        mat4f globalJointTransform = transformManager.getWorldTransform(jointInstance);
+        if (!isEqual(globalJointTransform, jointTransforms[boneIndex])) {
+            jointTransforms[boneIndex] = globalJointTransform;
+            jointsChanged = true;
+        }
+    }
+    if (jointsChanged) {
+        for (size_t boneIndex = 0; boneIndex < njoints; ++boneIndex) {
+            skinMatrices[boneIndex] =
+                    jointTransforms[boneIndex] * skin.inverseBindMatrices[boneIndex];
+        }
+    }
+
+    for (size_t target = 0; target < ntargets; ++target) {
+        const Entity entity = skin.targets[target];
+        auto renderable = renderableManager.getInstance(entity);
+        renderables[target] = renderable;
+        changed[target] = false;
+        if (!renderable) {
+            continue;
+        }
+        mat4f globalTransform;
+        auto xformable = transformManager.getInstance(entity);
+        if (xformable) {
+            globalTransform = transformManager.getWorldTransform(xformable);
+        }
+        if (valid && !jointsChanged && isEqual(globalTransform, targetTransforms[target])) {
+            continue;
+        }
+        targetTransforms[target] = globalTransform;
+        changed[target] = true;
+
+        // Targets are usually at the origin, otherwise share the matrices of a previous target
+        // that has the same transform.
+        if (isEqual(globalTransform, mat4f())) {
+            targetMatrices[target] = skinMatrices.data();
+            continue;
+        }
+        size_t other = 0;
+        while (other < target && !(renderables[other] &&
+                isEqual(globalTransform, targetTransforms[other]))) {
+            ++other;
+        }
+        if (other < target) {
+            targetMatrices[target] = targetMatrices[other];
+            continue;
+        }
+        std::vector<mat4f>& matrices = boneMatrices[target];
+        matrices.resize(njoints);
+        const mat4f inverseGlobalTransform = inverse(globalTransform);
+        for (size_t boneIndex = 0; boneIndex < njoints; ++boneIndex) {
+            matrices[boneIndex] = inverseGlobalTransform * skinMatrices[boneIndex];
+        }
+        targetMatrices[target] = matrices.data();
+    }
+    valid = true;
+}
+
+void updateSkins(const Skin* skins, SkinCache* caches, size_t count,
+        RenderableManager& renderableManager, TransformManager& transformManager, JobSystem& js) {
+    if (count == 0) {
+        return;
+    }
+
+    // The skins are independent, compute their matrices in parallel...
+    js.runAndWait(jobs::parallel_for(js, nullptr, 0, uint32_t(count),
+            [&](uint32_t start, uint32_t n) {
+                for (uint32_t i = start; i < start + n; ++i) {
+                    caches[i].update(skins[i], renderableManager, transformManager);
+                }
+            }, jobs::CountSplitter<1>()));
+
+    // ...then upload the ones that have changed.
+    for (size_t i = 0; i < count; ++i) {
+        SkinCache const& cache = caches[i];
+        const size_t njoints = skins[i].joints.size();
+        for (size_t target = 0, n = cache.changed.size(); target < n; ++target) {
+            if (cache.changed[target]) {
+                renderableManager.setBones(cache.renderables[target],
+                        cache.targetMatrices[target], njoints);
+            }
+        }
+    }
+}
+
+} // namespace details
+} // namespace gltfio
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLTFIO_SKINCACHE_H
+#define GLTFIO_SKINCACHE_H
+
+#include "FFilamentAsset.h"
+
+#include <filament/RenderableManager.h>
+#include <filament/TransformManager.h>
+
+#include <utils/JobSystem.h>
+
+#include <math/mat4.h>
+
+#include <vector>
+
+#include <stddef.h>
+
+namespace gltfio {
+namespace details {
+
+// The bone matrices of a skin are only recomputed when its joints or its targets have moved, and
+// the targets that have the same world transform share the same matrices.
+struct SkinCache {
+    bool valid = false;
+    std::vector<filament::math::mat4f> jointTransforms;     // world transforms of the joints
+    std::vector<filament::math::mat4f> skinMatrices;        // joint transforms * inverse binds
+    std::vector<filament::math::mat4f> targetTransforms;    // world transforms of the targets
+    std::vector<std::vector<filament::math::mat4f>> boneMatrices;  // per target, unless shared
+    std::vector<const filament::math::mat4f*> targetMatrices;      // bone matrices of each target
+    std::vector<filament::RenderableManager::Instance> renderables;
+    std::vector<bool> changed;      // targets whose matrices need to be uploaded
+
+    // Computes the bone matrices of the targets of the skin that have changed. This only reads the
+    // transforms, so it can run concurrently for several skins.
+    void update(const Skin& skin, filament::RenderableManager& renderableManager,
+            filament::TransformManager& transformManager);
+};
+
+// Updates the caches of the given skins in parallel, then uploads the bone matrices of the targets
+// that have changed. This must be called from a thread that belongs to the JobSystem.
+void updateSkins(const Skin* skins, SkinCache* caches, size_t count,
+        filament::RenderableManager& renderableManager,
+        filament::TransformManager& transformManager, utils::JobSystem& js);
+
+} // namespace details
+} // namespace gltfio
+
+#endif // GLTFIO_SKINCACHE_H
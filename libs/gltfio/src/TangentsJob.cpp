@@ -0,0 +1,211 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "TangentsJob.h"
+
+#include <geometry/SurfaceOrientation.h>
+
+#include <math/vec2.h>
+#include <math/vec3.h>
+
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace filament;
+using namespace filament::math;
+using namespace utils;
+
+namespace gltfio {
+namespace details {
+
+// Accessors are read in parallel over ranges of at least this many elements.
+static constexpr size_t ELEMENTS_PER_JOB = 16 * 1024;
+
+static const uint8_t* getElements(const cgltf_accessor* accessor, size_t start) {
+    const cgltf_buffer_view* view = accessor->buffer_view;
+    if (accessor->is_sparse || !view || !view->buffer->data) {
+        return nullptr;
+    }
+    return (const uint8_t*) view->buffer->data + view->offset + accessor->offset +
+            accessor->stride * start;
+}
+
+// Reads a range of elements of a float accessor, the data is copied directly unless it needs to
+// be converted, e.g. normalized integers.
+template<typename T>
+static void readFloats(const cgltf_accessor* accessor, size_t start, size_t count, T* out) {
+    const uint8_t* src = getElements(accessor, start);
+    if (src && accessor->component_type == cgltf_component_type_r_32f) {
+        if (accessor->stride == sizeof(T)) {
+            memcpy(out + start, src, count * sizeof(T));
+        } else {
+            for (size_t i = 0; i < count; ++i, src += accessor->stride) {
+                memcpy(out + start + i, src, sizeof(T));
+            }
+        }
+        return;
+    }
+    for (size_t i = start, end = start + count; i < end; ++i) {
+        cgltf_accessor_read_float(accessor, i, &out[i].x, sizeof(T) / sizeof(float));
+    }
+}
+
+static void readIndices(const cgltf_accessor* accessor, size_t start, size_t count,
+        uint32_t* out) {
+    const uint8_t* src = getElements(accessor, start);
+    const size_t stride = accessor->stride;
+    if (src && accessor->component_type == cgltf_component_type_r_32u && stride == 4) {
+        memcpy(out + start, src, count * sizeof(uint32_t));
+    } else if (src && accessor->component_type == cgltf_component_type_r_16u) {
+        for (size_t i = 0; i < count; ++i, src += stride) {
+            uint16_t index;
+            memcpy(&index, src, sizeof(index));
+            out[start + i] = index;
+        }
+    } else {
+        for (size_t i = start, end = start + count; i < end; ++i) {
+            out[i] = uint32_t(cgltf_accessor_read_index(accessor, i));
+        }
+    }
+}
+
+// Starts reading an accessor as a child of the given job, split over ranges of elements.
+template<typename T>
+static void readParallel(JobSystem& js, JobSystem::Job* parent, const cgltf_accessor* accessor,
+        T* out) {
+    js.run(jobs::parallel_for(js, parent, 0, uint32_t(accessor->count),
+            [accessor, out](uint32_t start, uint32_t count) {
+                readFloats(accessor, start, count, out);
+            }, jobs::CountSplitter<ELEMENTS_PER_JOB>()));
+}
+
+bool TangentsJob::needsQuats(const cgltf_primitive& primitive) {
+    for (cgltf_size slot = 0; slot < primitive.attributes_count; slot++) {
+        const cgltf_attribute& attr = primitive.attributes[slot];
+        if (attr.type == cgltf_attribute_type_normal && attr.index == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void TangentsJob::run(JobSystem& js) {
+    const cgltf_primitive& prim = *primitive;
+
+    // Collect accessors for normals, tangents, etc.
+    const int NUM_ATTRIBUTES = 8;
+    const cgltf_accessor* accessors[NUM_ATTRIBUTES] = {};
+    for (cgltf_size slot = 0; slot < prim.attributes_count; slot++) {
+        const cgltf_attribute& attr = prim.attributes[slot];
+        // Ignore the second set of UV's.
+        if (attr.index != 0) {
+            continue;
+        }
+        vertexCount = attr.data->count;
+        accessors[attr.type] = attr.data;
+        if (attr.type == cgltf_attribute_type_normal) {
+            normalSlot = int(slot);
+        }
+    }
+
+    // At a minimum we need normals to generate tangents.
+    auto normalsInfo = accessors[cgltf_attribute_type_normal];
+    if (normalsInfo == nullptr || vertexCount == 0) {
+        return;
+    }
+
+    auto tangentsInfo = accessors[cgltf_attribute_type_tangent];
+    auto positionsInfo = accessors[cgltf_attribute_type_position];
+    auto texcoordsInfo = accessors[cgltf_attribute_type_texcoord];
+    if (normalsInfo->count != vertexCount || normalsInfo->type != cgltf_type_vec3) {
+        error = "Bad normal count or type.";
+        return;
+    }
+    if (tangentsInfo &&
+            (tangentsInfo->count != vertexCount || tangentsInfo->type != cgltf_type_vec4)) {
+        error = "Bad tangent count or type.";
+        return;
+    }
+    if (positionsInfo &&
+            (positionsInfo->count != vertexCount || positionsInfo->type != cgltf_type_vec3)) {
+        error = "Bad position count or type.";
+        return;
+    }
+    if (texcoordsInfo &&
+            (texcoordsInfo->count != vertexCount || texcoordsInfo->type != cgltf_type_vec2)) {
+        error = "Bad texcoord count or type.";
+        return;
+    }
+
+    // Convert the attributes and the indices into packed arrays, all in parallel.
+    std::vector<float3> fp32Normals(vertexCount);
+    std::vector<float4> fp32Tangents(tangentsInfo ? vertexCount : 0);
+    std::vector<float3> fp32Positions(positionsInfo ? vertexCount : 0);
+    std::vector<float2> fp32TexCoords(texcoordsInfo ? vertexCount : 0);
+    std::vector<uint3> ui32Triangles((prim.indices ? prim.indices->count : vertexCount) / 3);
+
+    JobSystem::Job* parent = js.createJob();
+    readParallel(js, parent, normalsInfo, fp32Normals.data());
+    if (tangentsInfo) {
+        readParallel(js, parent, tangentsInfo, fp32Tangents.data());
+    }
+    if (positionsInfo) {
+        readParallel(js, parent, positionsInfo, fp32Positions.data());
+    }
+    if (texcoordsInfo) {
+        readParallel(js, parent, texcoordsInfo, fp32TexCoords.data());
+    }
+    if (prim.indices) {
+        const cgltf_accessor* indices = prim.indices;
+        uint32_t* out = &ui32Triangles.data()->x;
+        js.run(jobs::parallel_for(js, parent, 0, uint32_t(ui32Triangles.size() * 3),
+                [indices, out](uint32_t start, uint32_t count) {
+                    readIndices(indices, start, count, out);
+                }, jobs::CountSplitter<ELEMENTS_PER_JOB>()));
+    } else {
+        uint32_t j = 0;
+        for (auto& triangle : ui32Triangles) {
+            triangle = { j, j + 1, j + 2 };
+            j += 3;
+        }
+    }
+    js.runAndWait(parent);
+
+    geometry::SurfaceOrientation::Builder sob;
+    sob.vertexCount(vertexCount);
+    sob.normals(fp32Normals.data());
+    if (tangentsInfo) {
+        sob.tangents(fp32Tangents.data());
+    }
+    if (positionsInfo) {
+        sob.positions(fp32Positions.data());
+    }
+    if (texcoordsInfo) {
+        sob.uvs(fp32TexCoords.data());
+    }
+    sob.triangleCount(ui32Triangles.size());
+    sob.triangles(ui32Triangles.data());
+
+    // Compute surface orientation quaternions.
+    auto helper = sob.build();
+    quats = (short4*) malloc(sizeof(short4) * vertexCount);
+    helper.getQuats(quats, vertexCount);
+}
+
+} // namespace details
+} // namespace gltfio
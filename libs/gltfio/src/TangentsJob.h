@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GLTFIO_TANGENTSJOB_H
+#define GLTFIO_TANGENTSJOB_H
+
+#include <math/vec4.h>
+
+#include <utils/JobSystem.h>
+
+#include <cgltf.h>
+
+namespace gltfio {
+namespace details {
+
+// Computes the surface orientation quaternions of a primitive. Each primitive is independent so
+// they can be computed in parallel, one job each, and the accessors of a large primitive are read
+// in parallel over ranges of vertices.
+struct TangentsJob {
+    // Input: the primitive, which must have normals.
+    const cgltf_primitive* primitive = nullptr;
+
+    // Output: the attribute slot of the normals and the quaternions, allocated with malloc(). The
+    // quaternions are null if the primitive is malformed, in which case error says why.
+    int normalSlot = 0;
+    size_t vertexCount = 0;
+    filament::math::short4* quats = nullptr;
+    const char* error = nullptr;
+
+    // Returns true if the primitive has normals, i.e. if it needs quaternions.
+    static bool needsQuats(const cgltf_primitive& primitive);
+
+    // Can be called from any thread, including a job of the given JobSystem.
+    void run(utils::JobSystem& js);
+};
+
+} // namespace details
+} // namespace gltfio
+
+#endif // GLTFIO_TANGENTSJOB_H
@@ -0,0 +1,881 @@
+/*
+ * Copyright (C) 2019 The Android Open Source Project
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "../src/FFilamentAsset.h"
+#include "../src/Quantization.h"
+#include "../src/ResourceCache.h"
+#include "../src/SkinCache.h"
+#include "../src/math.h"
+
+#include <gltfio/Animator.h>
+#include <gltfio/AssetLoader.h>
+#include <gltfio/ResourceLoader.h>
+
+#include <filament/Engine.h>
+#include <filament/Fence.h>
+#include <filament/RenderableManager.h>
+#include <filament/Texture.h>
+#include <filament/TransformManager.h>
+
+#include <image/KtxBundle.h>
+
+#include <math/half.h>
+#include <math/mat4.h>
+#include <math/norm.h>
+#include <math/quat.h>
+#include <math/vec2.h>
+#include <math/vec3.h>
+#include <math/vec4.h>
+
+#include <utils/Entity.h>
+#include <utils/EntityManager.h>
+
+#include <gtest/gtest.h>
+
+// gltfio leaves the implementation of stb_image to the application
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <stdlib.h>
+#include <string.h>
+
+using namespace filament;
+using namespace gltfio;
+using namespace gltfio::details;
+using namespace filament::math;
+
+TEST(QuantizationTest, PositionQuantization) {
+    // A mesh around its origin.
+    EXPECT_EQ(getPositionQuantization(float3(-1, -2, -3), float3(1, 2, 3)),
+            VertexQuantization::HALF);
+
+    // A small mesh far from its origin, e.g. a part of a large scene.
+    EXPECT_EQ(getPositionQuantization(float3(1000, 0, 0), float3(1001, 1, 1)),
+            VertexQuantization::NONE);
+
+    // Coordinates that do not fit in half floats.
+    EXPECT_EQ(getPositionQuantization(float3(-100000), float3(100000)),
+            VertexQuantization::NONE);
+
+    // A degenerate mesh.
+    EXPECT_EQ(getPositionQuantization(float3(1), float3(1)), VertexQuantization::NONE);
+}
+
+TEST(QuantizationTest, TexCoordQuantization) {
+    const float min[2] = { 0.0f, -1.0f };
+    const float max[2] = { 1.0f, 0.5f };
+    const float tiled[2] = { 4.0f, 1.0f };
+    EXPECT_EQ(getTexCoordQuantization(min, max), VertexQuantization::SNORM16);
+    EXPECT_EQ(getTexCoordQuantization(min, tiled), VertexQuantization::HALF);
+    EXPECT_EQ(getTexCoordQuantization(nullptr, nullptr), VertexQuantization::HALF);
+}
+
+TEST(QuantizationTest, HalfPositions) {
+    // Interleaved positions and normals, as they often are in glTF buffers.
+    struct Vertex { float3 position; float3 normal; };
+    const std::vector<Vertex> vertices = {
+        { float3(-1.0f, 0.5f, 0.25f), float3(0, 0, 1) },
+        { float3(0.1f, 0.2f, 0.3f), float3(0, 1, 0) },
+        { float3(1.0f, -0.75f, 2.0f), float3(1, 0, 0) },
+    };
+    const uint32_t count = uint32_t(vertices.size());
+
+    EXPECT_EQ(getQuantizedSize(VertexQuantization::HALF, 3, count), count * sizeof(half4));
+
+    auto positions = (const half4*) quantizeVertices((const uint8_t*) vertices.data(),
+            sizeof(Vertex), count, 3, VertexQuantization::HALF);
+    for (uint32_t i = 0; i < count; i++) {
+        const float3 expected = vertices[i].position;
+        EXPECT_NEAR(float(positions[i].x), expected.x, 1e-3f);
+        EXPECT_NEAR(float(positions[i].y), expected.y, 1e-3f);
+        EXPECT_NEAR(float(positions[i].z), expected.z, 1e-3f);
+        EXPECT_EQ(float(positions[i].w), 1.0f);
+    }
+    free((void*) positions);
+}
+
+TEST(QuantizationTest, TexCoords) {
+    const std::vector<float2> uvs = {
+        float2(0.0f, 1.0f), float2(0.5f, 0.25f), float2(-1.0f, 0.125f)
+    };
+    const uint32_t count = uint32_t(uvs.size());
+
+    EXPECT_EQ(getQuantizedSize(VertexQuantization::SNORM16, 2, count), count * sizeof(short2));
+
+    auto snorm = (const short2*) quantizeVertices((const uint8_t*) uvs.data(), sizeof(float2),
+            count, 2, VertexQuantization::SNORM16);
+    auto halves = (const half2*) quantizeVertices((const uint8_t*) uvs.data(), sizeof(float2),
+            count, 2, VertexQuantization::HALF);
+    for (uint32_t i = 0; i < count; i++) {
+        EXPECT_NEAR(unpackSnorm16(snorm[i].x), uvs[i].x, 1.0f / 32767.0f);
+        EXPECT_NEAR(unpackSnorm16(snorm[i].y), uvs[i].y, 1.0f / 32767.0f);
+        EXPECT_NEAR(float(halves[i].x), uvs[i].x, 1e-3f);
+        EXPECT_NEAR(float(halves[i].y), uvs[i].y, 1e-3f);
+    }
+    free((void*) snorm);
+    free((void*) halves);
+}
+
+static std::shared_ptr<SharedBuffer> createBuffer(size_t size) {
+    return std::make_shared<SharedBuffer>(calloc(1, size), size);
+}
+
+TEST(ResourceCacheTest, SharedBuffers) {
+    ResourceCache cache(0);
+    auto buffer = createBuffer(16);
+    cache.addBuffer("scene.bin", buffer);
+    EXPECT_EQ(cache.getBuffer("scene.bin"), buffer);
+    EXPECT_EQ(cache.getBuffer("other.bin"), nullptr);
+    EXPECT_EQ(cache.getTexture("scene.bin"), nullptr);
+    EXPECT_EQ(cache.getSize(), 16u);
+}
+
+TEST(ResourceCacheTest, EvictsUnusedResources) {
+    ResourceCache cache(100);
+    auto used = createBuffer(60);
+    cache.addBuffer("used", used);
+    cache.addBuffer("old", createBuffer(30));
+    cache.addBuffer("recent", createBuffer(10));
+    EXPECT_EQ(cache.getSize(), 100u);
+
+    // Using a resource makes it the most recently used one.
+    EXPECT_NE(cache.getBuffer("old"), nullptr);
+
+    // The least recently used resource that no asset uses is evicted first.
+    cache.addBuffer("new", createBuffer(10));
+    EXPECT_EQ(cache.getBuffer("recent"), nullptr);
+    EXPECT_NE(cache.getBuffer("old"), nullptr);
+    EXPECT_NE(cache.getBuffer("used"), nullptr);
+    EXPECT_EQ(cache.getSize(), 100u);
+
+    // Resources in use are kept even beyond the budget.
+    cache.addBuffer("large", createBuffer(80));
+    EXPECT_NE(cache.getBuffer("used"), nullptr);
+    EXPECT_EQ(cache.getSize(), 60u);
+
+    // Until they are no longer used.
+    used.reset();
+    auto held = createBuffer(50);
+    cache.addBuffer("held", held);
+    EXPECT_EQ(cache.getBuffer("used"), nullptr);
+    EXPECT_EQ(cache.getSize(), 50u);
+}
+
+TEST(ResourceCacheTest, ContentKeys) {
+    const uint8_t a[] = { 1, 2, 3, 4 };
+    const uint8_t b[] = { 1, 2, 3, 5 };
+    EXPECT_EQ(ResourceCache::getContentKey(a, sizeof(a)), ResourceCache::getContentKey(a, 4));
+    EXPECT_NE(ResourceCache::getContentKey(a, sizeof(a)), ResourceCache::getContentKey(b, 4));
+    EXPECT_NE(ResourceCache::getContentKey(a, 4), ResourceCache::getContentKey(a, 3));
+}
+
+// Builds a GLB file whose binary chunk holds the buffer views, except for the external ones that
+// each get their own buffer, stored in a data URI.
+static bool isNear(mat4f const& a, mat4f const& b) {
+    for (size_t i = 0; i < 4; i++) {
+        for (size_t j = 0; j < 4; j++) {
+            if (std::abs(a[i][j] - b[i][j]) > 1e-5f) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+TEST(SkinCacheTest, UploadsOnlyMovedSkeletons) {
+    Engine* engine = Engine::create(Engine::Backend::NOOP);
+    RenderableManager& rm = engine->getRenderableManager();
+    TransformManager& tm = engine->getTransformManager();
+    utils::EntityManager& em = utils::EntityManager::get();
+
+    // A chain of joints one unit apart, in their bind pose, and a target at the origin.
+    Skin skin;
+    TransformManager::Instance parent;
+    for (size_t i = 0; i < 4; i++) {
+        utils::Entity joint = em.create();
+        tm.create(joint, parent, mat4f::translate(float3(0, 1, 0)));
+        parent = tm.getInstance(joint);
+        skin.joints.push_back(joint);
+        skin.inverseBindMatrices.push_back(mat4f::translate(float3(0, -float(i + 1), 0)));
+    }
+    utils::Entity target = em.create();
+    tm.create(target);
+    RenderableManager::Builder(1)
+            .boundingBox({{ -1, -1, -1 }, { 1, 1, 1 }})
+            .skinning(4)
+            .build(*engine, target);
+    skin.targets.push_back(target);
+
+    SkinCache cache;
+    cache.update(skin, rm, tm);
+    ASSERT_TRUE(cache.changed[0]);
+    for (size_t i = 0; i < 4; i++) {
+        EXPECT_TRUE(isNear(cache.targetMatrices[0][i], mat4f()));
+    }
+
+    cache.update(skin, rm, tm);
+    EXPECT_FALSE(cache.changed[0]);
+
+    // Moving the last joint only changes its own matrix, but the target needs an upload.
+    tm.setTransform(tm.getInstance(skin.joints[3]), mat4f::translate(float3(1, 1, 0)));
+    cache.update(skin, rm, tm);
+    EXPECT_TRUE(cache.changed[0]);
+    EXPECT_TRUE(isNear(cache.targetMatrices[0][2], mat4f()));
+    EXPECT_TRUE(isNear(cache.targetMatrices[0][3], mat4f::translate(float3(1, 0, 0))));
+
+    // So does moving the target, since the bones are relative to it.
+    tm.setTransform(tm.getInstance(target), mat4f::translate(float3(0, 0, 2)));
+    cache.update(skin, rm, tm);
+    EXPECT_TRUE(cache.changed[0]);
+    EXPECT_TRUE(isNear(cache.targetMatrices[0][0], mat4f::translate(float3(0, 0, -2))));
+
+    updateSkins(&skin, &cache, 1, rm, tm, engine->getJobSystem());
+    EXPECT_FALSE(cache.changed[0]);
+
+    rm.destroy(target);
+    tm.destroy(target);
+    em.destroy(target);
+    for (utils::Entity joint : skin.joints) {
+        tm.destroy(joint);
+        em.destroy(joint);
+    }
+    Engine::destroy(&engine);
+}
+
+class GlbBuilder {
+public:
+    // Adds a buffer view and returns its index.
+    size_t addBufferView(const void* data, size_t size) {
+        const size_t offset = mBin.size();
+        mBin.insert(mBin.end(), (const uint8_t*) data, (const uint8_t*) data + size);
+        mBin.resize((mBin.size() + 3) & ~size_t(3));
+        mBufferViews += std::string(mBufferViews.empty() ? "" : ",") +
+                "{\"buffer\":0,\"byteOffset\":" + std::to_string(offset) +
+                ",\"byteLength\":" + std::to_string(size) + "}";
+        return mBufferViewCount++;
+    }
+
+    // Adds a buffer view in a buffer of its own and returns its index.
+    size_t addExternalBufferView(const void* data, size_t size) {
+        static const char digits[] =
+                "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        auto bytes = (const uint8_t*) data;
+        std::string uri = "data:application/octet-stream;base64,";
+        for (size_t i = 0; i < size; i += 3) {
+            const uint32_t triple = uint32_t(bytes[i]) << 16 |
+                    (i + 1 < size ? uint32_t(bytes[i + 1]) << 8 : 0) |
+                    (i + 2 < size ? uint32_t(bytes[i + 2]) : 0);
+            uri += digits[(triple >> 18) & 63];
+            uri += digits[(triple >> 12) & 63];
+            uri += i + 1 < size ? digits[(triple >> 6) & 63] : '=';
+            uri += i + 2 < size ? digits[triple & 63] : '=';
+        }
+        mExternalBuffers += ",{\"byteLength\":" + std::to_string(size) +
+                ",\"uri\":\"" + uri + "\"}";
+        mBufferViews += std::string(mBufferViews.empty() ? "" : ",") +
+                "{\"buffer\":" + std::to_string(++mExternalBufferCount) +
+                ",\"byteLength\":" + std::to_string(size) + "}";
+        return mBufferViewCount++;
+    }
+
+    // Adds a buffer view with an RGBA PNG image, and returns the index of the buffer view.
+    size_t addPng(uint32_t width, uint32_t height, uint32_t color) {
+        std::vector<uint32_t> texels(width * height, color);
+        std::vector<uint8_t> png;
+        stbi_write_png_to_func([](void* context, void* data, int size) {
+            auto png = (std::vector<uint8_t>*) context;
+            png->insert(png->end(), (uint8_t*) data, (uint8_t*) data + size);
+        }, &png, int(width), int(height), 4, texels.data(), int(width * 4));
+        return addBufferView(png.data(), png.size());
+    }
+
+    // Returns the GLB file, the JSON holds the top-level properties of the asset except for the
+    // buffers and buffer views.
+    std::vector<uint8_t> build(std::string const& json) const {
+        std::string chunk = "{" + json + ",\"buffers\":[{\"byteLength\":" +
+                std::to_string(mBin.size()) + "}" + mExternalBuffers + "],\"bufferViews\":[" +
+                mBufferViews + "]}";
+        chunk.resize((chunk.size() + 3) & ~size_t(3), ' ');
+        std::vector<uint8_t> glb;
+        auto append32 = [&glb](uint32_t value) {
+            glb.insert(glb.end(), (uint8_t*) &value, (uint8_t*) &value + sizeof(value));
+        };
+        append32(0x46546C67);   // glTF
+        append32(2);
+        append32(uint32_t(12 + 8 + chunk.size() + 8 + mBin.size()));
+        append32(uint32_t(chunk.size()));
+        append32(0x4E4F534A);   // JSON
+        glb.insert(glb.end(), chunk.begin(), chunk.end());
+        append32(uint32_t(mBin.size()));
+        append32(0x004E4942);   // BIN
+        glb.insert(glb.end(), mBin.begin(), mBin.end());
+        return glb;
+    }
+
+private:
+    std::vector<uint8_t> mBin;
+    std::string mBufferViews;
+    size_t mBufferViewCount = 0;
+    std::string mExternalBuffers;
+    size_t mExternalBufferCount = 0;
+};
+
+// Loads synthetic assets with the no-op backend.
+class AssetTest : public testing::Test {
+protected:
+    void SetUp() override {
+        engine = Engine::create(Engine::Backend::NOOP);
+        loader = AssetLoader::create(engine);
+    }
+
+    void TearDown() override {
+        // The uploads hold onto the assets until the driver has consumed them.
+        Fence::waitAndDestroy(engine->createFence());
+        for (FilamentAsset* asset : assets) {
+            loader->destroyAsset(asset);
+        }
+        loader->destroyMaterials();
+        AssetLoader::destroy(&loader);
+        Engine::destroy(&engine);
+    }
+
+    FilamentAsset* createAsset(GlbBuilder const& builder, std::string const& json) {
+        std::vector<uint8_t> glb = builder.build(json);
+        FilamentAsset* asset = loader->createAssetFromBinary(glb.data(), uint32_t(glb.size()));
+        if (asset) {
+            assets.push_back(asset);
+        }
+        return asset;
+    }
+
+    // Calls asyncUpdateLoad() once per "frame" until the load completes.
+    static bool finishLoad(ResourceLoader& resourceLoader) {
+        for (int frame = 0; frame < 1000; frame++) {
+            if (resourceLoader.asyncGetLoadProgress() == 1.0f) {
+                return true;
+            }
+            resourceLoader.asyncUpdateLoad();
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+        }
+        return false;
+    }
+
+    Engine* engine = nullptr;
+    AssetLoader* loader = nullptr;
+    std::vector<FilamentAsset*> assets;
+};
+
+// An asset made of unlit textured triangles, each with its own material and its own image. The
+// images are 2 texels high, and their width is the index of the triangle plus 2, to tell them
+// apart.
+static FilamentAsset* createTexturedTriangles(GlbBuilder& builder,
+        std::function<FilamentAsset*(std::string const&)> create, size_t count) {
+    const float3 positions[] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+    const float2 uvs[] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+    const size_t positionView = builder.addBufferView(positions, sizeof(positions));
+    const size_t uvView = builder.addBufferView(uvs, sizeof(uvs));
+    std::string nodes, meshes, materials, textures, images;
+    for (size_t i = 0; i < count; i++) {
+        const std::string index = std::to_string(i);
+        const std::string separator = i ? "," : "";
+        const size_t imageView = builder.addPng(uint32_t(i + 2), 2, 0xff000000 | uint32_t(i));
+        nodes += separator + "{\"mesh\":" + index + "}";
+        meshes += separator + "{\"primitives\":[{\"attributes\":{\"POSITION\":0," +
+                "\"TEXCOORD_0\":1},\"material\":" + index + "}]}";
+        materials += separator + "{\"pbrMetallicRoughness\":{\"baseColorTexture\":" +
+                "{\"index\":" + index + "}},\"extensions\":{\"KHR_materials_unlit\":{}}}";
+        textures += separator + "{\"source\":" + index + "}";
+        images += separator + "{\"bufferView\":" + std::to_string(imageView) +
+                ",\"mimeType\":\"image/png\"}";
+    }
+    std::string sceneNodes;
+    for (size_t i = 0; i < count; i++) {
+        sceneNodes += (i ? "," : "") + std::to_string(i);
+    }
+    return create(R"("asset":{"version":"2.0"},"extensionsUsed":["KHR_materials_unlit"],)"
+            R"("scene":0,"scenes":[{"nodes":[)" + sceneNodes +
+            "]}],\"nodes\":[" + nodes + "],\"meshes\":[" + meshes +
+            "],\"materials\":[" + materials + "],\"textures\":[" + textures +
+            "],\"images\":[" + images + "],\"accessors\":[" +
+            "{\"bufferView\":" + std::to_string(positionView) +
+            ",\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"," +
+            "\"min\":[0,0,0],\"max\":[1,1,0]}," +
+            "{\"bufferView\":" + std::to_string(uvView) +
+            ",\"componentType\":5126,\"count\":3,\"type\":\"VEC2\"}]");
+}
+
+// Returns the widths of the textures created for the images of createTexturedTriangles().
+static std::vector<size_t> getImageTextureWidths(FilamentAsset* asset, Engine& engine) {
+    std::vector<size_t> widths;
+    for (Texture const* texture : upcast(asset)->mTextures) {
+        if (texture->getHeight() == 2) {
+            widths.push_back(texture->getWidth());
+        }
+    }
+    for (auto const& texture : upcast(asset)->mSharedTextures) {
+        widths.push_back(texture->texture->getWidth());
+    }
+    std::sort(widths.begin(), widths.end());
+    return widths;
+}
+
+static std::vector<size_t> getExpectedWidths(size_t count) {
+    std::vector<size_t> widths;
+    for (size_t i = 0; i < count; i++) {
+        widths.push_back(i + 2);
+    }
+    return widths;
+}
+
+TEST_F(AssetTest, DecodesAllImages) {
+    constexpr size_t COUNT = 12;
+    GlbBuilder builder;
+    auto create = [this, &builder](std::string const& json) { return createAsset(builder, json); };
+    FilamentAsset* asset = createTexturedTriangles(builder, create, COUNT);
+    ASSERT_NE(asset, nullptr);
+    ASSERT_EQ(upcast(asset)->getTextureBindingCount(), COUNT);
+
+    ResourceLoader resourceLoader({ engine, {}, false });
+    ASSERT_TRUE(resourceLoader.loadResources(asset));
+    EXPECT_EQ(getImageTextureWidths(asset, *engine), getExpectedWidths(COUNT));
+    EXPECT_EQ(upcast(asset)->mTextures.size(), COUNT);
+}
+
+TEST_F(AssetTest, DecodesAllImagesProgressively) {
+    constexpr size_t COUNT = 12;
+    GlbBuilder builder;
+    auto create = [this, &builder](std::string const& json) { return createAsset(builder, json); };
+    FilamentAsset* asset = createTexturedTriangles(builder, create, COUNT);
+    ASSERT_NE(asset, nullptr);
+
+    ResourceLoader resourceLoader({ engine, {}, false });
+    ASSERT_TRUE(resourceLoader.asyncBeginLoad(asset));
+    ASSERT_TRUE(finishLoad(resourceLoader));
+    EXPECT_EQ(getImageTextureWidths(asset, *engine), getExpectedWidths(COUNT));
+}
+
+// Two triangles, the first one is unlit and lives in the binary chunk, the second one is lit, has
+// normals and lives in a buffer of its own.
+TEST_F(AssetTest, SharesEmbeddedImages) {
+    constexpr size_t COUNT = 4;
+    GlbBuilder builders[2];
+    FilamentAsset* shared[2];
+    for (size_t i = 0; i < 2; i++) {
+        GlbBuilder& builder = builders[i];
+        auto create = [this, &builder](std::string const& json) {
+            return createAsset(builder, json);
+        };
+        shared[i] = createTexturedTriangles(builder, create, COUNT);
+        ASSERT_NE(shared[i], nullptr);
+    }
+
+    // The images are keyed by their contents, the second asset reuses the textures of the first.
+    ResourceConfiguration config = { engine, {}, false };
+    config.shareResources = true;
+    ResourceLoader resourceLoader(config);
+    ASSERT_TRUE(resourceLoader.loadResources(shared[0]));
+    ASSERT_TRUE(resourceLoader.asyncBeginLoad(shared[1]));
+    ASSERT_TRUE(finishLoad(resourceLoader));
+    std::vector<const Texture*> textures[2];
+    for (size_t i = 0; i < 2; i++) {
+        EXPECT_EQ(getImageTextureWidths(shared[i], *engine), getExpectedWidths(COUNT));
+        for (auto const& texture : upcast(shared[i])->mSharedTextures) {
+            textures[i].push_back(texture->texture);
+        }
+        std::sort(textures[i].begin(), textures[i].end());
+    }
+    EXPECT_EQ(textures[0].size(), COUNT);
+    EXPECT_EQ(textures[0], textures[1]);
+}
+
+static FilamentAsset* createTrianglesInTwoBuffers(GlbBuilder& builder,
+        std::function<FilamentAsset*(std::string const&)> create) {
+    const float3 positions[] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+    const float3 normals[] = { { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 } };
+    const size_t binaryView = builder.addBufferView(positions, sizeof(positions));
+    const size_t positionView = builder.addExternalBufferView(positions, sizeof(positions));
+    const size_t normalView = builder.addExternalBufferView(normals, sizeof(normals));
+    const std::string bounds = R"("min":[0,0,0],"max":[1,1,0])";
+    return create(R"("asset":{"version":"2.0"},"extensionsUsed":["KHR_materials_unlit"],)"
+            R"("scene":0,"scenes":[{"nodes":[0,1]}],"nodes":[{"mesh":0},{"mesh":1}],)"
+            R"("meshes":[{"primitives":[{"attributes":{"POSITION":0},"material":0}]},)"
+            R"({"primitives":[{"attributes":{"POSITION":1,"NORMAL":2},"material":1}]}],)"
+            R"("materials":[{"extensions":{"KHR_materials_unlit":{}}},{}],"accessors":[)"
+            "{\"bufferView\":" + std::to_string(binaryView) +
+            ",\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"," + bounds + "}," +
+            "{\"bufferView\":" + std::to_string(positionView) +
+            ",\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"," + bounds + "}," +
+            "{\"bufferView\":" + std::to_string(normalView) +
+            ",\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"}]");
+}
+
+static size_t countPlaceholders(FilamentAsset* asset) {
+    return size_t(std::count_if(upcast(asset)->mTextures.begin(), upcast(asset)->mTextures.end(),
+            [](Texture const* texture) {
+                return texture->getWidth() == 1 && texture->getHeight() == 1;
+            }));
+}
+
+TEST_F(AssetTest, ShowsRenderablesOnceUploaded) {
+    GlbBuilder builder;
+    auto create = [this, &builder](std::string const& json) { return createAsset(builder, json); };
+    FilamentAsset* asset = createTrianglesInTwoBuffers(builder, create);
+    ASSERT_NE(asset, nullptr);
+    const cgltf_data* gltf = upcast(asset)->mSourceAsset;
+    const utils::Entity inBinary = upcast(asset)->mNodeMap.find(&gltf->nodes[0])->second;
+    const utils::Entity inBuffer = upcast(asset)->mNodeMap.find(&gltf->nodes[1])->second;
+    RenderableManager& rm = engine->getRenderableManager();
+    rm.setLayerMask(rm.getInstance(inBinary), 0xff, 0x4);
+    rm.setLayerMask(rm.getInstance(inBuffer), 0xff, 0x4);
+
+    // The second triangle is hidden until its buffers are read and its orientations computed, then
+    // it gets its own layers back.
+    ResourceLoader resourceLoader({ engine, {}, false });
+    ASSERT_TRUE(resourceLoader.asyncBeginLoad(asset));
+    EXPECT_EQ(rm.getLayerMask(rm.getInstance(inBinary)), 0x4);
+    EXPECT_EQ(rm.getLayerMask(rm.getInstance(inBuffer)), 0);
+    EXPECT_EQ(resourceLoader.asyncGetLoadProgress(), 0.0f);
+    resourceLoader.asyncUpdateLoad();
+    EXPECT_EQ(resourceLoader.asyncGetLoadProgress(), 0.5f);
+    ASSERT_TRUE(finishLoad(resourceLoader));
+    EXPECT_EQ(rm.getLayerMask(rm.getInstance(inBinary)), 0x4);
+    EXPECT_EQ(rm.getLayerMask(rm.getInstance(inBuffer)), 0x4);
+}
+
+TEST_F(AssetTest, OrientsSurfaces) {
+    GlbBuilder builder;
+    auto create = [this, &builder](std::string const& json) { return createAsset(builder, json); };
+    FilamentAsset* asset = createTrianglesInTwoBuffers(builder, create);
+    ASSERT_NE(asset, nullptr);
+    ResourceLoader resourceLoader({ engine, {}, false });
+    ASSERT_TRUE(resourceLoader.loadResources(asset));
+    EXPECT_EQ(resourceLoader.asyncGetLoadProgress(), 1.0f);
+}
+
+TEST_F(AssetTest, BindsPlaceholdersUntilDecoded) {
+    constexpr size_t COUNT = 4;
+    GlbBuilder progressiveBuilder;
+    FilamentAsset* progressive = createTexturedTriangles(progressiveBuilder,
+            [this, &progressiveBuilder](std::string const& json) {
+                return createAsset(progressiveBuilder, json);
+            }, COUNT);
+    ASSERT_NE(progressive, nullptr);
+    GlbBuilder builder;
+    FilamentAsset* asset = createTexturedTriangles(builder,
+            [this, &builder](std::string const& json) { return createAsset(builder, json); },
+            COUNT);
+    ASSERT_NE(asset, nullptr);
+
+    // The base color maps share a white placeholder.
+    ResourceLoader resourceLoader({ engine, {}, false });
+    ASSERT_TRUE(resourceLoader.asyncBeginLoad(progressive));
+    EXPECT_EQ(countPlaceholders(progressive), 1u);
+    ASSERT_TRUE(finishLoad(resourceLoader));
+    EXPECT_EQ(getImageTextureWidths(progressive, *engine), getExpectedWidths(COUNT));
+
+    // A synchronous load has no use for them.
+    ASSERT_TRUE(resourceLoader.loadResources(asset));
+    EXPECT_EQ(countPlaceholders(asset), 0u);
+    EXPECT_EQ(getImageTextureWidths(asset, *engine), getExpectedWidths(COUNT));
+}
+
+TEST_F(AssetTest, DecodesImagesWithinBudget) {
+    constexpr size_t COUNT = 6;
+    GlbBuilder builder;
+    auto create = [this, &builder](std::string const& json) { return createAsset(builder, json); };
+    FilamentAsset* asset = createTexturedTriangles(builder, create, COUNT);
+    ASSERT_NE(asset, nullptr);
+
+    // The budget is smaller than any image, which are then decoded one at a time, so no more than
+    // one is uploaded per update.
+    ResourceConfiguration config = { engine, {}, false };
+    config.decodedTextureBudget = 1;
+    ResourceLoader resourceLoader(config);
+    ASSERT_TRUE(resourceLoader.asyncBeginLoad(asset));
+    size_t uploaded = 0;
+    for (int frame = 0; frame < 1000 && uploaded < COUNT; frame++) {
+        resourceLoader.asyncUpdateLoad();
+        const size_t count = size_t(std::lround(resourceLoader.asyncGetLoadProgress() * COUNT));
+        EXPECT_LE(count, uploaded + 1);
+        uploaded = count;
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    EXPECT_EQ(uploaded, COUNT);
+    EXPECT_EQ(getImageTextureWidths(asset, *engine), getExpectedWidths(COUNT));
+}
+
+// A KTX container of RGBA8 texels, 4x4 with 3 mip levels.
+static std::vector<uint8_t> createKtx(bool cubemap) {
+    image::KtxBundle ktx(3, 1, cubemap);
+    image::KtxInfo& info = ktx.info();
+    info.endianness = 0x04030201;
+    info.glType = image::KtxBundle::UNSIGNED_BYTE;
+    info.glTypeSize = 1;
+    info.glFormat = image::KtxBundle::RGBA;
+    info.glInternalFormat = image::KtxBundle::RGBA8;
+    info.glBaseInternalFormat = image::KtxBundle::RGBA;
+    info.pixelWidth = 4;
+    info.pixelHeight = 4;
+    info.pixelDepth = 0;
+    const uint32_t faces = cubemap ? 6 : 1;
+    for (uint32_t level = 0, size = 4; level < 3; level++, size /= 2) {
+        std::vector<uint32_t> texels(size * size, 0xff00ff00);
+        for (uint32_t face = 0; face < faces; face++) {
+            ktx.setBlob({ level, 0, face }, (const uint8_t*) texels.data(),
+                    uint32_t(texels.size() * sizeof(uint32_t)));
+        }
+    }
+    std::vector<uint8_t> contents(ktx.getSerializedLength());
+    ktx.serialize(contents.data(), uint32_t(contents.size()));
+    return contents;
+}
+
+// A lit triangle whose base color and metallic-roughness maps are the same KTX image.
+static FilamentAsset* createKtxTriangle(GlbBuilder& builder,
+        std::function<FilamentAsset*(std::string const&)> create, bool cubemap) {
+    const float3 positions[] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+    const float3 normals[] = { { 0, 0, 1 }, { 0, 0, 1 }, { 0, 0, 1 } };
+    const float2 uvs[] = { { 0, 0 }, { 1, 0 }, { 0, 1 } };
+    const size_t positionView = builder.addBufferView(positions, sizeof(positions));
+    const size_t normalView = builder.addBufferView(normals, sizeof(normals));
+    const size_t uvView = builder.addBufferView(uvs, sizeof(uvs));
+    const std::vector<uint8_t> ktx = createKtx(cubemap);
+    const size_t imageView = builder.addBufferView(ktx.data(), ktx.size());
+    return create(R"("asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0]}],)"
+            R"("nodes":[{"mesh":0}],"meshes":[{"primitives":[{"attributes":)"
+            R"({"POSITION":0,"NORMAL":1,"TEXCOORD_0":2},"material":0}]}],)"
+            R"("materials":[{"pbrMetallicRoughness":{"baseColorTexture":{"index":0},)"
+            R"("metallicRoughnessTexture":{"index":0}}}],"textures":[{"source":0}],)"
+            "\"images\":[{\"bufferView\":" + std::to_string(imageView) +
+            ",\"mimeType\":\"image/ktx\"}],\"accessors\":[" +
+            "{\"bufferView\":" + std::to_string(positionView) +
+            ",\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"," +
+            "\"min\":[0,0,0],\"max\":[1,1,0]}," +
+            "{\"bufferView\":" + std::to_string(normalView) +
+            ",\"componentType\":5126,\"count\":3,\"type\":\"VEC3\"}," +
+            "{\"bufferView\":" + std::to_string(uvView) +
+            ",\"componentType\":5126,\"count\":3,\"type\":\"VEC2\"}]");
+}
+
+TEST_F(AssetTest, UploadsKtxImages) {
+    GlbBuilder builder;
+    auto create = [this, &builder](std::string const& json) { return createAsset(builder, json); };
+    FilamentAsset* asset = createKtxTriangle(builder, create, false);
+    ASSERT_NE(asset, nullptr);
+
+    // The image gets a texture per color space, with all of its levels. The textures are owned by
+    // the asset, the KTX bundles by the uploads, which release them once the driver has consumed
+    // the levels.
+    ResourceLoader resourceLoader({ engine, {}, false });
+    ASSERT_TRUE(resourceLoader.loadResources(asset));
+    std::vector<Texture::InternalFormat> formats;
+    for (Texture const* texture : upcast(asset)->mTextures) {
+        EXPECT_EQ(texture->getWidth(), 4u);
+        EXPECT_EQ(texture->getLevels(), 3u);
+        formats.push_back(texture->getFormat());
+    }
+    std::vector<Texture::InternalFormat> expected = {
+            Texture::InternalFormat::RGBA8, Texture::InternalFormat::SRGB8_A8 };
+    std::sort(formats.begin(), formats.end());
+    std::sort(expected.begin(), expected.end());
+    EXPECT_EQ(formats, expected);
+}
+
+TEST_F(AssetTest, KeepsPlaceholdersForUnsupportedKtxImages) {
+    GlbBuilder builder;
+    auto create = [this, &builder](std::string const& json) { return createAsset(builder, json); };
+    FilamentAsset* asset = createKtxTriangle(builder, create, true);
+    ASSERT_NE(asset, nullptr);
+
+    // Cubemaps are rejected, their bundles are destroyed right away.
+    ResourceLoader resourceLoader({ engine, {}, false });
+    ASSERT_TRUE(resourceLoader.asyncBeginLoad(asset));
+    ASSERT_TRUE(finishLoad(resourceLoader));
+    EXPECT_EQ(upcast(asset)->mTextures.size(), countPlaceholders(asset));
+}
+
+// Three nodes that share a mesh, one of them a child of another one.
+static FilamentAsset* createSharedMeshNodes(GlbBuilder& builder,
+        std::function<FilamentAsset*(std::string const&)> create) {
+    const float3 positions[] = { { 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+    const size_t positionView = builder.addBufferView(positions, sizeof(positions));
+    return create(R"("asset":{"version":"2.0"},"extensionsUsed":["KHR_materials_unlit"],)"
+            R"("scene":0,"scenes":[{"nodes":[0,1]}],"nodes":[)"
+            R"({"mesh":0,"translation":[1,0,0],"children":[2]},)"
+            R"({"mesh":0,"translation":[0,0,3],"scale":[2,2,2]},)"
+            R"({"mesh":0,"translation":[0,2,0]}],)"
+            R"("meshes":[{"primitives":[{"attributes":{"POSITION":0},"material":0}]}],)"
+            R"("materials":[{"extensions":{"KHR_materials_unlit":{}}}],"accessors":[)"
+            "{\"bufferView\":" + std::to_string(positionView) +
+            R"(,"componentType":5126,"count":3,"type":"VEC3","min":[0,0,0],"max":[1,1,0]}])");
+}
+
+TEST_F(AssetTest, InstancesSharedMeshes) {
+    AssetLoader::destroy(&loader);
+    AssetConfiguration config = { engine };
+    config.instanceMeshes = true;
+    loader = AssetLoader::create(config);
+
+    GlbBuilder builder;
+    auto create = [this, &builder](std::string const& json) { return createAsset(builder, json); };
+    FilamentAsset* asset = createSharedMeshNodes(builder, create);
+    ASSERT_NE(asset, nullptr);
+    ResourceLoader resourceLoader({ engine, {}, false });
+    ASSERT_TRUE(resourceLoader.loadResources(asset));
+
+    RenderableManager& rm = engine->getRenderableManager();
+    size_t renderableCount = 0;
+    for (size_t i = 0; i < asset->getEntityCount(); i++) {
+        renderableCount += rm.hasComponent(asset->getEntities()[i]) ? 1 : 0;
+    }
+    EXPECT_EQ(renderableCount, 1u);
+
+    // The bones are the transforms of the nodes, in the order of the hierarchy.
+    FFilamentAsset* fasset = (FFilamentAsset*) asset;
+    ASSERT_EQ(fasset->mInstancedRenderables.size(), 1u);
+    const InstancedRenderable& renderable = fasset->mInstancedRenderables[0];
+    ASSERT_EQ(renderable.nodes.size(), 3u);
+    const mat4f expected[] = {
+        mat4f::translate(float3(1, 0, 0)),
+        mat4f::translate(float3(1, 2, 0)),
+        mat4f::translate(float3(0, 0, 3)) * mat4f::scale(2.0f) };
+    TransformManager& tm = engine->getTransformManager();
+    for (size_t i = 0; i < 3; i++) {
+        const mat4f transform = tm.getWorldTransform(tm.getInstance(renderable.nodes[i]));
+        EXPECT_TRUE(isNear(transform, expected[i]));
+    }
+
+    // The bounding box of the renderable encloses the three instances.
+    const Box& box = rm.getAxisAlignedBoundingBox(rm.getInstance(renderable.entity));
+    EXPECT_TRUE(isNear(mat4f::translate(box.getMin()), mat4f::translate(float3(0, 0, 0))));
+    EXPECT_TRUE(isNear(mat4f::translate(box.getMax()), mat4f::translate(float3(2, 3, 3))));
+
+    // Its vertex buffer holds a copy of the triangle per instance.
+    const cgltf_primitive* prim = &fasset->mSourceAsset->meshes[0].primitives[0];
+    ASSERT_EQ(fasset->mInstancedPrimMap[prim].size(), 1u);
+    EXPECT_EQ(fasset->mInstancedPrimMap[prim][0].instanceCount, 3u);
+    EXPECT_EQ(fasset->mInstancedPrimMap[prim][0].vertices->getVertexCount(), 9u);
+}
+
+// A node at (0, 0, 4) and two animations that move it: the first one holds it at (2, 0, 0) rotated
+// by 170 degrees around Y, the second one moves it from (0, 2, 0) to (0, 4, 0) rotated by -170
+// degrees, which is in the opposite hemisphere.
+static FilamentAsset* createAnimatedNode(GlbBuilder& builder,
+        std::function<FilamentAsset*(std::string const&)> create) {
+    const float times[] = { 0, 1 };
+    const float3 translations0[] = { { 2, 0, 0 }, { 2, 0, 0 } };
+    const float3 translations1[] = { { 0, 2, 0 }, { 0, 4, 0 } };
+    const quatf rotation0 = quatf::fromAxisAngle(float3(0, 1, 0), float(170 * M_PI / 180));
+    const quatf rotation1 = quatf::fromAxisAngle(float3(0, 1, 0), float(-170 * M_PI / 180));
+    const quatf rotations0[] = { rotation0, rotation0 };
+    const quatf rotations1[] = { rotation1, rotation1 };
+    std::string accessors = "{\"bufferView\":" +
+            std::to_string(builder.addBufferView(times, sizeof(times))) +
+            R"(,"componentType":5126,"count":2,"type":"SCALAR","min":[0],"max":[1]})";
+    auto addAccessor = [&](const void* data, size_t size, const char* type) {
+        accessors += ",{\"bufferView\":" + std::to_string(builder.addBufferView(data, size)) +
+                ",\"componentType\":5126,\"count\":2,\"type\":\"" + type + "\"}";
+    };
+    addAccessor(translations0, sizeof(translations0), "VEC3");
+    addAccessor(rotations0, sizeof(rotations0), "VEC4");
+    addAccessor(translations1, sizeof(translations1), "VEC3");
+    addAccessor(rotations1, sizeof(rotations1), "VEC4");
+    auto animation = [](int translation, int rotation) {
+        return "{\"samplers\":[{\"input\":0,\"output\":" + std::to_string(translation) +
+                "},{\"input\":0,\"output\":" + std::to_string(rotation) + "}],\"channels\":["
+                R"({"sampler":0,"target":{"node":0,"path":"translation"}},)"
+                R"({"sampler":1,"target":{"node":0,"path":"rotation"}}]})";
+    };
+    return create(R"("asset":{"version":"2.0"},"scene":0,"scenes":[{"nodes":[0]}],)"
+            R"("nodes":[{"translation":[0,0,4]}],"animations":[)" + animation(1, 2) + "," +
+            animation(3, 4) + "],\"accessors\":[" + accessors + "]");
+}
+
+class AnimatorTest : public AssetTest {
+protected:
+    void SetUp() override {
+        AssetTest::SetUp();
+        GlbBuilder builder;
+        asset = createAnimatedNode(builder, [this, &builder](std::string const& json) {
+            return createAsset(builder, json);
+        });
+        ASSERT_NE(asset, nullptr);
+        ResourceLoader resourceLoader({ engine, {}, false });
+        ASSERT_TRUE(resourceLoader.loadResources(asset));
+        ASSERT_EQ(asset->getAnimator()->getAnimationCount(), 2u);
+    }
+
+    mat4f getTransform() const {
+        TransformManager& tm = engine->getTransformManager();
+        return tm.getTransform(tm.getInstance(asset->getEntities()[0]));
+    }
+
+    FilamentAsset* asset = nullptr;
+};
+
+TEST_F(AnimatorTest, BlendsClipsByWeight) {
+    const AnimationClip clips[] = { { 0, 0.0f, 0.25f }, { 1, 0.0f, 0.75f } };
+    asset->getAnimator()->applyAnimations(clips, 2);
+    const float3 translation = getTransform()[3].xyz;
+    EXPECT_NEAR(translation.x, 0.5f, 1e-5f);
+    EXPECT_NEAR(translation.y, 1.5f, 1e-5f);
+    EXPECT_NEAR(translation.z, 0.0f, 1e-5f);
+}
+
+TEST_F(AnimatorTest, FillsMissingWeightsWithRestPose) {
+    const AnimationClip clips[] = { { 0, 0.0f, 0.5f } };
+    asset->getAnimator()->applyAnimations(clips, 1);
+    const quatf rotation = quatf::fromAxisAngle(float3(0, 1, 0), float(85 * M_PI / 180));
+    EXPECT_TRUE(isNear(getTransform(), composeMatrix(float3(1, 0, 2), rotation, float3(1))));
+}
+
+TEST_F(AnimatorTest, CrossfadesOppositeRotations) {
+    // Halfway between 170 and -170 degrees is 180 degrees, not the identity.
+    const AnimationClip clips[] = { { 0, 0.0f, 0.5f }, { 1, 0.0f, 0.5f } };
+    asset->getAnimator()->applyAnimations(clips, 2);
+    const quatf rotation = quatf::fromAxisAngle(float3(0, 1, 0), float(M_PI));
+    EXPECT_TRUE(isNear(getTransform(), composeMatrix(float3(1, 1, 0), rotation, float3(1))));
+}
+
+TEST_F(AnimatorTest, AddsAdditiveClips) {
+    // The second animation has moved by (0, 1, 0) from its first keyframe at half its duration.
+    const AnimationClip clips[] = { { 0, 0.0f, 1.0f }, { 1, 0.5f, 1.0f, true } };
+    asset->getAnimator()->applyAnimations(clips, 2);
+    const quatf rotation = quatf::fromAxisAngle(float3(0, 1, 0), float(170 * M_PI / 180));
+    EXPECT_TRUE(isNear(getTransform(), composeMatrix(float3(2, 1, 0), rotation, float3(1))));
+}
+
+TEST_F(AnimatorTest, IgnoresMissingAnimations) {
+    const mat4f rest = getTransform();
+    const AnimationClip clips[] = { { 0, 0.0f, 1.0f }, { 2, 0.0f, 1.0f } };
+    asset->getAnimator()->applyAnimations(clips, 2);
+    EXPECT_TRUE(isNear(getTransform(), rest));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -44,6 +44,15 @@ inline uint32_t murmur3(const uint32_t* key, size_t wordCount, uint32_t seed) {
     return h;
 }
 
+// 64-bits FNV-1a, the result doesn't depend on the platform and can be stored
+inline uint64_t fnv1a64(const void* data, size_t size, uint64_t h = 0xcbf29ce484222325llu) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) {
+        h = (h ^ p[i]) * 0x100000001b3llu;
+    }
+    return h;
+}
+
 template<typename T>
 struct MurmurHashFn {
     uint32_t operator()(const T& key) const {
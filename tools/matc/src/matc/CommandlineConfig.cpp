@@ -26,6 +26,8 @@
 #include <sstream>
 #include <string>
 
+#include <stdlib.h>
+
 using namespace utils;
 
 namespace matc {
@@ -59,6 +61,18 @@ static void usage(char* name) {
             "       Filter out specified comma-separated variants:\n"
             "           directionalLighting, dynamicLighting, shadowReceiver, skinning\n"
             "       This variant filter is merged the filter from the material, if any\n\n"
+            "   --variant-usage=<report>, -u <report>\n"
+            "       Keep only the variants listed for the material in this report, written\n"
+            "       by Engine::getVariantUsageReport(). Other variants fail to render\n\n"
+            "   --jobs=<count>, -j <count>\n"
+            "       Number of threads used to compile shaders, 1 disables multithreading\n"
+            "       (default: one per core)\n\n"
+            "   --timing, -T\n"
+            "       Print how long it took to compile the material\n\n"
+            "   --cache-dir=<path>, -C <path>\n"
+            "       Reuse the shaders compiled by previous runs, stored in this directory\n\n"
+            "   --compress, -Z\n"
+            "       Compress the shaders of the material package\n\n"
             "   --version, -v\n"
             "       Print the material version number\n\n"
             "Internal use and debugging only:\n"
@@ -111,7 +125,7 @@ CommandlineConfig::CommandlineConfig(int argc, char** argv) : Config(), mArgc(ar
 }
 
 bool CommandlineConfig::parse() {
-    static constexpr const char* OPTSTR = "hlxo:f:dm:a:p:OSEr:vV:g";
+    static constexpr const char* OPTSTR = "hlxo:f:dm:a:p:OSEr:vV:u:gj:TC:Z";
     static const struct option OPTIONS[] = {
             { "help",                    no_argument, nullptr, 'h' },
             { "license",                 no_argument, nullptr, 'l' },
@@ -120,6 +134,7 @@ bool CommandlineConfig::parse() {
             { "debug",                   no_argument, nullptr, 'd' },
             { "mode",              required_argument, nullptr, 'm' },
             { "variant-filter",    required_argument, nullptr, 'V' },
+            { "variant-usage",     required_argument, nullptr, 'u' },
             { "platform",          required_argument, nullptr, 'p' },
             { "optimize",                no_argument, nullptr, 'x' }, // for backward compatibility
             { "optimize",                no_argument, nullptr, 'O' }, // for backward compatibility
@@ -130,6 +145,10 @@ bool CommandlineConfig::parse() {
             { "reflect",           required_argument, nullptr, 'r' },
             { "print",                   no_argument, nullptr, 't' },
             { "version",                 no_argument, nullptr, 'v' },
+            { "jobs",              required_argument, nullptr, 'j' },
+            { "timing",                  no_argument, nullptr, 'T' },
+            { "cache-dir",         required_argument, nullptr, 'C' },
+            { "compress",                no_argument, nullptr, 'Z' },
             { nullptr, 0, nullptr, 0 }  // termination of the option list
     };
 
@@ -216,6 +235,9 @@ bool CommandlineConfig::parse() {
             case 'V':
                 mVariantFilter = parseVariantFilter(arg);
                 break;
+            case 'u':
+                mVariantUsageReport = arg;
+                break;
             // These 2 flags are supported for backward compatibility
             case 'O':
             case 'x':
@@ -236,6 +258,24 @@ bool CommandlineConfig::parse() {
             case 't':
                 mPrintShaders = true;
                 break;
+            case 'j': {
+                int jobCount = atoi(arg.c_str());
+                if (jobCount <= 0) {
+                    std::cerr << "The number of jobs must be a positive integer." << std::endl;
+                    return false;
+                }
+                mJobCount = uint32_t(jobCount);
+                break;
+            }
+            case 'T':
+                mPrintTimings = true;
+                break;
+            case 'C':
+                mCacheDirectory = arg;
+                break;
+            case 'Z':
+                mCompression = true;
+                break;
         }
     }
 
@@ -24,6 +24,7 @@
 
 #include <memory>
 #include <ostream>
+#include <string>
 
 #include <utils/compiler.h>
 
@@ -119,6 +120,29 @@ public:
         return mVariantFilter;
     }
 
+    // number of threads used to compile shaders, 0 means one per core
+    uint32_t getJobCount() const noexcept {
+        return mJobCount;
+    }
+
+    bool printTimings() const noexcept {
+        return mPrintTimings;
+    }
+
+    // directory of the compiled shaders cache, empty if the cache is disabled
+    std::string const& getCacheDirectory() const noexcept {
+        return mCacheDirectory;
+    }
+
+    bool compression() const noexcept {
+        return mCompression;
+    }
+
+    // report of the variants used by the engine, empty to keep all variants
+    std::string const& getVariantUsageReport() const noexcept {
+        return mVariantUsageReport;
+    }
+
 protected:
     bool mDebug = false;
     bool mIsValid = true;
@@ -130,6 +154,11 @@ protected:
     OutputFormat mOutputFormat = OutputFormat::BLOB;
     TargetApi mTargetApi = TargetApi::OPENGL;
     uint8_t mVariantFilter = 0;
+    uint32_t mJobCount = 0;
+    bool mPrintTimings = false;
+    std::string mCacheDirectory;
+    bool mCompression = false;
+    std::string mVariantUsageReport;
 };
 
 }
@@ -17,13 +17,18 @@
 #include "MaterialCompiler.h"
 
 #include <functional>
+#include <fstream>
 #include <memory>
 #include <iostream>
+#include <sstream>
 
 #include <filamat/MaterialBuilder.h>
+#include <filamat/ShaderCache.h>
 
 #include <filamat/Enums.h>
 
+#include <utils/JobSystem.h>
+
 #include "MaterialLexeme.h"
 #include "MaterialLexer.h"
 #include "JsonishLexer.h"
@@ -205,6 +210,27 @@ static bool reflectParameters(const MaterialBuilder& builder) {
     return true;
 }
 
+// Reads the variants used by the given material from a report written by
+// Engine::getVariantUsageReport(). Returns false if the report doesn't list the material.
+static bool readVariantUsage(std::istream& report, const char* name, uint32_t* usedVariants) {
+    bool found = false;
+    std::string line;
+    while (std::getline(report, line)) {
+        std::istringstream fields(line);
+        uint32_t mask;
+        std::string materialName;
+        if (!(fields >> std::hex >> mask) || !std::getline(fields >> std::ws, materialName)) {
+            continue;
+        }
+        if (materialName == name) {
+            // the same material can be listed by several concatenated reports
+            *usedVariants = found ? (*usedVariants | mask) : mask;
+            found = true;
+        }
+    }
+    return found;
+}
+
 bool MaterialCompiler::isValidJsonStart(const char* buffer, size_t size) const noexcept {
     // Skip all whitespace characters.
     const char* end = buffer + size;
@@ -272,11 +298,64 @@ bool MaterialCompiler::run(const Config& config) {
         .targetApi(config.getTargetApi())
         .optimization(config.getOptimizationLevel())
         .printShaders(config.printShaders())
+        .compression(config.compression())
         .variantFilter(config.getVariantFilter() | builder.getVariantFilter());
 
+    // Shaders are compiled on a JobSystem, unless we were asked to use a single thread. The
+    // JobSystem's threads are in addition to this thread.
+    std::unique_ptr<utils::JobSystem> jobSystem;
+    if (config.getJobCount() != 1) {
+        jobSystem.reset(new utils::JobSystem(
+                config.getJobCount() ? config.getJobCount() - 1 : 0));
+        jobSystem->adopt();
+        builder.jobSystem(jobSystem.get());
+    }
+
+    if (!config.getVariantUsageReport().empty()) {
+        std::ifstream report(config.getVariantUsageReport());
+        if (!report) {
+            std::cerr << "Could not open the variant usage report "
+                    << config.getVariantUsageReport() << std::endl;
+            return false;
+        }
+        uint32_t usedVariants;
+        if (readVariantUsage(report, builder.getName().c_str_safe(), &usedVariants)) {
+            builder.usedVariants(usedVariants);
+        } else {
+            std::cerr << "Warning: the variant usage report doesn't list the material \""
+                    << builder.getName().c_str_safe() << "\", all its variants are kept."
+                    << std::endl;
+        }
+    }
+
+    std::unique_ptr<ShaderCache> shaderCache;
+    if (!config.getCacheDirectory().empty()) {
+        shaderCache.reset(new ShaderCache(config.getCacheDirectory().c_str()));
+        builder.shaderCache(shaderCache.get());
+    }
+
     // Write builder.build() to output.
     Package package = builder.build();
     MaterialBuilder::shutdown();
+
+    if (jobSystem) {
+        jobSystem->emancipate();
+        jobSystem.reset();
+    }
+
+    if (config.printTimings()) {
+        MaterialBuilder::BuildStats const& stats = builder.getBuildStats();
+        std::cout << input->getName() << ": "
+                << stats.shaderCount << " shaders compiled in " << stats.compileTime << " ms"
+                << " (" << stats.shaderCompileTime << " ms of cumulated shader compile time)"
+                << ", package built in " << stats.packageTime << " ms";
+        if (shaderCache) {
+            std::cout << ", " << stats.cacheHits << " cache hits, "
+                    << stats.cacheMisses << " cache misses";
+        }
+        std::cout << std::endl;
+    }
+
     if (!package.isValid()) {
         std::cerr << "Could not compile material " << input->getName() << std::endl;
         return false;
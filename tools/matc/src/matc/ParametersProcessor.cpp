@@ -32,6 +32,7 @@ namespace matc {
 static constexpr const char* PARAM_KEY_NAME                     = "name";
 static constexpr const char* PARAM_KEY_INTERPOLATION            = "interpolation";
 static constexpr const char* PARAM_KEY_PARAMETERS               = "parameters";
+static constexpr const char* PARAM_KEY_CONSTANTS                = "constants";
 static constexpr const char* PARAM_KEY_VARIABLES                = "variables";
 static constexpr const char* PARAM_KEY_REQUIRES                 = "requires";
 static constexpr const char* PARAM_KEY_BLENDING                 = "blending";
@@ -55,6 +56,7 @@ ParametersProcessor::ParametersProcessor() {
     mConfigProcessor[PARAM_KEY_NAME]              = &ParametersProcessor::processName;
     mConfigProcessor[PARAM_KEY_INTERPOLATION]     = &ParametersProcessor::processInterpolation;
     mConfigProcessor[PARAM_KEY_PARAMETERS]        = &ParametersProcessor::processParameters;
+    mConfigProcessor[PARAM_KEY_CONSTANTS]         = &ParametersProcessor::processConstants;
     mConfigProcessor[PARAM_KEY_VARIABLES]         = &ParametersProcessor::processVariables;
     mConfigProcessor[PARAM_KEY_REQUIRES]          = &ParametersProcessor::processRequires;
     mConfigProcessor[PARAM_KEY_BLENDING]          = &ParametersProcessor::processBlending;
@@ -80,6 +82,7 @@ ParametersProcessor::ParametersProcessor() {
     mRootAsserts[PARAM_KEY_NAME]                     = JsonishValue::Type::STRING;
     mRootAsserts[PARAM_KEY_INTERPOLATION]            = JsonishValue::Type::STRING;
     mRootAsserts[PARAM_KEY_PARAMETERS]               = JsonishValue::Type::ARRAY;
+    mRootAsserts[PARAM_KEY_CONSTANTS]                = JsonishValue::Type::ARRAY;
     mRootAsserts[PARAM_KEY_VARIABLES]                = JsonishValue::Type::ARRAY;
     mRootAsserts[PARAM_KEY_REQUIRES]                 = JsonishValue::Type::ARRAY;
     mRootAsserts[PARAM_KEY_BLENDING]                 = JsonishValue::Type::STRING;
@@ -137,6 +140,9 @@ ParametersProcessor::ParametersProcessor() {
     mStringToVariant["dynamicLighting"] = filament::Variant::DYNAMIC_LIGHTING;
     mStringToVariant["shadowReceiver"] = filament::Variant::SHADOW_RECEIVER;
     mStringToVariant["skinning"] = filament::Variant::SKINNING;
+
+    mStringToConstantType["bool"] = MaterialBuilder::ConstantType::BOOL;
+    mStringToConstantType["int"] = MaterialBuilder::ConstantType::INT;
 }
 
 bool ParametersProcessor::process(filamat::MaterialBuilder& builder, const JsonishObject& jsonObject) {
@@ -198,6 +204,65 @@ bool ParametersProcessor::processParameters(filamat::MaterialBuilder& builder,
     return ok;
 }
 
+bool ParametersProcessor::processConstants(filamat::MaterialBuilder& builder,
+        const JsonishValue& v) {
+    auto jsonArray = v.toJsonArray();
+
+    for (auto value : jsonArray->getElements()) {
+        if (value->getType() != JsonishValue::Type::OBJECT) {
+            std::cerr << PARAM_KEY_CONSTANTS << " must be an array of OBJECTs." << std::endl;
+            return false;
+        }
+        if (!processConstant(builder, *value->toJsonObject())) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ParametersProcessor::processConstant(filamat::MaterialBuilder& builder,
+        const JsonishObject& jsonObject) const noexcept {
+
+    const JsonishValue* typeValue = jsonObject.getValue("type");
+    if (!typeValue || typeValue->getType() != JsonishValue::STRING) {
+        std::cerr << PARAM_KEY_CONSTANTS << ": entry without a STRING 'type' key." << std::endl;
+        return false;
+    }
+
+    const JsonishValue* nameValue = jsonObject.getValue("name");
+    if (!nameValue || nameValue->getType() != JsonishValue::STRING) {
+        std::cerr << PARAM_KEY_CONSTANTS << ": entry without a STRING 'name' key." << std::endl;
+        return false;
+    }
+
+    auto typeString = typeValue->toJsonString();
+    if (!isStringValidEnum(mStringToConstantType, typeString->getString())) {
+        return logEnumIssue(PARAM_KEY_CONSTANTS, *typeString, mStringToConstantType);
+    }
+    auto type = stringToEnum(mStringToConstantType, typeString->getString());
+    auto nameString = nameValue->toJsonString()->getString();
+
+    int32_t defaultValue = 0;
+    const JsonishValue* defaultJsonValue = jsonObject.getValue("default");
+    if (defaultJsonValue) {
+        if (type == MaterialBuilder::ConstantType::BOOL &&
+                defaultJsonValue->getType() == JsonishValue::BOOL) {
+            defaultValue = defaultJsonValue->toJsonBool()->getBool() ? 1 : 0;
+        } else if (type == MaterialBuilder::ConstantType::INT &&
+                defaultJsonValue->getType() == JsonishValue::NUMBER) {
+            defaultValue = int32_t(defaultJsonValue->toJsonNumber()->getFloat());
+        } else {
+            std::cerr << PARAM_KEY_CONSTANTS << ": the default value of constant '" << nameString
+                    << "' must be a " << (type == MaterialBuilder::ConstantType::BOOL ?
+                            "BOOL." : "NUMBER.") << std::endl;
+            return false;
+        }
+    }
+
+    builder.constant(type, nameString.c_str(), defaultValue);
+    return true;
+}
+
 /**
  * Parses the supplied type string to return the array size it defines, or 0
  * if the type is not an array. If the type is an array, the type string is
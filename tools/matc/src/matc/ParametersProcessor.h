@@ -39,6 +39,7 @@ private:
     bool processName(filamat::MaterialBuilder &builder, const JsonishValue &value);
     bool processInterpolation(filamat::MaterialBuilder &builder, const JsonishValue &value);
     bool processParameters(filamat::MaterialBuilder &builder, const JsonishValue &value);
+    bool processConstants(filamat::MaterialBuilder &builder, const JsonishValue &value);
     bool processVariables(filamat::MaterialBuilder &builder, const JsonishValue &value);
     bool processRequires(filamat::MaterialBuilder &builder, const JsonishValue &value);
     bool processBlending(filamat::MaterialBuilder &builder, const JsonishValue &value);
@@ -59,6 +60,8 @@ private:
     bool processVariantFilter(filamat::MaterialBuilder &builder, const JsonishValue &value);
     bool processParameter(filamat::MaterialBuilder& builder, const JsonishObject& value) const
     noexcept;
+    bool processConstant(filamat::MaterialBuilder& builder, const JsonishObject& value) const
+    noexcept;
 
     template <class T>
     bool logEnumIssue(const std::string& key, const JsonishString& value,
@@ -103,6 +106,7 @@ private:
     std::unordered_map<std::string, filament::VertexAttribute> mStringToAttributeIndex;
     std::unordered_map<std::string, filamat::MaterialBuilder::Shading> mStringToShading;
     std::unordered_map<std::string, uint8_t> mStringToVariant;
+    std::unordered_map<std::string, filamat::MaterialBuilder::ConstantType> mStringToConstantType;
 };
 
 } // namespace matc
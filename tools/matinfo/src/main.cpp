@@ -505,7 +505,7 @@ static bool printMaterial(const ChunkContainer& container) {
     return true;
 }
 
-static bool printParametersInfo(ChunkContainer container) {
+static bool printParametersInfo(ChunkContainer const& container) {
     if (!container.hasChunk(filamat::ChunkType::MaterialUib)) {
         return true;
     }
@@ -616,17 +616,32 @@ static void printChunks(const ChunkContainer& container) {
     std::cout << "Chunks:" << std::endl;
 
     std::cout << "    " << std::setw(9) << std::left << "Name ";
-    std::cout << std::setw(7) << std::right << "Size" << std::endl;
+    std::cout << std::setw(7) << std::right << "Size";
+    std::cout << std::setw(12) << std::right << "Compressed" << std::endl;
 
+    size_t totalSize = 0;
+    size_t totalStoredSize = 0;
     size_t count = container.getChunkCount();
     for (size_t i = 0; i < count; i++) {
         auto chunk = container.getChunk(i);
         std::cout << "    " << typeToString(chunk.type).c_str() << " ";
-        std::cout << std::setw(7) << std::right << chunk.desc.size << std::endl;
+        std::cout << std::setw(7) << std::right << chunk.desc.size;
+        if (chunk.desc.compressedSize) {
+            std::cout << std::setw(12) << std::right << chunk.desc.compressedSize;
+        }
+        std::cout << std::endl;
+        totalSize += chunk.desc.size;
+        totalStoredSize += chunk.desc.compressedSize ? chunk.desc.compressedSize : chunk.desc.size;
+    }
+
+    if (totalStoredSize != totalSize) {
+        std::cout << "    " << std::setw(9) << std::left << "Total ";
+        std::cout << std::setw(7) << std::right << totalSize;
+        std::cout << std::setw(12) << std::right << totalStoredSize << std::endl;
     }
 }
 
-static bool getMetalShaderInfo(ChunkContainer container, std::vector<ShaderInfo>* info) {
+static bool getMetalShaderInfo(ChunkContainer const& container, std::vector<ShaderInfo>* info) {
     if (!container.hasChunk(filamat::ChunkType::MaterialMetal)) {
         return true; // that's not an error, a material can have no metal stuff
     }
@@ -676,7 +691,7 @@ static bool getMetalShaderInfo(ChunkContainer container, std::vector<ShaderInfo>
     return true;
 }
 
-static bool getGlShaderInfo(ChunkContainer container, std::vector<ShaderInfo>* info) {
+static bool getGlShaderInfo(ChunkContainer const& container, std::vector<ShaderInfo>* info) {
     if (!container.hasChunk(filamat::ChunkType::MaterialGlsl)) {
         return true; // that's not an error, a material can have no glsl stuff
     }
@@ -725,7 +740,7 @@ static bool getGlShaderInfo(ChunkContainer container, std::vector<ShaderInfo>* i
     return true;
 }
 
-static bool getVkShaderInfo(ChunkContainer container, std::vector<ShaderInfo>* info) {
+static bool getVkShaderInfo(ChunkContainer const& container, std::vector<ShaderInfo>* info) {
     if (!container.hasChunk(filamat::ChunkType::MaterialSpirv)) {
         return true; // that's not an error, a material can have no spirv stuff
     }
@@ -790,7 +805,7 @@ static void printShaderInfo(const std::vector<ShaderInfo>& info) {
     std::cout << std::endl;
 }
 
-static bool printGlslInfo(ChunkContainer container) {
+static bool printGlslInfo(ChunkContainer const& container) {
     std::vector<ShaderInfo> info;
     if (!getGlShaderInfo(container, &info)) {
         return false;
@@ -800,7 +815,7 @@ static bool printGlslInfo(ChunkContainer container) {
     return true;
 }
 
-static bool printVkInfo(ChunkContainer container) {
+static bool printVkInfo(ChunkContainer const& container) {
     std::vector<ShaderInfo> info;
     if (!getVkShaderInfo(container, &info)) {
         return false;
@@ -810,7 +825,7 @@ static bool printVkInfo(ChunkContainer container) {
     return true;
 }
 
-static bool printMetalInfo(ChunkContainer container) {
+static bool printMetalInfo(ChunkContainer const& container) {
     std::vector<ShaderInfo> info;
     if (!getMetalShaderInfo(container, &info)) {
         return false;